@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+
+# Restart loop around a device executable, as expected by the --restart-expendable option of the ODC server.
+# DDS does not start tasks again, the loop keeps the DDS task alive and starts the device again after it failed.
+# odc-ex-launcher.sh <numRuns> <delay> <executable> [<args>...] [-- <args of the first run only>]
+# The arguments after "--" are passed to the first run only, e.g. to let it fail on purpose.
+
+if [[ "$#" -lt 3 ]]; then
+    echo "Illegal arguments. Usage: odc-ex-launcher.sh <numRuns> <delay> <executable> [<args>...] [-- <args of the first run only>]."
+    exit 1
+fi
+
+numRuns=$1
+delay=$2
+shift 2
+
+cmd=()
+while [[ "$#" -gt 0 && "$1" != "--" ]]; do
+    cmd+=("$1")
+    shift
+done
+firstArgs=()
+if [[ "$#" -gt 0 ]]; then
+    shift
+    firstArgs=("$@")
+fi
+
+status=0
+for ((run = 1; run <= numRuns; ++run)); do
+    if [[ ${run} -eq 1 ]]; then
+        "${cmd[@]}" "${firstArgs[@]}"
+    else
+        "${cmd[@]}"
+    fi
+    status=$?
+    if [[ ${status} -eq 0 ]]; then
+        exit 0
+    fi
+    echo "odc-ex-launcher: run ${run} of ${numRuns} exited with ${status}"
+    if [[ ${run} -lt ${numRuns} ]]; then
+        sleep "${delay}"
+    fi
+done
+exit ${status}
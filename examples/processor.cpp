@@ -10,6 +10,7 @@
 #include <fairmq/Device.h>
 #include <fairmq/runDevice.h>
 
+#include <cstdint> // uint64_t
 #include <cstdlib> // getenv
 #include <chrono>
 #include <regex>
@@ -28,7 +29,8 @@ struct Processor : fair::mq::Device
         const std::string& ddsTaskPath,
         const std::string& problemState,
         const std::string& currentState,
-        const std::string& problem)
+        const std::string& problem,
+        uint64_t delayMs = 0)
     {
         if (!problemPaths.empty() && !problemState.empty()) {
             if (problemState != currentState) {
@@ -36,7 +38,7 @@ struct Processor : fair::mq::Device
             }
 
             bool crash = true;
-            if (problem == "hang") {
+            if (problem == "hang" || problem == "delay") {
                 crash = false;
             } else if (problem == "crash") {
                 crash = true;
@@ -51,6 +53,9 @@ struct Processor : fair::mq::Device
                         << ", simulating a " << problem << ">>>";
                     if (crash) {
                         throw std::runtime_error("Instructed to crash. throwing runtime_error");
+                    } else if (problem == "delay") {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+                        return;
                     } else {
                         while (true) {
                             LOG(info) << "hanging...";
@@ -76,16 +81,21 @@ struct Processor : fair::mq::Device
             }
         });
 
-        std::string ddsTaskPath(std::getenv("DDS_TASK_PATH"));
+        ddsTaskPath = std::getenv("DDS_TASK_PATH");
         LOG(info) << "DDS_TASK_PATH: " << ddsTaskPath;
 
         problemPaths = GetConfig()->GetProperty<std::vector<std::string>>("problem-paths", std::vector<std::string>());
         problem = GetConfig()->GetProperty<std::string>("problem", std::string());
         problemState = GetConfig()->GetProperty<std::string>("problem-state", std::string());
+        problemDelay = GetConfig()->GetProperty<uint64_t>("problem-delay", 0);
 
-        HangOrCrash(problemPaths, ddsTaskPath, problemState, "init", problem);
+        HangOrCrash(problemPaths, ddsTaskPath, problemState, "init", problem, problemDelay);
     }
 
+    void ResetTask() override { HangOrCrash(problemPaths, ddsTaskPath, problemState, "reset-task", problem, problemDelay); }
+
+    void Reset() override { HangOrCrash(problemPaths, ddsTaskPath, problemState, "reset-device", problem, problemDelay); }
+
     bool HandleData(fair::mq::MessagePtr& msg, int)
     {
         // LOG(info) << "Received data, processing...";
@@ -106,9 +116,11 @@ struct Processor : fair::mq::Device
         return true;
     }
 
+    std::string ddsTaskPath;
     std::vector<std::string> problemPaths;
     std::string problem;
     std::string problemState;
+    uint64_t problemDelay = 0;
     bool selfDestruct = false;
     int taskIndex = 0;
     int collectionIndex = 0;
@@ -118,8 +130,9 @@ void addCustomOptions(bpo::options_description& options)
 {
     options.add_options()
         ("problem-paths", bpo::value<std::vector<std::string>>()->multitoken()->composing(), "Set of topology paths for which task should hang/crash.")
-        ("problem",       bpo::value<std::string>()->default_value("crash"), "Problem to simulate = crash/hang")
-        ("problem-state", bpo::value<std::string>()->default_value(""), "State to simulate hanging/crashing in, default = no hanging. pre-idle/init");
+        ("problem",       bpo::value<std::string>()->default_value("crash"), "Problem to simulate = crash/hang/delay")
+        ("problem-state", bpo::value<std::string>()->default_value(""), "State to simulate hanging/crashing in, default = no hanging. pre-idle/init/reset-task/reset-device")
+        ("problem-delay", bpo::value<uint64_t>()->default_value(0), "Duration of a simulated delay in milliseconds");
 }
 
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& config) {
@@ -129,8 +142,9 @@ std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& config) {
     std::vector<std::string> problemPaths = config.GetProperty<std::vector<std::string>>("problem-paths", std::vector<std::string>());
     std::string problem = config.GetProperty<std::string>("problem", std::string());
     std::string problemState = config.GetProperty<std::string>("problem-state", std::string());
+    uint64_t problemDelay = config.GetProperty<uint64_t>("problem-delay", 0);
 
-    Processor::HangOrCrash(problemPaths, ddsTaskPath, problemState, "pre-idle", problem);
+    Processor::HangOrCrash(problemPaths, ddsTaskPath, problemState, "pre-idle", problem, problemDelay);
 
     return std::make_unique<Processor>();
 }
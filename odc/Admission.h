@@ -0,0 +1,148 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_ADMISSION
+#define ODC_CORE_ADMISSION
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
+namespace odc::core {
+
+/**
+ * @brief Admission of the requests of one partition.
+ *
+ * Requests on the whole partition (Run, Update, Shutdown, ...) are processed one at a time.
+ * Requests on a set of tasks (Configure, SetProperties, ...) run concurrently with each other, as long as their task sets do not overlap.
+ * Pending requests on the whole partition take precedence over newly arriving requests on tasks, so that they are not starved.
+ */
+class Admission
+{
+  public:
+    using Tasks = std::unordered_set<uint64_t>;
+
+    /// Admitted request, released on destruction
+    class Ticket
+    {
+      public:
+        Ticket(Admission& admission, uint64_t id)
+            : mAdmission(&admission)
+            , mID(id)
+        {}
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        Ticket(Ticket&& other) noexcept
+            : mAdmission(other.mAdmission)
+            , mID(other.mID)
+        {
+            other.mAdmission = nullptr;
+        }
+        Ticket& operator=(Ticket&&) = delete;
+        ~Ticket()
+        {
+            if (mAdmission != nullptr) {
+                mAdmission->release(mID);
+            }
+        }
+
+      private:
+        Admission* mAdmission;
+        uint64_t mID; ///< 0 for requests on the whole partition
+    };
+
+    Admission() = default;
+    Admission(const Admission&) = delete;
+    Admission& operator=(const Admission&) = delete;
+
+    /// @brief Wait until no other request of the partition is in progress
+    Ticket admitPartition()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        admitPartition(lock);
+        return Ticket(*this, 0);
+    }
+
+    /// @brief Wait until no request on the whole partition and no request on an overlapping task set is in progress
+    /// @param resolve returns the task set of the request. It is called with no request on the whole partition in progress, and again after each one.
+    ///                An empty task set (e.g. partition without topology) is admitted like a request on the whole partition.
+    template<typename Resolve>
+    Ticket admitTasks(Resolve&& resolve)
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        while (true) {
+            mCV.wait(lock, [&]() { return !mExclusive && mNumExclusiveWaiting == 0; });
+            Tasks tasks = resolve();
+            if (tasks.empty()) {
+                admitPartition(lock);
+                return Ticket(*this, 0);
+            }
+            mCV.wait(lock, [&]() { return mExclusive || mNumExclusiveWaiting > 0 || !overlaps(tasks); });
+            if (!mExclusive && mNumExclusiveWaiting == 0) {
+                const uint64_t id = ++mLastID;
+                mActive.emplace(id, std::move(tasks));
+                return Ticket(*this, id);
+            }
+            // a request on the whole partition came first and may change the topology: resolve again after it
+        }
+    }
+
+    /// @brief Number of admitted requests on task sets
+    size_t numActive() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mActive.size();
+    }
+
+  private:
+    // precondition: lock holds mMtx
+    void admitPartition(std::unique_lock<std::mutex>& lock)
+    {
+        ++mNumExclusiveWaiting;
+        mCV.wait(lock, [&]() { return !mExclusive && mActive.empty(); });
+        --mNumExclusiveWaiting;
+        mExclusive = true;
+    }
+
+    // precondition: mMtx is locked
+    bool overlaps(const Tasks& tasks) const
+    {
+        return std::any_of(mActive.begin(), mActive.end(), [&](const auto& active) {
+            const Tasks& smaller = active.second.size() < tasks.size() ? active.second : tasks;
+            const Tasks& larger = active.second.size() < tasks.size() ? tasks : active.second;
+            return std::any_of(smaller.begin(), smaller.end(), [&](uint64_t task) { return larger.count(task) > 0; });
+        });
+    }
+
+    void release(uint64_t id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            if (id == 0) {
+                mExclusive = false;
+            } else {
+                mActive.erase(id);
+            }
+        }
+        mCV.notify_all();
+    }
+
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;
+    bool mExclusive{ false };          ///< a request on the whole partition is in progress
+    size_t mNumExclusiveWaiting{ 0 };  ///< requests on the whole partition waiting for admission
+    uint64_t mLastID{ 0 };             ///< last ID given to a request on a task set
+    std::map<uint64_t, Tasks> mActive; ///< task sets of admitted requests, by ID
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_ADMISSION
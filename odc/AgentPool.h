@@ -0,0 +1,341 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_AGENTPOOL
+#define ODC_CORE_AGENTPOOL
+
+#include <odc/DDSSubmit.h>
+#include <odc/Logger.h>
+#include <odc/MiscUtils.h>
+#include <odc/Params.h>
+
+#include <dds/Tools.h>
+
+#include <boost/uuid/uuid_io.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace odc::core
+{
+
+/**
+ * @class AgentPool
+ * @brief Pre-warmed DDS agents, kept idle in dedicated DDS sessions until a partition adopts them
+ *
+ * Each pool entry is a DDS session with agents submitted for one agent group of one zone.
+ * DDS agents cannot move between sessions, therefore a partition adopts the whole pooled session
+ * and submits any remaining agents into it. Adopted entries are refilled in the background.
+ * Pooled sessions outlive their handle, the partition that takes one is responsible for it.
+ * Ready entries whose session stopped are refilled and not handed out.
+ *
+ * @par Thread Safety
+ * Safe.
+ */
+class AgentPool
+{
+  public:
+    /// Pooled session handed over to a partition
+    struct Lease
+    {
+        std::string mSessionID;   ///< DDS session holding the agents
+        DDSSubmitParams mParams;  ///< Parameters the agents were submitted with
+        size_t mParamsIndex = 0;  ///< Index of the matched entry in the requested parameters
+    };
+
+    AgentPool() = default;
+    AgentPool(const AgentPool&) = delete;
+    AgentPool& operator=(const AgentPool&) = delete;
+
+    ~AgentPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mStop = true;
+        }
+        mCV.notify_all();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+        // pooled sessions are owned by ODC, not by a partition
+        for (auto& entry : mEntries) {
+            shutdown(entry);
+        }
+    }
+
+    /// @brief Configure the pool and start filling it in the background
+    /// @param specs submit parameters of the pool entries, one DDS session each
+    /// @param fillTimeout maximum time to wait for the agents of an entry to become active
+    /// @param retryInterval interval of the checks of ready entries and of the retries of failed ones
+    void configure(const std::vector<DDSSubmitParams>& specs, std::chrono::seconds fillTimeout = std::chrono::seconds(600), std::chrono::seconds retryInterval = std::chrono::seconds(30))
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mThread.joinable()) {
+            throw std::runtime_error("Agent pool is already configured");
+        }
+        mFillTimeout = fillTimeout;
+        mRetryInterval = retryInterval;
+        for (const auto& spec : specs) {
+            Entry entry;
+            entry.mParams = spec;
+            entry.mParams.mMinAgents = -1;
+            mEntries.push_back(std::move(entry));
+            OLOG(info) << "Agent pool entry: " << spec;
+        }
+        if (!mEntries.empty()) {
+            mThread = std::thread(&AgentPool::run, this);
+        }
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mEntries.empty();
+    }
+
+    /// @brief Take the ready pool entry that covers most of the requested slots
+    /// @param params requested submit parameters. An entry matches if everything but the number of agents is equal and it has no more agents than requested.
+    /// @return lease of the pooled session, nothing if no ready entry matches. The session keeps running, the caller has to shut it down if it does not use it.
+    std::optional<Lease> take(const std::vector<DDSSubmitParams>& params)
+    {
+        std::optional<Lease> lease;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            while (!lease) {
+                Entry* best = nullptr;
+                size_t bestSlots = 0;
+                size_t bestIndex = 0;
+                for (auto& entry : mEntries) {
+                    if (entry.mState != EntryState::Ready) {
+                        continue;
+                    }
+                    for (size_t i = 0; i < params.size(); ++i) {
+                        if (matches(entry.mParams, params.at(i))) {
+                            const size_t slots = entry.mParams.mNumAgents * entry.mParams.mNumSlots;
+                            if (slots > bestSlots) {
+                                best = &entry;
+                                bestSlots = slots;
+                                bestIndex = i;
+                            }
+                        }
+                    }
+                }
+                if (best == nullptr) {
+                    break;
+                }
+                if (expire(*best)) {
+                    continue;
+                }
+                lease = Lease{ boost::uuids::to_string(best->mSession->getSessionID()), best->mParams, bestIndex };
+                // the partition attaches on its own, the pool only drops its handle, which does not stop the session
+                best->mSession.reset();
+                best->mState = EntryState::Empty;
+                ++best->mNumAdopted;
+            }
+        }
+        // refill taken and expired entries
+        mCV.notify_all();
+        return lease;
+    }
+
+    std::vector<AgentPoolStatus> status() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        std::vector<AgentPoolStatus> result;
+        for (const auto& entry : mEntries) {
+            AgentPoolStatus s;
+            s.mZone = entry.mParams.mZone;
+            s.mAgentGroup = entry.mParams.mAgentGroup;
+            s.mNumAgents = entry.mParams.mNumAgents;
+            s.mNumSlots = entry.mParams.mNumSlots;
+            s.mState = toString(entry.mState);
+            s.mDDSSessionID = entry.mSession ? boost::uuids::to_string(entry.mSession->getSessionID()) : "";
+            s.mNumAdopted = entry.mNumAdopted;
+            result.push_back(s);
+        }
+        return result;
+    }
+
+  private:
+    enum class EntryState
+    {
+        Empty,
+        Filling,
+        Ready,
+        Failed
+    };
+
+    friend std::ostream& operator<<(std::ostream& os, EntryState state)
+    {
+        switch (state) {
+            case EntryState::Empty:   return os << "EMPTY";
+            case EntryState::Filling: return os << "FILLING";
+            case EntryState::Ready:   return os << "READY";
+            case EntryState::Failed:  return os << "FAILED";
+        }
+        return os;
+    }
+
+    struct Entry
+    {
+        DDSSubmitParams mParams;
+        std::unique_ptr<dds::tools_api::CSession> mSession;
+        EntryState mState = EntryState::Empty;
+        std::chrono::steady_clock::time_point mRetryAt;
+        uint64_t mNumAdopted = 0;
+    };
+
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;
+    std::vector<Entry> mEntries;
+    std::thread mThread;
+    bool mStop = false;
+    std::chrono::seconds mFillTimeout{ 600 };
+    std::chrono::seconds mRetryInterval{ 30 };
+
+    static bool matches(const DDSSubmitParams& pooled, const DDSSubmitParams& requested)
+    {
+        return pooled.mRMS == requested.mRMS
+            && pooled.mZone == requested.mZone
+            && pooled.mAgentGroup == requested.mAgentGroup
+            && pooled.mNumSlots == requested.mNumSlots
+            && pooled.mNumCores == requested.mNumCores
+            && pooled.mConfigFile == requested.mConfigFile
+            && pooled.mEnvFile == requested.mEnvFile
+            && pooled.mNumAgents <= requested.mNumAgents;
+    }
+
+    // precondition: mMtx is locked
+    /// @brief Drop a ready entry whose session stopped, e.g. because its commander or agents were shut down from outside
+    /// @return true if the entry expired and has to be refilled
+    bool expire(Entry& entry)
+    {
+        bool running = false;
+        try {
+            running = entry.mSession && entry.mSession->IsRunning();
+        } catch (const std::exception& e) {
+            OLOG(error) << "Agent pool: failed checking DDS session: " << e.what();
+        }
+        if (running) {
+            return false;
+        }
+        OLOG(warning) << "Agent pool: DDS session of the entry for agent group " << std::quoted(entry.mParams.mAgentGroup) << " is not running anymore, refilling it";
+        shutdown(entry);
+        entry.mState = EntryState::Empty;
+        return true;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        while (!mStop) {
+            for (auto& entry : mEntries) {
+                if (entry.mState == EntryState::Ready) {
+                    expire(entry);
+                }
+            }
+            const auto now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < mEntries.size() && !mStop; ++i) {
+                Entry& entry = mEntries.at(i);
+                if (entry.mState == EntryState::Empty || (entry.mState == EntryState::Failed && now >= entry.mRetryAt)) {
+                    entry.mState = EntryState::Filling;
+                    const DDSSubmitParams params = entry.mParams;
+                    lock.unlock();
+                    auto session = fill(params);
+                    lock.lock();
+                    if (session) {
+                        entry.mSession = std::move(session);
+                        entry.mState = EntryState::Ready;
+                    } else {
+                        entry.mState = EntryState::Failed;
+                        entry.mRetryAt = std::chrono::steady_clock::now() + mRetryInterval;
+                    }
+                }
+            }
+            mCV.wait_for(lock, mRetryInterval);
+        }
+    }
+
+    // runs without the lock
+    std::unique_ptr<dds::tools_api::CSession> fill(const DDSSubmitParams& params)
+    {
+        using namespace dds::tools_api;
+        auto session = std::make_unique<CSession>();
+        try {
+            const auto sessionID = session->create();
+            // pooled sessions outlive their handle: the pool drops it when a partition takes the session
+            session->setStopOnDestroy(false);
+            OLOG(info) << "Agent pool: filling DDS session " << sessionID << " with " << params;
+
+            std::mutex mtx;
+            std::condition_variable cv;
+            bool done = false;
+            bool failed = false;
+            SSubmitRequest::ptr_t requestPtr = SSubmitRequest::makeRequest(makeDDSSubmitRequest(params, "odc-agent-pool"));
+            requestPtr->setMessageCallback([&failed, &mtx](const SMessageResponseData& msg) {
+                if (msg.m_severity == dds::intercom_api::EMsgSeverity::error) {
+                    OLOG(error) << "Agent pool: submit error: " << msg.m_msg;
+                    std::lock_guard<std::mutex> lock(mtx);
+                    failed = true;
+                }
+            });
+            requestPtr->setDoneCallback([&done, &mtx, &cv]() {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    done = true;
+                }
+                cv.notify_all();
+            });
+            session->sendRequest<SSubmitRequest>(requestPtr);
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait_for(lock, mFillTimeout, [&done] { return done; });
+                if (!done || failed) {
+                    requestPtr->unsubscribeAll();
+                    throw std::runtime_error(done ? "submission failed" : "timed out waiting for submission");
+                }
+            }
+            session->waitForNumSlots<CSession::EAgentState::active>(params.mNumAgents * params.mNumSlots, mFillTimeout);
+            OLOG(info) << "Agent pool: DDS session " << sessionID << " is ready with " << params.mNumAgents << " agents of agent group " << std::quoted(params.mAgentGroup);
+            return session;
+        } catch (const std::exception& e) {
+            OLOG(error) << "Agent pool: failed filling entry for agent group " << std::quoted(params.mAgentGroup) << ": " << e.what() << ". Retrying in " << mRetryInterval.count() << "s";
+            Entry failedEntry;
+            failedEntry.mSession = std::move(session);
+            shutdown(failedEntry);
+            return nullptr;
+        }
+    }
+
+    static void shutdown(Entry& entry)
+    {
+        if (!entry.mSession) {
+            return;
+        }
+        try {
+            if (entry.mSession->IsRunning()) {
+                OLOG(info) << "Agent pool: shutting down DDS session " << entry.mSession->getSessionID();
+                entry.mSession->shutdown();
+            }
+        } catch (const std::exception& e) {
+            OLOG(error) << "Agent pool: failed shutting down DDS session: " << e.what();
+        }
+        entry.mSession.reset();
+    }
+};
+
+} // namespace odc::core
+
+#endif /* ODC_CORE_AGENTPOOL */
@@ -0,0 +1,286 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_AGENTTRACKER
+#define ODC_CORE_AGENTTRACKER
+
+#include <odc/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace odc::core {
+
+/**
+ * @brief Live table of the DDS agents of a session and their slots, by agent group.
+ *
+ * The table is fed with complete agent lists and turns them into agent up/down events.
+ * Any number of threads can wait for slot counts: only one of them queries DDS at a time, all others are woken up by its result.
+ * Queries back off while the agents do not change, so waiting for slow resources does not keep the DDS commander busy.
+ * Agents that disappear from a query result without being removed are reported to the down handler.
+ */
+class AgentTracker
+{
+  public:
+    struct Agent
+    {
+        uint64_t mID = 0;
+        std::string mGroup;
+        std::string mHost;
+        std::string mPath;
+        uint32_t mNumSlots = 0;
+        uint32_t mNumIdleSlots = 0;
+        uint32_t mNumExecutingSlots = 0;
+        std::chrono::milliseconds mStartUpTime{ 0 };
+    };
+
+    using Agents = std::vector<Agent>;
+    /// Queries the current agents, none if the answer is incomplete
+    using Query = std::function<std::optional<Agents>()>;
+    /// Condition on the active slots by agent group and in total
+    using Condition = std::function<bool(const std::map<std::string, size_t>& groupSlots, size_t numSlots)>;
+    /// Called for an agent that went down unexpectedly
+    using DownHandler = std::function<void(const Agent& agent)>;
+
+    static constexpr std::chrono::milliseconds kMaxQueryInterval{ 2000 };
+
+    AgentTracker() = default;
+    AgentTracker(const AgentTracker&) = delete;
+    AgentTracker& operator=(const AgentTracker&) = delete;
+
+    /// @brief Replace the table by a complete list of agents
+    /// @return true if agents came up, went down or changed their slots
+    bool update(const Agents& agents)
+    {
+        bool changed = false;
+        Agents down;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            changed = apply(agents, down);
+        }
+        mCV.notify_all();
+        notifyDown(down);
+        return changed;
+    }
+
+    /// @brief Set the handler for agents that went down unexpectedly. It is called without the table locked.
+    /// Setting a new handler waits for calls of the previous one to return.
+    void setDownHandler(DownHandler handler)
+    {
+        std::lock_guard<std::mutex> lock(mHandlerMtx);
+        mDownHandler = std::move(handler);
+    }
+
+    /// @brief Remove an agent that was shut down, it is not reported as down
+    void remove(uint64_t agentID)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            auto it = mAgents.find(agentID);
+            if (it == mAgents.end()) {
+                return;
+            }
+            OLOG(debug) << "Agent " << agentID << " of agent group " << std::quoted(it->second.mGroup) << " on " << it->second.mHost << " is down";
+            mGroupSlots[it->second.mGroup] -= it->second.mNumSlots;
+            mNumSlots -= it->second.mNumSlots;
+            mAgents.erase(it);
+        }
+        mCV.notify_all();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mAgents.clear();
+        mGroupSlots.clear();
+        mNumSlots = 0;
+        mNextQuery = {};
+    }
+
+    /// @brief Query the agents now, or take the result of a query already running
+    void refresh(const Query& query)
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        if (mQuerying) {
+            const uint64_t numQueries = mNumQueries;
+            mCV.wait(lock, [&]() { return mNumQueries != numQueries; });
+            return;
+        }
+        runQuery(lock, query, std::chrono::milliseconds(0));
+    }
+
+    /// @brief Wait until the condition holds for the active slots
+    /// @param query queries the agents when the table is due for a refresh
+    /// @param condition condition on the active slots
+    /// @param deadline time to give up at
+    /// @param minInterval time between queries while the agents change
+    /// @param fresh only check the condition on the result of a query started after this call
+    /// @return true if the condition holds, false on timeout
+    bool waitUntil(const Query& query, const Condition& condition, std::chrono::steady_clock::time_point deadline, std::chrono::milliseconds minInterval, bool fresh = true)
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        if (fresh) {
+            mNextQuery = {};
+        }
+        // a query already running may have been answered before the agents this call waits for came up
+        const uint64_t firstQuery = mNumQueries + ((fresh && mQuerying) ? 1 : 0);
+        while (true) {
+            if ((!fresh || mNumQueries > firstQuery) && condition(mGroupSlots, mNumSlots)) {
+                return true;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            if (!mQuerying && now >= mNextQuery) {
+                runQuery(lock, query, minInterval);
+                continue;
+            }
+            mCV.wait_until(lock, mQuerying ? deadline : std::min(deadline, mNextQuery));
+        }
+    }
+
+    Agents agents() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        Agents agents;
+        agents.reserve(mAgents.size());
+        for (const auto& [id, agent] : mAgents) {
+            agents.push_back(agent);
+        }
+        std::sort(agents.begin(), agents.end(), [](const Agent& a, const Agent& b) { return a.mID < b.mID; });
+        return agents;
+    }
+
+    std::map<std::string, size_t> groupSlots() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mGroupSlots;
+    }
+
+    size_t numSlots() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mNumSlots;
+    }
+
+    /// @brief Number of queries sent so far
+    uint64_t numQueries() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mNumQueries;
+    }
+
+  private:
+    /// @brief Run the query without holding the lock and apply its result. Query intervals double while nothing changes.
+    void runQuery(std::unique_lock<std::mutex>& lock, const Query& query, std::chrono::milliseconds minInterval)
+    {
+        mQuerying = true;
+        lock.unlock();
+        std::optional<Agents> agents;
+        try {
+            agents = query();
+        } catch (const std::exception& e) {
+            OLOG(error) << "Failed to query DDS agents: " << e.what();
+        }
+        lock.lock();
+        mQuerying = false;
+        ++mNumQueries;
+        Agents down;
+        const bool changed = agents.has_value() && apply(*agents, down);
+        mInterval = changed ? minInterval : std::min(std::max(mInterval * 2, minInterval), kMaxQueryInterval);
+        mNextQuery = std::chrono::steady_clock::now() + mInterval;
+        mCV.notify_all();
+        if (!down.empty()) {
+            lock.unlock();
+            notifyDown(down);
+            lock.lock();
+        }
+    }
+
+    void notifyDown(const Agents& down)
+    {
+        if (down.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mHandlerMtx);
+        for (const auto& agent : down) {
+            if (mDownHandler) {
+                try {
+                    mDownHandler(agent);
+                } catch (const std::exception& e) {
+                    OLOG(error) << "Failed to handle agent " << agent.mID << " going down: " << e.what();
+                }
+            }
+        }
+    }
+
+    bool apply(const Agents& agents, Agents& down)
+    {
+        std::unordered_map<uint64_t, Agent> table;
+        table.reserve(agents.size());
+        size_t numUp = 0;
+        size_t numChanged = 0;
+        for (const auto& agent : agents) {
+            auto it = mAgents.find(agent.mID);
+            if (it == mAgents.end()) {
+                OLOG(debug) << "Agent " << agent.mID << " of agent group " << std::quoted(agent.mGroup) << " on " << agent.mHost << " is up with " << agent.mNumSlots << " slots";
+                ++numUp;
+            } else if (it->second.mNumSlots != agent.mNumSlots) {
+                ++numChanged;
+            }
+            table.emplace(agent.mID, agent);
+        }
+        size_t numDown = 0;
+        for (const auto& [id, agent] : mAgents) {
+            if (table.count(id) == 0) {
+                OLOG(debug) << "Agent " << id << " of agent group " << std::quoted(agent.mGroup) << " on " << agent.mHost << " is down";
+                down.push_back(agent);
+                ++numDown;
+            }
+        }
+
+        mAgents = std::move(table);
+        mGroupSlots.clear();
+        mNumSlots = 0;
+        for (const auto& [id, agent] : mAgents) {
+            mGroupSlots[agent.mGroup] += agent.mNumSlots;
+            mNumSlots += agent.mNumSlots;
+        }
+        if (numUp > 0 || numDown > 0) {
+            OLOG(info) << "DDS agents: " << numUp << " up, " << numDown << " down, " << mAgents.size() << " with " << mNumSlots << " slots in total";
+        }
+        return numUp > 0 || numDown > 0 || numChanged > 0;
+    }
+
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;                  ///< Signals new query results and removed agents
+    std::unordered_map<uint64_t, Agent> mAgents;  ///< agent ID -> agent
+    std::map<std::string, size_t> mGroupSlots;    ///< active slots by agent group
+    size_t mNumSlots = 0;                         ///< active slots in total
+    bool mQuerying = false;                       ///< a query is running
+    uint64_t mNumQueries = 0;
+    std::chrono::milliseconds mInterval{ 0 };     ///< current time between queries
+    std::chrono::steady_clock::time_point mNextQuery;
+    std::mutex mHandlerMtx;                       ///< Serializes down handler calls with setDownHandler()
+    DownHandler mDownHandler;
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_AGENTTRACKER
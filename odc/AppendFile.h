@@ -0,0 +1,109 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_APPENDFILE
+#define ODC_CORE_APPENDFILE
+
+#include <odc/MiscUtils.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+namespace odc::core {
+
+/// @brief Flush data and metadata of a file or directory to disk
+/// @throws std::runtime_error on failure
+inline void SyncPath(const std::filesystem::path& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(toString("Failed to open ", std::quoted(path.string()), " for sync: ", std::strerror(errno)));
+    }
+    const int rc = ::fsync(fd);
+    const int err = errno;
+    ::close(fd);
+    if (rc != 0) {
+        throw std::runtime_error(toString("Failed to sync ", std::quoted(path.string()), ": ", std::strerror(err)));
+    }
+}
+
+/// File opened for appending. Data only reaches the disk for sure after sync().
+class AppendFile
+{
+  public:
+    /// @throws std::runtime_error if the file cannot be opened or created
+    explicit AppendFile(const std::filesystem::path& path)
+        : mPath(path)
+        , mFd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644))
+    {
+        if (mFd < 0) {
+            throw std::runtime_error(toString("Failed to open ", std::quoted(mPath.string()), " for appending: ", std::strerror(errno)));
+        }
+    }
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+    ~AppendFile() { ::close(mFd); }
+
+    /// @throws std::runtime_error if not all of the data could be written
+    void append(const std::string& data)
+    {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            const ssize_t n = ::write(mFd, data.data() + pos, data.size() - pos);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(toString("Failed to append to ", std::quoted(mPath.string()), ": ", std::strerror(errno)));
+            }
+            pos += n;
+        }
+    }
+
+    /// @throws std::runtime_error on failure
+    void sync()
+    {
+        if (::fsync(mFd) != 0) {
+            throw std::runtime_error(toString("Failed to sync ", std::quoted(mPath.string()), ": ", std::strerror(errno)));
+        }
+    }
+
+    /// @brief Discard the content, further appends start at the beginning
+    /// @throws std::runtime_error on failure
+    void truncate()
+    {
+        if (::ftruncate(mFd, 0) != 0) {
+            throw std::runtime_error(toString("Failed to truncate ", std::quoted(mPath.string()), ": ", std::strerror(errno)));
+        }
+        sync();
+    }
+
+    bool empty() const
+    {
+        struct stat st;
+        return ::fstat(mFd, &st) == 0 && st.st_size == 0;
+    }
+
+    const std::filesystem::path& path() const { return mPath; }
+
+  private:
+    std::filesystem::path mPath;
+    int mFd;
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_APPENDFILE
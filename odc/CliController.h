@@ -14,6 +14,8 @@
 #include <odc/DDSSubmit.h>
 
 #include <chrono>
+#include <functional>
+#include <mutex>
 #include <sstream>
 
 namespace odc {
@@ -21,32 +23,64 @@ namespace odc {
 class CliController : public odc::core::CliControllerHelper<CliController>
 {
   public:
-    CliController() {}
+    CliController()
+    {
+        // recoveries run in the background, in between the requests
+        mCtrl.setRecoveryAdmission([this](const std::string&, const std::function<void()>& recover) {
+            const std::lock_guard<std::mutex> lock(mRequestMtx);
+            recover();
+        });
+    }
 
     void setTimeout(const std::chrono::seconds& timeout) { mCtrl.setTimeout(timeout); }
     void setAgentWaitTimeout(const std::string& agentWaitTimeoutStr) { mCtrl.setAgentWaitTimeout(agentWaitTimeoutStr); }
     void setHistoryDir(const std::string& dir) { mCtrl.setHistoryDir(dir); }
+    void setPersistence(const std::string& fsync, std::chrono::seconds compactionInterval) { mCtrl.setPersistence(fsync, compactionInterval); }
     void setZoneCfgs(const std::vector<std::string>& zonesStr) { mCtrl.setZoneCfgs(zonesStr); }
     void setRMS(const std::string& rms) { mCtrl.setRMS(rms); }
+    void setSubmitParallelism(size_t parallelism) { mCtrl.setSubmitParallelism(parallelism); }
+    void setSubmitSurplus(uint32_t percent) { mCtrl.setSubmitSurplus(percent); }
+    void setAgentPools(const std::vector<std::string>& poolsStr) { mCtrl.setAgentPools(poolsStr); }
+    void setSessionPool(size_t size) { mCtrl.setSessionPool(size); }
+    void setMacroTransitions(bool enable) { mCtrl.setMacroTransitions(enable); }
+    void setPipelinedTransitions(bool enable) { mCtrl.setPipelinedTransitions(enable); }
+    void setRolloutPolicies(const std::vector<std::string>& policiesStr) { mCtrl.setRolloutPolicies(policiesStr); }
+    void setScheduledStart(std::chrono::milliseconds margin) { mCtrl.setScheduledStart(margin); }
+    void setOrderedStartStop(bool enable) { mCtrl.setOrderedStartStop(enable); }
+    void setAdaptiveTimeouts(double factor, std::chrono::milliseconds minimum) { mCtrl.setAdaptiveTimeouts(factor, minimum); }
+    void setTopologyCache(const std::string& dir, size_t maxSizeMB) { mCtrl.setTopologyCache(dir, maxSizeMB); }
+    void setTopologyScriptCache(const std::vector<std::string>& inputFiles, const std::vector<std::string>& inputEnv) { mCtrl.setTopologyScriptCache(inputFiles, inputEnv); }
 
     void registerResourcePlugins(const core::PluginManager::PluginMap& pluginMap) { mCtrl.registerResourcePlugins(pluginMap); }
     void restore(const std::string& restoreId, const std::string& restoreDir) { mCtrl.restore(restoreId, restoreDir); }
+    void setRestoreParallelism(size_t parallelism) { mCtrl.setRestoreParallelism(parallelism); }
+    void setSnapshotInterval(std::chrono::seconds interval) { mCtrl.setSnapshotInterval(interval); }
+    void setCollectionRecovery(bool enable) { mCtrl.setCollectionRecovery(enable); }
+    void setTaskRestart(uint32_t maxRestarts, std::chrono::seconds window, std::chrono::seconds timeout)
+    {
+        core::RestartLimiter::Config config;
+        config.mMaxRestarts = maxRestarts;
+        config.mWindow = window;
+        config.mTimeout = timeout;
+        mCtrl.setTaskRestart(config);
+    }
 
-    std::string requestInitialize(   const core::CommonParams& common, const core::InitializeParams& params)    { return generalReply(mCtrl.execInitialize(common, params)); }
-    std::string requestSubmit(       const core::CommonParams& common, const core::SubmitParams& params)        { return generalReply(mCtrl.execSubmit(common, params)); }
-    std::string requestActivate(     const core::CommonParams& common, const core::ActivateParams& params)      { return generalReply(mCtrl.execActivate(common, params)); }
-    std::string requestRun(          const core::CommonParams& common, const core::RunParams& params)           { return generalReply(mCtrl.execRun(common, params)); }
-    std::string requestUpscale(      const core::CommonParams& common, const core::UpdateParams& params)        { return generalReply(mCtrl.execUpdate(common, params)); }
-    std::string requestDownscale(    const core::CommonParams& common, const core::UpdateParams& params)        { return generalReply(mCtrl.execUpdate(common, params)); }
-    std::string requestGetState(     const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execGetState(common, params)); }
-    std::string requestSetProperties(const core::CommonParams& common, const core::SetPropertiesParams& params) { return generalReply(mCtrl.execSetProperties(common, params)); }
-    std::string requestConfigure(    const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execConfigure(common, params)); }
-    std::string requestStart(        const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execStart(common, params)); }
-    std::string requestStop(         const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execStop(common, params)); }
-    std::string requestReset(        const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execReset(common, params)); }
-    std::string requestTerminate(    const core::CommonParams& common, const core::DeviceParams& params)        { return generalReply(mCtrl.execTerminate(common, params)); }
-    std::string requestShutdown(     const core::CommonParams& common)                                          { return generalReply(mCtrl.execShutdown(common)); }
-    std::string requestStatus(       const core::StatusParams& params)                                          { return statusReply(mCtrl.execStatus(params)); }
+    std::string requestInitialize(   const core::CommonParams& common, const core::InitializeParams& params)    { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execInitialize(common, params)); }
+    std::string requestSubmit(       const core::CommonParams& common, const core::SubmitParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execSubmit(common, params)); }
+    std::string requestActivate(     const core::CommonParams& common, const core::ActivateParams& params)      { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execActivate(common, params)); }
+    std::string requestRun(          const core::CommonParams& common, const core::RunParams& params)           { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execRun(common, params)); }
+    std::string requestUpscale(      const core::CommonParams& common, const core::UpdateParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execUpdate(common, params)); }
+    std::string requestDownscale(    const core::CommonParams& common, const core::UpdateParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execUpdate(common, params)); }
+    std::string requestGetState(     const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execGetState(common, params)); }
+    std::string requestSetProperties(const core::CommonParams& common, const core::SetPropertiesParams& params) { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execSetProperties(common, params)); }
+    std::string requestConfigure(    const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execConfigure(common, params)); }
+    std::string requestStart(        const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execStart(common, params)); }
+    std::string requestStop(         const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execStop(common, params)); }
+    std::string requestReset(        const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execReset(common, params)); }
+    std::string requestTerminate(    const core::CommonParams& common, const core::DeviceParams& params)        { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execTerminate(common, params)); }
+    std::string requestShutdown(     const core::CommonParams& common)                                          { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execShutdown(common)); }
+    std::string requestTakeover(     const core::CommonParams& common)                                          { const std::lock_guard<std::mutex> lock(mRequestMtx); return generalReply(mCtrl.execTakeover(common)); }
+    std::string requestStatus(       const core::StatusParams& params)                                          { const std::lock_guard<std::mutex> lock(mRequestMtx); return statusReply(mCtrl.execStatus(params)); }
 
   private:
     std::string generalReply(const core::RequestResult& result)
@@ -65,6 +99,9 @@ class CliController : public odc::core::CliControllerHelper<CliController>
         ss << "  Partition ID: "     << result.mPartitionID << "\n";
         ss << "  Run Nr: "           << result.mRunNr << "\n";
         ss << "  Session ID: "       << result.mDDSSessionID << "\n";
+        if (!result.mTopoHash.empty()) {
+            ss << "  Topology hash: "    << result.mTopoHash << "\n";
+        }
         if (!result.mHosts.empty()) {
             ss << "  Hosts:\n    ";
             size_t i = 0;
@@ -115,13 +152,25 @@ class CliController : public odc::core::CliControllerHelper<CliController>
             ss << "    ID: " << p.mPartitionID
                << "; session ID: " << p.mDDSSessionID
                << "; status: " << ((p.mDDSSessionStatus == core::DDSSessionStatus::running) ? "RUNNING" : "STOPPED")
-               << "; state: " << core::GetAggregatedStateName(p.mAggregatedState) << "\n";
+               << "; state: " << core::GetAggregatedStateName(p.mAggregatedState)
+               << "; agents: " << p.mNumAgents
+               << "; slots: " << p.mNumSlots;
+            if (!p.mStandbyFor.empty()) {
+                ss << "; standby for: " << p.mStandbyFor << " (" << p.mStandbyState << ")";
+            }
+            ss << "\n";
+        }
+        ss << "  Topology script cache: " << result.mTopoScriptCacheStats << "\n";
+        ss << "  DDS session pool: " << result.mSessionPool << "\n";
+        for (const auto& p : result.mAgentPools) {
+            ss << "  Agent pool: " << p << "\n";
         }
         ss << "  Execution time: " << result.mExecTime << " msec\n";
         return ss.str();
     }
 
   private:
+    std::mutex mRequestMtx; ///< Serializes the requests with background recoveries
     core::Controller mCtrl; ///< Core ODC service
 };
 
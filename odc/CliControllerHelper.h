@@ -231,6 +231,8 @@ class CliControllerHelper
             reply = request("Terminate",     args, &Owner::requestTerminate,     CommonParams(), DeviceParams());
         } else if (cmd == ".down") {
             reply = request("Shutdown",      args, &Owner::requestShutdown,      CommonParams());
+        } else if (cmd == ".takeover") {
+            reply = request("Takeover",      args, &Owner::requestTakeover,      CommonParams());
         } else if (cmd == ".status") {
             reply = request("Status",        args, &Owner::requestStatus,        StatusParams());
         } else if (cmd == ".batch") {
@@ -268,6 +270,7 @@ class CliControllerHelper
                   << ".reset - Transitions devices to Idle state (via ResetTask->ResetDevice transitions).\n"
                   << ".term - Shutdown devices via End transition.\n"
                   << ".down - Shutdown DDS session.\n"
+                  << ".takeover - Replace a failed partition by its standby partition (see .run --standby) and start it.\n"
                   << ".status - Show statuses of managed partitions/sessions.\n"
                   << ".batch - Execute an array of commands.\n"
                   << ".sleep - Sleep for X ms.\n"
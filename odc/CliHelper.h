@@ -144,7 +144,8 @@ class CliHelper
         options.add_options()
             ("topo", value<std::string>(&params.mTopoFile)->implicit_value(""), "Topology filepath")
             ("content", value<std::string>(&params.mTopoContent)->implicit_value(""), "Topology content")
-            ("script", value<std::string>(&params.mTopoScript)->implicit_value(""), "Topology script");
+            ("script", value<std::string>(&params.mTopoScript)->implicit_value(""), "Topology script")
+            ("topo-hash", value<std::string>(&params.mTopoHash)->implicit_value(""), "Hash of a topology known to the topology cache");
     }
 
     static void addOptions(boost::program_options::options_description& options, UpdateParams& params)
@@ -153,7 +154,8 @@ class CliHelper
         options.add_options()
             ("topo", value<std::string>(&params.mTopoFile), "Topology filepath")
             ("content", value<std::string>(&params.mTopoContent), "Topology content")
-            ("script", value<std::string>(&params.mTopoScript)->implicit_value(""), "Topology script");
+            ("script", value<std::string>(&params.mTopoScript)->implicit_value(""), "Topology script")
+            ("topo-hash", value<std::string>(&params.mTopoHash)->implicit_value(""), "Hash of a topology known to the topology cache");
     }
 
     static void addOptions(boost::program_options::options_description& options, SubmitParams& params)
@@ -173,7 +175,10 @@ class CliHelper
             ("topo", value<std::string>(&params.mTopoFile)->implicit_value(""), "Topology filepath")
             ("content", value<std::string>(&params.mTopoContent)->implicit_value(""), "Topology content")
             ("script", value<std::string>(&params.mTopoScript)->implicit_value(""), "Topology script")
-            ("extract-topo-resources", bool_switch(&params.mExtractTopoResources)->default_value(false), "Extract required resources from the topology file (plugin & resources fields are ignored)");
+            ("topo-hash", value<std::string>(&params.mTopoHash)->implicit_value(""), "Hash of a topology known to the topology cache")
+            ("extract-topo-resources", bool_switch(&params.mExtractTopoResources)->default_value(false), "Extract required resources from the topology file (plugin & resources fields are ignored)")
+            ("pipelined", bool_switch(&params.mPipelined)->default_value(false), "Configure devices agent group by agent group while the topology is starting. Topology ends up in READY instead of IDLE")
+            ("standby", bool_switch(&params.mStandby)->default_value(false), "Prepare a standby partition up to READY in the background, to take over with .takeover");
     }
 
     static void addOptions(boost::program_options::options_description& options, DeviceParams& params)
@@ -181,7 +186,10 @@ class CliHelper
         using namespace boost::program_options;
         options.add_options()
             ("path", value<std::string>(&params.mPath)->default_value(""), "Topology path of devices")
-            ("detailed", bool_switch(&params.mDetailed)->default_value(false), "Detailed reply of devices");
+            ("detailed", bool_switch(&params.mDetailed)->default_value(false), "Detailed reply of devices")
+            ("on-host", value<std::string>(&params.mHost)->default_value(""), "Restrict detailed reply to devices running on this host")
+            ("rollout-max", value<size_t>(&params.mRollout.mMaxDevices)->default_value(0), "State changes only: maximum number of devices in transition at the same time, 0 means no limit")
+            ("rollout-max-per-host", value<size_t>(&params.mRollout.mMaxPerHost)->default_value(0), "State changes only: maximum number of devices in transition at the same time on one host, 0 means no limit");
     }
 
     static void addOptions(boost::program_options::options_description& options, SetPropertiesParams& params)
@@ -7,8 +7,10 @@
  ********************************************************************************/
 
 #include <odc/Controller.h>
+#include <odc/DataFlow.h>
 #include <odc/DDSSubmit.h>
 #include <odc/Error.h>
+#include <odc/InFlightWindow.h>
 #include <odc/Logger.h>
 #include <odc/Process.h>
 #include <odc/Restore.h>
@@ -25,18 +27,52 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cctype> // std::tolower
 #include <filesystem>
+#include <future>
 #include <iterator> // std::distance
+#include <optional>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace odc;
 using namespace odc::core;
 using namespace std;
 namespace bfs = boost::filesystem;
 
+Controller::~Controller()
+{
+    // standby preparations and shutdowns use the other members, wait for them first
+    vector<future<void>> standbys;
+    {
+        lock_guard<mutex> lock(mStandbyMtx);
+        for (auto& s : mStandbys) {
+            if (s.second.mPreparation.valid()) {
+                standbys.push_back(std::move(s.second.mPreparation));
+            }
+        }
+    }
+    standbys.clear();
+
+    mRecoveryWorker.stop();
+    {
+        lock_guard<mutex> lock(mSnapshotMtx);
+        mSnapshotStop = true;
+    }
+    mSnapshotCV.notify_all();
+    if (mSnapshotThread.joinable()) {
+        mSnapshotThread.join();
+    }
+}
+
 RequestResult Controller::execInitialize(const CommonParams& common, const InitializeParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Initialize failed", TopologyState(), "", {});
+    }
     try {
         auto& partition = acquirePartition(common);
 
@@ -51,6 +87,11 @@ RequestResult Controller::execInitialize(const CommonParams& common, const Initi
             if (success) {
                 // Request current active topology, if any
                 partition.mSession->mTopoFilePath = getActiveDDSTopology(common, *(partition.mSession), error);
+                // a restored session may still run from a cached topology file, which must not be evicted
+                if (auto pin = mTopoCache.pinFile(partition.mSession->mTopoFilePath)) {
+                    partition.mSession->mTopoHash = pin->hash();
+                    partition.mSession->mTopoCachePin = make_shared<TopologyCachePin>(std::move(*pin));
+                }
                 // If a topology is active, create DDS and FairMQ topology objects
                 if (!partition.mSession->mTopoFilePath.empty()) {
                     createDDSTopology(common, *(partition.mSession), error)
@@ -59,6 +100,7 @@ RequestResult Controller::execInitialize(const CommonParams& common, const Initi
             }
         }
         updateRestore();
+        stageSnapshot(partition);
         return createRequestResult(common, *(partition.mSession), error, "Initialize done", TopologyState(), "", {});
     } catch (exception& e) {
         fillAndLogFatalError(common, error, ErrorCode::RuntimeError, e.what());
@@ -69,9 +111,13 @@ RequestResult Controller::execInitialize(const CommonParams& common, const Initi
 RequestResult Controller::execSubmit(const CommonParams& common, const SubmitParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Submit failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     auto [hosts, rmsJobIDs] = submit(common, *(partition.mSession), error, params.mPlugin, params.mResources, false);
+    stageSnapshot(partition);
 
     return createRequestResult(common, *(partition.mSession), error, "Submit done", TopologyState(), rmsJobIDs, hosts);
 }
@@ -110,9 +156,27 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
         }
     }
 
+    // agents of a pre-warmed pool session replace the matching part of the submission
+    const vector<DDSSubmitParams> requiredParams = ddsParams;
+    map<string, uint32_t> pooledAgents;
+    if (!error.mCode) {
+        adoptPooledAgents(common, session, error, ddsParams, pooledAgents);
+    }
+
+    // speculative surplus for nMin protected groups, appended after the required submissions
+    const size_t numRequired = ddsParams.size();
+    addSurplusParams(common, ddsParams, mSubmitSurplus);
+
     // initial expected number of slots from the current total slots, which may have been updated by previous submissions
     size_t expectedNumSlots = session.mTotalSlots;
+    map<string, size_t> expectedGroupSlots = session.mGroupSlots;
     bool topologyChanged = false;
+    bool slotsReady = false;
+    for (const auto& [groupName, numAgents] : pooledAgents) {
+        auto it = find_if(requiredParams.cbegin(), requiredParams.cend(), [&](const auto& p) { return p.mAgentGroup == groupName; });
+        expectedNumSlots += numAgents * it->mNumSlots;
+        expectedGroupSlots[groupName] += numAgents * it->mNumSlots;
+    }
 
     if (!error.mCode) {
         OLOG(info, common) << "Preparing to submit " << ddsParams.size() << " configurations:";
@@ -120,14 +184,31 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
             OLOG(info, common) << "  [" << i + 1 << "/" << ddsParams.size() << "]: " << ddsParams.at(i);
         }
 
-        for (unsigned int i = 0; i < ddsParams.size(); ++i) {
-            OLOG(info, common) << "Submitting [" << i + 1 << "/" << ddsParams.size() << "]: " << ddsParams.at(i);
+        // all groups are submitted concurrently, the outcome is evaluated per group afterwards
+        const vector<uint32_t> submitted = submitDDSAgents(common, session, error, ddsParams, numRequired);
+
+        map<string, uint32_t> surplusAgents; // started surplus agents by agent group
+        for (unsigned int i = numRequired; i < ddsParams.size(); ++i) {
+            OLOG(info, common) << "Surplus submission for agent group " << quoted(ddsParams.at(i).mAgentGroup) << ": " << submitted.at(i) << " agents";
+            surplusAgents[ddsParams.at(i).mAgentGroup] += submitted.at(i);
+        }
+
+        for (unsigned int i = 0; i < numRequired; ++i) {
             std::string groupName = ddsParams.at(i).mAgentGroup;
             int32_t minCount = ddsParams.at(i).mMinAgents;
             uint32_t numExpectedAgents = ddsParams.at(i).mNumAgents;
-            uint32_t numSubmittedAgents = submitDDSAgents(common, session, error, ddsParams.at(i));
+            uint32_t numSubmittedAgents = submitted.at(i);
+            // surplus agents that started make up for required ones that did not
+            auto surplusIt = surplusAgents.find(groupName);
+            if (numSubmittedAgents < numExpectedAgents && surplusIt != surplusAgents.end() && surplusIt->second > 0) {
+                const uint32_t numCovered = std::min(numExpectedAgents - numSubmittedAgents, surplusIt->second);
+                OLOG(info, common) << numCovered << " surplus agents of agent group " << quoted(groupName) << " make up for agents that failed to start";
+                surplusIt->second -= numCovered;
+                numSubmittedAgents += numCovered;
+            }
             if (numSubmittedAgents == numExpectedAgents) {
                 expectedNumSlots += numSubmittedAgents * ddsParams.at(i).mNumSlots;
+                expectedGroupSlots[groupName] += numSubmittedAgents * ddsParams.at(i).mNumSlots;
             } else {
                 OLOG(info, common) << "Submitted " << numSubmittedAgents << " agents instead of " << numExpectedAgents;
                 if (minCount < 0) { // nMin is not defined
@@ -140,13 +221,14 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
                 }
                 OLOG(info, common) << "Number of agents (" << numSubmittedAgents << ") for group " << groupName << " is less than requested (" << numExpectedAgents << "), " << "but nMin (" << minCount << ") is satisfied";
                 expectedNumSlots += numSubmittedAgents * ddsParams.at(i).mNumSlots;
+                expectedGroupSlots[groupName] += numSubmittedAgents * ddsParams.at(i).mNumSlots;
 
                 // update nCurrent for the agent group
                 auto ni =  std::find_if(session.mNinfo.begin(), session.mNinfo.end(), [&](const auto& _ni) {
                     return _ni.second.agentGroup == groupName;
                 });
                 if (ni != session.mNinfo.end()) {
-                    ni->second.nCurrent = numSubmittedAgents;
+                    ni->second.nCurrent = numSubmittedAgents + (pooledAgents.count(groupName) > 0 ? pooledAgents.at(groupName) : 0);
                 } else {
                     OLOG(error, common) << "Agent group info not found for group " << groupName;
                 }
@@ -155,15 +237,21 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
                 topologyChanged = true;
             }
         }
+        // the remaining surplus agents count towards the active slots of their group, but are not required
+        for (const auto& [groupName, numAgents] : surplusAgents) {
+            session.mSurplusAgents[groupName] += numAgents;
+        }
         if (!error.mCode) {
             if (topologyChanged) {
                 updateTopology(common, session);
             }
 
-            OLOG(info, common) << "Waiting for " << expectedNumSlots << " slots...";
-            // TODO: wait not for total number of slots, but count each group individually
-            if (waitForNumActiveSlots(common, session, error, expectedNumSlots)) {
+            OLOG(info, common) << "Waiting for " << expectedNumSlots << " slots in " << expectedGroupSlots.size() << " agent groups...";
+            // the groups add up to the expected slots, each group is logged as soon as it is ready
+            if (waitForAgentGroupSlots(common, session, error, expectedGroupSlots)) {
+                slotsReady = true;
                 session.mTotalSlots = expectedNumSlots;
+                session.mGroupSlots = expectedGroupSlots;
                 OLOG(info, common) << "Done waiting for " << expectedNumSlots << " slots.";
             }
         }
@@ -171,43 +259,49 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
 
     if (session.mDDSSession.IsRunning()) {
         map<string, uint32_t> agentCounts; // agent count sorted by their group name
+        map<string, size_t> groupSlots; // active slots by group name
 
-        for (const auto& p : ddsParams) {
+        for (const auto& p : requiredParams) {
             agentCounts[p.mAgentGroup] = 0;
         }
 
         try {
-            auto agentInfo = getAgentInfo(common, session);
-            OLOG(info, common) << "Launched " << agentInfo.size() << " DDS agents:";
-            hosts.reserve(agentInfo.size());
-            for (const auto& ai : agentInfo) {
-                agentCounts[ai.m_groupName]++;
-                session.mAgentInfo[ai.m_agentID].numSlots = ai.m_nSlots;
+            // after the slot waits the agent table is up to date, it is only queried again if they did not complete
+            if (!slotsReady) {
+                session.mAgentTracker.refresh(agentQuery(common, session));
+            }
+            const auto agents = session.mAgentTracker.agents();
+            OLOG(info, common) << "Launched " << agents.size() << " DDS agents:";
+            hosts.reserve(agents.size());
+            for (const auto& ai : agents) {
+                agentCounts[ai.mGroup]++;
+                groupSlots[ai.mGroup] += ai.mNumSlots;
+                session.mAgentInfo[ai.mID].numSlots = ai.mNumSlots;
 
                 std::string rmsJobID;
                 auto agiIt = std::find_if(session.mAgentGroupInfo.begin(), session.mAgentGroupInfo.end(), [&ai](const AgentGroupInfo& info) {
-                    return info.name == ai.m_groupName;
+                    return info.name == ai.mGroup;
                 });
                 if (agiIt != session.mAgentGroupInfo.end()) {
-                    session.mAgentInfo.at(ai.m_agentID).agentGroupInfoIndex = std::distance(session.mAgentGroupInfo.begin(), agiIt);
+                    session.mAgentInfo.at(ai.mID).agentGroupInfoIndex = std::distance(session.mAgentGroupInfo.begin(), agiIt);
                     rmsJobID = agiIt->rmsJobID;
                 } else {
-                    OLOG(error, common) << "Agent group info not found for agent " << ai.m_agentID;
+                    OLOG(error, common) << "Agent group info not found for agent " << ai.mID;
                 }
 
-                hosts.emplace(ai.m_host);
+                hosts.emplace(ai.mHost);
                 rmsJobIDs += rmsJobID + " ";
                 OLOG(info, common)
-                    << "  Agent ID: " << ai.m_agentID
+                    << "  Agent ID: " << ai.mID
                     // << ", pid: " << ai.m_agentPid
-                    << "; host: " << ai.m_host
-                    << "; path: " << ai.m_DDSPath
-                    << "; group: " << ai.m_groupName
+                    << "; host: " << ai.mHost
+                    << "; path: " << ai.mPath
+                    << "; group: " << ai.mGroup
                     << "; rmsJobID: " << std::quoted(rmsJobID)
                     // << "; index: " << ai.m_index
                     // << "; username: " << ai.m_username
-                    << "; startup time: " << ai.m_startUpTime.count() << " ms"
-                    << "; slots: " << ai.m_nSlots;
+                    << "; startup time: " << ai.mStartUpTime.count() << " ms"
+                    << "; slots: " << ai.mNumSlots;
                     // << " (idle: " << ai.m_nIdleSlots
                     // << ", executing: " << ai.m_nExecutingSlots << ").";
             }
@@ -223,131 +317,275 @@ pair<unordered_set<string>, string> Controller::submit(const CommonParams& commo
         }
 
         if (error.mCode) {
-            attemptSubmitRecovery(common, session, error, ddsParams, agentCounts);
+            attemptSubmitRecovery(common, session, error, requiredParams, agentCounts);
+            if (!error.mCode) {
+                session.mGroupSlots = groupSlots;
+            }
         }
     }
 
     return std::make_pair(hosts, rmsJobIDs);
 }
 
-uint32_t Controller::submitDDSAgents(const CommonParams& common, Session& session, Error& error, const DDSSubmitParams& params)
+vector<uint32_t> Controller::submitDDSAgents(const CommonParams& common, Session& session, Error& error, const vector<DDSSubmitParams>& ddsParams, size_t numRequired)
 {
     using namespace dds::tools_api;
 
-    uint32_t numSubmittedAgents = params.mNumAgents;
+    struct GroupSubmission
+    {
+        SSubmitRequest::ptr_t mRequest;
+        uint32_t mNumSubmittedAgents = 0;
+        Error mError;
+        bool mDone = false;
+    };
+
+    vector<GroupSubmission> submissions(ddsParams.size());
+    mutex mtx; // protects submissions and session.mAgentGroupInfo while requests are in flight
+    InFlightWindow window(mSubmitParallelism);
+
+    for (size_t i = 0; i < ddsParams.size(); ++i) {
+        const DDSSubmitParams& params = ddsParams.at(i);
+        GroupSubmission& submission = submissions.at(i);
+        submission.mNumSubmittedAgents = params.mNumAgents;
+
+        submission.mRequest = SSubmitRequest::makeRequest(makeDDSSubmitRequest(params, common.mPartitionID));
+
+        submission.mRequest->setMessageCallback([&submission, &mtx, &common, &params, this](const SMessageResponseData& msg) {
+            if (msg.m_severity == dds::intercom_api::EMsgSeverity::error) {
+                lock_guard<mutex> lock(mtx);
+                submission.mNumSubmittedAgents = 0;
+                fillAndLogError(common, submission.mError, ErrorCode::DDSSubmitAgentsFailed, toString("Submit error for agent group ", params.mAgentGroup, ": ", msg.m_msg));
+            } else {
+                OLOG(info, common) << "...Submit (" << params.mAgentGroup << "): " << msg.m_msg;
+            }
+        });
 
-    SSubmitRequest::request_t requestInfo;
-    requestInfo.m_submissionTag = common.mPartitionID;
-    requestInfo.m_rms = params.mRMS;
-    requestInfo.m_instances = params.mNumAgents;
-    requestInfo.m_minInstances = (params.mMinAgents >= 0) ? static_cast<uint32_t>(params.mMinAgents) : 0;
-    // requestInfo.m_minInstances = 0;
-    // OLOG(debug, common) << "Ignoring params.mMinAgents for DDS submission to avoid nMin handling temporarily";
-    requestInfo.m_slots = params.mNumSlots;
-    requestInfo.m_config = params.mConfigFile;
-    requestInfo.m_envCfgFilePath = params.mEnvFile;
-    requestInfo.m_groupName = params.mAgentGroup;
+        submission.mRequest->setResponseCallback([&submission, &mtx, &common, &session, &params](const SSubmitResponseData& res) {
+            lock_guard<mutex> lock(mtx);
+            OLOG(info, common) << "Submission details for " << params.mAgentGroup << " agent group:";
+
+            if (!res.m_jobIDs.empty()) {
+                auto agiIt = std::find_if(session.mAgentGroupInfo.begin(), session.mAgentGroupInfo.end(), [&params](const AgentGroupInfo& agi) {
+                    return agi.name == params.mAgentGroup;
+                });
+                if (agiIt == session.mAgentGroupInfo.end()) {
+                    OLOG(warning, common) << "Agent group info not found for " << params.mAgentGroup;
+                } else {
+                    agiIt->rmsJobID = strVecToStr(res.m_jobIDs);
+                }
+            }
 
-    // DDS does not support ncores parameter directly, set it here through additional config in case of Slurm
-    if (params.mRMS == "slurm" && params.mNumCores > 0) {
-        // the following disables `#SBATCH --cpus-per-task=%DDS_NSLOTS%` of DDS for Slurm
-        requestInfo.setFlag(SSubmitRequestData::ESubmitRequestFlags::enable_overbooking, true);
+            if (res.m_jobInfoAvailable) {
+                OLOG(info, common) << "Allocated " << res.m_allocNodes << " nodes for " << params.mAgentGroup << " agent group";
+                // when not using core-based scheduling, number of allocated nodes equals number of agents
+                submission.mNumSubmittedAgents = res.m_allocNodes;
+            } else {
+                OLOG(debug, common) << "Warning: Job information is not fully available";
+            }
+        });
 
-        requestInfo.m_inlineConfig = string("#SBATCH --cpus-per-task=" + to_string(params.mNumCores));
+        submission.mRequest->setDoneCallback([&submission, &mtx, &window]() {
+            {
+                lock_guard<mutex> lock(mtx);
+                submission.mDone = true;
+            }
+            window.done();
+        });
     }
 
-    OLOG(info, common) << "Submitting: " << requestInfo;
+    try {
+        // keep up to mSubmitParallelism submissions in flight, issue the next one as soon as one is acknowledged
+        window.run(ddsParams.size(), chrono::steady_clock::now() + requestTimeout(common, "submitDDSAgents"), [&](size_t i) {
+            OLOG(info, common) << "Submitting [" << i + 1 << "/" << ddsParams.size() << "]: " << ddsParams.at(i);
+            session.mDDSSession.sendRequest<SSubmitRequest>(submissions.at(i).mRequest);
+        });
+    } catch (Error& e) {
+        error = e;
+        OLOG(error, common) << "Agent submission error: " << e;
+    }
 
-    bool done = false;
-    mutex mtx;
-    condition_variable cv;
+    vector<uint32_t> numSubmittedAgents(ddsParams.size(), 0);
+    vector<SSubmitRequest::ptr_t> pending;
+    {
+        lock_guard<mutex> lock(mtx);
+        for (size_t i = 0; i < ddsParams.size(); ++i) {
+            GroupSubmission& submission = submissions.at(i);
+            if (!submission.mDone) {
+                submission.mNumSubmittedAgents = 0;
+                fillAndLogError(common, submission.mError, ErrorCode::RequestTimeout, "Timed out waiting for agent submission for agent group " + ddsParams.at(i).mAgentGroup);
+                pending.push_back(submission.mRequest);
+            }
+            if (submission.mError.mCode && !error.mCode && i < numRequired) {
+                error = submission.mError;
+            }
+            numSubmittedAgents.at(i) = submission.mNumSubmittedAgents;
+        }
+    }
+    // outside of the lock: callbacks of pending requests may be running
+    for (auto& request : pending) {
+        request->unsubscribeAll();
+    }
 
-    SSubmitRequest::ptr_t requestPtr = SSubmitRequest::makeRequest(requestInfo);
+    return numSubmittedAgents;
+}
 
-    requestPtr->setMessageCallback([&numSubmittedAgents, &error, &common, this](const SMessageResponseData& msg) {
-        if (msg.m_severity == dds::intercom_api::EMsgSeverity::error) {
-            numSubmittedAgents = 0;
-            fillAndLogError(common, error, ErrorCode::DDSSubmitAgentsFailed, toString("Submit error: ", msg.m_msg));
-        } else {
-            OLOG(info, common) << "...Submit: " << msg.m_msg;
-        }
-    });
+void Controller::adoptPooledAgents(const CommonParams& common, Session& session, Error& error, vector<DDSSubmitParams>& ddsParams, map<string, uint32_t>& pooledAgents)
+{
+    // a DDS session is adopted as a whole, only a session without agents can be replaced
+    if (mAgentPool.empty() || session.mTotalSlots > 0 || !session.mAgentInfo.empty()) {
+        return;
+    }
 
-    requestPtr->setResponseCallback([&numSubmittedAgents, &common, &session, &params](const SSubmitResponseData& res) {
-        OLOG(info, common) << "Submission details:";
+    auto lease = mAgentPool.take(ddsParams);
+    if (!lease) {
+        OLOG(info, common) << "No pre-warmed agents available for the requested resources";
+        return;
+    }
 
-        if (!res.m_jobIDs.empty()) {
-            auto agiIt = std::find_if(session.mAgentGroupInfo.begin(), session.mAgentGroupInfo.end(), [&params](const AgentGroupInfo& agi) {
-                return agi.name == params.mAgentGroup;
-            });
-            if (agiIt == session.mAgentGroupInfo.end()) {
-                OLOG(warning, common) << "Agent group info not found for " << params.mAgentGroup;
-            } else {
-                agiIt->rmsJobID = strVecToStr(res.m_jobIDs);
+    const string ownSessionID = to_string(session.mDDSSession.getSessionID());
+    try {
+        session.mDDSSession.shutdown();
+        session.mDDSSession.attach(lease->mSessionID);
+        if (!session.mDDSSession.IsRunning()) {
+            throw runtime_error("session is not running");
+        }
+    } catch (const exception& e) {
+        OLOG(error, common) << "Failed to adopt pre-warmed DDS session " << quoted(lease->mSessionID) << ": " << e.what() << ". Submitting without pre-warmed agents.";
+        // the pool gave up the session, nobody else shuts it down
+        try {
+            dds::tools_api::CSession pooled;
+            pooled.attach(lease->mSessionID);
+            if (pooled.IsRunning()) {
+                pooled.shutdown();
             }
+        } catch (const exception& e) {
+            OLOG(warning, common) << "Failed to shut down pre-warmed DDS session " << quoted(lease->mSessionID) << ": " << e.what();
+        }
+        if (!session.mDDSSession.IsRunning()) {
+            createDDSSession(common, session, error);
         }
+        updateRestore();
+        return;
+    }
+    OLOG(info, common) << "Replaced DDS session " << ownSessionID << " by pre-warmed DDS session " << lease->mSessionID << " with " << lease->mParams.mNumAgents << " agents of agent group " << quoted(lease->mParams.mAgentGroup);
+    updateHistory(common, lease->mSessionID);
+    updateRestore();
 
-        if (res.m_jobInfoAvailable) {
-            OLOG(info, common) << "Allocated " << res.m_allocNodes << " nodes for " << params.mAgentGroup << " agent group";
-            // when not using core-based scheduling, number of allocated nodes equals number of agents
-            numSubmittedAgents = res.m_allocNodes;
-        } else {
-            OLOG(debug, common) << "Warning: Job information is not fully available";
+    pooledAgents[lease->mParams.mAgentGroup] += lease->mParams.mNumAgents;
+    DDSSubmitParams& p = ddsParams.at(lease->mParamsIndex);
+    p.mNumAgents -= lease->mParams.mNumAgents;
+    if (p.mMinAgents >= 0) {
+        p.mMinAgents = std::max<int32_t>(0, p.mMinAgents - static_cast<int32_t>(lease->mParams.mNumAgents));
+    }
+    if (p.mNumAgents == 0) {
+        ddsParams.erase(ddsParams.begin() + lease->mParamsIndex);
+    }
+}
+
+void Controller::addSurplusParams(const CommonParams& common, vector<DDSSubmitParams>& ddsParams, uint32_t percent)
+{
+    if (percent == 0) {
+        return;
+    }
+
+    // agents per nMin protected group, over all of its submissions
+    map<string, uint32_t> groupAgents;
+    map<string, DDSSubmitParams> groupParams;
+    for (const auto& p : ddsParams) {
+        if (p.mMinAgents >= 0) {
+            groupAgents[p.mAgentGroup] += p.mNumAgents;
+            groupParams.emplace(p.mAgentGroup, p);
         }
-    });
+    }
 
-    requestPtr->setDoneCallback([&mtx, &cv, &done]() {
-        {
-            lock_guard<mutex> lock(mtx);
-            done = true;
+    for (const auto& [group, numAgents] : groupAgents) {
+        const uint32_t numSurplus = (numAgents * percent + 99) / 100;
+        if (numSurplus == 0) {
+            continue;
         }
-        cv.notify_all();
-    });
+        OLOG(info, common) << "Requesting " << numSurplus << " surplus agents (" << percent << "%) for nMin protected agent group " << quoted(group) << " of " << numAgents << " agents";
+        DDSSubmitParams surplus = groupParams.at(group);
+        surplus.mMinAgents = 0;
+        // for localhost only submissions for 1 agent are allowed by DDS
+        const uint32_t numSubmissions = (surplus.mRMS == "localhost") ? numSurplus : 1;
+        surplus.mNumAgents = numSurplus / numSubmissions;
+        ddsParams.insert(ddsParams.end(), numSubmissions, surplus);
+    }
+}
 
-    session.mDDSSession.sendRequest<SSubmitRequest>(requestPtr);
+void Controller::releaseSurplusAgents(const CommonParams& common, Partition& partition)
+{
+    Session& session = *(partition.mSession);
+    if (session.mSurplusAgents.empty() || partition.mTopology == nullptr) {
+        return;
+    }
 
     try {
-        unique_lock<mutex> lock(mtx);
-        cv.wait_for(lock, requestTimeout(common, "wait_for lock in submitDDSAgents"), [&done]{ return done; });
-
-        if (!done) {
-            numSubmittedAgents = 0;
-            fillAndLogError(common, error, ErrorCode::RequestTimeout, "Timed out waiting for agent submission for agent group " + params.mAgentGroup);
-
-            requestPtr->unsubscribeAll();
-        } else {
-            // OLOG(info, common) << "Agent submission done successfully";
+        size_t numReleased = 0;
+        // surplus agents are not waited for, some may have come up since the submission
+        session.mAgentTracker.refresh(agentQuery(common, session));
+        for (const auto& ai : session.mAgentTracker.agents()) {
+            if (session.mSurplusAgents.count(ai.mGroup) > 0 && session.getAgentTasks(ai.mID).empty()) {
+                OLOG(info, common) << "Releasing surplus agent " << ai.mID << " of agent group " << quoted(ai.mGroup) << " on " << ai.mHost;
+                partition.mTopology->ShutdownDDSAgent(ai.mID);
+                session.mAgentInfo.erase(ai.mID);
+                ++numReleased;
+            }
         }
-    } catch (Error& e) {
-        error = e;
-        OLOG(error, common) << "Agent submission error: " << e;
-        numSubmittedAgents = 0;
+        OLOG(info, common) << "Released " << numReleased << " surplus agents without tasks";
+    } catch (exception& e) {
+        OLOG(error, common) << "Failed releasing surplus agents: " << e.what();
     }
-
-    return numSubmittedAgents;
+    session.mSurplusAgents.clear();
 }
 
-bool Controller::waitForNumActiveSlots(const CommonParams& common, Session& session, Error& error, size_t numSlots)
+bool Controller::waitForAgentGroupSlots(const CommonParams& common, Session& session, Error& error, const map<string, size_t>& groupSlots)
 {
     try {
+        std::chrono::seconds timeout;
         if (!mAgentWaitTimeout.empty()) {
             std::chrono::seconds configuredTimeoutS = (common.mTimeout == 0 ? mTimeout : std::chrono::seconds(common.mTimeout));
-            std::chrono::seconds duration = parseTimeString(mAgentWaitTimeout, configuredTimeoutS);
-            OLOG(debug, common) << "waitForNumActiveSlots: Using --agent-wait-timeout timeout ('" << mAgentWaitTimeout << "') --> " << duration.count() << " seconds";
-            session.mDDSSession.waitForNumSlots<dds::tools_api::CSession::EAgentState::active>(numSlots, duration);
+            timeout = parseTimeString(mAgentWaitTimeout, configuredTimeoutS);
+            OLOG(debug, common) << "waitForAgentGroupSlots: Using --agent-wait-timeout timeout ('" << mAgentWaitTimeout << "') --> " << timeout.count() << " seconds";
         } else {
-            OLOG(debug, common) << "waitForNumActiveSlots: Using default timeout";
-            session.mDDSSession.waitForNumSlots<dds::tools_api::CSession::EAgentState::active>(numSlots, requestTimeout(common, "waitForNumActiveSlots..waitForNumSlots<dds::tools_api::CSession::EAgentState::active>"));
+            OLOG(debug, common) << "waitForAgentGroupSlots: Using default timeout";
+            timeout = requestTimeout(common, "waitForAgentGroupSlots");
+        }
+        const auto deadline = chrono::steady_clock::now() + timeout;
+
+        Timer timer;
+        map<string, size_t> pending(groupSlots);
+        // checked on every update of the agent table, which is shared with concurrent waits on the same session
+        auto groupsReady = [&](const map<string, size_t>& activeSlots, size_t) {
+            for (auto it = pending.begin(); it != pending.end();) {
+                auto active = activeSlots.find(it->first);
+                if (active != activeSlots.end() && active->second >= it->second) {
+                    OLOG(info, common) << "Agent group " << quoted(it->first) << " is ready: " << active->second << "/" << it->second << " slots active after " << timer.duration().count() << " ms";
+                    it = pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            return pending.empty();
+        };
+        if (session.mAgentTracker.waitUntil(agentQuery(common, session), groupsReady, deadline, mAgentGroupPollInterval)) {
+            return true;
+        }
+        const auto activeSlots = session.mAgentTracker.groupSlots();
+        stringstream ss;
+        for (const auto& [group, numSlots] : pending) {
+            auto active = activeSlots.find(group);
+            ss << " " << quoted(group) << ": " << (active == activeSlots.end() ? 0 : active->second) << "/" << numSlots;
         }
+        fillAndLogError(common, error, ErrorCode::RequestTimeout, toString("Timeout waiting for DDS slots of agent groups:", ss.str()));
+        return false;
     } catch (Error& e) {
         error = e;
         OLOG(error, common) << "Error while waiting for DDS slots: " << e;
-        return false;
     } catch (exception& e) {
-        fillAndLogError(common, error, ErrorCode::RequestTimeout, toString("Timeout waiting for DDS slots: ", e.what()));
-        return false;
+        fillAndLogError(common, error, ErrorCode::RequestTimeout, toString("Failed waiting for DDS slots: ", e.what()));
     }
-    return true;
+    return false;
 }
 
 void Controller::attemptSubmitRecovery(const CommonParams& common, Session& session, Error& error, const vector<DDSSubmitParams>& ddsParams, const map<string, uint32_t>& agentCounts)
@@ -375,13 +613,15 @@ void Controller::attemptSubmitRecovery(const CommonParams& common, Session& sess
         }
         if (!error.mCode) {
             try {
-                session.mTotalSlots = getNumSlots(common, session);
+                // the agent counts come from the agent table, so do the slots
+                session.mTotalSlots = session.mAgentTracker.numSlots();
                 for (auto& ni : session.mNinfo) {
                     auto it = find_if(agentCounts.cbegin(), agentCounts.cend(), [&](const auto& ac) {
                         return ac.first == ni.second.agentGroup;
                     });
                     if (it != agentCounts.cend()) {
-                        ni.second.nCurrent = it->second;
+                        // surplus agents may exceed the original count
+                        ni.second.nCurrent = std::min<int32_t>(it->second, ni.second.nOriginal);
                     }
                 }
                 updateTopology(common, session);
@@ -436,6 +676,9 @@ void Controller::updateTopology(const CommonParams& common, Session& session)
 RequestResult Controller::execActivate(const CommonParams& common, const ActivateParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Activate failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     if (!partition.mSession->mDDSSession.IsRunning()) {
@@ -443,8 +686,7 @@ RequestResult Controller::execActivate(const CommonParams& common, const Activat
     }
 
     try {
-        partition.mSession->mTopoFilePath = topoFilepath(common, params.mTopoFile, params.mTopoContent, params.mTopoScript);
-        extractRequirements(common, *(partition.mSession));
+        prepareTopology(common, *(partition.mSession), params.mTopoFile, params.mTopoContent, params.mTopoScript, params.mTopoHash);
     } catch (Error& e) {
         error = e;
         OLOG(error, common) << "Activate failed: " << e;
@@ -455,6 +697,7 @@ RequestResult Controller::execActivate(const CommonParams& common, const Activat
     if (!error.mCode) {
         activate(common, partition, error);
     }
+    stageSnapshot(partition);
 
     TopologyState topologyState(error.mCode ? AggregatedState::Undefined : AggregatedState::Idle);
     return createRequestResult(common, *(partition.mSession), error, "Activate done", std::move(topologyState), "", {});
@@ -466,11 +709,75 @@ void Controller::activate(const CommonParams& common, Partition& partition, Erro
         && createDDSTopology(common, *(partition.mSession), error)
         && createTopology(common, partition, error)
         && waitForState(common, partition, error, "", DeviceState::Idle);
+    releaseSurplusAgents(common, partition);
+}
+
+void Controller::activatePipelined(const CommonParams& common, Partition& partition, Error& error)
+{
+    TopologyState topologyState;
+    const bool activated = activateDDSTopology(common, *(partition.mSession), error, dds::tools_api::STopologyRequest::request_t::EUpdateType::ACTIVATE)
+        && createDDSTopology(common, *(partition.mSession), error)
+        && createTopology(common, partition, error);
+    releaseSurplusAgents(common, partition);
+
+    activated
+        && initializeByAgentGroup(common, partition, error)
+        // barrier: channel addresses are only complete once every device is bound, the slowest agent group gates Connect
+        && changeState(common, partition, error, "", TopoTransition::Connect,  topologyState)
+        && changeState(common, partition, error, "", TopoTransition::InitTask, topologyState);
+}
+
+bool Controller::initializeByAgentGroup(const CommonParams& common, Partition& partition, Error& error)
+{
+    if (partition.mTopology == nullptr) {
+        fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, "FairMQ topology is not initialized");
+        return false;
+    }
+
+    map<string, string> groupPaths = partition.mSession->getAgentGroupPaths();
+    if (groupPaths.empty()) {
+        groupPaths.emplace("", ""); // no task details: whole topology at once
+    }
+    OLOG(info, common) << "Pipelined configure: initializing devices of " << groupPaths.size() << " agent groups as they reach Idle";
+
+    // each agent group proceeds on its own: wait for Idle -> InitDevice -> CompleteInit -> Bind.
+    // The groups only share the topology, the transition statistics and the topology key, which are guarded by their own locks.
+    // The group states carry no detailed state, which would be filled into the shared session.
+    vector<future<Error>> groups;
+    groups.reserve(groupPaths.size());
+    for (const auto& [group, path] : groupPaths) {
+        groups.push_back(async(launch::async, [this, &common, &partition, group = group, path = path]() {
+            Error groupError;
+            Timer timer;
+            TopologyState groupState;
+            bool success = waitForState(common, partition, groupError, path, DeviceState::Idle)
+                && changeState(common, partition, groupError, path, TopoTransition::InitDevice,   groupState)
+                && changeState(common, partition, groupError, path, TopoTransition::CompleteInit, groupState)
+                && changeState(common, partition, groupError, path, TopoTransition::Bind,         groupState);
+            if (success) {
+                OLOG(info, common) << "Pipelined configure: agent group " << quoted(group) << " bound after " << timer.duration().count() << " ms";
+            } else {
+                OLOG(error, common) << "Pipelined configure: agent group " << quoted(group) << " failed: " << groupError;
+            }
+            return groupError;
+        }));
+    }
+
+    for (auto& g : groups) {
+        Error groupError = g.get();
+        if (groupError.mCode && !error.mCode) {
+            error = groupError;
+        }
+    }
+    return !error.mCode;
 }
 
 RequestResult Controller::execRun(const CommonParams& common, const RunParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Run failed", TopologyState(), "", {});
+    }
     try {
         auto& partition = acquirePartition(common);
         std::unordered_set<std::string> hosts;
@@ -488,8 +795,7 @@ RequestResult Controller::execRun(const CommonParams& common, const RunParams& p
 
             if (!error.mCode) {
                 try {
-                    partition.mSession->mTopoFilePath = topoFilepath(common, params.mTopoFile, params.mTopoContent, params.mTopoScript);
-                    extractRequirements(common, *(partition.mSession));
+                    prepareTopology(common, *(partition.mSession), params.mTopoFile, params.mTopoContent, params.mTopoScript, params.mTopoHash);
                 } catch (Error& e) {
                     error = e;
                     OLOG(error, common) << "Topology creation failed: " << e;
@@ -509,7 +815,11 @@ RequestResult Controller::execRun(const CommonParams& common, const RunParams& p
                     }
 
                     if (!error.mCode) {
-                        activate(common, partition, error);
+                        if (params.mPipelined) {
+                            activatePipelined(common, partition, error);
+                        } else {
+                            activate(common, partition, error);
+                        }
                     }
                 }
             }
@@ -517,7 +827,13 @@ RequestResult Controller::execRun(const CommonParams& common, const RunParams& p
             error = Error(MakeErrorCode(ErrorCode::RequestNotSupported), "Repeated Run request is not supported. Shutdown this partition to retry.");
         }
 
-        TopologyState topologyState(error.mCode ? AggregatedState::Undefined : AggregatedState::Idle);
+        stageSnapshot(partition);
+
+        if (params.mStandby && !error.mCode) {
+            prepareStandby(common, params);
+        }
+
+        TopologyState topologyState(error.mCode ? AggregatedState::Undefined : (params.mPipelined ? AggregatedState::Ready : AggregatedState::Idle));
         return createRequestResult(common, *(partition.mSession), error, "Run done", std::move(topologyState), rmsJobIDs, hosts);
     } catch (exception& e) {
         fillAndLogFatalError(common, error, ErrorCode::RuntimeError, e.what());
@@ -528,13 +844,22 @@ RequestResult Controller::execRun(const CommonParams& common, const RunParams& p
 RequestResult Controller::execUpdate(const CommonParams& common, const UpdateParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Update failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState;
 
+    // preparing the new topology replaces the requirements of the running one
+    const bool inPlace = partition.mTopology != nullptr && partition.mSession->mDDSTopo != nullptr;
+    Session::TopologySnapshot previous;
+    if (inPlace) {
+        previous = partition.mSession->snapshotTopology();
+    }
+
     try {
-        partition.mSession->mTopoFilePath = topoFilepath(common, params.mTopoFile, params.mTopoContent, params.mTopoScript);
-        extractRequirements(common, *(partition.mSession));
+        prepareTopology(common, *(partition.mSession), params.mTopoFile, params.mTopoContent, params.mTopoScript, params.mTopoHash);
     } catch (Error& e) {
         error = e;
         OLOG(error, common) << "Topology creation failed: " << e;
@@ -542,21 +867,582 @@ RequestResult Controller::execUpdate(const CommonParams& common, const UpdatePar
         fillAndLogFatalError(common, error, ErrorCode::TopologyFailed, toString("Incorrect topology provided: ", e.what()));
     }
 
-    if (!error.mCode) {
-        changeStateReset(common, partition, error, "", topologyState)
-            && resetTopology(partition)
-            && activateDDSTopology(common, *(partition.mSession), error, dds::tools_api::STopologyRequest::request_t::EUpdateType::UPDATE)
-            && createDDSTopology(common, *(partition.mSession), error)
-            && createTopology(common, partition, error)
-            && waitForState(common, partition, error, "", DeviceState::Idle)
-            && changeStateConfigure(common, partition, error, "", topologyState);
+    if (error.mCode) {
+        if (inPlace) {
+            partition.mSession->restoreTopology(std::move(previous));
+        }
+    } else {
+        if (inPlace) {
+            updateInPlace(common, partition, error, topologyState, std::move(previous));
+        } else {
+            updateWhole(common, partition, error, topologyState);
+        }
     }
+    stageSnapshot(partition);
     return createRequestResult(common, *(partition.mSession), error, "Update done", std::move(topologyState), "", {});
 }
 
+bool Controller::updateWhole(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState)
+{
+    return changeStateReset(common, partition, error, "", topologyState)
+        && resetTopology(partition)
+        && activateDDSTopology(common, *(partition.mSession), error, dds::tools_api::STopologyRequest::request_t::EUpdateType::UPDATE)
+        && createDDSTopology(common, *(partition.mSession), error)
+        && createTopology(common, partition, error)
+        && waitForState(common, partition, error, "", DeviceState::Idle)
+        && changeStateConfigure(common, partition, error, "", topologyState);
+}
+
+bool Controller::updateInPlace(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState, Session::TopologySnapshot previous)
+{
+    Session& session = *(partition.mSession);
+
+    // the FairMQ topology refers to the previous DDS topology until it is switched over, failures switch the session back to it and its requirements
+    const auto previousDDSTopo = previous.mDDSTopo;
+    auto restorePrevious = [&]() {
+        session.restoreTopology(std::move(previous));
+        return false;
+    };
+
+    const AggregatedState previousState = AggregateState(partition.mTopology->GetCurrentState());
+    if (previousState != AggregatedState::Idle && previousState != AggregatedState::Ready && previousState != AggregatedState::Running) {
+        fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Topology can only be updated in Idle, Ready or Running state, current state: ", previousState));
+        return restorePrevious();
+    }
+    if (!createDDSTopology(common, session, error)) {
+        return restorePrevious();
+    }
+
+    TopologyDiff diff;
+    try {
+        diff = diffTopologies(*previousDDSTopo, *(session.mDDSTopo));
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::DDSCreateTopologyFailed, toString("Failed to compare topologies: ", e.what()));
+        return restorePrevious();
+    }
+    OLOG(info, common) << "Topology update: " << diff.mNumKept << " tasks kept (" << diff.mNumChanged << " of them changed), " << diff.mNumRemoved << " removed, " << diff.mNumAdded << " added";
+
+    if (diff.mNumChanged > 0) {
+        // running devices cannot take a new command or requirements, all of them are restarted with the new topology
+        OLOG(info, common) << "Tasks changed their declaration, updating the whole topology";
+        session.mDDSTopo = previousDDSTopo;
+        TopologyState stopState;
+        return (previousState != AggregatedState::Running || changeState(common, partition, error, "", TopoTransition::Stop, stopState))
+            && updateWhole(common, partition, error, topologyState);
+    }
+
+    // removed devices are brought to Idle, DDS stops them during activation
+    bool success = true;
+    if (diff.mNumRemoved > 0 && previousState != AggregatedState::Idle) {
+        TopologyState removedState;
+        success = (previousState != AggregatedState::Running || changeState(common, partition, error, diff.mRemovedPath, TopoTransition::Stop, removedState))
+            && changeStateReset(common, partition, error, diff.mRemovedPath, removedState);
+    }
+
+    success = success && activateDDSTopology(common, session, error, dds::tools_api::STopologyRequest::request_t::EUpdateType::UPDATE);
+    if (!success) {
+        return restorePrevious();
+    }
+
+    try {
+        partition.mTopology->UpdateTopology(*(session.mDDSTopo), diff.mAddedPath);
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::FairMQCreateTopologyFailed, toString("Failed to update FairMQ topology: ", e.what()));
+        // keep the state table consistent with the activated DDS topology
+        resetTopology(partition);
+        createTopology(common, partition, error);
+        return false;
+    }
+
+    // only new devices are brought to the state of the unchanged ones
+    if (diff.mNumAdded > 0) {
+        success = catchUpToState(common, partition, error, diff.mAddedPath, previousState, topologyState);
+    }
+
+    getState(common, partition, error, "", topologyState);
+    return success;
+}
+
+bool Controller::catchUpToState(const CommonParams& common, Partition& partition, Error& error, const string& path, AggregatedState state, TopologyState& topologyState)
+{
+    return waitForState(common, partition, error, path, DeviceState::Idle)
+        && (state == AggregatedState::Idle || changeStateConfigure(common, partition, error, path, topologyState))
+        && (state != AggregatedState::Running || changeState(common, partition, error, path, TopoTransition::Run, topologyState));
+}
+
+void Controller::recover(const string& partitionID)
+{
+    Partition* partition = nullptr;
+    {
+        lock_guard<mutex> lock(mPartitionMtx);
+        auto it = mPartitions.find(partitionID);
+        if (it != mPartitions.end()) {
+            partition = &(it->second);
+        }
+    }
+    if (partition == nullptr || partition->mTopology == nullptr || partition->mSession->mDDSTopo == nullptr) {
+        return;
+    }
+
+    const CommonParams common(partitionID, partition->mSession->mLastRunNr.load(), 0);
+    Error error;
+    TopologyState topologyState;
+    // agents that went down are reported to the topology, which fails all their tasks
+    partition->mSession->mAgentTracker.refresh(agentQuery(common, *(partition->mSession)));
+    if (mCollectionRecovery) {
+        replaceCollections(common, *partition, error, topologyState);
+    }
+    if (mTaskRestart.mMaxRestarts > 0) {
+        restartTasks(common, *partition, error, topologyState);
+    }
+    stageSnapshot(*partition);
+    if (error.mCode) {
+        OLOG(error, common) << "Recovery of the partition failed: " << error;
+    }
+}
+
+bool Controller::replaceCollections(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState)
+{
+    using namespace dds::topology_api;
+    Session& session = *(partition.mSession);
+
+    // they stay pending until the topology with their replacements is built, earlier failures are retried with the next ignored collection
+    const vector<DDSCollectionId> failed = partition.mTopology->GetIgnoredCollections();
+    if (failed.empty()) {
+        return true;
+    }
+
+    const AggregatedState previousState = AggregateState(partition.mTopology->GetCurrentState());
+    if (previousState != AggregatedState::Idle && previousState != AggregatedState::Ready && previousState != AggregatedState::Running) {
+        fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Failed collections can only be replaced in Idle, Ready or Running state, current state: ", previousState));
+        return false;
+    }
+
+    // Runtime IDs follow from the position of a collection in its group, so a failed collection cannot be started again under its ID.
+    // Instead its group grows by the number of failed collections in it: existing instances keep their IDs, the failed ones stay ignored.
+    map<string, size_t> groupGrowth; // group path -> number of added instances
+    set<string> replacedNames;       // names of the replaced collections
+    try {
+        map<string, map<string, size_t>> failedByGroup; // group path -> collection name -> number of failed instances
+        for (const auto id : failed) {
+            const auto& runtimeCollection = session.mDDSTopo->getRuntimeCollectionById(id);
+            const auto* parent = runtimeCollection.m_collection->getParent();
+            if (parent->getType() != CTopoBase::EType::GROUP || parent->getName() == "main") {
+                OLOG(warning, common) << "Failed collection " << quoted(runtimeCollection.m_collectionPath) << " is not in a group, it cannot be replaced";
+                continue;
+            }
+            ++failedByGroup[parent->getPath()][runtimeCollection.m_collection->getName()];
+            replacedNames.insert(runtimeCollection.m_collection->getName());
+        }
+        for (const auto& [groupPath, collections] : failedByGroup) {
+            for (const auto& [name, numFailed] : collections) {
+                groupGrowth[groupPath] = max(groupGrowth[groupPath], numFailed);
+            }
+        }
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::DDSCreateTopologyFailed, toString("Failed to look up the failed collections: ", e.what()));
+        return false;
+    }
+    if (groupGrowth.empty()) {
+        return true;
+    }
+    if (previousState != AggregatedState::Idle && !checkReplacementChannels(common, partition, error, replacedNames)) {
+        return false;
+    }
+
+    // an agent hosts one instance of each collection of its agent group
+    map<string, int32_t> groupAgents; // agent group -> number of agents to submit
+    for (const auto& [name, colInfo] : session.mCollections) {
+        auto it = groupGrowth.find(colInfo.topoPath);
+        if (it != groupGrowth.end() && !colInfo.agentGroup.empty()) {
+            groupAgents[colInfo.agentGroup] = max<int32_t>(groupAgents[colInfo.agentGroup], it->second);
+        }
+    }
+    // the replacement agents come on top of the agents currently up
+    session.mAgentTracker.refresh(agentQuery(common, session));
+    unordered_set<DDSAgentId> previousAgents;
+    for (const auto& ai : session.mAgentTracker.agents()) {
+        previousAgents.insert(ai.mID);
+    }
+    vector<AgentGroupInfo> agentGroups;
+    map<string, size_t> expectedGroupSlots = session.mAgentTracker.groupSlots();
+    for (const auto& [group, numAgents] : groupAgents) {
+        auto agiIt = session.findAgentGroup(group);
+        if (agiIt == session.mAgentGroupInfo.end()) {
+            fillAndLogError(common, error, ErrorCode::DDSSubmitAgentsFailed, toString("Agent group info not found for agent group ", quoted(group)));
+            return false;
+        }
+        AgentGroupInfo agi = *agiIt;
+        agi.numAgents = numAgents;
+        agi.minAgents = -1;
+        agentGroups.push_back(agi);
+        expectedGroupSlots[group] += numAgents * agi.numSlots;
+        OLOG(info, common) << "Submitting " << numAgents << " replacement agents for agent group " << quoted(group);
+    }
+
+    vector<DDSSubmitParams> ddsParams;
+    try {
+        ddsParams = mSubmit.makeParams(mRMS, mZoneCfgs, agentGroups);
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::DDSSubmitAgentsFailed, toString("Failed to prepare the submission of replacement agents: ", e.what()));
+        return false;
+    }
+
+    // a failed replacement leaves the partition as it was: the previous topology stays, the replacement agents are released
+    const string previousTopoFilePath = session.mTopoFilePath;
+    const auto previousDDSTopo = session.mDDSTopo;
+    bfs::path tmpPath;
+    auto rollback = [&]() {
+        session.mDDSTopo = previousDDSTopo;
+        session.mTopoFilePath = previousTopoFilePath;
+        if (!tmpPath.empty()) {
+            boost::system::error_code ec;
+            bfs::remove_all(tmpPath, ec);
+        }
+        try {
+            session.mAgentTracker.refresh(agentQuery(common, session));
+            for (const auto& ai : session.mAgentTracker.agents()) {
+                if (previousAgents.count(ai.mID) > 0 || groupAgents.count(ai.mGroup) == 0) {
+                    continue;
+                }
+                OLOG(info, common) << "Releasing replacement agent " << ai.mID << " of agent group " << quoted(ai.mGroup) << " on " << ai.mHost;
+                partition.mTopology->ShutdownDDSAgent(ai.mID);
+                if (session.mAgentInfo.erase(ai.mID) > 0) {
+                    session.mTotalSlots -= ai.mNumSlots;
+                    session.mGroupSlots[ai.mGroup] -= ai.mNumSlots;
+                }
+            }
+        } catch (const exception& e) {
+            OLOG(error, common) << "Failed releasing replacement agents: " << e.what();
+        }
+    };
+
+    const vector<uint32_t> submitted = submitDDSAgents(common, session, error, ddsParams, ddsParams.size());
+    for (size_t i = 0; i < ddsParams.size() && !error.mCode; ++i) {
+        if (submitted.at(i) != ddsParams.at(i).mNumAgents) {
+            fillAndLogError(common, error, ErrorCode::DDSSubmitAgentsFailed, toString("Submitted ", submitted.at(i), " instead of ", ddsParams.at(i).mNumAgents, " replacement agents for agent group ", quoted(ddsParams.at(i).mAgentGroup)));
+        }
+    }
+    if (error.mCode || !waitForAgentGroupSlots(common, session, error, expectedGroupSlots)) {
+        rollback();
+        return false;
+    }
+    for (const auto& ai : session.mAgentTracker.agents()) {
+        auto agiIt = session.findAgentGroup(ai.mGroup);
+        if (previousAgents.count(ai.mID) > 0 || agiIt == session.mAgentGroupInfo.end()) {
+            continue;
+        }
+        session.mAgentInfo[ai.mID] = AgentInfo{ ai.mNumSlots, static_cast<uint16_t>(distance(session.mAgentGroupInfo.begin(), agiIt)) };
+        session.mTotalSlots += ai.mNumSlots;
+        session.mGroupSlots[ai.mGroup] += ai.mNumSlots;
+        OLOG(info, common) << "Replacement agent " << ai.mID << " of agent group " << quoted(ai.mGroup) << " on " << ai.mHost << " with " << ai.mNumSlots << " slots";
+    }
+
+    // grow the groups of the failed collections in the topology file
+    try {
+        CTopoCreator creator;
+        creator.getMainGroup()->initFromXML(session.mTopoFilePath);
+        for (auto& group : creator.getMainGroup()->getElementsByType(CTopoBase::EType::GROUP)) {
+            auto it = groupGrowth.find(group->getPath());
+            if (it != groupGrowth.end()) {
+                auto topoGroup = static_cast<CTopoGroup*>(group.get());
+                OLOG(info, common) << "Growing group " << quoted(group->getPath()) << " from " << topoGroup->getN() << " to " << topoGroup->getN() + it->second << " to replace failed collections";
+                topoGroup->setN(topoGroup->getN() + it->second);
+            }
+        }
+        tmpPath = bfs::temp_directory_path() / bfs::unique_path();
+        bfs::create_directories(tmpPath);
+        const bfs::path filepath{ tmpPath / ("topo_" + session.mPartitionID + "_recovered.xml") };
+        creator.save(filepath.string());
+        session.mTopoFilePath = filepath.string();
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::DDSCreateTopologyFailed, toString("Failed to write the topology with the replacement collections: ", e.what()));
+        rollback();
+        return false;
+    }
+
+    TopologyDiff diff;
+    vector<pair<DDSCollectionId, string>> added;
+    bool success = createDDSTopology(common, session, error);
+    if (success) {
+        try {
+            diff = diffTopologies(*previousDDSTopo, *(session.mDDSTopo));
+            unordered_set<DDSCollectionId> previousCollections;
+            auto previousColIt = previousDDSTopo->getRuntimeCollectionIterator();
+            for (auto it = previousColIt.first; it != previousColIt.second; ++it) {
+                previousCollections.insert(it->first);
+            }
+            auto colIt = session.mDDSTopo->getRuntimeCollectionIterator();
+            for (auto it = colIt.first; it != colIt.second; ++it) {
+                if (previousCollections.count(it->first) == 0) {
+                    added.emplace_back(it->first, it->second.m_collection->getName());
+                }
+            }
+            // new instances of expendable tasks are expendable as well
+            auto taskIt = session.mDDSTopo->getRuntimeTaskIterator(nullptr);
+            for (auto it = taskIt.first; it != taskIt.second; ++it) {
+                for (const auto& tr : it->second.m_task->getRequirements()) {
+                    if (tr->getRequirementType() == CTopoRequirement::EType::Custom && strStartsWith(tr->getName(), "odc_expendable_") && tr->getValue() == "true") {
+                        session.mExpendableTasks.insert(it->first);
+                    }
+                }
+            }
+        } catch (const exception& e) {
+            fillAndLogError(common, error, ErrorCode::DDSCreateTopologyFailed, toString("Failed to compare topologies: ", e.what()));
+            success = false;
+        }
+    }
+    OLOG(info, common) << "Collection replacement: " << failed.size() << " failed collections, " << added.size() << " added, " << diff.mNumAdded << " tasks added";
+
+    if (success) {
+        // the activation records the agents of the new collections, they have to be known before
+        partition.mTopology->ReplaceCollections(failed, added);
+        success = activateDDSTopology(common, session, error, dds::tools_api::STopologyRequest::request_t::EUpdateType::UPDATE);
+        if (!success) {
+            partition.mTopology->RevertReplaceCollections(failed, added);
+        }
+    }
+    if (!success) {
+        // the FairMQ topology keeps referring to the previous topology, which holds all of its devices
+        rollback();
+        return false;
+    }
+
+    try {
+        partition.mTopology->UpdateTopology(*(session.mDDSTopo), diff.mAddedPath);
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::FairMQCreateTopologyFailed, toString("Failed to update FairMQ topology: ", e.what()));
+        resetTopology(partition);
+        createTopology(common, partition, error);
+        return false;
+    }
+
+    // the new devices are configured like the others, which also makes them take part in the exchange of channel addresses
+    success = diff.mNumAdded == 0 || catchUpToState(common, partition, error, diff.mAddedPath, previousState, topologyState);
+    if (success) {
+        OLOG(info, common) << "Replaced " << failed.size() << " failed collections by " << added.size() << " new ones";
+    }
+    return success;
+}
+
+bool Controller::checkReplacementChannels(const CommonParams& common, Partition& partition, Error& error, const set<string>& collections)
+{
+    // Devices past Connect do not connect again: a replacement binding a channel that devices outside of
+    // the replaced collections connect to would stay without peers. Channels inside of the replacements are fine.
+    set<string> bound;
+    set<string> connected;
+    try {
+        Session& session = *(partition.mSession);
+        unordered_map<DDSTaskId, DDSCollectionId> taskCollections;
+        for (const auto& device : partition.mTopology->GetCurrentState()) {
+            taskCollections.emplace(device.taskId, device.collectionId);
+        }
+        auto [errorCode, result] = partition.mTopology->GetProperties("^chans\\..+\\.method$", "", requestTimeout(common, "GetProperties(channel methods)"));
+        if (errorCode && result.devices.empty()) {
+            fillAndLogError(common, error, ErrorCode::DeviceGetPropertiesFailed, toString("Failed to get the channel methods of the devices: ", errorCode.message()));
+            return false;
+        }
+        for (const auto& [taskId, device] : result.devices) {
+            auto it = taskCollections.find(taskId);
+            const bool replaced = it != taskCollections.end() && it->second != 0
+                               && collections.count(session.mDDSTopo->getRuntimeCollectionById(it->second).m_collection->getName()) > 0;
+            for (const auto& [key, method] : device.props) {
+                const string channel = DataFlow::ChannelName(key);
+                if (channel.empty()) {
+                    continue;
+                }
+                if (replaced && method == "bind") {
+                    bound.insert(channel);
+                } else if (!replaced && method == "connect") {
+                    connected.insert(channel);
+                }
+            }
+        }
+    } catch (const exception& e) {
+        fillAndLogError(common, error, ErrorCode::DeviceGetPropertiesFailed, toString("Failed to get the channel methods of the devices: ", e.what()));
+        return false;
+    }
+
+    for (const auto& channel : bound) {
+        if (connected.count(channel) > 0) {
+            fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Failed collections bind channel ", quoted(channel), ", which connected devices do not connect to again. They can only be replaced in Idle state"));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Controller::restartTasks(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState)
+{
+    // time between probes of a crashed task, until it reports back or its deadline expires
+    constexpr chrono::milliseconds probeInterval{ 1000 };
+    Topology& topo = *(partition.mTopology);
+
+    const auto crashTime = chrono::steady_clock::now();
+    for (const auto id : topo.TakeCrashedTasks()) {
+        const auto due = partition.mRestartLimiter.admit(id, crashTime);
+        if (!due) {
+            partition.mPendingRestarts.erase(id);
+            OLOG(warning, common) << "Expendable task " << id << " crashed more than " << mTaskRestart.mMaxRestarts << " times within " << mTaskRestart.mWindow.count() << " s, it stays ignored";
+            continue;
+        }
+        partition.mPendingRestarts[id] = Partition::PendingRestart{ *due, *due + mTaskRestart.mTimeout };
+        OLOG(info, common) << "Expendable task " << id << " crashed, waiting for it to be started again";
+    }
+
+    // tasks that reported back are brought to the state of the others
+    bool success = true;
+    const vector<DDSTaskId> restarted = topo.TakeRestartedTasks();
+    if (!restarted.empty()) {
+        const unordered_set<DDSTaskId> ids(restarted.begin(), restarted.end());
+        TopoState others;
+        for (const auto& ds : topo.GetCurrentState()) {
+            if (ids.count(ds.taskId) == 0) {
+                others.push_back(ds);
+            }
+        }
+        for (const auto id : restarted) {
+            partition.mPendingRestarts.erase(id);
+        }
+        const AggregatedState state = AggregateState(others);
+        if (state != AggregatedState::Idle && state != AggregatedState::Ready && state != AggregatedState::Running) {
+            fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Restarted tasks can only be brought to Idle, Ready or Running state, current state: ", state));
+            success = false;
+        } else {
+            success = catchUpToState(common, partition, error, tasksPath(*(partition.mSession->mDDSTopo), ids), state, topologyState);
+            if (success) {
+                OLOG(info, common) << "Brought " << restarted.size() << " restarted expendable tasks to " << state << " state";
+            }
+        }
+    }
+
+    const auto now = chrono::steady_clock::now();
+    vector<DDSTaskId> probes;
+    vector<DDSTaskId> expired;
+    auto next = chrono::steady_clock::time_point::max();
+    for (auto it = partition.mPendingRestarts.begin(); it != partition.mPendingRestarts.end();) {
+        auto& pending = it->second;
+        if (now >= pending.mDeadline) {
+            OLOG(warning, common) << "Expendable task " << it->first << " did not report back within " << mTaskRestart.mTimeout.count() << " s, it stays ignored";
+            expired.push_back(it->first);
+            it = partition.mPendingRestarts.erase(it);
+            continue;
+        }
+        if (now >= pending.mProbeAt) {
+            probes.push_back(it->first);
+            pending.mProbeAt = now + probeInterval;
+        }
+        next = min({ next, pending.mProbeAt, pending.mDeadline });
+        ++it;
+    }
+    topo.CancelProbes(expired);
+    topo.ProbeTasks(probes);
+    if (!partition.mPendingRestarts.empty()) {
+        mRecoveryWorker.schedule(partition.mID, chrono::duration_cast<chrono::milliseconds>(next - now) + chrono::milliseconds(1));
+    }
+    return success;
+}
+
+Controller::TopologyDiff Controller::diffTopologies(dds::topology_api::CTopology& from, dds::topology_api::CTopology& to)
+{
+    using namespace dds::topology_api;
+    // what a running task was started with: command, environment and requirements
+    auto declarations = [](CTopology& topo) {
+        unordered_map<DDSTaskId, string> decls;
+        auto itPair = topo.getRuntimeTaskIterator(nullptr);
+        for (auto it = itPair.first; it != itPair.second; ++it) {
+            const auto& task = it->second.m_task;
+            set<string> requirements;
+            for (const auto& tr : task->getRequirements()) {
+                requirements.insert(toString(static_cast<int>(tr->getRequirementType()), ":", tr->getName(), "=", tr->getValue()));
+            }
+            string decl = toString(task->getExe(), "\n", task->getEnv());
+            for (const auto& r : requirements) {
+                decl += "\n" + r;
+            }
+            decls.emplace(it->first, move(decl));
+        }
+        return decls;
+    };
+    const unordered_map<DDSTaskId, string> fromDecls = declarations(from);
+    const unordered_map<DDSTaskId, string> toDecls = declarations(to);
+
+    unordered_set<DDSTaskId> removed;
+    unordered_set<DDSTaskId> added;
+    TopologyDiff diff;
+    for (const auto& [id, decl] : fromDecls) {
+        auto it = toDecls.find(id);
+        if (it == toDecls.end()) {
+            removed.insert(id);
+        } else {
+            ++diff.mNumKept;
+            if (it->second != decl) {
+                ++diff.mNumChanged;
+            }
+        }
+    }
+    for (const auto& [id, decl] : toDecls) {
+        if (fromDecls.count(id) == 0) {
+            added.insert(id);
+        }
+    }
+    diff.mNumRemoved = removed.size();
+    diff.mNumAdded = added.size();
+    diff.mRemovedPath = tasksPath(from, removed);
+    diff.mAddedPath = tasksPath(to, added);
+    return diff;
+}
+
+string Controller::tasksPath(dds::topology_api::CTopology& topo, const unordered_set<DDSTaskId>& taskIds)
+{
+    if (taskIds.empty()) {
+        return "";
+    }
+
+    map<DDSCollectionId, size_t> collectionSizes;
+    map<DDSCollectionId, vector<string>> collectionTasks; // selected task paths by runtime collection
+    set<string> patterns;
+    auto itPair = topo.getRuntimeTaskIterator(nullptr);
+    for (auto it = itPair.first; it != itPair.second; ++it) {
+        const auto& task = it->second;
+        if (task.m_taskCollectionId != 0) {
+            ++collectionSizes[task.m_taskCollectionId];
+        }
+        if (taskIds.count(it->first) == 0) {
+            continue;
+        }
+        if (task.m_taskCollectionId != 0) {
+            collectionTasks[task.m_taskCollectionId].push_back(task.m_taskPath);
+        } else {
+            patterns.insert(Session::escapeRegex(task.m_taskPath));
+        }
+    }
+
+    // whole runtime collections are matched by their path, to keep the expression short
+    for (const auto& [colId, paths] : collectionTasks) {
+        const string colPath = paths.front().substr(0, paths.front().rfind('/'));
+        if (paths.size() == collectionSizes.at(colId) && !colPath.empty()) {
+            patterns.insert(Session::escapeRegex(colPath) + "/.*");
+        } else {
+            for (const auto& p : paths) {
+                patterns.insert(Session::escapeRegex(p));
+            }
+        }
+    }
+
+    string path;
+    for (const auto& p : patterns) {
+        path += (path.empty() ? "" : "|") + p;
+    }
+    return "^(" + path + ")$";
+}
+
 RequestResult Controller::execShutdown(const CommonParams& common)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Shutdown failed", TopologyState(), "", {});
+    }
 
     // grab the session id before shutting down the session, to return it in the reply
     string ddsSessionId;
@@ -568,13 +1454,263 @@ RequestResult Controller::execShutdown(const CommonParams& common)
 
     removePartition(common);
     updateRestore();
+    {
+        lock_guard<mutex> lock(mSnapshotMtx);
+        mStagedSnapshots.erase(common.mPartitionID);
+    }
+
+    shutdownStandby(common);
 
     return createRequestResult(common, ddsSessionId, error, "Shutdown done", TopologyState(), "", {});
 }
 
+RequestResult Controller::execTakeover(const CommonParams& common)
+{
+    Error error;
+    string standbyID;
+    RunParams runParams;
+    if (checkPartitionID(common, error)) {
+        lock_guard<mutex> lock(mStandbyMtx);
+        auto it = mStandbys.find(common.mPartitionID);
+        if (it == mStandbys.end() || it->second.mCancelled) {
+            fillAndLogError(common, error, ErrorCode::RequestNotSupported, "Partition has no standby partition. Use Run with standby enabled to prepare one.");
+        } else if (it->second.mState != "READY") {
+            fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Standby partition ", quoted(it->second.mPartitionID), " is not ready, state: ", it->second.mState));
+        } else {
+            standbyID = it->second.mPartitionID;
+            runParams = it->second.mRunParams;
+            // the preparation is done, the future only waits for its thread to exit
+            mStandbys.erase(it);
+        }
+    }
+    if (error.mCode) {
+        return createRequestResult(common, "", error, "Takeover failed", TopologyState(), "", {});
+    }
+
+    OLOG(info, common) << "Taking over with standby partition " << quoted(standbyID);
+
+    // the failed partition is gone either way, errors shutting it down do not stop the takeover
+    {
+        Error shutdownError;
+        auto& partition = acquirePartition(common);
+        shutdownDDSSession(common, partition, shutdownError);
+    }
+    removePartition(common);
+
+    string ddsSessionId;
+    Partition* partition = nullptr;
+    {
+        lock_guard<mutex> lock(mPartitionMtx);
+        auto node = mPartitions.extract(standbyID);
+        if (!node.empty()) {
+            node.key() = common.mPartitionID;
+            node.mapped().mID = common.mPartitionID;
+            node.mapped().mStandbyFor.clear();
+            node.mapped().mSession->mPartitionID = common.mPartitionID;
+            ddsSessionId = to_string(node.mapped().mSession->mDDSSession.getSessionID());
+            partition = &(mPartitions.insert(std::move(node)).position->second);
+        }
+    }
+    if (ddsSessionId.empty()) {
+        fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Standby partition ", quoted(standbyID), " is gone"));
+        return createRequestResult(common, "", error, "Takeover failed", TopologyState(), "", {});
+    }
+    // the topology was created for the standby ID, its recovery handlers and logs follow the rename
+    if (partition->mTopology != nullptr) {
+        partition->mTopology->SetPartitionID(common.mPartitionID);
+        setTopologyHandlers(*partition);
+    }
+    updateRestore();
+    updateHistory(common, ddsSessionId);
+
+    RequestResult result = execStart(common, DeviceParams());
+    result.mMsg = "Takeover done";
+
+    if (runParams.mStandby && !result.mError.mCode) {
+        prepareStandby(common, runParams);
+    }
+    return result;
+}
+
+void Controller::prepareStandby(const CommonParams& common, const RunParams& params)
+{
+    const string partitionID = common.mPartitionID;
+    const string standbyID = toString(common.mPartitionID, kStandbySuffix);
+    const uint64_t runNr = common.mRunNr;
+    const size_t timeout = common.mTimeout;
+    RunParams standbyParams = params;
+    standbyParams.mStandby = false;
+
+    lock_guard<mutex> lock(mStandbyMtx);
+    reapStandbys();
+    if (mStandbys.count(partitionID) > 0) {
+        OLOG(warning, common) << "Standby partition " << quoted(standbyID) << " already exists, state: " << mStandbys.at(partitionID).mState;
+        return;
+    }
+    Standby& standby = mStandbys[partitionID];
+    standby.mPartitionID = standbyID;
+    standby.mRunParams = params;
+    standby.mState = "PREPARING";
+    OLOG(info, common) << "Preparing standby partition " << quoted(standbyID);
+
+    // Admitted like a recovery of the standby partition. Clients cannot address it, its ID is reserved.
+    standby.mPreparation = async(launch::async, [this, partitionID, standbyID, runNr, timeout, standbyParams]() {
+        admitStandby(standbyID, [&]() {
+            // each request measures its own timeout
+            const auto standbyCommon = [&]() {
+                CommonParams common(standbyID, runNr, timeout);
+                common.mInternal = true;
+                return common;
+            };
+
+            bool success = false;
+            bool cancelled = false;
+            // a failed attempt is shut down right away, so that it does not keep its agents
+            for (size_t attempt = 1; attempt <= kStandbyAttempts && !success && !cancelled; ++attempt) {
+                try {
+                    acquirePartition(standbyCommon());
+                    {
+                        lock_guard<mutex> partitionLock(mPartitionMtx);
+                        mPartitions.at(standbyID).mStandbyFor = partitionID;
+                    }
+                    RequestResult result = execRun(standbyCommon(), standbyParams);
+                    if (!result.mError.mCode && result.mTopologyState.aggregated != AggregatedState::Ready) {
+                        result = execConfigure(standbyCommon(), DeviceParams());
+                    }
+                    success = !result.mError.mCode;
+                } catch (const exception& e) {
+                    OLOG(error, standbyID, runNr) << "Failed to prepare standby partition: " << e.what();
+                }
+                if (!success) {
+                    OLOG(warning, standbyID, runNr) << "Attempt " << attempt << " of " << kStandbyAttempts << " to prepare the standby partition failed, shutting it down";
+                    execShutdown(standbyCommon());
+                }
+                lock_guard<mutex> lock(mStandbyMtx);
+                cancelled = mStandbys.at(partitionID).mCancelled;
+            }
+
+            {
+                lock_guard<mutex> lock(mStandbyMtx);
+                Standby& standby = mStandbys.at(partitionID);
+                cancelled = standby.mCancelled;
+                standby.mState = cancelled ? "SHUTTING_DOWN" : (success ? "READY" : "FAILED");
+            }
+            if (cancelled && success) {
+                OLOG(info, standbyID, runNr) << "Active partition " << quoted(partitionID) << " is gone, shutting down its standby partition";
+                execShutdown(standbyCommon());
+            } else {
+                OLOG(info, standbyID, runNr) << "Standby partition for " << quoted(partitionID) << (success ? " is ready" : " failed");
+            }
+        });
+    });
+}
+
+void Controller::shutdownStandby(const CommonParams& common)
+{
+    lock_guard<mutex> lock(mStandbyMtx);
+    reapStandbys();
+    auto it = mStandbys.find(common.mPartitionID);
+    if (it == mStandbys.end() || it->second.mCancelled) {
+        return;
+    }
+    Standby& standby = it->second;
+    standby.mCancelled = true;
+    if (standby.mPreparation.valid() && standby.mPreparation.wait_for(chrono::seconds(0)) != future_status::ready) {
+        OLOG(info, common) << "Standby partition " << quoted(standby.mPartitionID) << " is shut down once its preparation is done";
+        return;
+    }
+    if (standby.mState == "FAILED") {
+        // failed attempts are shut down by the preparation
+        mStandbys.erase(it);
+        return;
+    }
+
+    OLOG(info, common) << "Shutting down standby partition " << quoted(standby.mPartitionID);
+    standby.mState = "SHUTTING_DOWN";
+    CommonParams standbyCommon(standby.mPartitionID, common.mRunNr, common.mTimeout);
+    standbyCommon.mInternal = true;
+    standby.mPreparation = async(launch::async, [this, standbyCommon]() {
+        admitStandby(standbyCommon.mPartitionID, [&]() { execShutdown(standbyCommon); });
+    });
+}
+
+void Controller::adoptStandby(const string& partitionID, const string& standbyID)
+{
+    bool ready = false;
+    {
+        lock_guard<mutex> lock(mPartitionMtx);
+        auto it = mPartitions.find(standbyID);
+        if (it == mPartitions.end()) {
+            return;
+        }
+        it->second.mStandbyFor = partitionID;
+        const auto& session = it->second.mSession;
+        const auto& topology = it->second.mTopology;
+        try {
+            ready = mPartitions.count(partitionID) > 0
+                && topology != nullptr && session->mDDSTopo != nullptr
+                && aggregateStateForPath(session->mDDSTopo.get(), topology->GetCurrentState(), "") == AggregatedState::Ready;
+        } catch (const exception& e) {
+            OLOG(warning, standbyID, 0) << "Failed to get the state of the standby partition: " << e.what();
+        }
+    }
+
+    lock_guard<mutex> lock(mStandbyMtx);
+    Standby& standby = mStandbys[partitionID];
+    standby.mPartitionID = standbyID;
+    if (ready) {
+        // the run parameters are not restored, a takeover does not prepare the next standby partition
+        OLOG(info, partitionID, 0) << "Adopted standby partition " << quoted(standbyID);
+        standby.mState = "READY";
+        return;
+    }
+
+    OLOG(info, partitionID, 0) << "Standby partition " << quoted(standbyID) << " is not ready or its partition is gone, shutting it down";
+    standby.mState = "SHUTTING_DOWN";
+    standby.mCancelled = true;
+    CommonParams standbyCommon(standbyID, 0, 0);
+    standbyCommon.mInternal = true;
+    standby.mPreparation = async(launch::async, [this, standbyCommon]() {
+        admitStandby(standbyCommon.mPartitionID, [&]() { execShutdown(standbyCommon); });
+    });
+}
+
+void Controller::admitStandby(const string& standbyID, const function<void()>& task)
+{
+    if (mRecoveryAdmission) {
+        mRecoveryAdmission(standbyID, task);
+    } else {
+        task();
+    }
+}
+
+void Controller::reapStandbys()
+{
+    for (auto it = mStandbys.begin(); it != mStandbys.end();) {
+        const bool done = !it->second.mPreparation.valid() || it->second.mPreparation.wait_for(chrono::seconds(0)) == future_status::ready;
+        if (done && (it->second.mCancelled || it->second.mState == "FAILED")) {
+            it = mStandbys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool Controller::checkPartitionID(const CommonParams& common, Error& error)
+{
+    if (!common.mInternal && boost::algorithm::ends_with(common.mPartitionID, kStandbySuffix)) {
+        fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Partition IDs ending in ", quoted(kStandbySuffix), " are reserved for standby partitions. Address them through their active partition."));
+        return false;
+    }
+    return true;
+}
+
 RequestResult Controller::execSetProperties(const CommonParams& common, const SetPropertiesParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "SetProperties failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState;
@@ -585,43 +1721,76 @@ RequestResult Controller::execSetProperties(const CommonParams& common, const Se
 RequestResult Controller::execGetState(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "GetState failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
     getState(common, partition, error, params.mPath, topologyState);
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
     return createRequestResult(common, *(partition.mSession), error, "GetState done", std::move(topologyState), "", {});
 }
 
 RequestResult Controller::execConfigure(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Configure failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
-    changeStateConfigure(common, partition, error, params.mPath, topologyState);
+    changeStateConfigure(common, partition, error, params.mPath, topologyState, params.mRollout);
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
     return createRequestResult(common, *(partition.mSession), error, "Configure done", std::move(topologyState), "", {});
 }
 
 RequestResult Controller::execStart(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Start failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     // update run number
     partition.mSession->mLastRunNr.store(common.mRunNr);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
-    changeState(common, partition, error, params.mPath, TopoTransition::Run, topologyState);
-    return createRequestResult(common, *(partition.mSession), error, "Start done", std::move(topologyState), "", {});
+    string msg("Start done");
+    if (mScheduledStartMargin.count() > 0 && params.mRollout.IsLimited()) {
+        // a rollout in waves contradicts starting all devices at the same time
+        fillAndLogError(common, error, ErrorCode::RequestNotSupported, toString("Rollout limits (", params.mRollout, ") are not supported with scheduled start"));
+        msg = "Start failed";
+    } else if (mScheduledStartMargin.count() > 0) {
+        TransitionSkew skew;
+        changeStateScheduled(common, partition, error, params.mPath, TopoTransition::Run, topologyState, skew);
+        msg = toString(msg, " (scheduled start, ", skew, ")");
+    } else if (mOrderedStartStop) {
+        changeStateOrdered(common, partition, error, params.mPath, TopoTransition::Run, topologyState, params.mRollout);
+    } else {
+        changeState(common, partition, error, params.mPath, TopoTransition::Run, topologyState, params.mRollout);
+    }
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
+    return createRequestResult(common, *(partition.mSession), error, msg, std::move(topologyState), "", {});
 }
 
 RequestResult Controller::execStop(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Stop failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
-    changeState(common, partition, error, params.mPath, TopoTransition::Stop, topologyState);
+    if (mOrderedStartStop) {
+        changeStateOrdered(common, partition, error, params.mPath, TopoTransition::Stop, topologyState, params.mRollout);
+    } else {
+        changeState(common, partition, error, params.mPath, TopoTransition::Stop, topologyState, params.mRollout);
+    }
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
 
     // reset the run number, which is valid only for the running state
     partition.mSession->mLastRunNr.store(0);
@@ -632,25 +1801,61 @@ RequestResult Controller::execStop(const CommonParams& common, const DeviceParam
 RequestResult Controller::execReset(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Reset failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
-    changeStateReset(common, partition, error, params.mPath, topologyState);
+    changeStateReset(common, partition, error, params.mPath, topologyState, params.mRollout);
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
     return createRequestResult(common, *(partition.mSession), error, "Reset done", std::move(topologyState), "", {});
 }
 
 RequestResult Controller::execTerminate(const CommonParams& common, const DeviceParams& params)
 {
     Error error;
+    if (!checkPartitionID(common, error)) {
+        return createRequestResult(common, "", error, "Terminate failed", TopologyState(), "", {});
+    }
     auto& partition = acquirePartition(common);
 
     TopologyState topologyState(AggregatedState::Undefined, params.mDetailed ? std::make_optional<DetailedState>() : std::nullopt);
-    changeState(common, partition, error, params.mPath, TopoTransition::End, topologyState);
+    changeState(common, partition, error, params.mPath, TopoTransition::End, topologyState, params.mRollout);
+    partition.mSession->filterDetailedStateByHost(params.mHost, topologyState);
     return createRequestResult(common, *(partition.mSession), error, "Terminate done", std::move(topologyState), "", {});
 }
 
+unordered_set<uint64_t> Controller::getTasks(const string& partitionID, const string& path)
+{
+    lock_guard<mutex> lock(mPartitionMtx);
+    auto it = mPartitions.find(partitionID);
+    if (it == mPartitions.end() || it->second.mTopology == nullptr) {
+        return {};
+    }
+    try {
+        unordered_set<uint64_t> tasks;
+        for (const auto& taskId : it->second.mTopology->GetTasks(path)) {
+            tasks.insert(taskId);
+        }
+        return tasks;
+    } catch (const exception& e) {
+        OLOG(debug, partitionID, 0) << "Failed to resolve tasks of path " << quoted(path) << ": " << e.what();
+        return {};
+    }
+}
+
 StatusRequestResult Controller::execStatus(const StatusParams& params)
 {
+    // standby partition ID -> (active partition ID, standby state)
+    map<string, pair<string, string>> standbys;
+    {
+        lock_guard<mutex> lock(mStandbyMtx);
+        for (const auto& s : mStandbys) {
+            standbys.emplace(s.second.mPartitionID, make_pair(s.first, s.second.mState));
+        }
+    }
+
     lock_guard<mutex> lock(mPartitionMtx);
 
     StatusRequestResult result;
@@ -665,6 +1870,12 @@ StatusRequestResult Controller::execStatus(const StatusParams& params)
         } catch (exception& e) {
             OLOG(warning, status.mPartitionID, 0) << "Failed to get session ID or session status: " << e.what();
         }
+        status.mNumAgents = session->mAgentInfo.size();
+        status.mNumSlots = session->mTotalSlots;
+        if (auto it = standbys.find(status.mPartitionID); it != standbys.end()) {
+            status.mStandbyFor = it->second.first;
+            status.mStandbyState = it->second.second;
+        }
 
         // Filter running sessions if needed
         if ((params.mRunning && status.mDDSSessionStatus == DDSSessionStatus::running) || (!params.mRunning)) {
@@ -680,6 +1891,9 @@ StatusRequestResult Controller::execStatus(const StatusParams& params)
             result.mPartitions.push_back(status);
         }
     }
+    result.mTopoScriptCacheStats = mTopoScriptCache.stats();
+    result.mAgentPools = mAgentPool.status();
+    result.mSessionPool = mSessionPool.stats();
     result.mStatusCode = StatusCode::ok;
     result.mMsg = "Status done";
     result.mExecTime = params.mTimer.duration().count();
@@ -687,64 +1901,189 @@ StatusRequestResult Controller::execStatus(const StatusParams& params)
 }
 
 void Controller::updateRestore()
-{
-    if (mRestoreId.empty()) {
-        return;
-    }
-
+{
     RestoreData data;
+    data.mSpareSessions = mSessionPool.sessionIDs();
 
+    // the restore ID is checked under the lock, since the session pool may call this before restore() has set it
     lock_guard<mutex> lock(mPartitionMtx);
+    if (mRestoreId.empty()) {
+        return;
+    }
     for (const auto& p : mPartitions) {
         const auto& session =  p.second.mSession;
         try {
             if (session->mDDSSession.IsRunning()) {
-                data.mPartitions.push_back(RestorePartition(session->mPartitionID, to_string(session->mDDSSession.getSessionID())));
+                data.mPartitions.push_back(RestorePartition(session->mPartitionID, to_string(session->mDDSSession.getSessionID()), p.second.mStandbyFor));
             }
         } catch (exception& e) {
             OLOG(warning, session->mPartitionID, 0) << "Failed to get session ID or session status: " << e.what();
         }
     }
+    // a crash while restoring must not lose the partitions that are not back yet
+    for (const auto& [id, pending] : mRestorePending) {
+        if (none_of(data.mPartitions.begin(), data.mPartitions.end(), [&](const RestorePartition& p) { return p.mPartitionID == id; })) {
+            data.mPartitions.push_back(pending);
+        }
+    }
 
-    // Writing the file is locked by mPartitionMtx
-    // This is done in order to prevent write failure in case of a parallel execution.
-    RestoreFile(mRestoreId, mRestoreDir, data).write();
+    // Queued under mPartitionMtx, so that the latest restore data is also queued last. The file is written in the background.
+    mPersistence.restore(mRestoreId, mRestoreDir, std::move(data));
 }
 
-void Controller::updateHistory(const CommonParams& common, const std::string& sessionId)
+void Controller::stageSnapshot(const Partition& partition)
 {
-    if (mHistoryDir.empty()) {
+    const Session& session = *(partition.mSession);
+    PartitionSnapshot snapshot;
+    snapshot.mPartitionID = session.mPartitionID;
+    snapshot.mTopoFilePath = session.mTopoFilePath;
+    snapshot.mDetails.mTasks.reserve(session.mTaskDetails.size());
+    for (const auto& [taskID, details] : session.mTaskDetails) {
+        snapshot.mDetails.mTasks.push_back(details);
+    }
+    snapshot.mDetails.mCollections.reserve(session.mCollectionDetails.size());
+    for (const auto& [collectionID, details] : session.mCollectionDetails) {
+        snapshot.mDetails.mCollections.push_back(details);
+    }
+    snapshot.mDetails.mAgents.assign(session.mAgentInfo.begin(), session.mAgentInfo.end());
+
+    lock_guard<mutex> lock(mSnapshotMtx);
+    mStagedSnapshots[snapshot.mPartitionID] = move(snapshot);
+}
+
+void Controller::writeSnapshots()
+{
+    string restoreId;
+    string restoreDir;
+    vector<string> ids;
+    {
+        lock_guard<mutex> lock(mPartitionMtx);
+        restoreId = mRestoreId;
+        restoreDir = mRestoreDir;
+        for (const auto& [id, partition] : mPartitions) {
+            ids.push_back(id);
+        }
+    }
+    if (restoreId.empty()) {
         return;
     }
 
-    lock_guard<mutex> lock(mPartitionMtx);
+    // the live state is copied outside of the partition map lock, serialized with the requests of the partition like its recovery
+    vector<PartitionSnapshot> snapshots;
+    for (const auto& id : ids) {
+        auto take = [&]() {
+            Partition* partition = nullptr;
+            {
+                lock_guard<mutex> lock(mPartitionMtx);
+                auto it = mPartitions.find(id);
+                if (it != mPartitions.end()) {
+                    partition = &(it->second);
+                }
+            }
+            if (partition == nullptr || partition->mTopology == nullptr) {
+                return;
+            }
+            PartitionSnapshot snapshot;
+            snapshot.mPartitionID = id;
+            try {
+                snapshot.mDDSSessionID = to_string(partition->mSession->mDDSSession.getSessionID());
+            } catch (exception& e) {
+                OLOG(warning, id, 0) << "Failed to get session ID for the snapshot: " << e.what();
+                return;
+            }
+            snapshot.mRunNr = partition->mSession->mLastRunNr.load();
+            snapshot.mStates = partition->mTopology->GetCurrentState();
+            snapshots.push_back(move(snapshot));
+        };
+        if (mRecoveryAdmission) {
+            mRecoveryAdmission(id, take);
+        } else {
+            take();
+        }
+    }
 
-    try {
-        auto dir = filesystem::path(mHistoryDir);
-        if (!filesystem::exists(dir) && !filesystem::create_directories(dir)) {
-            throw runtime_error(toString("History: failed to create directory ", quoted(dir.string())));
+    set<string> partitionIDs;
+    for (auto& snapshot : snapshots) {
+        partitionIDs.insert(snapshot.mPartitionID);
+        {
+            lock_guard<mutex> lock(mSnapshotMtx);
+            auto it = mStagedSnapshots.find(snapshot.mPartitionID);
+            if (it != mStagedSnapshots.end()) {
+                snapshot.mTopoFilePath = it->second.mTopoFilePath;
+                snapshot.mDetails = it->second.mDetails;
+            }
+        }
+        const string encoded = snapshot.Encode();
+        const size_t hash = std::hash<string>()(encoded);
+        auto it = mSnapshotHashes.find(snapshot.mPartitionID);
+        if (it != mSnapshotHashes.end() && it->second == hash) {
+            continue;
+        }
+        if (SnapshotFile(restoreId, snapshot.mPartitionID, restoreDir).write(encoded)) {
+            mSnapshotHashes[snapshot.mPartitionID] = hash;
+        }
+    }
+
+    for (auto it = mSnapshotHashes.begin(); it != mSnapshotHashes.end();) {
+        if (partitionIDs.count(it->first) == 0) {
+            SnapshotFile(restoreId, it->first, restoreDir).remove();
+            it = mSnapshotHashes.erase(it);
+        } else {
+            ++it;
         }
+    }
+}
 
-        filesystem::path filepath = dir / toString("odc_session_history.log");
+void Controller::applySnapshot(const CommonParams& common, Partition& partition, const PartitionSnapshot& snapshot)
+{
+    Session& session = *(partition.mSession);
+    if (snapshot.mDDSSessionID != to_string(session.mDDSSession.getSessionID()) || snapshot.mTopoFilePath != session.mTopoFilePath) {
+        OLOG(info, common) << "Ignoring snapshot of session " << quoted(snapshot.mDDSSessionID) << " with topology " << quoted(snapshot.mTopoFilePath) << ", the partition has moved on";
+        return;
+    }
 
-        OLOG(info, common) << "Updating history file " << quoted(filepath.string()) << "...";
+    for (const auto& details : snapshot.mDetails.mTasks) {
+        if (session.mTaskDetails.emplace(details.mTaskID, details).second) {
+            session.indexTask(details);
+        }
+    }
+    for (const auto& details : snapshot.mDetails.mCollections) {
+        session.mCollectionDetails.emplace(details.mCollectionID, details);
+    }
+    for (const auto& [agentID, info] : snapshot.mDetails.mAgents) {
+        session.mAgentInfo.emplace(agentID, info);
+    }
+    if (session.mLastRunNr == 0) {
+        session.mLastRunNr = snapshot.mRunNr;
+    }
+    // devices that already reported their state keep it, the others show the snapshot state until they report or the request timeout passes
+    const size_t numStates = (partition.mTopology != nullptr) ? partition.mTopology->ApplySnapshot(snapshot.mStates, mTimeout) : 0;
+    OLOG(info, common) << "Restored from snapshot: " << numStates << " device states, " << snapshot.mDetails.mTasks.size() << " tasks, "
+                       << snapshot.mDetails.mCollections.size() << " collections, " << snapshot.mDetails.mAgents.size() << " agents, run number " << session.mLastRunNr;
 
-        stringstream ss;
-        ss << getDateTime() << ", " << common.mPartitionID << ", " << sessionId << "\n";
+    stageSnapshot(partition);
+}
 
-        ofstream out;
-        out.open(filepath, std::ios_base::app);
-        out << ss.str() << flush;
-    } catch (const std::exception& e) {
-        OLOG(error) << "Failed to write history file " << quoted(toString(mHistoryDir, "/odc_session_history.log")) << ": " << e.what();
+void Controller::updateHistory(const CommonParams& common, const std::string& sessionId)
+{
+    if (mHistoryDir.empty()) {
+        return;
     }
+
+    OLOG(info, common) << "Updating history file in " << quoted(mHistoryDir) << "...";
+
+    stringstream ss;
+    ss << getDateTime() << ", " << common.mPartitionID << ", " << sessionId << "\n";
+    mPersistence.history(mHistoryDir, ss.str());
 }
 
 RequestResult Controller::createRequestResult(const CommonParams& common, const Session& session, const Error& error, const string& msg, TopologyState&& topologyState, const std::string& rmsJobIDs, const std::unordered_set<std::string>& hosts)
 {
     string sidStr = to_string(session.mDDSSession.getSessionID());
     StatusCode status = error.mCode ? StatusCode::error : StatusCode::ok;
-    return RequestResult(status, msg, common.mTimer.duration().count(), error, common.mPartitionID, common.mRunNr, sidStr, std::move(topologyState), rmsJobIDs, hosts);
+    RequestResult result(status, msg, common.mTimer.duration().count(), error, common.mPartitionID, common.mRunNr, sidStr, std::move(topologyState), rmsJobIDs, hosts);
+    result.mTopoHash = session.mTopoHash;
+    return result;
 }
 
 RequestResult Controller::createRequestResult(const CommonParams& common, const string& sessionId, const Error& error, const string& msg, TopologyState&& topologyState, const std::string& rmsJobIDs, const std::unordered_set<std::string>& hosts)
@@ -755,6 +2094,18 @@ RequestResult Controller::createRequestResult(const CommonParams& common, const
 
 bool Controller::createDDSSession(const CommonParams& common, Session& session, Error& error)
 {
+    const string spareSessionID = mSessionPool.take();
+    if (!spareSessionID.empty()) {
+        try {
+            session.mDDSSession.attach(spareSessionID);
+            OLOG(info, common) << "Attached to spare DDS session: " << spareSessionID;
+            updateHistory(common, spareSessionID);
+            return true;
+        } catch (exception& e) {
+            OLOG(warning, common) << "Failed to attach to spare DDS session " << spareSessionID << ": " << e.what() << ". Creating a new one.";
+        }
+    }
+
     try {
         boost::uuids::uuid sessionID = session.mDDSSession.create();
         OLOG(info, common) << "DDS session created with session ID: " << to_string(sessionID);
@@ -789,8 +2140,17 @@ bool Controller::shutdownDDSSession(const CommonParams& common, Partition& parti
         partition.mSession->mCollections.clear();
         partition.mSession->mAgentGroupInfo.clear();
         partition.mSession->mTopoFilePath.clear();
+        partition.mSession->mParsedDDSTopo.reset();
+        partition.mSession->mParsedTopoFilePath.clear();
+        partition.mSession->mTopoHash.clear();
+        partition.mSession->mTopoCacheEntry.reset();
+        partition.mSession->mTopoCachePin.reset();
         partition.mSession->mExpendableTasks.clear();
         partition.mSession->mAgentInfo.clear();
+        partition.mSession->mAgentTracker.clear();
+        partition.mSession->mGroupSlots.clear();
+        partition.mSession->mSurplusAgents.clear();
+        partition.mSession->clearIndices();
 
         if (partition.mSession->mDDSSession.getSessionID() != boost::uuids::nil_uuid()) {
             if (partition.mSession->mDDSOnTaskDoneRequest) {
@@ -867,7 +2227,8 @@ bool Controller::activateDDSTopology(const CommonParams& common, Session& sessio
         }
     });
 
-    requestPtr->setResponseCallback([&common, &session, &mtx](const dds::tools_api::STopologyResponseData& res) {
+    vector<DDSTaskId> stopped; // tasks stopped by an update
+    requestPtr->setResponseCallback([&common, &session, &mtx, &stopped](const dds::tools_api::STopologyResponseData& res) {
         OLOG(debug, common) << "DDS Activate Response: "
             << "agentID: " << res.m_agentID
             << "; slotID: " << res.m_slotID
@@ -883,7 +2244,8 @@ bool Controller::activateDDSTopology(const CommonParams& common, Session& sessio
             // response callbacks can be called in parallel - protect session access with a lock
             lock_guard<mutex> lock(mtx);
             std::string rmsJobId = session.mAgentGroupInfo.at(session.mAgentInfo.at(res.m_agentID).agentGroupInfoIndex).rmsJobID;
-            session.mTaskDetails.emplace(res.m_taskID, TaskDetails{res.m_agentID, res.m_slotID, res.m_taskID, res.m_collectionID, res.m_path, res.m_host, res.m_wrkDir, rmsJobId});
+            auto [taskIt, inserted] = session.mTaskDetails.emplace(res.m_taskID, TaskDetails{res.m_agentID, res.m_slotID, res.m_taskID, res.m_collectionID, res.m_path, res.m_host, res.m_wrkDir, rmsJobId});
+            session.indexTask(taskIt->second);
 
             if (res.m_collectionID > 0) {
                 if (session.mCollectionDetails.find(res.m_collectionID) == session.mCollectionDetails.end()) {
@@ -896,6 +2258,9 @@ bool Controller::activateDDSTopology(const CommonParams& common, Session& sessio
                     session.mRuntimeCollectionIndex.at(res.m_collectionID)->mRuntimeCollectionAgents[res.m_collectionID] = res.m_agentID;
                 }
             }
+        } else {
+            lock_guard<mutex> lock(mtx);
+            stopped.push_back(res.m_taskID);
         }
     });
 
@@ -920,19 +2285,22 @@ bool Controller::activateDDSTopology(const CommonParams& common, Session& sessio
 
             requestPtr->unsubscribeAll();
 
-            auto agentInfo = getAgentInfo(common, session);
-            OLOG(info, common) << agentInfo.size() << " DDS agents active:";
-            for (const auto& ai : agentInfo) {
+            // as last seen, not queried again while the commander may be busy with the activation
+            const auto agents = session.mAgentTracker.agents();
+            OLOG(info, common) << agents.size() << " DDS agents active:";
+            for (const auto& ai : agents) {
                 OLOG(info, common)
-                    << "  Agent ID: " << ai.m_agentID
-                    << "; host: " << ai.m_host
-                    << "; path: " << ai.m_DDSPath
-                    << "; group: " << ai.m_groupName
-                    << "; slots: " << ai.m_nSlots
-                    << " (idle: " << ai.m_nIdleSlots
-                    << ", executing: " << ai.m_nExecutingSlots << ").";
+                    << "  Agent ID: " << ai.mID
+                    << "; host: " << ai.mHost
+                    << "; path: " << ai.mPath
+                    << "; group: " << ai.mGroup
+                    << "; slots: " << ai.mNumSlots
+                    << " (idle: " << ai.mNumIdleSlots
+                    << ", executing: " << ai.mNumExecutingSlots << ").";
             }
         } else {
+            // stopped tasks do not appear in the details and indices anymore
+            session.removeTasks(stopped);
             // try {
             //     if (!session.mCollections.empty()) {
             //         OLOG(info, common) << "Collections:";
@@ -963,7 +2331,8 @@ void Controller::extractRequirements(const CommonParams& common, Session& sessio
 {
     using namespace dds::topology_api;
 
-    CTopology ddsTopo(session.mTopoFilePath);
+    // parsed once per request, the same object becomes the session topology in createDDSTopology()
+    CTopology& ddsTopo = session.parseTopology();
 
     session.mNinfo.clear();
     session.mZoneInfo.clear();
@@ -1187,7 +2556,7 @@ bool Controller::createDDSTopology(const CommonParams& common, Session& session,
 {
     using namespace dds::topology_api;
     try {
-        session.mDDSTopo = make_unique<CTopology>(session.mTopoFilePath);
+        session.mDDSTopo = session.takeParsedTopology();
         OLOG(info, common) << "DDS CTopology for " << quoted(session.mTopoFilePath) << " created successfully";
     } catch (exception& e) {
         fillAndLogError(common, error, ErrorCode::DDSCreateTopologyFailed, toString("Failed to initialize DDS topology: ", e.what()));
@@ -1200,6 +2569,10 @@ bool Controller::createTopology(const CommonParams& common, Partition& partition
 {
     try {
         partition.mTopology = make_unique<Topology>(*(partition.mSession->mDDSTopo), *(partition.mSession), false);
+        setTopologyHandlers(partition);
+        partition.mRestartLimiter = RestartLimiter(mTaskRestart);
+        partition.mPendingRestarts.clear();
+        dropDataFlows(partition, "");
     } catch (exception& e) {
         partition.mTopology = nullptr;
         fillAndLogError(common, error, ErrorCode::FairMQCreateTopologyFailed, toString("Failed to initialize FairMQ topology: ", e.what()));
@@ -1207,39 +2580,242 @@ bool Controller::createTopology(const CommonParams& common, Partition& partition
     return partition.mTopology != nullptr;
 }
 
+void Controller::setTopologyHandlers(Partition& partition)
+{
+    // the handlers schedule the recovery by partition ID, a takeover renames the partition and sets them again
+    // an unexpected exit may be the first sign of a lost agent, recovery checks the agents
+    partition.mTopology->SetTaskExitHandler([this, partitionID = partition.mID](DDSTaskId) { mRecoveryWorker.schedule(partitionID); });
+    if (mCollectionRecovery) {
+        partition.mTopology->SetCollectionIgnoredHandler([this, partitionID = partition.mID](DDSCollectionId) { mRecoveryWorker.schedule(partitionID); });
+    }
+    if (mTaskRestart.mMaxRestarts > 0) {
+        partition.mTopology->SetTaskRestartHandler([this, partitionID = partition.mID](DDSTaskId) { mRecoveryWorker.schedule(partitionID); });
+    }
+}
+
 bool Controller::resetTopology(Partition& partition)
 {
     partition.mTopology.reset();
+    dropDataFlows(partition, "");
     return true;
 }
 
-bool Controller::changeState(const CommonParams& common, Partition& partition, Error& error, const string& path, TopoTransition transition, TopologyState& topologyState)
+bool Controller::changeState(const CommonParams& common, Partition& partition, Error& error, const string& path, TopoTransition transition, TopologyState& topologyState, const RolloutPolicy& rollout)
+{
+    return changeStateSequence(common, partition, error, path, vector<TopoTransition>{ transition }, topologyState, rollout);
+}
+
+bool Controller::changeStateSequence(const CommonParams& common, Partition& partition, Error& error, const string& path, const vector<TopoTransition>& transitions, TopologyState& topologyState, const RolloutPolicy& rollout)
+{
+    if (partition.mTopology == nullptr) {
+        fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, "FairMQ topology is not initialized");
+        return false;
+    }
+    if (transitions.empty()) {
+        fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, "No FairMQ transition given");
+        return false;
+    }
+
+    // e.g. "InitDevice+CompleteInit+Bind"
+    string transition;
+    for (const auto& t : transitions) {
+        transition += (transition.empty() ? "" : "+") + toString(t);
+    }
+
+    OLOG(info, common) << "Requesting transition " << transition << " for path " << quoted(path);
+
+    for (const auto& t : transitions) {
+        if (gExpectedState.find(t) == gExpectedState.end()) {
+            fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, toString("Unexpected FairMQ transition ", t));
+            return false;
+        }
+    }
+    const DeviceState expState{ gExpectedState.at(transitions.back()) };
+
+    // rollout limits apply to transitions sent one at a time
+    const RolloutPolicy policy = transitions.size() == 1 ? rolloutPolicy(transitions.front(), rollout) : rollout;
+    if (transitions.size() == 1 && policy.IsLimited()) {
+        OLOG(info, common) << "Rolling out transition " << transition << " with " << policy;
+    }
+
+    const string variant = transitions.size() > 1 ? (mMacroTransitions ? "macro" : "pipelined")
+                                                  : (policy.IsLimited() ? toString("rollout ", policy) : "");
+    return changeStateWith(common, partition, error, path, transition, variant, expState, topologyState, [&](chrono::seconds timeout) {
+        // single transitions keep using the plain ChangeState command, understood by devices with older plugins
+        return transitions.size() == 1 ? partition.mTopology->ChangeState(transitions.front(), path, timeout, policy)
+             : mMacroTransitions       ? partition.mTopology->ChangeStateSequence(transitions, path, timeout)
+                                       : partition.mTopology->ChangeStatePipelined(transitions, path, timeout);
+    });
+}
+
+bool Controller::changeStateOrdered(const CommonParams& common, Partition& partition, Error& error, const string& path, TopoTransition transition, TopologyState& topologyState, const RolloutPolicy& rollout)
 {
     if (partition.mTopology == nullptr) {
         fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, "FairMQ topology is not initialized");
         return false;
     }
+    if (gExpectedState.find(transition) == gExpectedState.end()) {
+        fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, toString("Unexpected FairMQ transition ", transition));
+        return false;
+    }
+
+    // the order is derived from the channel socket types known to the devices, without them the transition goes to all devices at once
+    optional<DataFlow> cached = dataFlow(common, partition, path);
+    if (!cached) {
+        OLOG(warning, common) << "Requesting transition " << transition << " without ordering";
+        return changeState(common, partition, error, path, transition, topologyState, rollout);
+    }
+    DataFlow flow(std::move(*cached));
+
+    // Stop from the sources, so that consumers drain the data in flight. Start from the sinks, so that producers find their consumers running
+    if (transition == TopoTransition::Run) {
+        reverse(flow.mLayers.begin(), flow.mLayers.end());
+    }
 
-    OLOG(info, common) << "Requesting transition " << toString(transition) << " for path " << quoted(path);
+    const RolloutPolicy policy = rolloutPolicy(transition, rollout);
+    OLOG(info, common) << "Requesting transition " << transition << " for path " << quoted(path) << " in " << flow.mLayers.size() << " layers of devices"
+                       << (policy.IsLimited() ? toString(" with ", policy) : "");
+
+    const string variant = policy.IsLimited() ? toString("ordered, rollout ", policy) : "ordered";
+    return changeStateWith(common, partition, error, path, toString(transition), variant, gExpectedState.at(transition), topologyState, [&](chrono::seconds timeout) {
+        return partition.mTopology->ChangeStateOrdered(transition, flow.mLayers, path, timeout, policy);
+    });
+}
+
+optional<DataFlow> Controller::dataFlow(const CommonParams& common, Partition& partition, const string& path)
+{
+    {
+        lock_guard<mutex> lock(partition.mDataFlowsMtx);
+        auto it = partition.mDataFlows.find(path);
+        if (it != partition.mDataFlows.end()) {
+            return it->second;
+        }
+    }
+    if (partition.mTopology == nullptr) {
+        return nullopt;
+    }
+
+    try {
+        auto [errorCode, result] = partition.mTopology->GetProperties(gChannelTypeQuery, path, requestTimeout(common, "GetProperties(channel types)"));
+        if (errorCode) {
+            OLOG(warning, common) << "Failed to get the channel types of the devices: " << errorCode.message();
+            return nullopt;
+        }
+        unordered_map<uint64_t, DataFlow::Props> props;
+        for (auto& [taskId, device] : result.devices) {
+            props.emplace(taskId, std::move(device.props));
+        }
+        DataFlow flow = DataFlow::FromChannelTypes(props);
+        if (flow.mNumCyclic > 0) {
+            OLOG(warning, common) << flow.mNumCyclic << " devices are on or behind a cycle of channels, they go through ordered transitions together in the last layer";
+        }
+        OLOG(info, common) << "Devices of path " << quoted(path) << " are in " << flow.mLayers.size() << " layers along the flow of data";
+        // the devices were asked without the lock, the layers of a concurrent request for the same path are as good
+        lock_guard<mutex> lock(partition.mDataFlowsMtx);
+        partition.mDataFlows.insert_or_assign(path, flow);
+        return flow;
+    } catch (exception& e) {
+        OLOG(warning, common) << "Failed to get the channel types of the devices: " << e.what();
+    }
+    return nullopt;
+}
+
+void Controller::dropDataFlows(Partition& partition, const string& path)
+{
+    // flows of other paths stay valid, unless they share devices with the path
+    unordered_set<DDSTaskId> tasks;
+    bool all = path.empty() || partition.mSession->mDDSTopo == nullptr;
+    if (!all) {
+        try {
+            auto it = partition.mSession->mDDSTopo->getRuntimeTaskIteratorMatchingPath(path);
+            for (; it.first != it.second; ++it.first) {
+                tasks.insert(it.first->first);
+            }
+        } catch (const exception&) {
+            all = true;
+        }
+    }
+
+    lock_guard<mutex> lock(partition.mDataFlowsMtx);
+    if (all) {
+        partition.mDataFlows.clear();
+        return;
+    }
+    for (auto it = partition.mDataFlows.begin(); it != partition.mDataFlows.end();) {
+        const auto& layers = it->second.mLayers;
+        const bool shared = any_of(layers.cbegin(), layers.cend(), [&](const auto& layer) {
+            return any_of(layer.cbegin(), layer.cend(), [&](DataFlow::TaskId id) { return tasks.count(id) > 0; });
+        });
+        it = shared ? partition.mDataFlows.erase(it) : next(it);
+    }
+}
+
+RolloutPolicy Controller::rolloutPolicy(TopoTransition transition, const RolloutPolicy& requested) const
+{
+    // limits of the request take precedence over the configured ones
+    if (!requested.IsLimited()) {
+        auto it = mRolloutPolicies.find(transition);
+        if (it != mRolloutPolicies.end()) {
+            return it->second;
+        }
+    }
+    return requested;
+}
 
-    auto it = gExpectedState.find(transition);
-    DeviceState expState{ it != gExpectedState.end() ? it->second : DeviceState::Undefined };
-    if (expState == DeviceState::Undefined) {
+bool Controller::changeStateScheduled(const CommonParams& common, Partition& partition, Error& error, const string& path, TopoTransition transition, TopologyState& topologyState, TransitionSkew& skew)
+{
+    if (partition.mTopology == nullptr) {
+        fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, "FairMQ topology is not initialized");
+        return false;
+    }
+    if (gExpectedState.find(transition) == gExpectedState.end()) {
         fillAndLogError(common, error, ErrorCode::FairMQChangeStateFailed, toString("Unexpected FairMQ transition ", transition));
         return false;
     }
 
+    // devices arm a local timer for the start time, a margin in the future leaves time to distribute the command to all of them
+    const auto startTime = chrono::system_clock::now() + mScheduledStartMargin;
+    OLOG(info, common) << "Requesting transition " << transition << " for path " << quoted(path) << " in " << mScheduledStartMargin.count() << " ms";
+
+    // no device completes the transition before the start time, the margin comes on top of the timeout
+    const auto margin = chrono::ceil<chrono::seconds>(mScheduledStartMargin);
+    const bool success = changeStateWith(common, partition, error, path, toString(transition), "scheduled", gExpectedState.at(transition), topologyState, [&](chrono::seconds timeout) {
+        return partition.mTopology->ChangeStateAt(transition, startTime, path, timeout + margin, skew);
+    });
+    OLOG(info, common) << "Scheduled " << transition << " transition: " << skew;
+    return success;
+}
+
+bool Controller::changeStateWith(const CommonParams& common, Partition& partition, Error& error, const string& path, const string& transition, const string& variant, DeviceState expState, TopologyState& topologyState, const function<pair<error_code, TopoState>(chrono::seconds)>& changeStateFunc)
+{
     bool success = true;
 
     try {
-        auto [errorCode, topoState] = partition.mTopology->ChangeState(transition, path, requestTimeout(common, toString("ChangeState(", transition, ")")));
+        auto timeout = requestTimeout(common, toString("ChangeState(", transition, ")"));
+
+        // completion times of previous transitions of the topology give a tighter deadline than the request timeout.
+        // Ordered, scheduled and rolled out transitions take longer than the plain ones, their samples are kept apart
+        const string topology = partition.mSession->topologyKey();
+        const string statsKey = variant.empty() ? transition : toString(transition, " (", variant, ")");
+        const size_t numDevices = partition.mTopology->GetNumTasks(path);
+        const auto deadline = mTransitionStats.deadline(topology, statsKey, numDevices);
+        const bool adaptive = deadline.has_value() && *deadline < timeout;
+        if (adaptive) {
+            timeout = chrono::ceil<chrono::seconds>(*deadline);
+            OLOG(debug, common) << "ChangeState(" << transition << "): adaptive deadline for " << numDevices << " devices: " << deadline->count() << " ms";
+        }
+
+        Timer timer;
+        auto [errorCode, topoState] = changeStateFunc(timeout);
 
         success = !errorCode;
-        if (!success) {
+        if (success) {
+            mTransitionStats.add(topology, statsKey, timer.duration(), numDevices);
+        } else {
             stateSummaryOnFailure(common, *(partition.mSession), partition.mTopology->GetCurrentState(), expState);
             switch (static_cast<ErrorCode>(errorCode.value())) {
                 case ErrorCode::OperationTimeout:
-                    fillAndLogFatalError(common, error, ErrorCode::RequestTimeout, toString("Timed out waiting for ", transition, " transition"));
+                    fillAndLogFatalError(common, error, ErrorCode::RequestTimeout, toString("Timed out waiting for ", transition, " transition", (adaptive ? toString(" (adaptive deadline of ", timeout.count(), " s)") : "")));
                     break;
                 default:
                     fillAndLogFatalError(common, error, ErrorCode::FairMQChangeStateFailed, toString("Change state failed: ", errorCode.message()));
@@ -1312,19 +2888,39 @@ bool Controller::waitForState(const CommonParams& common, Partition& partition,
     return success;
 }
 
-bool Controller::changeStateConfigure(const CommonParams& common, Partition& partition, Error& error, const string& path, TopologyState& topologyState)
+bool Controller::changeStateConfigure(const CommonParams& common, Partition& partition, Error& error, const string& path, TopologyState& topologyState, const RolloutPolicy& rollout)
 {
-    return changeState(common, partition, error, path, TopoTransition::InitDevice,   topologyState)
-        && changeState(common, partition, error, path, TopoTransition::CompleteInit, topologyState)
-        && changeState(common, partition, error, path, TopoTransition::Bind,         topologyState)
-        && changeState(common, partition, error, path, TopoTransition::Connect,      topologyState)
-        && changeState(common, partition, error, path, TopoTransition::InitTask,     topologyState);
+    Timer timer;
+    bool success = false;
+    const char* mode = mMacroTransitions ? "macro" : (mPipelinedTransitions ? "pipelined" : "lockstep");
+    if (mMacroTransitions || mPipelinedTransitions) {
+        // devices need the addresses of all bound channels before they can connect: wait for all of them to be bound in between
+        success = changeStateSequence(common, partition, error, path, { TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind }, topologyState)
+               && changeStateSequence(common, partition, error, path, { TopoTransition::Connect, TopoTransition::InitTask }, topologyState);
+    } else {
+        success = changeState(common, partition, error, path, TopoTransition::InitDevice,   topologyState, rollout)
+               && changeState(common, partition, error, path, TopoTransition::CompleteInit, topologyState, rollout)
+               && changeState(common, partition, error, path, TopoTransition::Bind,         topologyState, rollout)
+               && changeState(common, partition, error, path, TopoTransition::Connect,      topologyState, rollout)
+               && changeState(common, partition, error, path, TopoTransition::InitTask,     topologyState, rollout);
+    }
+    OLOG(info, common) << "Configure " << (success ? "done" : "failed") << " in " << timer.duration().count() << " ms (" << mode << " transitions)";
+    // channels are known now, Start and Stop use the layers without asking the devices again
+    dropDataFlows(partition, path);
+    if (success) {
+        dataFlow(common, partition, path);
+    }
+    return success;
 }
 
-bool Controller::changeStateReset(const CommonParams& common, Partition& partition, Error& error, const string& path, TopologyState& topologyState)
+bool Controller::changeStateReset(const CommonParams& common, Partition& partition, Error& error, const string& path, TopologyState& topologyState, const RolloutPolicy& rollout)
 {
-    return changeState(common, partition, error, path, TopoTransition::ResetTask,   topologyState)
-        && changeState(common, partition, error, path, TopoTransition::ResetDevice, topologyState);
+    dropDataFlows(partition, path);
+    if (mMacroTransitions || mPipelinedTransitions) {
+        return changeStateSequence(common, partition, error, path, { TopoTransition::ResetTask, TopoTransition::ResetDevice }, topologyState);
+    }
+    return changeState(common, partition, error, path, TopoTransition::ResetTask,   topologyState, rollout)
+        && changeState(common, partition, error, path, TopoTransition::ResetDevice, topologyState, rollout);
 }
 
 void Controller::getState(const CommonParams& common, Partition& partition, Error& error, const string& path, TopologyState& topologyState)
@@ -1486,7 +3082,7 @@ Partition& Controller::acquirePartition(const CommonParams& common)
         lock_guard<mutex> lock(mPartitionMtx);
         auto it = mPartitions.find(common.mPartitionID);
         if (it == mPartitions.end()) {
-            auto [partitionIt, inserted] = mPartitions.try_emplace(common.mPartitionID, Partition(common.mPartitionID));
+            auto [partitionIt, inserted] = mPartitions.try_emplace(common.mPartitionID, common.mPartitionID);
             try {
                 partitionIt->second.mSession = make_unique<Session>();
                 partitionIt->second.mSession->mPartitionID = common.mPartitionID;
@@ -1616,7 +3212,7 @@ void Controller::stateSummaryOnFailure(const CommonParams& common, Session& sess
 //     }
 // }
 
-dds::tools_api::SAgentInfoRequest::responseVector_t Controller::getAgentInfo(const CommonParams& common, Session& session) const
+dds::tools_api::SAgentInfoRequest::responseVector_t Controller::getAgentInfo(const CommonParams& common, Session& session, bool* complete) const
 {
     using namespace dds::tools_api;
     SAgentInfoRequest::responseVector_t agentInfo;
@@ -1660,6 +3256,9 @@ dds::tools_api::SAgentInfoRequest::responseVector_t Controller::getAgentInfo(con
         } else {
             // OLOG(info, common) << "Agent submission done successfully";
         }
+        if (complete != nullptr) {
+            *complete = done;
+        }
     } catch (Error& e) {
         OLOG(error, common) << "Agent submission error: " << e;
     }
@@ -1668,6 +3267,32 @@ dds::tools_api::SAgentInfoRequest::responseVector_t Controller::getAgentInfo(con
     return agentInfo;
 }
 
+AgentTracker::Query Controller::agentQuery(const CommonParams& common, Session& session) const
+{
+    return [this, &common, &session]() -> optional<AgentTracker::Agents> {
+        bool complete = false;
+        const auto agentInfo = getAgentInfo(common, session, &complete);
+        if (!complete) {
+            return nullopt;
+        }
+        AgentTracker::Agents agents;
+        agents.reserve(agentInfo.size());
+        for (const auto& ai : agentInfo) {
+            AgentTracker::Agent agent;
+            agent.mID = ai.m_agentID;
+            agent.mGroup = ai.m_groupName;
+            agent.mHost = ai.m_host;
+            agent.mPath = ai.m_DDSPath;
+            agent.mNumSlots = ai.m_nSlots;
+            agent.mNumIdleSlots = ai.m_nIdleSlots;
+            agent.mNumExecutingSlots = ai.m_nExecutingSlots;
+            agent.mStartUpTime = ai.m_startUpTime;
+            agents.push_back(move(agent));
+        }
+        return agents;
+    };
+}
+
 uint32_t Controller::getNumSlots(const CommonParams& common, Session& session) const
 {
     using namespace dds::tools_api;
@@ -1676,6 +3301,61 @@ uint32_t Controller::getNumSlots(const CommonParams& common, Session& session) c
     return agentCountInfo.m_activeSlotsCount;
 }
 
+void Controller::setTopologyCache(const string& dir, size_t maxSizeMB)
+{
+    try {
+        mTopoCache.configure(dir, static_cast<uintmax_t>(maxSizeMB) * 1024 * 1024);
+    } catch (const exception& e) {
+        OLOG(error) << "Failed to set up the topology cache in " << quoted(dir) << ", continuing without it: " << e.what();
+        mTopoCache.configure(dir, 0);
+    }
+}
+
+void Controller::prepareTopology(const CommonParams& common, Session& session, const string& topologyFile, const string& topologyContent, const string& topologyScript, const string& topologyHash)
+{
+    session.mTopoHash.clear();
+    session.mTopoCacheEntry.reset();
+
+    if (!mTopoCache.enabled()) {
+        if (!topologyHash.empty()) {
+            throw runtime_error("Topology hash given, but the topology cache is disabled");
+        }
+        session.mTopoCachePin.reset();
+        session.mTopoFilePath = topoFilepath(common, topologyFile, topologyContent, topologyScript);
+        extractRequirements(common, session);
+        return;
+    }
+
+    // the entry stays pinned for as long as the session runs from it
+    optional<TopologyCache::Pin> pin;
+    if (!topologyHash.empty()) {
+        if (!topologyFile.empty() || !topologyContent.empty() || !topologyScript.empty()) {
+            throw runtime_error("Either topology filepath, content, script or hash has to be set");
+        }
+        pin.emplace(mTopoCache.pin(topologyHash));
+    } else if (!topologyFile.empty() && topologyContent.empty() && topologyScript.empty()) {
+        ifstream file(topologyFile);
+        if (!file.is_open()) {
+            throw runtime_error(toString("Failed to open topology file ", quoted(topologyFile)));
+        }
+        pin.emplace(mTopoCache.put(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>())));
+    } else {
+        pin.emplace(mTopoCache.put(topoContent(common, topologyFile, topologyContent, topologyScript)));
+    }
+    const string hash = pin->hash();
+    session.mTopoCachePin = make_shared<TopologyCachePin>(std::move(*pin));
+
+    session.mTopoFilePath = mTopoCache.filePath(hash);
+    session.mTopoHash = hash;
+    if (mTopoCache.restore(hash, session)) {
+        OLOG(info, common) << "Topology cache hit for " << hash << ", reusing parsed topology and requirements of " << quoted(session.mTopoFilePath);
+    } else {
+        OLOG(info, common) << "Topology cache miss for " << hash << ", topology file: " << quoted(session.mTopoFilePath);
+        extractRequirements(common, session);
+        mTopoCache.store(hash, session);
+    }
+}
+
 string Controller::topoFilepath(const CommonParams& common, const string& topologyFile, const string& topologyContent, const string& topologyScript)
 {
     int count{ (topologyFile.empty() ? 0 : 1) + (topologyContent.empty() ? 0 : 1) + (topologyScript.empty() ? 0 : 1) };
@@ -1685,44 +3365,84 @@ string Controller::topoFilepath(const CommonParams& common, const string& topolo
     if (!topologyFile.empty()) {
         return topologyFile;
     }
-
-    string content{ topologyContent };
-
-    // Execute topology script if needed
     if (!topologyScript.empty()) {
-        string out;
-        string err;
-        int exitCode = EXIT_SUCCESS;
-        OLOG(info, common) << "Executing topology generation script: " << topologyScript;
-        std::vector<std::pair<std::string, std::string>> extraEnv;
-        extraEnv.emplace_back(std::make_pair("ODC_TOPO_GEN_CMD", topologyScript));
-        execute(topologyScript, requestTimeout(common, "topoFilepath..execute"), &out, &err, &exitCode, extraEnv);
+        return execTopoScript(common, topologyScript);
+    }
+    return writeTempTopoFile(common, topologyContent);
+}
 
-        const size_t shortSize = 75;
-        string shortSuffix;
-        string shortOut = out.substr(0, shortSize);
-        if (out.length() > shortSize) {
-            shortSuffix = " [...]";
+string Controller::topoContent(const CommonParams& common, const string& topologyFile, const string& topologyContent, const string& topologyScript)
+{
+    int count{ (topologyFile.empty() ? 0 : 1) + (topologyContent.empty() ? 0 : 1) + (topologyScript.empty() ? 0 : 1) };
+    if (count != 1) {
+        throw runtime_error("Either topology filepath, content or script has to be set");
+    }
+    if (!topologyFile.empty()) {
+        throw runtime_error("Topology content requested for a topology file");
+    }
+    if (!topologyScript.empty()) {
+        const string filepath{ execTopoScript(common, topologyScript) };
+        ifstream file(filepath);
+        if (!file.is_open()) {
+            throw runtime_error(toString("Failed to open topology file ", quoted(filepath)));
         }
+        return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    return topologyContent;
+}
 
-        if (exitCode != EXIT_SUCCESS) {
-            OLOG(fatal, common) << "Topology generation script failed with exit code: " << exitCode;
-            logFatalLineByLine(common, toString(", stderr:\n", quoted(err), ",\nstdout:\n", quoted(shortOut), shortSuffix));
-            throw runtime_error(toString("Topology generation script failed with exit code: ", exitCode, ", stderr: ", quoted(err)));
+string Controller::execTopoScript(const CommonParams& common, const string& topologyScript)
+{
+    // key is computed before the execution, inputs modified by the script itself must not validate its output
+    const string key{ mTopoScriptCache.enabled() ? mTopoScriptCache.key(topologyScript) : "" };
+    if (!key.empty()) {
+        string filepath;
+        if (mTopoScriptCache.get(key, filepath)) {
+            OLOG(info, common) << "Topology script cache hit, reusing output " << quoted(filepath) << " (" << mTopoScriptCache.stats() << ")";
+            return filepath;
         }
+    }
 
-        if (out.empty()) {
-            OLOG(fatal, common) << "Topology generation script produced no output. Check the script for errors:";
-            logFatalLineByLine(common, topologyScript);
-            throw runtime_error("Topology generation script produced no output. Check the script for errors.");
-        }
+    string out;
+    string err;
+    int exitCode = EXIT_SUCCESS;
+    OLOG(info, common) << "Executing topology generation script: " << topologyScript;
+    std::vector<std::pair<std::string, std::string>> extraEnv;
+    extraEnv.emplace_back(std::make_pair("ODC_TOPO_GEN_CMD", topologyScript));
+    Timer timer;
+    execute(topologyScript, requestTimeout(common, "topoFilepath..execute"), &out, &err, &exitCode, extraEnv);
+    const auto duration{ timer.duration() };
+
+    const size_t shortSize = 75;
+    string shortSuffix;
+    string shortOut = out.substr(0, shortSize);
+    if (out.length() > shortSize) {
+        shortSuffix = " [...]";
+    }
+
+    if (exitCode != EXIT_SUCCESS) {
+        OLOG(fatal, common) << "Topology generation script failed with exit code: " << exitCode;
+        logFatalLineByLine(common, toString(", stderr:\n", quoted(err), ",\nstdout:\n", quoted(shortOut), shortSuffix));
+        throw runtime_error(toString("Topology generation script failed with exit code: ", exitCode, ", stderr: ", quoted(err)));
+    }
 
-        OLOG(info, common) << "Topology generation script successfull. stderr: " << quoted(err) << ", stdout: " << quoted(shortOut) << shortSuffix;
+    if (out.empty()) {
+        OLOG(fatal, common) << "Topology generation script produced no output. Check the script for errors:";
+        logFatalLineByLine(common, topologyScript);
+        throw runtime_error("Topology generation script produced no output. Check the script for errors.");
+    }
+
+    OLOG(info, common) << "Topology generation script successfull in " << duration.count() << "ms. stderr: " << quoted(err) << ", stdout: " << quoted(shortOut) << shortSuffix;
 
-        content = out;
+    const string filepath{ writeTempTopoFile(common, out) };
+    if (!key.empty()) {
+        mTopoScriptCache.put(key, filepath, duration);
     }
+    return filepath;
+}
 
-    // Create temp topology file with `content`
+string Controller::writeTempTopoFile(const CommonParams& common, const string& content)
+{
     const bfs::path tmpPath{ bfs::temp_directory_path() / bfs::unique_path() };
     bfs::create_directories(tmpPath);
     const bfs::path filepath{ tmpPath / "topology.xml" };
@@ -1742,30 +3462,123 @@ void Controller::registerResourcePlugins(const DDSSubmit::PluginMap& pluginMap)
     }
 }
 
-void Controller::restore(const string& id, const string& dir)
+void Controller::restore(const string& id, const string& dir, const function<void(const vector<string>&)>& onRestoring, const function<void(const string&)>& onRestored)
 {
-    mRestoreId = id;
-    mRestoreDir = dir;
-
     OLOG(info) << "Restoring sessions for " << quoted(id);
+    Timer timer;
 
-    RestoreData data;
+    // partitions stay in the restore file while they are restored, so that a crash while restoring does not lose the pending ones
+    RestoreData data = RestoreFile(id, dir).read();
+
+    // spare sessions survive restarts, unused ones are shut down if the pool has shrunk or is disabled
+    mSessionPool.keepOnExit(true);
+    if (!data.mSpareSessions.empty()) {
+        OLOG(info) << "Found " << data.mSpareSessions.size() << " spare DDS sessions to restore";
+        mSessionPool.adopt(data.mSpareSessions);
+    }
+
+    OLOG(info) << "Found " << data.mPartitions.size() << " partitions to restore";
+
+    if (onRestoring) {
+        vector<string> partitionIDs;
+        for (const auto& v : data.mPartitions) {
+            partitionIDs.push_back(v.mPartitionID);
+        }
+        onRestoring(partitionIDs);
+    }
+
+    // requests for restored partitions may come in while others are still restoring, their changes have to be recorded already
     {
         lock_guard<mutex> lock(mPartitionMtx);
-        data = RestoreFile(id, dir).read();
+        mRestoreId = id;
+        mRestoreDir = dir;
+        for (const auto& v : data.mPartitions) {
+            mRestorePending.emplace(v.mPartitionID, v);
+        }
     }
 
-    OLOG(info) << "Found " << data.mPartitions.size() << " partitions to restore";
+    // each worker attaches to one session after the other, a partition is usable as soon as its own attach completed
+    atomic<size_t> next{ 0 };
+    atomic<size_t> numRestored{ 0 };
+    auto worker = [&]() {
+        for (size_t i = next++; i < data.mPartitions.size(); i = next++) {
+            const auto& v = data.mPartitions.at(i);
+            Timer partitionTimer;
+            try {
+                OLOG(info, v.mPartitionID, 0) << "Restoring (" << quoted(v.mPartitionID) << "/" << quoted(v.mDDSSessionId) << ")";
+                CommonParams common(v.mPartitionID, 0, 0);
+                common.mInternal = true;
+                auto snapshot = SnapshotFile(id, v.mPartitionID, dir).read();
+                auto result{ execInitialize(common, InitializeParams(v.mDDSSessionId)) };
+                if (!result.mError.mCode && snapshot) {
+                    try {
+                        applySnapshot(common, acquirePartition(common), *snapshot);
+                    } catch (exception& e) {
+                        OLOG(warning, common) << "Failed to apply snapshot: " << e.what();
+                    }
+                }
+                if (result.mError.mCode) {
+                    // not written again by the snapshot thread, which only knows the partitions that are back
+                    SnapshotFile(id, v.mPartitionID, dir).remove();
+                    OLOG(info, v.mPartitionID, 0) << "Failed to attach to the session for partition " << quoted(v.mPartitionID) << ", session " << quoted(v.mDDSSessionId) << " in " << partitionTimer.duration().count() << " ms";
+                } else {
+                    ++numRestored;
+                    OLOG(info, v.mPartitionID, 0) << "Successfully attached to the session (" << quoted(v.mPartitionID) << "/" << quoted(v.mDDSSessionId) << ") in " << partitionTimer.duration().count() << " ms";
+                }
+            } catch (const exception& e) {
+                SnapshotFile(id, v.mPartitionID, dir).remove();
+                OLOG(error, v.mPartitionID, 0) << "Restoring the partition failed in " << partitionTimer.duration().count() << " ms: " << e.what();
+            }
+            {
+                lock_guard<mutex> lock(mPartitionMtx);
+                mRestorePending.erase(v.mPartitionID);
+            }
+            if (onRestored) {
+                onRestored(v.mPartitionID);
+            }
+        }
+    };
+
+    const size_t numWorkers = min(max<size_t>(1, mRestoreParallelism), data.mPartitions.size());
+    vector<thread> workers;
+    for (size_t i = 1; i < numWorkers; ++i) {
+        workers.emplace_back(worker);
+    }
+    if (numWorkers > 0) {
+        worker();
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    OLOG(info) << "Restored " << numRestored << " of " << data.mPartitions.size() << " partitions in " << timer.duration().count() << " ms using " << numWorkers << " workers";
 
     for (const auto& v : data.mPartitions) {
-        OLOG(info, v.mPartitionID, 0) << "Restoring (" << quoted(v.mPartitionID) << "/" << quoted(v.mDDSSessionId) << ")";
-        auto result{ execInitialize(CommonParams(v.mPartitionID, 0, 0), InitializeParams(v.mDDSSessionId)) };
-        if (result.mError.mCode) {
-            OLOG(info, v.mPartitionID, 0) << "Failed to attach to the session for partition " << quoted(v.mPartitionID) << ", session " << quoted(v.mDDSSessionId);
-        } else {
-            OLOG(info, v.mPartitionID, 0) << "Successfully attached to the session (" << quoted(v.mPartitionID) << "/" << quoted(v.mDDSSessionId) << ")";
+        if (!v.mStandbyFor.empty()) {
+            adoptStandby(v.mStandbyFor, v.mPartitionID);
         }
     }
+
+    updateRestore();
+
+    if (mSnapshotInterval.count() > 0 && !mSnapshotThread.joinable()) {
+        mSnapshotThread = thread([this]() {
+            unique_lock<mutex> lock(mSnapshotMtx);
+            while (!mSnapshotCV.wait_for(lock, mSnapshotInterval, [this]() { return mSnapshotStop; })) {
+                lock.unlock();
+                writeSnapshots();
+                lock.lock();
+            }
+        });
+    }
+}
+
+void Controller::setPersistence(const std::string& fsync, std::chrono::seconds compactionInterval)
+{
+    Persistence::Config config;
+    config.mFsync = Persistence::ParseFsyncPolicy(fsync);
+    config.mCompactionInterval = compactionInterval;
+    mPersistence.configure(config);
 }
 
 void Controller::setZoneCfgs(const std::vector<std::string>& zonesStr)
@@ -1780,6 +3593,64 @@ void Controller::setZoneCfgs(const std::vector<std::string>& zonesStr)
     }
 }
 
+void Controller::setRolloutPolicies(const std::vector<std::string>& policiesStr)
+{
+    // transition names are matched ignoring case, spaces and underscores: "InitTask", "INIT_TASK" and "init task" are the same
+    auto normalize = [](const std::string& name) {
+        std::string result;
+        for (char c : name) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                result += std::tolower(static_cast<unsigned char>(c));
+            }
+        }
+        return result;
+    };
+    for (const auto& p : policiesStr) {
+        std::vector<std::string> policyCfg;
+        boost::algorithm::split(policyCfg, p, boost::algorithm::is_any_of(":"));
+        if (policyCfg.size() != 2 && policyCfg.size() != 3) {
+            throw std::runtime_error(odc::core::toString("Provided rollout policy has incorrect format. Expected <transition>:<maxDevices>[:<maxPerHost>]. Received: ", p));
+        }
+        auto transition = std::find_if(gExpectedState.begin(), gExpectedState.end(), [&](const auto& t) { return normalize(toString(t.first)) == normalize(policyCfg.at(0)); });
+        if (transition == gExpectedState.end()) {
+            throw std::runtime_error(odc::core::toString("Provided rollout policy has an unknown transition. Received: ", p));
+        }
+        RolloutPolicy policy;
+        policy.mMaxDevices = std::stoul(policyCfg.at(1));
+        policy.mMaxPerHost = (policyCfg.size() == 3) ? std::stoul(policyCfg.at(2)) : 0;
+        mRolloutPolicies[transition->first] = policy;
+    }
+}
+
+void Controller::setAgentPools(const std::vector<std::string>& poolsStr)
+{
+    std::vector<DDSSubmitParams> specs;
+    for (const auto& p : poolsStr) {
+        std::vector<std::string> poolCfg;
+        boost::algorithm::split(poolCfg, p, boost::algorithm::is_any_of(":"));
+        if (poolCfg.size() != 4 && poolCfg.size() != 5) {
+            throw std::runtime_error(odc::core::toString("Provided agent pool configuration has incorrect format. Expected <zone>:<agentGroup>:<numAgents>:<numSlots>[:<numCores>]. Received: ", p));
+        }
+        DDSSubmitParams spec;
+        spec.mRMS = mRMS;
+        spec.mZone = poolCfg.at(0);
+        spec.mAgentGroup = poolCfg.at(1);
+        spec.mNumAgents = std::stoul(poolCfg.at(2));
+        spec.mNumSlots = std::stoul(poolCfg.at(3));
+        spec.mNumCores = (poolCfg.size() == 5) ? std::stoul(poolCfg.at(4)) : 0;
+        auto zoneIt = mZoneCfgs.find(spec.mZone);
+        if (zoneIt != mZoneCfgs.end()) {
+            spec.mConfigFile = zoneIt->second.cfgPath;
+            spec.mEnvFile = zoneIt->second.envPath;
+        }
+        if (spec.mNumAgents == 0 || spec.mNumSlots == 0) {
+            throw std::runtime_error(odc::core::toString("Agent pool needs at least one agent with at least one slot. Received: ", p));
+        }
+        specs.push_back(spec);
+    }
+    mAgentPool.configure(specs);
+}
+
 void Controller::printStateStats(const CommonParams& common, const TopoState& topoState, const TopoStateByCollection& collectionMap, bool debugLog)
 {
     std::map<DeviceState, uint64_t> taskStateCounts;
@@ -9,20 +9,38 @@
 #ifndef ODC_CORE_CONTROLLER
 #define ODC_CORE_CONTROLLER
 
+#include <odc/AgentPool.h>
+#include <odc/DataFlow.h>
 #include <odc/DDSSubmit.h>
 #include <odc/Params.h>
+#include <odc/PartitionWorker.h>
+#include <odc/Persistence.h>
+#include <odc/RestartLimiter.h>
 #include <odc/Session.h>
+#include <odc/SessionPool.h>
+#include <odc/Snapshot.h>
 #include <odc/Topology.h>
+#include <odc/TopologyCache.h>
+#include <odc/TopologyScriptCache.h>
+#include <odc/TransitionStats.h>
 
 #include <dds/Tools.h>
 #include <dds/Topology.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <utility> // std::pair
+#include <vector>
 
 namespace odc::core
 {
@@ -33,15 +51,28 @@ struct Partition
         : mID(id)
     {}
 
+    /// Crashed expendable task waiting to be started again
+    struct PendingRestart
+    {
+        std::chrono::steady_clock::time_point mProbeAt;  ///< time of the next probe
+        std::chrono::steady_clock::time_point mDeadline; ///< time to give up at
+    };
+
     std::string mID;
+    std::string mStandbyFor; ///< ID of the active partition, if this is its standby partition
     std::unique_ptr<Session> mSession = nullptr;
     std::unique_ptr<Topology> mTopology = nullptr;
+    RestartLimiter mRestartLimiter;                        ///< Restarts of the crashed expendable tasks of the topology
+    std::map<DDSTaskId, PendingRestart> mPendingRestarts;  ///< Crashed expendable tasks probed until they report back
+    std::mutex mDataFlowsMtx;                               ///< Guards mDataFlows, requests on disjoint paths run concurrently
+    std::map<std::string, DataFlow> mDataFlows;             ///< Layers of devices by path, computed at Configure, dropped on Reset
 };
 
 class Controller
 {
   public:
     Controller() {}
+    ~Controller();
     // Disable copy constructors and assignment operators
     Controller(const Controller&) = delete;
     Controller(Controller&&) = delete;
@@ -56,20 +87,114 @@ class Controller
     /// \param [in] agentWaitTimeoutStr Agent wait timeout in seconds or percentage, if set to "" then default value is used
     void setAgentWaitTimeout(const std::string& agentWaitTimeoutStr) { mAgentWaitTimeout = agentWaitTimeoutStr; }
 
+    /// \brief Set maximum number of agent group submissions in flight
+    /// \param [in] parallelism maximum number of concurrent submissions, 1 submits the groups one after another
+    void setSubmitParallelism(size_t parallelism) { mSubmitParallelism = parallelism; }
+
+    /// \brief Set speculative over-submission for nMin protected agent groups
+    /// \param [in] percent surplus of agents in percent of the requested number, 0 disables
+    void setSubmitSurplus(uint32_t percent) { mSubmitSurplus = percent; }
+
+    /// \brief Set up pools of pre-warmed DDS agents
+    /// \param [in] poolsStr string representations of pools: "<zone>:<agentGroup>:<numAgents>:<numSlots>[:<numCores>]"
+    void setAgentPools(const std::vector<std::string>& poolsStr);
+
+    /// \brief Keep spare DDS sessions for new partitions
+    /// \param [in] size number of spare DDS sessions, 0 disables
+    void setSessionPool(size_t size) { mSessionPool.configure(size, [this]() { updateRestore(); }); }
+
+    /// \brief Let devices drive the Configure and Reset transitions on their own
+    /// \param [in] enable if true, Configure is sent as two transition sequences (up to Bound, then up to Ready) and Reset as one
+    void setMacroTransitions(bool enable) { mMacroTransitions = enable; }
+
+    /// \brief Advance each device to its next Configure and Reset transition as soon as it completed the previous one
+    /// \param [in] enable if true, devices only wait for each other once all of them are bound. Ignored with macro transitions
+    void setPipelinedTransitions(bool enable) { mPipelinedTransitions = enable; }
+
+    /// \brief Limit the devices going through a transition at the same time
+    /// \param [in] policiesStr string representations of policies: "<transition>:<maxDevices>[:<maxPerHost>]", 0 means no limit
+    void setRolloutPolicies(const std::vector<std::string>& policiesStr);
+
+    /// \brief Let devices start the Run transition together at a scheduled time instead of on arrival of the command
+    /// \param [in] margin time between the Start request and the scheduled start, 0 disables. Requires synchronized clocks on all hosts.
+    ///  The margin extends the timeout of the Start request, Start requests with rollout limits are rejected
+    void setScheduledStart(std::chrono::milliseconds margin) { mScheduledStartMargin = margin; }
+
+    /// \brief Start and Stop devices layer by layer along the flow of data, derived from the socket types of their channels
+    /// \param [in] enable if true, Start goes from the sinks to the sources and Stop from the sources to the sinks. Scheduled start takes precedence for Start
+    void setOrderedStartStop(bool enable) { mOrderedStartStop = enable; }
+
+    /// \brief Derive the deadline of each state transition from the completion times of previous ones of the same topology
+    /// \param [in] factor safety factor on the 99th percentile of the completion times, scaled by the number of devices. 0 disables
+    /// \param [in] minimum lower bound of the derived deadlines. The request timeout remains the upper bound
+    void setAdaptiveTimeouts(double factor, std::chrono::milliseconds minimum)
+    {
+        TransitionStats::Policy policy;
+        policy.mFactor = factor;
+        policy.mMinDeadline = minimum;
+        mTransitionStats.setPolicy(policy);
+    }
+
     /// \brief Register resource plugins
     /// \param [in] pluginMap Map of plugin name to path
     void registerResourcePlugins(const PluginManager::PluginMap& pluginMap);
 
     /// \brief Restore sessions for the specified ID
-    ///  The function has to be called before the service start accepting request.
+    ///  Partitions are restored concurrently by up to setRestoreParallelism() workers. Requests to a partition must not be
+    ///  executed before its restore completed, requests to partitions not being restored can be executed at any time.
     /// \param [in] id ID of the restore file
     /// \param [in] dir directory to store restore files in
-    void restore(const std::string& id, const std::string& dir);
+    /// \param [in] onRestoring called with the IDs of the partitions to restore, before any of them is restored
+    /// \param [in] onRestored called from a worker with the partition ID once its restore completed, successfully or not
+    void restore(const std::string& id,
+                 const std::string& dir,
+                 const std::function<void(const std::vector<std::string>&)>& onRestoring = {},
+                 const std::function<void(const std::string&)>& onRestored = {});
+
+    /// \brief Set maximum number of partitions restored concurrently
+    /// \param [in] parallelism maximum number of concurrent restores, 1 restores the partitions one after another
+    void setRestoreParallelism(size_t parallelism) { mRestoreParallelism = parallelism; }
+
+    /// \brief Set interval of the partition snapshots written next to the restore file
+    ///  Snapshots hold the device states and session details of each partition, restore() takes them over until the devices report again.
+    ///  They are written from the first restore() call on.
+    /// \param [in] interval time between snapshots, 0 disables them
+    void setSnapshotInterval(std::chrono::seconds interval) { mSnapshotInterval = interval; }
+
+    /// \brief Runs the recovery of a partition while no request is in progress on it
+    using RecoveryAdmission = std::function<void(const std::string& partitionID, const std::function<void()>& recover)>;
+
+    /// \brief Set how background recoveries are admitted
+    /// \param [in] admission runs the recovery of a partition, serializing it with the requests to the partition
+    void setRecoveryAdmission(RecoveryAdmission admission) { mRecoveryAdmission = std::move(admission); }
+
+    /// \brief Replace failed nMin protected collections of a partition by new ones, instead of continuing without them for the rest of the run
+    ///  Replacement agents are submitted with the configured RMS and zone configs, the groups of the failed collections grow by their number
+    ///  via a topology update, and the new collections are brought to the state of the partition. Healthy devices keep their state.
+    /// \param [in] enable if true, collections ignored under nMin are replaced in the background
+    void setCollectionRecovery(bool enable) { mCollectionRecovery = enable; }
+
+    /// \brief Take crashed expendable tasks back into their partition, instead of ignoring them for the rest of the run
+    ///  DDS does not start single tasks again, a crashed task has to be started again on its agent by its launcher, e.g. a restart loop around its executable.
+    ///  ODC asks the task to report back until it does or the timeout expires, then brings it to the state of the partition and counts the restart.
+    /// \param [in] config restarts of a task allowed within the window (0 disables), backoff before the first probe and time a task has to report back
+    void setTaskRestart(const RestartLimiter::Config& config) { mTaskRestart = config; }
+
+    /// \brief Recover a partition: replace its failed collections and take back its restarted tasks, if enabled.
+    ///  Called by the recovery worker through the recovery admission.
+    void recover(const std::string& partitionID);
 
     /// \brief Set directory where history file is stored
     /// \param [in] dir directory path
     void setHistoryDir(const std::string& dir) { mHistoryDir = dir; }
 
+    /// \brief Set how the restore and history files are written
+    ///  Changes of the restore data are appended to a journal, which is folded into the restore file every compaction interval.
+    /// \param [in] fsync when appended data is flushed to disk: "always", "periodic" (every second) or "never"
+    /// \param [in] compactionInterval time between foldings of the restore journal into the restore file
+    /// \throws std::runtime_error for an unknown fsync policy
+    void setPersistence(const std::string& fsync, std::chrono::seconds compactionInterval);
+
     /// \brief Set zone configs
     /// \param [in] zonesStr string representations of zone configs: "<name>:<cfgFilePath>:<envFilePath>"
     void setZoneCfgs(const std::vector<std::string>& zonesStr);
@@ -78,6 +203,16 @@ class Controller
     /// \param [in] rms name of the RMS
     void setRMS(const std::string& rms) { mRMS = rms; }
 
+    /// \brief Set up the content-addressed topology cache
+    /// \param [in] dir directory to store topology files in
+    /// \param [in] maxSizeMB size cap in MiB, 0 disables the cache
+    void setTopologyCache(const std::string& dir, size_t maxSizeMB);
+
+    /// \brief Enable memoization of topology generation scripts
+    /// \param [in] inputFiles files or directories the scripts depend on
+    /// \param [in] inputEnv names of environment variables the scripts depend on
+    void setTopologyScriptCache(const std::vector<std::string>& inputFiles, const std::vector<std::string>& inputEnv) { mTopoScriptCache.configure(true, inputFiles, inputEnv); }
+
     // DDS topology and session requests
 
     /// \brief Initialize DDS session
@@ -92,6 +227,8 @@ class Controller
     RequestResult execUpdate(const CommonParams& common, const UpdateParams& params);
     /// \brief Shutdown DDS session
     RequestResult execShutdown(const CommonParams& common);
+    /// \brief Replace a failed partition by its standby partition and start it
+    RequestResult execTakeover(const CommonParams& common);
 
     /// \brief Set properties
     RequestResult execSetProperties(const CommonParams& common, const SetPropertiesParams& params);
@@ -114,9 +251,28 @@ class Controller
     /// \brief Status request
     StatusRequestResult execStatus(const StatusParams& params);
 
+    /// \brief Resolve the tasks of a partition selected by a path
+    /// \param [in] partitionID partition ID
+    /// \param [in] path path of tasks or collections, empty selects all tasks
+    /// \return task IDs, empty if the partition has no topology
+    std::unordered_set<uint64_t> getTasks(const std::string& partitionID, const std::string& path);
+
     static void extractRequirements(const CommonParams& common, Session& session);
 
+    /// \brief Append surplus submissions for agent groups protected by nMin
+    /// \param [in] percent surplus of agents in percent of the agents of a group, rounded up. 0 appends nothing
+    static void addSurplusParams(const CommonParams& common, std::vector<DDSSubmitParams>& ddsParams, uint32_t percent);
+
   private:
+    /// Recovers partitions in the background. Declared first: topologies notify it until they are destroyed, ~Controller() stops it before the members it uses.
+    PartitionWorker mRecoveryWorker{ [this](const std::string& id) {
+        if (mRecoveryAdmission) {
+            mRecoveryAdmission(id, [&]() { recover(id); });
+        } else {
+            recover(id);
+        }
+    } };
+    TopologyCache mTopoCache;                     ///< Topology files, parsed topologies and requirements by content hash. Declared before the partitions, their sessions pin its entries
     std::map<std::string, Partition> mPartitions; ///< Map of partition ID to Partition object
     std::mutex mPartitionMtx;                     ///< Mutex for the partition map
     std::chrono::seconds mTimeout{ 30 };          ///< Request timeout in sec
@@ -124,34 +280,131 @@ class Controller
     DDSSubmit mSubmit;                            ///< ODC to DDS submit resource converter
     std::string mRestoreId;                       ///< Restore ID
     std::string mRestoreDir;                      ///< Restore file directory
+    std::map<std::string, RestorePartition> mRestorePending; ///< Partitions still being restored, kept in the restore file until they are back
     std::string mHistoryDir;                      ///< History file directory
     std::map<std::string, ZoneConfig> mZoneCfgs;  ///< stores zones configuration (cfgFilePath/envFilePath) by zone name
     std::string mRMS{ "localhost" };              ///< resource management system to be used by DDS
+    TopologyScriptCache mTopoScriptCache;         ///< Outputs of topology generation scripts
+    size_t mSubmitParallelism{ 1 };               ///< Maximum number of agent group submissions in flight, 1 submits them one after another
+    size_t mRestoreParallelism{ 8 };              ///< Maximum number of partitions restored concurrently
+    std::chrono::seconds mSnapshotInterval{ 10 }; ///< Interval of partition snapshots, 0 disables them
+    std::mutex mSnapshotMtx;                      ///< Mutex for the staged snapshots and the stop flag
+    std::condition_variable mSnapshotCV;          ///< Wakes up the snapshot thread when stopping
+    bool mSnapshotStop{ false };                  ///< Stops the snapshot thread
+    std::map<std::string, PartitionSnapshot> mStagedSnapshots; ///< Topology file and session details staged by the request threads, by partition ID
+    std::map<std::string, size_t> mSnapshotHashes; ///< Hash of the last written snapshot by partition ID, only used by the snapshot thread
+    std::thread mSnapshotThread;                  ///< Writes the partition snapshots every mSnapshotInterval
+    uint32_t mSubmitSurplus{ 0 };                 ///< Surplus of agents in percent requested for nMin protected agent groups, 0 disables
+    std::chrono::milliseconds mAgentGroupPollInterval{ 200 }; ///< Minimum interval of agent info queries while waiting for agent groups, backs off while agents do not change
+    bool mMacroTransitions{ false };              ///< Send Configure and Reset as device-side transition sequences
+    bool mPipelinedTransitions{ false };          ///< Send Configure and Reset transitions to each device as soon as it is ready for them
+    std::map<TopoTransition, RolloutPolicy> mRolloutPolicies; ///< Default limits on the devices in transition at the same time, by transition
+    std::chrono::milliseconds mScheduledStartMargin{ 0 }; ///< Time between a Start request and the scheduled start of the devices, 0 disables
+    bool mOrderedStartStop{ false };              ///< Start and Stop devices layer by layer along the flow of data
+    bool mCollectionRecovery{ false };            ///< Replace failed nMin protected collections by new ones
+    RecoveryAdmission mRecoveryAdmission;         ///< Serializes the recovery of a partition with its requests
+    RestartLimiter::Config mTaskRestart;          ///< Restarts of crashed expendable tasks, disabled by default
+    TransitionStats mTransitionStats;             ///< Completion times of state transitions, by topology and transition
+    AgentPool mAgentPool;                         ///< Pre-warmed DDS agents, adopted by fresh partitions
+    Persistence mPersistence;                     ///< Writes restore and history files in the background
+    SessionPool mSessionPool;                     ///< Spare DDS sessions. Its background thread uses the members above until it is stopped.
+
+    static constexpr char kStandbySuffix[] = "-standby"; ///< Suffix of the IDs of standby partitions, reserved for them
+    static constexpr size_t kStandbyAttempts = 3;         ///< Attempts to prepare a standby partition
+
+    /// Standby partition, prepared in the background to take over an active partition
+    struct Standby
+    {
+        std::string mPartitionID;       ///< ID of the standby partition
+        RunParams mRunParams;           ///< Run parameters of the active partition, default for standbys adopted on restore
+        std::string mState;             ///< PREPARING, READY, FAILED or SHUTTING_DOWN
+        bool mCancelled = false;        ///< The active partition is gone, the standby partition is shut down once its preparation is done
+        std::future<void> mPreparation; ///< Run and Configure of the standby partition, or its shutdown
+    };
+    std::mutex mStandbyMtx;                       ///< Mutex for the standby map
+    std::map<std::string, Standby> mStandbys;     ///< Standby partitions by ID of the active partition. Declared last: preparations use the members above until they are done.
 
     void updateRestore();
+    /// \brief Stage topology file and session details for the next snapshot. Called by the request thread operating on the partition.
+    void stageSnapshot(const Partition& partition);
+    /// \brief Write the snapshots of the partitions that changed since the last ones and remove those of partitions that are gone
+    void writeSnapshots();
+    /// \brief Take over the snapshot of a previous run for a partition that was just attached to its session
+    void applySnapshot(const CommonParams& common, Partition& partition, const PartitionSnapshot& snapshot);
     void updateHistory(const CommonParams& common, const std::string& sessionId);
 
     std::pair<std::unordered_set<std::string>, std::string> submit(const CommonParams& common, Session& session, Error& error, const std::string& plugin, const std::string& res, bool extractResources);
     void activate(const CommonParams& common, Partition& partition, Error& error);
+    /// \brief Activate and configure, starting InitDevice/CompleteInit/Bind per agent group as soon as its devices are Idle.
+    /// Connect/InitTask remain topology-wide: devices connect to the addresses of all bound channels, so the slowest agent group still gates them.
+    void activatePipelined(const CommonParams& common, Partition& partition, Error& error);
+    /// \brief Bring the devices of each agent group from Idle to Bound concurrently, one thread per agent group
+    bool initializeByAgentGroup(const CommonParams& common, Partition& partition, Error& error);
+
+    /// Task changes between two DDS topologies
+    struct TopologyDiff
+    {
+        size_t mNumKept = 0;      ///< Number of tasks present in both topologies
+        size_t mNumChanged = 0;   ///< Number of tasks present in both topologies, with a changed command, environment or requirements
+        size_t mNumRemoved = 0;   ///< Number of tasks only present in the previous topology
+        size_t mNumAdded = 0;     ///< Number of tasks only present in the updated topology
+        std::string mRemovedPath; ///< Path matching the removed tasks in the previous topology, empty if none
+        std::string mAddedPath;   ///< Path matching the added tasks in the updated topology, empty if none
+    };
+
+    /// \brief Update the topology of a partition, resetting all devices and recreating the FairMQ topology
+    bool updateWhole(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState);
+    /// \brief Update the topology of a partition, keeping the FairMQ topology. Only removed and added devices change state.
+    /// Falls back to updateWhole() if tasks present in both topologies changed. Failures before the switch-over restore the previous topology of the session.
+    bool updateInPlace(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState, Session::TopologySnapshot previous);
+    /// \brief Bring devices that were just added to the topology from Idle to the given state of the partition: Idle, Ready or Running
+    bool catchUpToState(const CommonParams& common, Partition& partition, Error& error, const std::string& path, AggregatedState state, TopologyState& topologyState);
+    /// \brief Replace the collections that failed and were ignored under nMin by new instances of their groups
+    bool replaceCollections(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState);
+    bool checkReplacementChannels(const CommonParams& common, Partition& partition, Error& error, const std::set<std::string>& collections);
+    /// \brief Probe crashed expendable tasks until they report back after a restart, and bring those that did to the state of the partition
+    bool restartTasks(const CommonParams& common, Partition& partition, Error& error, TopologyState& topologyState);
+    static TopologyDiff diffTopologies(dds::topology_api::CTopology& from, dds::topology_api::CTopology& to);
+    /// \brief Path expression matching exactly the given tasks
+    static std::string tasksPath(dds::topology_api::CTopology& topo, const std::unordered_set<DDSTaskId>& taskIds);
 
     bool createDDSSession(           const CommonParams& common, Session& session, Error& error);
     bool attachToDDSSession(         const CommonParams& common, Session& session, Error& error, const std::string& sessionID);
     bool shutdownDDSSession(         const CommonParams& common, Partition& partition, Error& error);
     std::string getActiveDDSTopology(const CommonParams& common, Session& session, Error& error);
 
-    uint32_t submitDDSAgents(      const CommonParams& common, Session& session, Error& error, const DDSSubmitParams& params);
-    bool waitForNumActiveSlots(const CommonParams& common, Session& session, Error& error, size_t numSlots);
+    /// \brief Submit all agent groups concurrently, with at most mSubmitParallelism submissions in flight
+    /// \return number of submitted agents per group, 0 for failed groups. error is set to the first failure.
+    /// Submissions from numRequired on are best-effort: their failures are logged, but not set in error.
+    std::vector<uint32_t> submitDDSAgents(const CommonParams& common, Session& session, Error& error, const std::vector<DDSSubmitParams>& ddsParams, size_t numRequired);
+    /// \brief Replace a fresh DDS session by a matching pre-warmed one and reduce the submit parameters by the adopted agents
+    /// \return error is set if the adoption failed and no new DDS session could be created
+    void adoptPooledAgents(const CommonParams& common, Session& session, Error& error, std::vector<DDSSubmitParams>& ddsParams, std::map<std::string, uint32_t>& pooledAgents);
+    /// \brief Shut down surplus agents that did not get any tasks during activation
+    void releaseSurplusAgents(const CommonParams& common, Partition& partition);
+    /// \brief Wait until every agent group has at least the given number of active slots, logging each group as it becomes ready
+    bool waitForAgentGroupSlots(const CommonParams& common, Session& session, Error& error, const std::map<std::string, size_t>& groupSlots);
     // void ShutdownDDSAgent(     const CommonParams& common, Session& session, uint64_t agentID);
 
     bool activateDDSTopology(const CommonParams& common, Session& session, Error& error, dds::tools_api::STopologyRequest::request_t::EUpdateType updateType);
     bool createDDSTopology(  const CommonParams& common, Session& session, Error& error);
 
     bool createTopology(const CommonParams& common, Partition& partition, Error& error);
+    /// \brief Set the handlers of the topology, which schedule the recovery of the partition under its current ID
+    void setTopologyHandlers(Partition& partition);
     bool resetTopology(Partition& partition);
 
-    bool changeState(         const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopoTransition transition, TopologyState& topologyState);
-    bool changeStateConfigure(const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopologyState& topologyState);
-    bool changeStateReset(    const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopologyState& topologyState);
+    bool changeState(         const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopoTransition transition, TopologyState& topologyState, const RolloutPolicy& rollout = RolloutPolicy());
+    bool changeStateSequence( const CommonParams& common, Partition& partition, Error& error, const std::string& path, const std::vector<TopoTransition>& transitions, TopologyState& topologyState, const RolloutPolicy& rollout = RolloutPolicy());
+    bool changeStateOrdered(  const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopoTransition transition, TopologyState& topologyState, const RolloutPolicy& rollout = RolloutPolicy());
+    std::optional<DataFlow> dataFlow(const CommonParams& common, Partition& partition, const std::string& path);
+    /// \brief Drop the cached data flows sharing devices with the path, all of them for an empty path
+    void dropDataFlows(Partition& partition, const std::string& path);
+    bool changeStateScheduled(const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopoTransition transition, TopologyState& topologyState, TransitionSkew& skew);
+    bool changeStateWith(     const CommonParams& common, Partition& partition, Error& error, const std::string& path, const std::string& transition, const std::string& variant, DeviceState expState, TopologyState& topologyState, const std::function<std::pair<std::error_code, TopoState>(std::chrono::seconds)>& changeStateFunc);
+    bool changeStateConfigure(const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopologyState& topologyState, const RolloutPolicy& rollout = RolloutPolicy());
+    bool changeStateReset(    const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopologyState& topologyState, const RolloutPolicy& rollout = RolloutPolicy());
+    RolloutPolicy rolloutPolicy(TopoTransition transition, const RolloutPolicy& requested) const;
     bool waitForState(        const CommonParams& common, Partition& partition, Error& error, const std::string& path, DeviceState expState);
     bool setProperties(       const CommonParams& common, Partition& partition, Error& error, const std::string& path, const SetPropertiesParams::Props& props, TopologyState& topologyState);
     void getState(            const CommonParams& common, Partition& partition, Error& error, const std::string& path, TopologyState& state);
@@ -169,11 +422,32 @@ class Controller
     Partition& acquirePartition(const CommonParams& common);
     void removePartition(const CommonParams& common);
 
+    /// \brief Start preparing a standby partition for the given active partition: Run and Configure with the same parameters.
+    ///  Failed attempts are shut down and retried up to kStandbyAttempts times.
+    void prepareStandby(const CommonParams& common, const RunParams& params);
+    /// \brief Shut down the standby partition of the given active partition in the background, once its preparation is done
+    void shutdownStandby(const CommonParams& common);
+    /// \brief Take over a restored standby partition if it is ready and its active partition was restored, shut it down otherwise
+    void adoptStandby(const std::string& partitionID, const std::string& standbyID);
+    /// \brief Run a task on a standby partition through the recovery admission
+    void admitStandby(const std::string& standbyID, const std::function<void()>& task);
+    /// \brief Drop the standbys that failed or were shut down. Called with mStandbyMtx locked
+    void reapStandbys();
+    /// \brief Reject client requests to standby partitions, their IDs are reserved
+    bool checkPartitionID(const CommonParams& common, Error& error);
+
     void stateSummaryOnFailure(const CommonParams& common, Session& session, const TopoState& topoState, DeviceState expectedState);
     void attemptSubmitRecovery(const CommonParams& common, Session& session, Error& error, const std::vector<DDSSubmitParams>& ddsParams, const std::map<std::string, uint32_t>& agentCounts);
     void updateTopology(const CommonParams& common, Session& session);
 
     std::string topoFilepath(const CommonParams& common, const std::string& topologyFile, const std::string& topologyContent, const std::string& topologyScript);
+    std::string topoContent(const CommonParams& common, const std::string& topologyFile, const std::string& topologyContent, const std::string& topologyScript);
+    /// \brief Run the topology generation script, or reuse the output of a previous run if the script cache is enabled and its inputs are unchanged
+    /// \return path to the file holding the script output
+    std::string execTopoScript(const CommonParams& common, const std::string& topologyScript);
+    std::string writeTempTopoFile(const CommonParams& common, const std::string& content);
+    /// \brief Set the topology file of the session and its requirements, going through the topology cache if it is enabled
+    void prepareTopology(const CommonParams& common, Session& session, const std::string& topologyFile, const std::string& topologyContent, const std::string& topologyScript, const std::string& topologyHash);
 
     std::chrono::seconds requestTimeout(const CommonParams& common, const std::string& op) const
     {
@@ -191,7 +465,10 @@ class Controller
     }
 
     uint32_t getNumSlots(const CommonParams& common, Session& session) const;
-    dds::tools_api::SAgentInfoRequest::responseVector_t getAgentInfo(const CommonParams& common, Session& session) const;
+    /// \param [out] complete set to false if DDS did not answer completely in time
+    dds::tools_api::SAgentInfoRequest::responseVector_t getAgentInfo(const CommonParams& common, Session& session, bool* complete = nullptr) const;
+    /// \brief Query of the agents of a session for its agent tracker
+    AgentTracker::Query agentQuery(const CommonParams& common, Session& session) const;
 
     void printStateStats(const CommonParams& common, const TopoState& topoState, const TopoStateByCollection& collectionMap, bool debugLog);
 };
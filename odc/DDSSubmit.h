@@ -15,6 +15,8 @@
 #include <odc/PluginManager.h>
 #include <odc/TopologyDefs.h>
 
+#include <dds/Tools.h>
+
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -131,6 +133,32 @@ inline bool operator!=(const DDSSubmitParams& lhs, const DDSSubmitParams& rhs)
     return !(lhs == rhs);
 }
 
+/// @brief Translate ODC submit parameters into a DDS submit request
+/// @param params submit parameters
+/// @param submissionTag tag identifying the submission on the RMS side
+inline dds::tools_api::SSubmitRequest::request_t makeDDSSubmitRequest(const DDSSubmitParams& params, const std::string& submissionTag)
+{
+    using namespace dds::tools_api;
+    SSubmitRequest::request_t requestInfo;
+    requestInfo.m_submissionTag = submissionTag;
+    requestInfo.m_rms = params.mRMS;
+    requestInfo.m_instances = params.mNumAgents;
+    requestInfo.m_minInstances = (params.mMinAgents >= 0) ? static_cast<uint32_t>(params.mMinAgents) : 0;
+    requestInfo.m_slots = params.mNumSlots;
+    requestInfo.m_config = params.mConfigFile;
+    requestInfo.m_envCfgFilePath = params.mEnvFile;
+    requestInfo.m_groupName = params.mAgentGroup;
+
+    // DDS does not support ncores parameter directly, set it here through additional config in case of Slurm
+    if (params.mRMS == "slurm" && params.mNumCores > 0) {
+        // the following disables `#SBATCH --cpus-per-task=%DDS_NSLOTS%` of DDS for Slurm
+        requestInfo.setFlag(SSubmitRequestData::ESubmitRequestFlags::enable_overbooking, true);
+
+        requestInfo.m_inlineConfig = std::string("#SBATCH --cpus-per-task=" + std::to_string(params.mNumCores));
+    }
+    return requestInfo;
+}
+
 class DDSSubmit : public PluginManager
 {
   public:
@@ -0,0 +1,186 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_DATAFLOW
+#define ODC_CORE_DATAFLOW
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility> // std::pair
+#include <vector>
+
+namespace odc::core {
+
+/// Query for the socket types of all device channels, as stored in the FairMQ properties
+const std::string gChannelTypeQuery = "^chans\\..+\\.type$";
+
+/**
+ * @brief Layers of devices along the flow of data through their channels.
+ *
+ * Devices are connected by channels of the same name. Devices with a push or pub socket on a channel produce into it,
+ * devices with a pull or sub socket consume from it. Other socket types (req/rep, pair, ...) impose no order.
+ * Every device is placed in the layer after the last layer of its producers, so the first layer holds the sources.
+ * Stopping layer by layer from the first lets consumers drain the data in flight, starting from the last lets producers find their consumers running.
+ */
+struct DataFlow
+{
+    using TaskId = uint64_t;
+    using Props = std::vector<std::pair<std::string, std::string>>;
+
+    std::vector<std::vector<TaskId>> mLayers; ///< devices by layer, sources first
+    size_t mNumCyclic = 0;                    ///< devices on or behind a cycle of channels, placed in the last layer
+
+    /// @brief Compute the layers from the channel socket types of the devices
+    /// @param props properties of each device matching gChannelTypeQuery, i.e. chans.<name>.<index>.type -> socket type
+    static DataFlow FromChannelTypes(const std::unordered_map<TaskId, Props>& props)
+    {
+        // devices and channels form a bipartite graph: producer -> channel -> consumer.
+        // A channel is done once all its producers are placed, a consumer once all channels it consumes from are done.
+        // A consumer that also produces into a channel only waits for the other producers of it.
+        // Every socket is visited a constant number of times: linear in the number of sockets, also for n:m channels.
+        struct Channel
+        {
+            std::vector<TaskId> mProducers;
+            std::vector<TaskId> mConsumers;
+            size_t mNumPending = 0;           // producers not placed yet
+            const TaskId* mSelf = nullptr;    // last pending producer, if it consumes from the channel as well
+        };
+        std::map<std::string, Channel> channels;
+        std::unordered_map<TaskId, std::vector<std::string>> produced;
+        std::unordered_map<TaskId, std::vector<std::string>> consumed;
+        for (const auto& [taskId, deviceProps] : props) {
+            produced[taskId];
+            consumed[taskId];
+            for (const auto& [key, type] : deviceProps) {
+                const std::string channel = ChannelName(key);
+                if (channel.empty()) {
+                    continue;
+                }
+                if (type == "push" || type == "pub") {
+                    produced[taskId].push_back(channel);
+                } else if (type == "pull" || type == "sub") {
+                    consumed[taskId].push_back(channel);
+                }
+            }
+        }
+
+        for (auto& [taskId, deviceChannels] : produced) {
+            std::sort(deviceChannels.begin(), deviceChannels.end());
+            deviceChannels.erase(std::unique(deviceChannels.begin(), deviceChannels.end()), deviceChannels.end());
+            for (const auto& channel : deviceChannels) {
+                channels[channel].mProducers.push_back(taskId);
+            }
+        }
+
+        std::unordered_map<TaskId, size_t> numInputs; // channels not done yet, per consumer
+        for (auto& [taskId, deviceChannels] : consumed) {
+            std::sort(deviceChannels.begin(), deviceChannels.end());
+            deviceChannels.erase(std::unique(deviceChannels.begin(), deviceChannels.end()), deviceChannels.end());
+            size_t& n = numInputs[taskId];
+            for (const auto& channel : deviceChannels) {
+                auto it = channels.find(channel);
+                if (it != channels.end()) {
+                    it->second.mConsumers.push_back(taskId);
+                    ++n;
+                }
+            }
+        }
+
+        std::unordered_map<TaskId, bool> placed;
+        std::vector<TaskId> next;
+        const auto done = [&](TaskId consumer) {
+            if (--numInputs.at(consumer) == 0) {
+                next.push_back(consumer);
+            }
+        };
+        // called whenever a producer of the channel is placed, each count of pending producers is reached once
+        const auto update = [&](Channel& channel) {
+            if (channel.mNumPending == 1) {
+                auto producer = std::find_if(channel.mProducers.begin(), channel.mProducers.end(), [&](TaskId p) { return !placed[p]; });
+                if (producer != channel.mProducers.end() && std::binary_search(channel.mConsumers.begin(), channel.mConsumers.end(), *producer)) {
+                    channel.mSelf = &*producer;
+                    done(*producer);
+                }
+            } else if (channel.mNumPending == 0) {
+                for (const auto& consumer : channel.mConsumers) {
+                    if (channel.mSelf == nullptr || consumer != *channel.mSelf) {
+                        done(consumer);
+                    }
+                }
+            }
+        };
+        for (auto& [name, channel] : channels) {
+            std::sort(channel.mProducers.begin(), channel.mProducers.end());
+            std::sort(channel.mConsumers.begin(), channel.mConsumers.end());
+            channel.mNumPending = channel.mProducers.size();
+            update(channel);
+        }
+
+        DataFlow flow;
+        std::vector<TaskId> layer;
+        for (const auto& [taskId, n] : numInputs) {
+            if (n == 0) {
+                layer.push_back(taskId);
+            }
+        }
+        next.clear();
+        size_t numPlaced = 0;
+        while (!layer.empty()) {
+            std::sort(layer.begin(), layer.end());
+            numPlaced += layer.size();
+            for (const auto& taskId : layer) {
+                placed[taskId] = true;
+            }
+            for (const auto& taskId : layer) {
+                for (const auto& channel : produced.at(taskId)) {
+                    Channel& c = channels.at(channel);
+                    --c.mNumPending;
+                    update(c);
+                }
+            }
+            flow.mLayers.push_back(std::move(layer));
+            layer = std::move(next);
+            next.clear();
+        }
+
+        if (numPlaced < numInputs.size()) {
+            std::vector<TaskId> cyclic;
+            for (const auto& [taskId, n] : numInputs) {
+                if (n > 0) {
+                    cyclic.push_back(taskId);
+                }
+            }
+            std::sort(cyclic.begin(), cyclic.end());
+            flow.mNumCyclic = cyclic.size();
+            flow.mLayers.push_back(std::move(cyclic));
+        }
+        return flow;
+    }
+
+    /// @brief Channel name of a chans.<name>.<index>.<property> key, empty for other keys
+    static std::string ChannelName(const std::string& key)
+    {
+        const std::string prefix("chans.");
+        const size_t typePos = key.rfind('.');
+        if (key.compare(0, prefix.size(), prefix) != 0 || typePos == std::string::npos || typePos <= prefix.size()) {
+            return "";
+        }
+        const size_t indexPos = key.rfind('.', typePos - 1);
+        if (indexPos == std::string::npos || indexPos < prefix.size()) {
+            return "";
+        }
+        return key.substr(prefix.size(), indexPos - prefix.size());
+    }
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_DATAFLOW
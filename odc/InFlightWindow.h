@@ -0,0 +1,95 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_INFLIGHTWINDOW
+#define ODC_CORE_INFLIGHTWINDOW
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace odc::core {
+
+/**
+ * @brief Sends a number of asynchronous requests with at most a given number of them in flight.
+ *
+ * The next request is sent as soon as one of the requests in flight reports done().
+ * With a window of 1 the requests are sent one after another.
+ */
+class InFlightWindow
+{
+  public:
+    /// @param maxInFlight maximum number of requests in flight, 0 is treated as 1
+    explicit InFlightWindow(size_t maxInFlight)
+        : mMaxInFlight(std::max<size_t>(1, maxInFlight))
+    {}
+    InFlightWindow(const InFlightWindow&) = delete;
+    InFlightWindow& operator=(const InFlightWindow&) = delete;
+
+    /// @brief Send the requests and wait until all of them are done or the deadline passed
+    /// @param num number of requests
+    /// @param deadline time until which requests are sent and waited for
+    /// @param send sends the request with the given index, called without the lock. Exceptions abort the sending and are passed on.
+    /// @return true if all requests were sent and reported done before the deadline
+    template<typename Send>
+    bool run(size_t num, std::chrono::steady_clock::time_point deadline, Send&& send)
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        size_t next = 0;
+        while (true) {
+            while (next < num && mInFlight < mMaxInFlight) {
+                const size_t i = next++;
+                ++mInFlight;
+                mMaxSeen = std::max(mMaxSeen, mInFlight);
+                lock.unlock();
+                send(i);
+                lock.lock();
+            }
+            if (next == num && mInFlight == 0) {
+                return true;
+            }
+            if (mCV.wait_until(lock, deadline) == std::cv_status::timeout && (next < num || mInFlight > 0)) {
+                return false;
+            }
+        }
+    }
+
+    /// @brief Report a request as done. Can be called from any thread, once per sent request.
+    void done()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            if (mInFlight > 0) {
+                --mInFlight;
+            }
+        }
+        mCV.notify_all();
+    }
+
+    size_t maxInFlight() const { return mMaxInFlight; }
+
+    /// @brief Highest number of requests in flight at the same time so far
+    size_t maxSeen() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mMaxSeen;
+    }
+
+  private:
+    const size_t mMaxInFlight;
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;
+    size_t mInFlight = 0;
+    size_t mMaxSeen = 0;
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_INFLIGHTWINDOW
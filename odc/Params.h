@@ -13,7 +13,10 @@
 #include <odc/Timer.h>
 #include <odc/TopologyDefs.h>
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <ostream>
 #include <string>
 #include <system_error>
 #include <unordered_set>
@@ -50,6 +53,10 @@ struct PartitionStatus
     std::string mDDSSessionID;                                      ///< Session ID of DDS
     DDSSessionStatus mDDSSessionStatus = DDSSessionStatus::unknown; ///< DDS session status
     AggregatedState mAggregatedState = AggregatedState::Undefined;  ///< Aggregated state of the affected divices
+    size_t mNumAgents = 0;                                          ///< Number of DDS agents in use
+    size_t mNumSlots = 0;                                           ///< Number of DDS slots in use
+    std::string mStandbyFor;                                        ///< ID of the active partition, if this is a standby partition
+    std::string mStandbyState;                                      ///< PREPARING, READY or FAILED, if this is a standby partition
 };
 
 struct BaseRequestResult
@@ -95,11 +102,59 @@ struct RequestResult : public BaseRequestResult
     std::string mDDSSessionID;    ///< Session ID of DDS
     TopologyState mTopologyState; ///< Topology state (aggregated + optional detailed)
     std::string mRMSJobIDs;       ///< RMS job IDs
+    std::string mTopoHash;        ///< Content hash of the used topology, if it went through the topology cache
 
     // Optional parameters
     std::unordered_set<std::string> mHosts; ///< List of used hosts
 };
 
+struct TopologyScriptCacheStats
+{
+    uint64_t mHits = 0;                      ///< Number of script executions served from the cache
+    uint64_t mMisses = 0;                    ///< Number of script executions with no matching cache entry
+    std::chrono::milliseconds mSavedTime{ 0 }; ///< Accumulated execution time of the original runs, for every hit
+
+    friend std::ostream& operator<<(std::ostream& os, const TopologyScriptCacheStats& s)
+    {
+        return os << "hits: " << s.mHits << ", misses: " << s.mMisses << ", saved time: " << s.mSavedTime.count() << "ms";
+    }
+};
+
+struct SessionPoolStats
+{
+    size_t mSize = 0;                           ///< Number of spare DDS sessions to keep
+    size_t mNumReady = 0;                       ///< Number of spare DDS sessions currently available
+    uint64_t mHits = 0;                         ///< Number of partitions served with a spare DDS session
+    uint64_t mMisses = 0;                       ///< Number of partitions that had to create a DDS session
+    uint64_t mNumCreated = 0;                   ///< Number of spare DDS sessions created
+    uint64_t mNumFailed = 0;                    ///< Number of failed creations of spare DDS sessions
+    std::chrono::milliseconds mCreateTime{ 0 }; ///< Accumulated creation time of spare DDS sessions
+
+    friend std::ostream& operator<<(std::ostream& os, const SessionPoolStats& s)
+    {
+        return os << "size: " << s.mSize << ", ready: " << s.mNumReady << ", hits: " << s.mHits << ", misses: " << s.mMisses
+                  << ", created: " << s.mNumCreated << ", failed: " << s.mNumFailed
+                  << ", avg. creation time: " << (s.mNumCreated > 0 ? s.mCreateTime.count() / s.mNumCreated : 0) << "ms";
+    }
+};
+
+struct AgentPoolStatus
+{
+    std::string mZone;          ///< Zone name
+    std::string mAgentGroup;    ///< Agent group name
+    uint32_t mNumAgents = 0;    ///< Number of pre-warmed DDS agents
+    uint32_t mNumSlots = 0;     ///< Number of slots per DDS agent
+    std::string mDDSSessionID;  ///< DDS session holding the agents, empty if not ready
+    std::string mState;         ///< EMPTY, FILLING, READY or FAILED
+    uint64_t mNumAdopted = 0;   ///< Number of times the pre-warmed agents were adopted by a partition
+
+    friend std::ostream& operator<<(std::ostream& os, const AgentPoolStatus& s)
+    {
+        return os << "zone: " << s.mZone << ", agent group: " << s.mAgentGroup << ", agents: " << s.mNumAgents << ", slots: " << s.mNumSlots
+                  << ", state: " << s.mState << ", DDS session: " << (s.mDDSSessionID.empty() ? "-" : s.mDDSSessionID) << ", adopted: " << s.mNumAdopted;
+    }
+};
+
 struct StatusRequestResult : public BaseRequestResult
 {
     StatusRequestResult() {}
@@ -108,6 +163,9 @@ struct StatusRequestResult : public BaseRequestResult
     {}
 
     std::vector<PartitionStatus> mPartitions; ///< Statuses of partitions
+    TopologyScriptCacheStats mTopoScriptCacheStats; ///< Topology script cache metrics
+    std::vector<AgentPoolStatus> mAgentPools; ///< Statuses of the pre-warmed agent pools
+    SessionPoolStats mSessionPool; ///< Spare DDS session metrics
 };
 
 struct CommonParams
@@ -122,6 +180,7 @@ struct CommonParams
     std::string mPartitionID; ///< Partition ID.
     uint64_t mRunNr = 0;      ///< Run number.
     size_t mTimeout = 0;      ///< Request timeout in seconds. 0 means "not set"
+    bool mInternal = false;   ///< Issued by ODC itself, e.g. on a standby partition. Only internal requests may address reserved partition IDs
     Timer mTimer; // TODO: put this into a wrapper "Request" class that encompases Params + timer
 
     friend std::ostream& operator<<(std::ostream& os, const CommonParams& p)
@@ -168,22 +227,25 @@ struct SubmitParams
 struct ActivateParams
 {
     ActivateParams() {}
-    ActivateParams(const std::string& topoFile, const std::string& topoContent, const std::string& topoScript)
+    ActivateParams(const std::string& topoFile, const std::string& topoContent, const std::string& topoScript, const std::string& topoHash = "")
         : mTopoFile(topoFile)
         , mTopoContent(topoContent)
         , mTopoScript(topoScript)
+        , mTopoHash(topoHash)
     {}
 
     std::string mTopoFile;    ///< Path to the topology file
     std::string mTopoContent; ///< Content of the XML topology
     std::string mTopoScript;  ///< Script that generates topology content
+    std::string mTopoHash;    ///< Hash of a topology known to the topology cache
 
     friend std::ostream& operator<<(std::ostream& os, const ActivateParams& p)
     {
         return os << "ActivateParams"
                   << ": topologyFile: "    << quoted(p.mTopoFile)
                   << "; topologyContent: " << quoted(p.mTopoContent)
-                  << "; topologyScript: "  << quoted(p.mTopoScript);
+                  << "; topologyScript: "  << quoted(p.mTopoScript)
+                  << "; topologyHash: "    << quoted(p.mTopoHash);
     }
 };
 
@@ -195,13 +257,19 @@ struct RunParams
               const std::string& topoFile,
               const std::string& topoContent,
               const std::string& topoScript,
-              bool extractTopoResources)
+              bool extractTopoResources,
+              const std::string& topoHash = "",
+              bool pipelined = false,
+              bool standby = false)
         : mPlugin(plugin)
         , mResources(resources)
         , mTopoFile(topoFile)
         , mTopoContent(topoContent)
         , mTopoScript(topoScript)
         , mExtractTopoResources(extractTopoResources)
+        , mTopoHash(topoHash)
+        , mPipelined(pipelined)
+        , mStandby(standby)
     {}
 
     std::string mPlugin;                ///< ODC resource plugin name. Plugin has to be registered in ODC server.
@@ -210,6 +278,9 @@ struct RunParams
     std::string mTopoContent;           ///< Content of the XML topology
     std::string mTopoScript;            ///< Script that generates topology content
     bool mExtractTopoResources = false; ///< Submit resource request based on topology content
+    std::string mTopoHash;              ///< Hash of a topology known to the topology cache
+    bool mPipelined = false;            ///< Configure devices agent group by agent group while the topology is starting
+    bool mStandby = false;              ///< Prepare a standby partition up to READY in the background, see Controller::execTakeover
 
     friend std::ostream& operator<<(std::ostream& os, const RunParams& p)
     {
@@ -219,28 +290,34 @@ struct RunParams
                   << "; topologyFile: "         << quoted(p.mTopoFile)
                   << "; topologyContent: "      << quoted(p.mTopoContent)
                   << "; topologyScript: "       << quoted(p.mTopoScript)
-                  << "; extractTopoResources: " << p.mExtractTopoResources;
+                  << "; extractTopoResources: " << p.mExtractTopoResources
+                  << "; topologyHash: "         << quoted(p.mTopoHash)
+                  << "; pipelined: "            << p.mPipelined
+                  << "; standby: "              << p.mStandby;
     }
 };
 
 struct UpdateParams
 {
     UpdateParams() {}
-    UpdateParams(const std::string& topoFile, const std::string& topoContent, const std::string& topoScript)
+    UpdateParams(const std::string& topoFile, const std::string& topoContent, const std::string& topoScript, const std::string& topoHash = "")
         : mTopoFile(topoFile)
         , mTopoContent(topoContent)
         , mTopoScript(topoScript)
+        , mTopoHash(topoHash)
     {}
 
     std::string mTopoFile;    ///< Path to the topology file
     std::string mTopoContent; ///< Content of the XML topology
     std::string mTopoScript;  ///< Script that generates topology content
+    std::string mTopoHash;    ///< Hash of a topology known to the topology cache
 
     friend std::ostream& operator<<(std::ostream& os, const UpdateParams& p)
     {
         return os << "UpdateParams: topologyFile: " << quoted(p.mTopoFile)
                   << "; topologyContent: " << quoted(p.mTopoContent)
-                  << "; topologyScript: " << quoted(p.mTopoScript);
+                  << "; topologyScript: " << quoted(p.mTopoScript)
+                  << "; topologyHash: " << quoted(p.mTopoHash);
     }
 };
 
@@ -271,18 +348,24 @@ struct SetPropertiesParams
 struct DeviceParams
 {
     DeviceParams() {}
-    DeviceParams(const std::string& path, bool detailed)
+    DeviceParams(const std::string& path, bool detailed, const std::string& host = "", const RolloutPolicy& rollout = RolloutPolicy())
         : mPath(path)
         , mDetailed(detailed)
+        , mHost(host)
+        , mRollout(rollout)
     {}
 
     std::string mPath;      ///< Path to the topology file
     bool mDetailed = false; ///< If True than return also detailed information
+    std::string mHost;      ///< If not empty, detailed information is restricted to devices on this host
+    RolloutPolicy mRollout; ///< Limits on the devices in transition at the same time, overriding the configured ones if set
 
     friend std::ostream& operator<<(std::ostream& os, const DeviceParams& p)
     {
         return os << "DeviceParams: path: " << quoted(p.mPath)
-                  << "; detailed: " << p.mDetailed;
+                  << "; detailed: " << p.mDetailed
+                  << "; host: " << quoted(p.mHost)
+                  << "; rollout: " << p.mRollout;
     }
 };
 
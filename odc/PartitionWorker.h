@@ -0,0 +1,157 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_PARTITIONWORKER
+#define ODC_CORE_PARTITIONWORKER
+
+#include <odc/Logger.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace odc::core {
+
+/**
+ * @brief Runs work for partitions in a background thread, one partition at a time, in the order they are due.
+ *
+ * Scheduling a partition that is already waiting only moves its run forward, so a burst of events leads to a single run.
+ * A partition scheduled while its work is running is run again afterwards.
+ */
+class PartitionWorker
+{
+  public:
+    using Work = std::function<void(const std::string& partitionID)>;
+    using Clock = std::chrono::steady_clock;
+
+    explicit PartitionWorker(Work work)
+        : mWork(std::move(work))
+        , mThread([this]() { run(); })
+    {}
+    PartitionWorker(const PartitionWorker&) = delete;
+    PartitionWorker& operator=(const PartitionWorker&) = delete;
+
+    ~PartitionWorker() { stop(); }
+
+    /// @brief Queue the partition to run after the delay, unless it is already waiting to run before. Does not block, can be called from any thread.
+    void schedule(const std::string& partitionID, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            if (mStop) {
+                return;
+            }
+            const auto due = Clock::now() + delay;
+            auto it = mWaiting.find(partitionID);
+            if (it != mWaiting.end()) {
+                if (it->second <= due) {
+                    return;
+                }
+                unqueue(partitionID, it->second);
+            }
+            mWaiting[partitionID] = due;
+            mQueue.emplace(due, partitionID);
+        }
+        mCV.notify_all();
+    }
+
+    /// @brief Wait until all scheduled partitions are done, delayed ones included
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        mDoneCV.wait(lock, [&]() { return (mQueue.empty() && !mBusy) || mStop; });
+    }
+
+    /// @brief Finish the running work and stop. Partitions still waiting are dropped, later ones are ignored.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mStop = true;
+        }
+        mCV.notify_all();
+        mDoneCV.notify_all();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    /// @brief Number of runs done so far
+    uint64_t numRuns() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mNumRuns;
+    }
+
+  private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        while (true) {
+            if (mStop) {
+                return;
+            }
+            if (mQueue.empty()) {
+                mCV.wait(lock);
+                continue;
+            }
+            if (Clock::now() < mQueue.begin()->first) {
+                mCV.wait_until(lock, mQueue.begin()->first);
+                continue;
+            }
+            const std::string partitionID = mQueue.begin()->second;
+            mQueue.erase(mQueue.begin());
+            mWaiting.erase(partitionID);
+            mBusy = true;
+            lock.unlock();
+
+            try {
+                mWork(partitionID);
+            } catch (const std::exception& e) {
+                OLOG(error, partitionID, 0) << "Background work on the partition failed: " << e.what();
+            }
+
+            lock.lock();
+            mBusy = false;
+            ++mNumRuns;
+            mDoneCV.notify_all();
+        }
+    }
+
+    void unqueue(const std::string& partitionID, Clock::time_point due)
+    {
+        auto range = mQueue.equal_range(due);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == partitionID) {
+                mQueue.erase(it);
+                return;
+            }
+        }
+    }
+
+    Work mWork;
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;       ///< Wakes up the worker
+    std::condition_variable mDoneCV;   ///< Signals finished runs to flush()
+    std::multimap<Clock::time_point, std::string> mQueue; ///< partitions waiting by due time, in the order they were scheduled
+    std::map<std::string, Clock::time_point> mWaiting;    ///< due time of the partitions in the queue
+    bool mBusy = false;                ///< work is running
+    bool mStop = false;
+    uint64_t mNumRuns = 0;
+
+    std::thread mThread; ///< Declared last: started once the members above are initialized
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_PARTITIONWORKER
@@ -0,0 +1,325 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_PERSISTENCE
+#define ODC_CORE_PERSISTENCE
+
+#include <odc/AppendFile.h>
+#include <odc/Logger.h>
+#include <odc/Restore.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace odc::core {
+
+/**
+ * @brief Writes the restore and history files in a background thread, so that requests do not wait for the file system.
+ *
+ * Changes of the restore data are appended to a journal next to the restore file, which is folded into the restore file
+ * every compaction interval. Only the latest queued restore data is written, intermediate ones are skipped.
+ * History lines are appended to the history file. The fsync policy sets when appended data is flushed to disk.
+ */
+class Persistence
+{
+  public:
+    enum class FsyncPolicy
+    {
+        Always,   ///< after every append
+        Periodic, ///< every fsync interval
+        Never     ///< left to the operating system
+    };
+
+    struct Config
+    {
+        FsyncPolicy mFsync = FsyncPolicy::Periodic;
+        std::chrono::milliseconds mFsyncInterval{ 1000 };
+        std::chrono::milliseconds mCompactionInterval{ 60000 }; ///< time between foldings of the journal into the restore file
+    };
+
+    /// @throws std::runtime_error for unknown policies
+    static FsyncPolicy ParseFsyncPolicy(const std::string& policy)
+    {
+        if (policy == "always") {
+            return FsyncPolicy::Always;
+        } else if (policy == "periodic") {
+            return FsyncPolicy::Periodic;
+        } else if (policy == "never") {
+            return FsyncPolicy::Never;
+        }
+        throw std::runtime_error(toString("Unknown fsync policy ", std::quoted(policy), ". Expected always, periodic or never"));
+    }
+
+    Persistence()
+        : mThread([this]() { run(); })
+    {}
+    Persistence(const Persistence&) = delete;
+    Persistence& operator=(const Persistence&) = delete;
+
+    /// @brief Write all queued data, fold the journal into the restore file and stop
+    ~Persistence()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mStop = true;
+        }
+        mCV.notify_all();
+        mThread.join();
+    }
+
+    void configure(const Config& config)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mConfig = config;
+    }
+
+    /// @brief Queue the restore data to be written, replacing any queued one
+    void restore(const std::string& id, const std::string& dir, RestoreData data)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mPendingRestore = PendingRestore{ id, dir, std::move(data) };
+            ++mNumQueued;
+        }
+        mCV.notify_all();
+    }
+
+    /// @brief Queue a line to be appended to the history file in the given directory
+    void history(const std::string& dir, const std::string& line)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mPendingHistory.push_back({ dir, line });
+            ++mNumQueued;
+        }
+        mCV.notify_all();
+    }
+
+    /// @brief Wait until everything queued so far is written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        const uint64_t numQueued = mNumQueued;
+        mWrittenCV.wait(lock, [&]() { return mNumWritten >= numQueued; });
+    }
+
+  private:
+    struct PendingRestore
+    {
+        std::string mId;
+        std::string mDir;
+        RestoreData mData;
+    };
+
+    struct PendingHistory
+    {
+        std::string mDir;
+        std::string mLine;
+    };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        while (true) {
+            auto pending = [&]() { return mStop || mPendingRestore.has_value() || !mPendingHistory.empty(); };
+            if (mUnsynced || mJournalRecords > 0) {
+                mCV.wait_until(lock, nextMaintenance(), pending);
+            } else {
+                mCV.wait(lock, pending);
+            }
+            std::optional<PendingRestore> restore = std::move(mPendingRestore);
+            mPendingRestore.reset();
+            std::vector<PendingHistory> history = std::move(mPendingHistory);
+            mPendingHistory.clear();
+            const Config config = mConfig;
+            const bool stop = mStop;
+            const uint64_t numQueued = mNumQueued;
+            lock.unlock();
+
+            if (restore) {
+                writeRestore(*restore, config);
+            }
+            for (const auto& h : history) {
+                writeHistory(h, config);
+            }
+            maintain(config, stop);
+
+            lock.lock();
+            mNumWritten = numQueued;
+            mWrittenCV.notify_all();
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    std::chrono::steady_clock::time_point nextMaintenance() const
+    {
+        auto next = std::chrono::steady_clock::time_point::max();
+        if (mUnsynced) {
+            next = std::min(next, mLastSync + mConfig.mFsyncInterval);
+        }
+        if (mJournalRecords > 0) {
+            next = std::min(next, mLastCompaction + mConfig.mCompactionInterval);
+        }
+        return next;
+    }
+
+    void writeRestore(PendingRestore& restore, const Config& config)
+    {
+        try {
+            if (!mJournal || restore.mId != mRestoreId || restore.mDir != mRestoreDir) {
+                openJournal(restore.mId, restore.mDir);
+            }
+            const auto records = RestoreJournal::Diff(mRestoreData, restore.mData);
+            if (records.empty()) {
+                return;
+            }
+            std::string data;
+            for (const auto& r : records) {
+                data += r + "\n";
+            }
+            mJournal->append(data);
+            mRestoreData = std::move(restore.mData);
+            mJournalRecords += records.size();
+            written(*mJournal, config);
+        } catch (const std::exception& e) {
+            OLOG(error) << "Failed to append to the restore journal, writing the restore file instead: " << e.what();
+            mJournal.reset();
+            mRestoreData = std::move(restore.mData);
+            RestoreFile(mRestoreId, mRestoreDir, mRestoreData).write();
+        }
+    }
+
+    void openJournal(const std::string& id, const std::string& dir)
+    {
+        compact();
+        mJournal.reset();
+        mRestoreId = id;
+        mRestoreDir = dir;
+        RestoreFile file(id, dir);
+        mRestoreData = file.exists() ? file.read() : RestoreData();
+        std::filesystem::create_directories(std::filesystem::path(file.getJournalPath()).parent_path());
+        mJournal = std::make_unique<AppendFile>(file.getJournalPath());
+        // a journal left by a previous run may end with a record torn by a crash, start from a clean one
+        if (!mJournal->empty()) {
+            if (RestoreFile(id, dir, mRestoreData).write()) {
+                mJournal->truncate();
+            }
+        }
+        mJournalRecords = 0;
+        mLastCompaction = std::chrono::steady_clock::now();
+    }
+
+    void writeHistory(const PendingHistory& history, const Config& config)
+    {
+        const auto dir = std::filesystem::path(history.mDir);
+        const auto filepath = dir / "odc_session_history.log";
+        try {
+            if (!mHistory || mHistory->path() != filepath) {
+                mHistory.reset();
+                if (!std::filesystem::exists(dir) && !std::filesystem::create_directories(dir)) {
+                    throw std::runtime_error(toString("History: failed to create directory ", std::quoted(dir.string())));
+                }
+                mHistory = std::make_unique<AppendFile>(filepath);
+            }
+            mHistory->append(history.mLine);
+            written(*mHistory, config);
+        } catch (const std::exception& e) {
+            OLOG(error) << "Failed to write history file " << std::quoted(filepath.string()) << ": " << e.what();
+            mHistory.reset();
+        }
+    }
+
+    void written(AppendFile& file, const Config& config)
+    {
+        if (config.mFsync == FsyncPolicy::Always) {
+            file.sync();
+        } else if (config.mFsync == FsyncPolicy::Periodic) {
+            if (!mUnsynced) {
+                mLastSync = std::chrono::steady_clock::now();
+            }
+            mUnsynced = true;
+        }
+    }
+
+    /// @brief Sync and compact when due, or right away when stopping
+    void maintain(const Config& config, bool stop)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (mUnsynced && (stop || now >= mLastSync + config.mFsyncInterval)) {
+            mUnsynced = false;
+            mLastSync = now;
+            for (auto* file : { mJournal.get(), mHistory.get() }) {
+                try {
+                    if (file != nullptr) {
+                        file->sync();
+                    }
+                } catch (const std::exception& e) {
+                    OLOG(error) << e.what();
+                }
+            }
+        }
+        if (mJournalRecords > 0 && (stop || now >= mLastCompaction + config.mCompactionInterval)) {
+            compact();
+        }
+    }
+
+    /// @brief Fold the journal into the restore file. The journal is only cleared once the restore file is replaced.
+    void compact()
+    {
+        mLastCompaction = std::chrono::steady_clock::now();
+        if (!mJournal || mJournalRecords == 0) {
+            return;
+        }
+        if (RestoreFile(mRestoreId, mRestoreDir, mRestoreData).write()) {
+            try {
+                mJournal->truncate();
+                mJournalRecords = 0;
+            } catch (const std::exception& e) {
+                OLOG(error) << e.what();
+            }
+        }
+    }
+
+    std::mutex mMtx;                 ///< Mutex for the queue and the config
+    std::condition_variable mCV;     ///< Wakes up the writer
+    std::condition_variable mWrittenCV; ///< Signals written data to flush()
+    Config mConfig;
+    std::optional<PendingRestore> mPendingRestore;
+    std::vector<PendingHistory> mPendingHistory;
+    uint64_t mNumQueued = 0;
+    uint64_t mNumWritten = 0;
+    bool mStop = false;
+
+    // only used by the writer thread
+    std::string mRestoreId;
+    std::string mRestoreDir;
+    RestoreData mRestoreData;              ///< restore data as persisted by restore file and journal
+    std::unique_ptr<AppendFile> mJournal;
+    size_t mJournalRecords = 0;            ///< records appended since the last compaction
+    std::unique_ptr<AppendFile> mHistory;
+    bool mUnsynced = false;                ///< appended data not synced yet
+    std::chrono::steady_clock::time_point mLastSync;
+    std::chrono::steady_clock::time_point mLastCompaction;
+
+    std::thread mThread; ///< Declared last: started once the members above are initialized
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_PERSISTENCE
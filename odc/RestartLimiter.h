@@ -0,0 +1,82 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_RESTARTLIMITER
+#define ODC_CORE_RESTARTLIMITER
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+
+namespace odc::core {
+
+/**
+ * @brief Limits the restarts of crashed tasks, so that a task in a crash loop is given up instead of restarted forever.
+ *
+ * A task is restarted at most mMaxRestarts times within a sliding window. Each restart is delayed by a backoff
+ * that doubles with every restart of the task still in the window.
+ */
+class RestartLimiter
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        uint32_t mMaxRestarts = 0;                    ///< restarts within the window, 0 disables restarts
+        std::chrono::seconds mWindow{ 600 };          ///< length of the sliding window
+        std::chrono::milliseconds mBackoff{ 1000 };   ///< delay of the first restart in the window
+        std::chrono::seconds mTimeout{ 60 };          ///< time a restarted task has to report back
+    };
+
+    RestartLimiter() = default;
+    explicit RestartLimiter(const Config& config)
+        : mConfig(config)
+    {}
+
+    const Config& config() const { return mConfig; }
+
+    /// @brief Register a restart of the task
+    /// @param taskID task that crashed
+    /// @param now time of the crash
+    /// @return time the restart is due at, none if the task restarted too often within the window
+    std::optional<Clock::time_point> admit(uint64_t taskID, Clock::time_point now)
+    {
+        auto& restarts = mRestarts[taskID];
+        while (!restarts.empty() && restarts.front() + mConfig.mWindow <= now) {
+            restarts.pop_front();
+        }
+        if (restarts.size() >= mConfig.mMaxRestarts) {
+            return std::nullopt;
+        }
+        const auto backoff = mConfig.mBackoff * (1 << std::min<size_t>(restarts.size(), 16));
+        restarts.push_back(now);
+        return now + backoff;
+    }
+
+    /// @brief Number of restarts of the task within the window ending now
+    size_t numRestarts(uint64_t taskID, Clock::time_point now) const
+    {
+        auto it = mRestarts.find(taskID);
+        if (it == mRestarts.end()) {
+            return 0;
+        }
+        return std::count_if(it->second.begin(), it->second.end(), [&](const auto& t) { return t + mConfig.mWindow > now; });
+    }
+
+  private:
+    Config mConfig;
+    std::map<uint64_t, std::deque<Clock::time_point>> mRestarts; ///< times of the restarts in the window, by task ID
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_RESTARTLIMITER
@@ -9,22 +9,30 @@
 #ifndef ODC_CORE_RESTORE
 #define ODC_CORE_RESTORE
 
+#include <odc/AppendFile.h>
 #include <odc/Logger.h>
 
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <istream>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace odc::core {
 
 struct RestorePartition
 {
     RestorePartition() {}
-    RestorePartition(const std::string& partitionId, const std::string& sessionId)
+    RestorePartition(const std::string& partitionId, const std::string& sessionId, const std::string& standbyFor = "")
         : mPartitionID(partitionId)
         , mDDSSessionId(sessionId)
+        , mStandbyFor(standbyFor)
     {}
     RestorePartition(const boost::property_tree::ptree& pt) { fromPT(pt); }
 
@@ -33,16 +41,21 @@ struct RestorePartition
         boost::property_tree::ptree pt;
         pt.put<std::string>("partition", mPartitionID);
         pt.put<std::string>("session", mDDSSessionId);
+        if (!mStandbyFor.empty()) {
+            pt.put<std::string>("standby", mStandbyFor);
+        }
         return pt;
     }
     void fromPT(const boost::property_tree::ptree& pt)
     {
         mPartitionID = pt.get<std::string>("partition", "");
         mDDSSessionId = pt.get<std::string>("session", "");
+        mStandbyFor = pt.get<std::string>("standby", "");
     }
 
     std::string mPartitionID;
     std::string mDDSSessionId;
+    std::string mStandbyFor; ///< ID of the active partition, if this is its standby partition
 };
 
 struct RestoreData
@@ -56,8 +69,15 @@ struct RestoreData
         for (const auto& v : mPartitions) {
             children.push_back(make_pair("", v.toPT()));
         }
+        boost::property_tree::ptree spare;
+        for (const auto& v : mSpareSessions) {
+            boost::property_tree::ptree child;
+            child.put_value(v);
+            spare.push_back(make_pair("", child));
+        }
         boost::property_tree::ptree pt;
         pt.add_child("sessions", children);
+        pt.add_child("spare", spare);
         return pt;
     }
     void fromPT(const boost::property_tree::ptree& _pt)
@@ -68,9 +88,110 @@ struct RestoreData
                 mPartitions.push_back(RestorePartition(v.second));
             }
         }
+        auto spt{ _pt.get_child_optional("spare") };
+        if (spt) {
+            for (const auto& v : spt.get()) {
+                mSpareSessions.push_back(v.second.get_value<std::string>());
+            }
+        }
     }
 
     std::vector<RestorePartition> mPartitions;
+    std::vector<std::string> mSpareSessions; ///< Idle DDS sessions of the session pool
+};
+
+/**
+ * @brief Records of changes to the restore data, appended to a journal next to the restore file.
+ *
+ * One record per line, fields separated by tabs:
+ * "+ partition session [standbyFor]" adds or updates a partition, "- partition" removes one, "= spare..." replaces the spare sessions.
+ * Records set values instead of changing them, so replaying a journal on a restore file that already contains some of them is harmless.
+ */
+struct RestoreJournal
+{
+    /// @brief Records that turn one restore data into another
+    static std::vector<std::string> Diff(const RestoreData& from, const RestoreData& to)
+    {
+        std::vector<std::string> records;
+        std::map<std::string, std::pair<std::string, std::string>> fromSessions;
+        for (const auto& p : from.mPartitions) {
+            fromSessions[p.mPartitionID] = { p.mDDSSessionId, p.mStandbyFor };
+        }
+        std::map<std::string, std::string> toSessions;
+        for (const auto& p : to.mPartitions) {
+            toSessions[p.mPartitionID] = p.mDDSSessionId;
+            auto it = fromSessions.find(p.mPartitionID);
+            if (it == fromSessions.end() || it->second != std::make_pair(p.mDDSSessionId, p.mStandbyFor)) {
+                records.push_back(toString("+\t", p.mPartitionID, "\t", p.mDDSSessionId, p.mStandbyFor.empty() ? "" : "\t", p.mStandbyFor));
+            }
+        }
+        for (const auto& p : from.mPartitions) {
+            if (toSessions.count(p.mPartitionID) == 0) {
+                records.push_back(toString("-\t", p.mPartitionID));
+            }
+        }
+        if (from.mSpareSessions != to.mSpareSessions) {
+            std::string record("=");
+            for (const auto& s : to.mSpareSessions) {
+                record += "\t" + s;
+            }
+            records.push_back(record);
+        }
+        return records;
+    }
+
+    /// @brief Apply a record to the restore data
+    /// @return false if the record is malformed
+    static bool Apply(const std::string& record, RestoreData& data)
+    {
+        std::vector<std::string> fields;
+        size_t pos = 0;
+        for (size_t tab = record.find('\t'); tab != std::string::npos; tab = record.find('\t', pos)) {
+            fields.push_back(record.substr(pos, tab - pos));
+            pos = tab + 1;
+        }
+        fields.push_back(record.substr(pos));
+
+        auto& partitions = data.mPartitions;
+        if (fields.at(0) == "+" && (fields.size() == 3 || fields.size() == 4)) {
+            const std::string standbyFor = fields.size() == 4 ? fields.at(3) : "";
+            auto it = std::find_if(partitions.begin(), partitions.end(), [&](const RestorePartition& p) { return p.mPartitionID == fields.at(1); });
+            if (it == partitions.end()) {
+                partitions.push_back(RestorePartition(fields.at(1), fields.at(2), standbyFor));
+            } else {
+                it->mDDSSessionId = fields.at(2);
+                it->mStandbyFor = standbyFor;
+            }
+        } else if (fields.at(0) == "-" && fields.size() == 2) {
+            partitions.erase(std::remove_if(partitions.begin(), partitions.end(), [&](const RestorePartition& p) { return p.mPartitionID == fields.at(1); }), partitions.end());
+        } else if (fields.at(0) == "=") {
+            data.mSpareSessions.assign(fields.begin() + 1, fields.end());
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Apply the records of a journal in order
+    /// A last record without line end was torn by a crash during the append and is skipped.
+    /// @return number of applied records
+    static size_t Replay(std::istream& is, RestoreData& data)
+    {
+        size_t numApplied = 0;
+        std::string record;
+        while (std::getline(is, record)) {
+            if (is.eof()) {
+                OLOG(warning) << "Skipping incomplete last record of the restore journal";
+                break;
+            }
+            if (!Apply(record, data)) {
+                OLOG(error) << "Stopping restore journal replay at malformed record " << std::quoted(record);
+                break;
+            }
+            ++numApplied;
+        }
+        return numApplied;
+    }
 };
 
 class RestoreFile
@@ -86,32 +207,59 @@ class RestoreFile
         , mData(data)
     {}
 
-    void write()
+    /// @brief Replace the restore file atomically: the data is written to a temporary file, synced to disk and renamed over the previous file
+    /// @return true if the file was written
+    bool write()
     {
+        const std::string tmpPath = getFilepath() + ".tmp";
         try {
             if (!std::filesystem::exists(mDir) && !std::filesystem::create_directories(mDir)) {
                 throw std::runtime_error(toString("Restore failed to create directory ", std::quoted(mDir.string())));
             }
 
             OLOG(info) << "Writing restore file " << std::quoted(getFilepath());
-            boost::property_tree::write_json(getFilepath(), mData.toPT());
+            boost::property_tree::write_json(tmpPath, mData.toPT());
+            SyncPath(tmpPath);
+            std::filesystem::rename(tmpPath, getFilepath());
+            SyncPath(mDir);
+            return true;
         } catch (const std::exception& e) {
             OLOG(error) << "Failed to write restore data " << quoted(mId) << " to file " << quoted(getFilepath()) << ": " << e.what();
+            std::error_code ec;
+            std::filesystem::remove(tmpPath, ec);
+            return false;
         }
     }
+    /// @brief Read the restore file and replay the journal of the changes since it was written
     const RestoreData& read()
     {
+        const bool hasJournal = std::filesystem::exists(getJournalPath());
         try {
-            boost::property_tree::ptree pt;
-            OLOG(info) << "Reading restore file " << std::quoted(getFilepath());
-            boost::property_tree::read_json(getFilepath(), pt);
-            mData = RestoreData(pt);
+            // a journal without restore file is left by a controller that did not compact it yet
+            if (!hasJournal || std::filesystem::exists(getFilepath())) {
+                boost::property_tree::ptree pt;
+                OLOG(info) << "Reading restore file " << std::quoted(getFilepath());
+                boost::property_tree::read_json(getFilepath(), pt);
+                mData = RestoreData(pt);
+            }
         } catch (const std::exception& e) {
             OLOG(error) << "Failed to read restore data " << quoted(mId) << " from file " << quoted(getFilepath()) << ": " << e.what();
         }
+        if (hasJournal) {
+            std::ifstream journal(getJournalPath());
+            const size_t numApplied = RestoreJournal::Replay(journal, mData);
+            OLOG(info) << "Replayed " << numApplied << " records of restore journal " << std::quoted(getJournalPath());
+        }
         return mData;
     }
 
+    bool exists() const { return std::filesystem::exists(getFilepath()) || std::filesystem::exists(getJournalPath()); }
+
+    std::string getJournalPath() const
+    {
+        return std::filesystem::path(mDir / toString("odc_", mId, ".journal")).string();
+    }
+
   private:
     std::string getFilepath() const
     {
@@ -9,24 +9,51 @@
 #ifndef ODC_CORE_SESSION
 #define ODC_CORE_SESSION
 
+#include <odc/AgentTracker.h>
+#include <odc/MiscUtils.h>
 #include <odc/TopologyDefs.h>
 
 #include <dds/Tools.h>
 #include <dds/Topology.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace odc::core
 {
 
+struct TopologyCacheEntry;
+class TopologyCachePin;
+
 struct Session
 {
+    /// Topology of the session with its requirements, to switch the session back after a failed topology update
+    struct TopologySnapshot
+    {
+        std::shared_ptr<dds::topology_api::CTopology> mDDSTopo;
+        std::string mTopoFilePath;
+        std::string mTopoHash;
+        std::shared_ptr<const TopologyCacheEntry> mTopoCacheEntry;
+        std::shared_ptr<TopologyCachePin> mTopoCachePin;
+        std::map<std::string, CollectionNInfo> mNinfo;
+        std::map<std::string, std::vector<ZoneGroup>> mZoneInfo;
+        std::vector<AgentGroupInfo> mAgentGroupInfo;
+        std::vector<TaskInfo> mStandaloneTasks;
+        std::map<std::string, CollectionInfo> mCollections;
+        std::unordered_set<DDSTaskId> mExpendableTasks;
+    };
+
     TaskDetails& getTaskDetails(DDSTaskId taskID)
     {
         auto it = mTaskDetails.find(taskID);
@@ -74,6 +101,188 @@ struct Session
 
     }
 
+    /// @brief Restrict an already filled detailed state to the tasks & collections running on the given host
+    /// @param host host name; empty host leaves the state unchanged
+    /// @param topologyState topology state with optional detailed state
+    void filterDetailedStateByHost(const std::string& host, TopologyState& topologyState) const
+    {
+        if (host.empty() || !topologyState.detailed.has_value()) {
+            return;
+        }
+
+        std::unordered_set<DDSTaskId> hostTasks;
+        std::unordered_set<DDSCollectionId> hostCollections;
+        auto hostIt = mHostAgents.find(host);
+        if (hostIt != mHostAgents.end()) {
+            for (const auto agentID : hostIt->second) {
+                auto tasksIt = mAgentTasks.find(agentID);
+                if (tasksIt != mAgentTasks.end()) {
+                    hostTasks.insert(tasksIt->second.begin(), tasksIt->second.end());
+                }
+                auto colsIt = mAgentCollections.find(agentID);
+                if (colsIt != mAgentCollections.end()) {
+                    hostCollections.insert(colsIt->second.begin(), colsIt->second.end());
+                }
+            }
+        }
+
+        auto& tasks = topologyState.detailed->tasks;
+        tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [&](const DetailedTaskStatus& t) { return hostTasks.count(t.mStatus.taskId) == 0; }), tasks.end());
+        auto& collections = topologyState.detailed->collections;
+        collections.erase(std::remove_if(collections.begin(), collections.end(), [&](const DetailedCollectionStatus& c) { return hostCollections.count(c.mID) == 0; }), collections.end());
+    }
+
+    /// @brief Add an activated task to the host/agent indices
+    /// @param details task details as reported by DDS
+    void indexTask(const TaskDetails& details)
+    {
+        mHostAgents[details.mHost].insert(details.mAgentID);
+        mAgentTasks[details.mAgentID].insert(details.mTaskID);
+        if (details.mCollectionID > 0) {
+            mAgentCollections[details.mAgentID].insert(details.mCollectionID);
+        }
+    }
+
+    /// @brief Get all tasks that were activated on the given agent
+    const std::unordered_set<DDSTaskId>& getAgentTasks(DDSAgentId agentID) const
+    {
+        static const std::unordered_set<DDSTaskId> empty;
+        auto it = mAgentTasks.find(agentID);
+        return it == mAgentTasks.end() ? empty : it->second;
+    }
+
+    /// @brief Remove tasks stopped by a topology update from the task & collection details and the indices
+    void removeTasks(const std::vector<DDSTaskId>& taskIDs)
+    {
+        if (taskIDs.empty()) {
+            return;
+        }
+        std::unordered_set<DDSCollectionId> collections;
+        std::unordered_map<DDSAgentId, std::string> agents; // agents that lost tasks -> their host
+        for (const auto taskID : taskIDs) {
+            auto it = mTaskDetails.find(taskID);
+            if (it == mTaskDetails.end()) {
+                continue;
+            }
+            agents.emplace(it->second.mAgentID, it->second.mHost);
+            auto agentIt = mAgentTasks.find(it->second.mAgentID);
+            if (agentIt != mAgentTasks.end()) {
+                agentIt->second.erase(taskID);
+                if (agentIt->second.empty()) {
+                    mAgentTasks.erase(agentIt);
+                }
+            }
+            if (it->second.mCollectionID > 0) {
+                collections.insert(it->second.mCollectionID);
+            }
+            mTaskDetails.erase(it);
+        }
+        // collections are removed with their last task
+        for (const auto& [taskID, task] : mTaskDetails) {
+            collections.erase(task.mCollectionID);
+        }
+        for (const auto collectionID : collections) {
+            auto colIt = mCollectionDetails.find(collectionID);
+            if (colIt == mCollectionDetails.end()) {
+                continue;
+            }
+            auto agentIt = mAgentCollections.find(colIt->second.mAgentID);
+            if (agentIt != mAgentCollections.end()) {
+                agentIt->second.erase(collectionID);
+                if (agentIt->second.empty()) {
+                    mAgentCollections.erase(agentIt);
+                }
+            }
+            mCollectionDetails.erase(colIt);
+        }
+        // agents without tasks are no longer reported for their host, e.g. after they were lost
+        for (const auto& [agentID, host] : agents) {
+            if (mAgentTasks.count(agentID) > 0) {
+                continue;
+            }
+            mAgentCollections.erase(agentID);
+            auto hostIt = mHostAgents.find(host);
+            if (hostIt != mHostAgents.end()) {
+                hostIt->second.erase(agentID);
+                if (hostIt->second.empty()) {
+                    mHostAgents.erase(hostIt);
+                }
+            }
+        }
+    }
+
+    void clearIndices()
+    {
+        mHostAgents.clear();
+        mAgentTasks.clear();
+        mAgentCollections.clear();
+    }
+
+    /// @brief Parse the topology file of the session, replacing the previously parsed one
+    /// @return parsed DDS topology, kept until handed over via takeParsedTopology()
+    dds::topology_api::CTopology& parseTopology()
+    {
+        mParsedDDSTopo = std::make_shared<dds::topology_api::CTopology>(mTopoFilePath);
+        mParsedTopoFilePath = mTopoFilePath;
+        return *mParsedDDSTopo;
+    }
+
+    /// @brief Hand over the topology parsed during the current request. Parses the file only if it was not yet parsed or if the topology file changed since.
+    std::shared_ptr<dds::topology_api::CTopology> takeParsedTopology()
+    {
+        if (!mParsedDDSTopo || mParsedTopoFilePath != mTopoFilePath) {
+            parseTopology();
+        }
+        mParsedTopoFilePath.clear();
+        return std::move(mParsedDDSTopo);
+    }
+
+    TopologySnapshot snapshotTopology() const
+    {
+        return TopologySnapshot{ mDDSTopo, mTopoFilePath, mTopoHash, mTopoCacheEntry, mTopoCachePin, mNinfo, mZoneInfo, mAgentGroupInfo, mStandaloneTasks, mCollections, mExpendableTasks };
+    }
+
+    /// @brief Switch back to the snapshotted topology. The collection index is rebuilt, as it points into the collections.
+    void restoreTopology(TopologySnapshot snapshot)
+    {
+        mDDSTopo = std::move(snapshot.mDDSTopo);
+        mTopoFilePath = std::move(snapshot.mTopoFilePath);
+        mTopoHash = std::move(snapshot.mTopoHash);
+        mTopoCacheEntry = std::move(snapshot.mTopoCacheEntry);
+        mTopoCachePin = std::move(snapshot.mTopoCachePin);
+        mNinfo = std::move(snapshot.mNinfo);
+        mZoneInfo = std::move(snapshot.mZoneInfo);
+        mAgentGroupInfo = std::move(snapshot.mAgentGroupInfo);
+        mStandaloneTasks = std::move(snapshot.mStandaloneTasks);
+        mCollections = std::move(snapshot.mCollections);
+        mExpendableTasks = std::move(snapshot.mExpendableTasks);
+        mRuntimeCollectionIndex.clear();
+        for (auto& [name, colInfo] : mCollections) {
+            for (const auto& [colId, agentId] : colInfo.mRuntimeCollectionAgents) {
+                mRuntimeCollectionIndex.emplace(colId, &colInfo);
+            }
+        }
+        mParsedDDSTopo.reset();
+        mParsedTopoFilePath.clear();
+    }
+
+    /// @brief Key of the topology for the transition statistics: its content hash, also without the topology cache,
+    /// where each request with topology content gets a new temporary file. Hashes the file only if it changed since.
+    /// Concurrent requests on disjoint paths and the activations of the agent groups ask for it at the same time.
+    std::string topologyKey()
+    {
+        if (!mTopoHash.empty()) {
+            return mTopoHash;
+        }
+        std::lock_guard<std::mutex> lock(mTopoKeyMtx);
+        if (mTopoKeyFilePath != mTopoFilePath) {
+            std::ifstream file(mTopoFilePath);
+            mTopoKey = file ? contentHash(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>())) : mTopoFilePath;
+            mTopoKeyFilePath = mTopoFilePath;
+        }
+        return mTopoKey;
+    }
+
     std::vector<odc::core::AgentGroupInfo>::iterator findAgentGroup(const std::string& agentGroupName)
     {
         auto agiIt = std::find_if(mAgentGroupInfo.begin(), mAgentGroupInfo.end(), [&agentGroupName](const AgentGroupInfo& info) {
@@ -86,6 +295,90 @@ struct Session
         }
     }
 
+    /// @brief Name of the agent group the given agent belongs to, empty if unknown
+    std::string getAgentGroupName(DDSAgentId agentID) const
+    {
+        auto it = mAgentInfo.find(agentID);
+        if (it == mAgentInfo.end() || it->second.agentGroupInfoIndex >= mAgentGroupInfo.size()) {
+            return "";
+        }
+        return mAgentGroupInfo.at(it->second.agentGroupInfoIndex).name;
+    }
+
+    /// @brief Topology path (regex) selecting the activated tasks of each agent group, by agent group name
+    /// Runtime collections and standalone tasks are folded into their declaration (e.g. main/group1/collection1_[0-9]+/.*)
+    /// when all its instances run in the same agent group, so a path lists the declarations of its group, not every instance.
+    std::map<std::string, std::string> getAgentGroupPaths() const
+    {
+        struct Element
+        {
+            std::string mGroup;
+            bool mCollection;
+        };
+        std::map<std::string, Element> elements; // runtime path of a collection or standalone task -> agent group
+        for (const auto& [taskID, task] : mTaskDetails) {
+            auto colIt = (task.mCollectionID == 0) ? mCollectionDetails.end() : mCollectionDetails.find(task.mCollectionID);
+            if (colIt != mCollectionDetails.end()) {
+                elements.emplace(colIt->second.mPath, Element{ getAgentGroupName(task.mAgentID), true });
+            } else {
+                elements.emplace(task.mPath, Element{ getAgentGroupName(task.mAgentID), false });
+            }
+        }
+
+        std::map<std::string, std::set<std::string>> declarationGroups; // declaration pattern -> agent groups of its instances
+        for (const auto& [path, element] : elements) {
+            declarationGroups[declarationPattern(path, element.mCollection)].insert(element.mGroup);
+        }
+
+        std::map<std::string, std::set<std::string>> patterns;
+        for (const auto& [path, element] : elements) {
+            const std::string declaration = declarationPattern(path, element.mCollection);
+            if (declarationGroups.at(declaration).size() == 1) {
+                patterns[element.mGroup].insert(declaration);
+            } else {
+                // instances spread over agent groups, select them one by one
+                patterns[element.mGroup].insert(escapeRegex(path) + (element.mCollection ? "/.*" : ""));
+            }
+        }
+
+        std::map<std::string, std::string> paths;
+        for (const auto& [group, groupPatterns] : patterns) {
+            std::string path;
+            for (const auto& p : groupPatterns) {
+                path += (path.empty() ? "" : "|") + p;
+            }
+            paths.emplace(group, "^(" + path + ")$");
+        }
+        return paths;
+    }
+
+    /// @brief Pattern matching all runtime instances of the declaration of a runtime collection or task path
+    /// The runtime index is appended to the last path element, e.g. main/group1/collection1_4 -> main/group1/collection1_[0-9]+
+    static std::string declarationPattern(const std::string& runtimePath, bool collection)
+    {
+        const std::string suffix = collection ? "/.*" : "";
+        const auto pos = runtimePath.rfind('_');
+        if (pos == std::string::npos || pos + 1 == runtimePath.size() || runtimePath.find('/', pos) != std::string::npos
+            || runtimePath.find_first_not_of("0123456789", pos + 1) != std::string::npos) {
+            return escapeRegex(runtimePath) + suffix;
+        }
+        return escapeRegex(runtimePath.substr(0, pos)) + "_[0-9]+" + suffix;
+    }
+
+    static std::string escapeRegex(const std::string& str)
+    {
+        static const std::string special{ R"(\^$.|?*+()[]{})" };
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (const char c : str) {
+            if (special.find(c) != std::string::npos) {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
 
     void debug()
     {
@@ -99,24 +392,38 @@ struct Session
         }
     }
 
-    std::unique_ptr<dds::topology_api::CTopology> mDDSTopo = nullptr; ///< DDS topology
+    std::shared_ptr<dds::topology_api::CTopology> mDDSTopo = nullptr; ///< DDS topology
     dds::tools_api::CSession mDDSSession; ///< DDS session
     std::string mPartitionID; ///< External partition ID of this DDS session
     std::string mTopoFilePath;
+    std::shared_ptr<dds::topology_api::CTopology> mParsedDDSTopo = nullptr; ///< Topology parsed for the current request, not yet active
+    std::string mParsedTopoFilePath; ///< File path mParsedDDSTopo was parsed from
+    std::string mTopoHash; ///< Content hash of the topology, if it went through the topology cache
+    std::shared_ptr<const TopologyCacheEntry> mTopoCacheEntry = nullptr; ///< Parsed topology & requirements of the current topology in the topology cache
+    std::shared_ptr<TopologyCachePin> mTopoCachePin = nullptr; ///< Keeps the cached topology file the session runs from, and its entry, from being evicted
+    std::mutex mTopoKeyMtx; ///< Guards the lazily computed mTopoKey and mTopoKeyFilePath
+    std::string mTopoKey; ///< Content hash of the topology file, see topologyKey()
+    std::string mTopoKeyFilePath; ///< File path mTopoKey was computed from
     std::map<std::string, CollectionNInfo> mNinfo; ///< Holds information on minimum number of collections, by collection name
     std::map<std::string, std::vector<ZoneGroup>> mZoneInfo; ///< Zones info zoneName:vector<ZoneGroup>
     std::vector<AgentGroupInfo> mAgentGroupInfo; ///< Agent group info groupName:AgentGroupInfo
     std::unordered_map<DDSAgentId, AgentInfo> mAgentInfo; ///< agent ID : agent info
+    AgentTracker mAgentTracker; ///< Live DDS agents and their slots by agent group
     std::vector<TaskInfo> mStandaloneTasks; ///< Standalone tasks (not belonging to any collection)
     std::map<std::string, CollectionInfo> mCollections; ///< Collection info collectionName:CollectionInfo
     std::unordered_map<DDSCollectionId, CollectionInfo*> mRuntimeCollectionIndex; ///< Collection index by collection ID
     std::unordered_set<DDSTaskId> mExpendableTasks; ///< List of expandable task IDs
     size_t mTotalSlots = 0; ///< total number of DDS slots
+    std::map<std::string, size_t> mGroupSlots; ///< expected number of active DDS slots by agent group name
+    std::map<std::string, uint32_t> mSurplusAgents; ///< number of speculatively submitted agents by agent group name, until released after activation
     bool mRunAttempted = false;
     dds::tools_api::SOnTaskDoneRequest::ptr_t mDDSOnTaskDoneRequest;
     std::atomic<uint64_t> mLastRunNr = 0;
     std::unordered_map<DDSTaskId, TaskDetails> mTaskDetails; ///< Additional information about task
     std::unordered_map<DDSCollectionId, CollectionDetails> mCollectionDetails; ///< Additional information about collection
+    std::unordered_map<std::string, std::unordered_set<DDSAgentId>> mHostAgents; ///< host -> agents running on it
+    std::unordered_map<DDSAgentId, std::unordered_set<DDSTaskId>> mAgentTasks; ///< agent ID -> tasks activated on it
+    std::unordered_map<DDSAgentId, std::unordered_set<DDSCollectionId>> mAgentCollections; ///< agent ID -> runtime collections activated on it
 };
 
 } // namespace odc::core
@@ -0,0 +1,289 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_SESSIONPOOL
+#define ODC_CORE_SESSIONPOOL
+
+#include <odc/Logger.h>
+#include <odc/Params.h>
+
+#include <dds/Tools.h>
+
+#include <boost/uuid/uuid_io.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace odc::core
+{
+
+/**
+ * @class SessionPool
+ * @brief Spare, idle DDS sessions created ahead of time
+ *
+ * Keeps up to a configured number of running DDS sessions without agents or topology.
+ * A partition that needs a new DDS session attaches to a spare one instead of waiting for a commander to start.
+ * Taken sessions are replaced in the background.
+ *
+ * @par Thread Safety
+ * Safe. The change callback is invoked without the internal lock held.
+ */
+class SessionPool
+{
+  public:
+    using ChangeCallback = std::function<void()>;
+
+    SessionPool() = default;
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    ~SessionPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mStop = true;
+        }
+        mCV.notify_all();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+        if (mKeepOnExit) {
+            // spare sessions are recorded in the restore file and picked up again by the next instance
+            return;
+        }
+        for (auto& session : mSessions) {
+            shutdown(*session);
+        }
+    }
+
+    /// @brief Configure the pool and start filling it in the background
+    /// @param size number of spare sessions to keep, 0 disables the pool
+    /// @param onChange called from the background thread whenever the set of spare sessions changed
+    void configure(size_t size, ChangeCallback onChange)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mThread.joinable()) {
+            throw std::runtime_error("DDS session pool is already configured");
+        }
+        mSize = size;
+        mOnChange = std::move(onChange);
+        if (mSize > 0) {
+            OLOG(info) << "Keeping " << mSize << " spare DDS sessions";
+            mThread = std::thread(&SessionPool::run, this);
+        }
+    }
+
+    bool enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mSize > 0;
+    }
+
+    /// @brief Keep spare sessions running when the pool is destroyed, so that a restored instance can reuse them
+    void keepOnExit(bool keep)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mKeepOnExit = keep;
+    }
+
+    /// @brief Take over spare sessions of a previous instance. Sessions that are gone are dropped, sessions exceeding the pool size are shut down.
+    void adopt(const std::vector<std::string>& sessionIDs)
+    {
+        for (const auto& id : sessionIDs) {
+            auto session = std::make_unique<dds::tools_api::CSession>();
+            try {
+                session->attach(id);
+                session->setStopOnDestroy(false);
+                if (!session->IsRunning()) {
+                    OLOG(info) << "Spare DDS session " << id << " is not running anymore";
+                    continue;
+                }
+            } catch (const std::exception& e) {
+                OLOG(warning) << "Failed to attach to spare DDS session " << id << ": " << e.what();
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                if (mSessions.size() < mSize) {
+                    OLOG(info) << "Reusing spare DDS session " << id;
+                    mSessions.push_back(std::move(session));
+                    continue;
+                }
+            }
+            shutdown(*session);
+        }
+        mCV.notify_all();
+    }
+
+    /// @brief Take a spare session. Spare sessions are checked to answer requests before one is handed out, broken ones are shut down.
+    /// @return ID of a running DDS session, empty if none is available
+    std::string take()
+    {
+        while (true) {
+            std::unique_ptr<dds::tools_api::CSession> session;
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                if (mSize == 0) {
+                    return "";
+                }
+                if (mSessions.empty()) {
+                    ++mStats.mMisses;
+                    break;
+                }
+                session = std::move(mSessions.front());
+                mSessions.pop_front();
+            }
+            mCV.notify_all();
+
+            const std::string id = boost::uuids::to_string(session->getSessionID());
+            if (!healthy(*session)) {
+                OLOG(warning) << "Dropping spare DDS session " << id << ", it does not respond";
+                shutdown(*session);
+                continue;
+            }
+            // the caller attaches on its own, the pool only drops its handle, which must leave the session running
+            session.reset();
+            dds::tools_api::CSession check;
+            try {
+                check.attach(id);
+            } catch (const std::exception& e) {
+                OLOG(error) << "Spare DDS session " << id << " is gone after its handle was dropped: " << e.what();
+                continue;
+            }
+            if (!check.IsRunning()) {
+                OLOG(error) << "Spare DDS session " << id << " stopped when its handle was dropped";
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mMtx);
+            ++mStats.mHits;
+            return id;
+        }
+        return "";
+    }
+
+    /// @brief IDs of the spare sessions, for the restore file
+    std::vector<std::string> sessionIDs() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        std::vector<std::string> ids;
+        for (const auto& session : mSessions) {
+            ids.push_back(boost::uuids::to_string(session->getSessionID()));
+        }
+        return ids;
+    }
+
+    SessionPoolStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        SessionPoolStats stats = mStats;
+        stats.mSize = mSize;
+        stats.mNumReady = mSessions.size();
+        return stats;
+    }
+
+  private:
+    mutable std::mutex mMtx;
+    std::condition_variable mCV;
+    std::deque<std::unique_ptr<dds::tools_api::CSession>> mSessions; ///< spare sessions, oldest first
+    std::thread mThread;
+    ChangeCallback mOnChange;
+    size_t mSize = 0;
+    bool mStop = false;
+    bool mKeepOnExit = false;
+    std::chrono::seconds mRetryInterval{ 10 };
+    std::chrono::seconds mHealthTimeout{ 5 };
+    SessionPoolStats mStats;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        while (!mStop) {
+            if (mSessions.size() >= mSize) {
+                mCV.wait(lock, [&] { return mStop || mSessions.size() < mSize; });
+                continue;
+            }
+
+            lock.unlock();
+            const auto start = std::chrono::steady_clock::now();
+            auto session = std::make_unique<dds::tools_api::CSession>();
+            bool created = false;
+            try {
+                const auto sid = session->create();
+                // spare sessions outlive their handle: the pool drops it when the session is taken
+                session->setStopOnDestroy(false);
+                created = true;
+                OLOG(info) << "Created spare DDS session " << sid;
+            } catch (const std::exception& e) {
+                OLOG(error) << "Failed to create a spare DDS session: " << e.what() << ". Retrying in " << mRetryInterval.count() << "s";
+            }
+            const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            lock.lock();
+
+            if (!created) {
+                ++mStats.mNumFailed;
+                mCV.wait_for(lock, mRetryInterval, [&] { return mStop; });
+                continue;
+            }
+            ++mStats.mNumCreated;
+            mStats.mCreateTime += duration;
+            if (mSessions.size() >= mSize) {
+                // filled by adopted sessions in the meantime
+                lock.unlock();
+                shutdown(*session);
+                lock.lock();
+                continue;
+            }
+            mSessions.push_back(std::move(session));
+
+            if (mOnChange) {
+                lock.unlock();
+                mOnChange();
+                lock.lock();
+            }
+        }
+    }
+
+    /// @brief Check that the commander of a session is running and answers a request
+    bool healthy(dds::tools_api::CSession& session) const
+    {
+        try {
+            if (!session.IsRunning()) {
+                return false;
+            }
+            dds::tools_api::SAgentCountRequest::response_t res;
+            session.syncSendRequest<dds::tools_api::SAgentCountRequest>(dds::tools_api::SAgentCountRequest::request_t(), res, mHealthTimeout);
+            return true;
+        } catch (const std::exception& e) {
+            OLOG(debug) << "Health check of spare DDS session failed: " << e.what();
+            return false;
+        }
+    }
+
+    static void shutdown(dds::tools_api::CSession& session)
+    {
+        try {
+            if (session.IsRunning()) {
+                OLOG(info) << "Shutting down spare DDS session " << session.getSessionID();
+                session.shutdown();
+            }
+        } catch (const std::exception& e) {
+            OLOG(error) << "Failed to shut down spare DDS session: " << e.what();
+        }
+    }
+};
+
+} // namespace odc::core
+
+#endif /* ODC_CORE_SESSIONPOOL */
@@ -0,0 +1,297 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_SNAPSHOT
+#define ODC_CORE_SNAPSHOT
+
+#include <odc/AppendFile.h>
+#include <odc/Logger.h>
+#include <odc/TopologyDefs.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility> // std::pair
+#include <vector>
+
+namespace odc::core {
+
+/// Task, collection and agent details of a partition, as known after activation
+struct SnapshotDetails
+{
+    std::vector<TaskDetails> mTasks;
+    std::vector<CollectionDetails> mCollections;
+    std::vector<std::pair<DDSAgentId, AgentInfo>> mAgents;
+};
+
+/**
+ * @brief State of a partition persisted across controller restarts.
+ *
+ * Encoded in a compact binary format in host byte order, it is only meant to be read back on the same host.
+ */
+struct PartitionSnapshot
+{
+    std::string mPartitionID;
+    std::string mDDSSessionID;
+    std::string mTopoFilePath; ///< active topology the states belong to
+    uint64_t mRunNr = 0;
+    TopoState mStates;
+    SnapshotDetails mDetails;
+
+    std::string Encode() const
+    {
+        Writer w;
+        w.Raw(kMagic, sizeof(kMagic));
+        w.Put(kVersion);
+        w.Put(mPartitionID);
+        w.Put(mDDSSessionID);
+        w.Put(mTopoFilePath);
+        w.Put(mRunNr);
+        w.Put<uint64_t>(mStates.size());
+        for (const auto& s : mStates) {
+            w.Put<uint64_t>(s.taskId);
+            w.Put<uint64_t>(s.collectionId);
+            w.Put<uint8_t>((s.ignored ? 1 : 0) | (s.expendable ? 2 : 0));
+            w.Put<int32_t>(static_cast<int32_t>(s.lastState));
+            w.Put<int32_t>(static_cast<int32_t>(s.state));
+            w.Put<int32_t>(s.exitCode);
+            w.Put<int32_t>(s.signal);
+            w.Put<uint32_t>(s.restarts);
+        }
+        w.Put<uint64_t>(mDetails.mTasks.size());
+        for (const auto& t : mDetails.mTasks) {
+            w.Put(t.mAgentID);
+            w.Put(t.mSlotID);
+            w.Put(t.mTaskID);
+            w.Put(t.mCollectionID);
+            w.Put(t.mPath);
+            w.Put(t.mHost);
+            w.Put(t.mWrkDir);
+            w.Put(t.mRMSJobID);
+        }
+        w.Put<uint64_t>(mDetails.mCollections.size());
+        for (const auto& c : mDetails.mCollections) {
+            w.Put(c.mAgentID);
+            w.Put(c.mCollectionID);
+            w.Put(c.mPath);
+            w.Put(c.mHost);
+            w.Put(c.mWrkDir);
+            w.Put(c.mRMSJobID);
+        }
+        w.Put<uint64_t>(mDetails.mAgents.size());
+        for (const auto& [agentID, info] : mDetails.mAgents) {
+            w.Put<uint64_t>(agentID);
+            w.Put(info.numSlots);
+            w.Put(info.agentGroupInfoIndex);
+        }
+        return std::move(w.mData);
+    }
+
+    /// @throws std::runtime_error if the data is not a complete snapshot of this version
+    static PartitionSnapshot Decode(const std::string& data)
+    {
+        Reader r(data);
+        if (data.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0) {
+            throw std::runtime_error("not a partition snapshot");
+        }
+        r.Skip(sizeof(kMagic));
+        if (r.Get<uint32_t>() != kVersion) {
+            throw std::runtime_error("unsupported partition snapshot version");
+        }
+
+        PartitionSnapshot s;
+        s.mPartitionID = r.GetString();
+        s.mDDSSessionID = r.GetString();
+        s.mTopoFilePath = r.GetString();
+        s.mRunNr = r.Get<uint64_t>();
+        for (uint64_t n = r.GetCount(); n > 0; --n) {
+            DeviceStatus ds;
+            ds.taskId = r.Get<uint64_t>();
+            ds.collectionId = r.Get<uint64_t>();
+            const auto flags = r.Get<uint8_t>();
+            ds.ignored = (flags & 1) != 0;
+            ds.expendable = (flags & 2) != 0;
+            ds.lastState = static_cast<DeviceState>(r.Get<int32_t>());
+            ds.state = static_cast<DeviceState>(r.Get<int32_t>());
+            ds.exitCode = r.Get<int32_t>();
+            ds.signal = r.Get<int32_t>();
+            ds.restarts = r.Get<uint32_t>();
+            s.mStates.push_back(ds);
+        }
+        for (uint64_t n = r.GetCount(); n > 0; --n) {
+            TaskDetails t;
+            t.mAgentID = r.Get<uint64_t>();
+            t.mSlotID = r.Get<uint64_t>();
+            t.mTaskID = r.Get<uint64_t>();
+            t.mCollectionID = r.Get<uint64_t>();
+            t.mPath = r.GetString();
+            t.mHost = r.GetString();
+            t.mWrkDir = r.GetString();
+            t.mRMSJobID = r.GetString();
+            s.mDetails.mTasks.push_back(std::move(t));
+        }
+        for (uint64_t n = r.GetCount(); n > 0; --n) {
+            CollectionDetails c;
+            c.mAgentID = r.Get<uint64_t>();
+            c.mCollectionID = r.Get<uint64_t>();
+            c.mPath = r.GetString();
+            c.mHost = r.GetString();
+            c.mWrkDir = r.GetString();
+            c.mRMSJobID = r.GetString();
+            s.mDetails.mCollections.push_back(std::move(c));
+        }
+        for (uint64_t n = r.GetCount(); n > 0; --n) {
+            const auto agentID = r.Get<uint64_t>();
+            AgentInfo info;
+            info.numSlots = r.Get<uint32_t>();
+            info.agentGroupInfoIndex = r.Get<uint16_t>();
+            s.mDetails.mAgents.emplace_back(agentID, info);
+        }
+        if (!r.AtEnd()) {
+            throw std::runtime_error("trailing data in partition snapshot");
+        }
+        return s;
+    }
+
+  private:
+    static constexpr char kMagic[8] = { 'O', 'D', 'C', 'S', 'N', 'A', 'P', '\0' };
+    static constexpr uint32_t kVersion = 2;
+
+    struct Writer
+    {
+        void Raw(const void* data, size_t size) { mData.append(static_cast<const char*>(data), size); }
+        template<typename T>
+        void Put(const T& value)
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            Raw(&value, sizeof(T));
+        }
+        void Put(const std::string& value)
+        {
+            Put<uint64_t>(value.size());
+            Raw(value.data(), value.size());
+        }
+        std::string mData;
+    };
+
+    struct Reader
+    {
+        explicit Reader(const std::string& data)
+            : mData(data)
+        {}
+        void Skip(size_t size)
+        {
+            if (mData.size() - mPos < size) {
+                throw std::runtime_error("truncated partition snapshot");
+            }
+            mPos += size;
+        }
+        template<typename T>
+        T Get()
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            T value;
+            const size_t pos = mPos;
+            Skip(sizeof(T));
+            std::memcpy(&value, mData.data() + pos, sizeof(T));
+            return value;
+        }
+        std::string GetString()
+        {
+            const auto size = Get<uint64_t>();
+            const size_t pos = mPos;
+            Skip(size);
+            return mData.substr(pos, size);
+        }
+        /// number of following entries, each taking at least one byte
+        uint64_t GetCount()
+        {
+            const auto n = Get<uint64_t>();
+            if (n > mData.size() - mPos) {
+                throw std::runtime_error("corrupt partition snapshot");
+            }
+            return n;
+        }
+        bool AtEnd() const { return mPos == mData.size(); }
+
+        const std::string& mData;
+        size_t mPos = 0;
+    };
+};
+
+/// File holding the snapshot of one partition in the restore directory, replaced atomically on each write
+class SnapshotFile
+{
+  public:
+    SnapshotFile(const std::string& restoreId, const std::string& partitionId, const std::string& dir)
+        : mPath(std::filesystem::path(dir.empty() ? smart_path(toString("$HOME/.ODC/restore/")) : dir) / toString("odc_", restoreId, "_", partitionId, ".snapshot"))
+    {}
+
+    /// @brief Replace the snapshot atomically: the data is written to a temporary file, synced to disk and renamed over the previous one
+    /// @return true if the snapshot was written
+    bool write(const std::string& encoded)
+    {
+        const std::filesystem::path tmpPath(mPath.string() + ".tmp");
+        try {
+            std::filesystem::create_directories(mPath.parent_path());
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                file.write(encoded.data(), encoded.size());
+                file.flush();
+                if (!file) {
+                    throw std::runtime_error("write failed");
+                }
+            }
+            SyncPath(tmpPath);
+            std::filesystem::rename(tmpPath, mPath);
+            SyncPath(mPath.parent_path());
+            return true;
+        } catch (const std::exception& e) {
+            OLOG(error) << "Failed to write partition snapshot " << std::quoted(mPath.string()) << ": " << e.what();
+            std::error_code ec;
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+
+    /// @return snapshot, none if there is no valid one
+    std::optional<PartitionSnapshot> read() const
+    {
+        try {
+            if (!std::filesystem::exists(mPath)) {
+                return std::nullopt;
+            }
+            std::ifstream file(mPath, std::ios::binary);
+            const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            return PartitionSnapshot::Decode(data);
+        } catch (const std::exception& e) {
+            OLOG(warning) << "Ignoring partition snapshot " << std::quoted(mPath.string()) << ": " << e.what();
+            return std::nullopt;
+        }
+    }
+
+    void remove() const
+    {
+        std::error_code ec;
+        std::filesystem::remove(mPath, ec);
+    }
+
+  private:
+    std::filesystem::path mPath;
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_SNAPSHOT
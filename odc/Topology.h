@@ -23,7 +23,7 @@
 
 #include <boost/asio/associated_executor.hpp>
 #include <boost/asio/async_result.hpp>
-#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
 #include <boost/asio/system_executor.hpp>
 
 #include <dds/Tools.h>
@@ -32,11 +32,14 @@
 #include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <sstream>
@@ -44,6 +47,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace odc::core
 {
@@ -52,13 +56,14 @@ namespace odc::core
  * @class BasicTopology
  * @tparam Executor Associated I/O executor
  * @tparam Allocator Associated default allocator
+ * @tparam Clock Clock used for operation timeouts and heartbeats (see VirtualClock for tests)
  * @brief Represents a FairMQ topology
  *
  * @par Thread Safety
  * @e Distinct @e objects: Safe.@n
  * @e Shared @e objects: Safe.
  */
-template<typename Executor, typename Allocator>
+template<typename Executor, typename Allocator, typename Clock = std::chrono::steady_clock>
 class BasicTopology : public AsioBase<Executor, Allocator>
 {
   public:
@@ -67,7 +72,7 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     /// @param session ODC Session
     /// @param blockUntilConnected if true, ctor will wait for all tasks to confirm subscriptions
     BasicTopology(dds::topology_api::CTopology& topo, Session& session, bool blockUntilConnected = false)
-        : BasicTopology<Executor, Allocator>(boost::asio::system_executor(), topo, session, blockUntilConnected)
+        : BasicTopology<Executor, Allocator, Clock>(boost::asio::system_executor(), topo, session, blockUntilConnected)
     {}
 
     /// @brief (Re)Construct a FairMQ topology from an existing DDS topology
@@ -84,19 +89,20 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         : AsioBase<Executor, Allocator>(ex, std::move(alloc))
         , mSession(session)
         , mDDSCustomCmd(mDDSService)
-        , mDDSTopo(topo)
+        , mDDSTopo(&topo)
         , mMtx(std::make_unique<std::mutex>())
         , mStateChangeSubscriptionsCV(std::make_unique<std::condition_variable>())
         , mNumStateChangePublishers(0)
         , mHeartbeatsTimer(boost::asio::system_executor())
         , mHeartbeatInterval(600000)
-        , mPartitionID(mSession.mPartitionID)
+        , mSnapshotTimer(boost::asio::system_executor())
+        , mPartitionID(std::make_shared<const std::string>(mSession.mPartitionID))
     {
         // TODO: resources should be extracted from the topology file here, not in the Controller
 
         // prepare topology state
         dds::topology_api::STopoRuntimeTask::FilterIteratorPair_t itPair;
-        itPair = mDDSTopo.getRuntimeTaskIterator(nullptr);
+        itPair = mDDSTopo->getRuntimeTaskIterator(nullptr);
         auto tasks = boost::make_iterator_range(itPair.first, itPair.second);
         mStateData.reserve(boost::size(tasks));
         int index = 0;
@@ -108,6 +114,8 @@ class BasicTopology : public AsioBase<Executor, Allocator>
 
         SubscribeToCommands();
         SubscribeToTaskDoneEvents();
+        // tasks of agents that disappear from the agent table are failed at once, not one by one as DDS reports them
+        mSession.mAgentTracker.setDownHandler([this](const AgentTracker::Agent& agent) { HandleAgentLost(agent.mID); });
 
         mDDSService.start(to_string(mSession.mDDSSession.getSessionID()));
         SubscribeToStateChanges();
@@ -126,6 +134,8 @@ class BasicTopology : public AsioBase<Executor, Allocator>
 
     ~BasicTopology()
     {
+        mSession.mAgentTracker.setDownHandler(nullptr);
+        mSnapshotTimer.cancel();
         UnsubscribeFromStateChanges();
 
         mDDSCustomCmd.unsubscribe();
@@ -146,23 +156,23 @@ class BasicTopology : public AsioBase<Executor, Allocator>
 
         dds::topology_api::STopoRuntimeTask::FilterIteratorPair_t itPair;
         if (path.empty()) {
-            itPair = mDDSTopo.getRuntimeTaskIterator(nullptr); // passing nullptr will get all tasks
+            itPair = mDDSTopo->getRuntimeTaskIterator(nullptr); // passing nullptr will get all tasks
         } else {
-            itPair = mDDSTopo.getRuntimeTaskIteratorMatchingPath(path);
+            itPair = mDDSTopo->getRuntimeTaskIteratorMatchingPath(path);
         }
         auto tasks = boost::make_iterator_range(itPair.first, itPair.second);
 
         set.reserve(boost::size(tasks));
 
-        // OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "GetTasks(): Num of tasks: " << boost::size(tasks);
+        // OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "GetTasks(): Num of tasks: " << boost::size(tasks);
         for (const auto& task : tasks) {
-            // OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "GetTasks(): Found task with id: " << task.first << ", "
+            // OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "GetTasks(): Found task with id: " << task.first << ", "
             //            << "Path: " << task.second.m_taskPath << ", "
             //            << "Collection id: " << task.second.m_taskCollectionId << ", "
             //            << "Name: " << task.second.m_task->getName() << "_" << task.second.m_taskIndex;
             const DeviceStatus& ds = mStateData.at(mStateIndex.at(task.first));
             if (ds.ignored) {
-                // OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "GetTasks(): Task " << ds.taskId << " has failed and is set to be ignored, skipping";
+                // OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "GetTasks(): Task " << ds.taskId << " has failed and is set to be ignored, skipping";
                 continue;
             }
             set.emplace(task.first);
@@ -171,6 +181,76 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         return set;
     }
 
+    /// @brief Number of devices selected by a path, failed expendable devices excluded
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    size_t GetNumTasks(const std::string& path) const
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        return GetTasks(path).size();
+    }
+
+    /// @brief Switch to an updated DDS topology, keeping state and subscriptions of the tasks present in both
+    /// Tasks missing in the updated topology are dropped, new tasks are appended to the state table and subscribed to state changes.
+    /// @param topo updated DDS topology, replaces the one given at construction and has to outlive this object
+    /// @param addedPath path matching the new tasks
+    /// @return number of new tasks
+    /// @throws std::runtime_error if operations are pending
+    size_t UpdateTopology(dds::topology_api::CTopology& topo, const std::string& addedPath)
+    {
+        size_t numAdded = 0;
+        {
+            std::lock_guard<std::mutex> lk(*mMtx);
+            // pending operations refer to positions in the state table
+            auto pending = [](auto& ops) { return std::any_of(ops.begin(), ops.end(), [](auto& op) { return !op.second.IsCompleted(); }); };
+            if (pending(mChangeStateOps) || pending(mWaitForStateOps) || pending(mSetPropertiesOps) || pending(mGetPropertiesOps)) {
+                throw std::runtime_error("Topology cannot be updated while operations are pending");
+            }
+            mChangeStateOps.clear();
+            mWaitForStateOps.clear();
+            mSetPropertiesOps.clear();
+            mGetPropertiesOps.clear();
+            mPipelines.clear();
+            mRollouts.clear();
+
+            dds::topology_api::STopoRuntimeTask::FilterIteratorPair_t itPair = topo.getRuntimeTaskIterator(nullptr);
+            auto tasks = boost::make_iterator_range(itPair.first, itPair.second);
+            std::unordered_set<DDSTaskId> taskIds;
+            taskIds.reserve(boost::size(tasks));
+            for (const auto& task : tasks) {
+                taskIds.insert(task.first);
+            }
+
+            TopoState stateData;
+            TopoStateIndex stateIndex;
+            stateData.reserve(taskIds.size());
+            for (auto& device : mStateData) {
+                if (taskIds.count(device.taskId) > 0) {
+                    device.expendable = mSession.mExpendableTasks.count(device.taskId) > 0;
+                    stateIndex.emplace(device.taskId, stateData.size());
+                    stateData.push_back(device);
+                } else if (device.subscribedToStateChanges) {
+                    --mNumStateChangePublishers;
+                }
+            }
+            for (const auto& [id, task] : tasks) {
+                if (stateIndex.count(id) == 0) {
+                    bool expendable = mSession.mExpendableTasks.find(id) != mSession.mExpendableTasks.end();
+                    stateIndex.emplace(id, stateData.size());
+                    stateData.push_back(DeviceStatus(expendable, id, task.m_taskCollectionId));
+                    ++numAdded;
+                }
+            }
+            mStateData = std::move(stateData);
+            mStateIndex = std::move(stateIndex);
+            mDDSTopo = &topo;
+        }
+
+        if (numAdded > 0) {
+            mDDSCustomCmd.send(cc::Cmds(cc::make<cc::SubscribeToStateChange>(mHeartbeatInterval.count())).Serialize(), addedPath);
+        }
+        return numAdded;
+    }
+
     void SubscribeToStateChanges()
     {
         // FAIR_LOG(debug) << "Subscribing to state change";
@@ -192,7 +272,14 @@ class BasicTopology : public AsioBase<Executor, Allocator>
 
             {
                 std::unique_lock<std::mutex> lk(*mMtx);
-                DeviceStatus& device = mStateData.at(mStateIndex.at(task.m_taskID));
+                auto it = mStateIndex.find(task.m_taskID);
+                if (it == mStateIndex.end()) {
+                    // removed from the topology by an update
+                    OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Task " << task.m_taskID << " exited after it was removed from the topology";
+                    return;
+                }
+                DeviceStatus& device = mStateData.at(it->second);
+                mSnapshotTasks.erase(device.taskId);
                 if (device.subscribedToStateChanges) {
                     device.subscribedToStateChanges = false;
                     --mNumStateChangePublishers;
@@ -208,6 +295,9 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                 if ((device.lastState != DeviceState::Idle && device.lastState != DeviceState::Exiting) || device.exitCode > 0) {
                     unexpected = true;
                     device.state = DeviceState::Error;
+                    if (mTaskExitHandler) {
+                        mTaskExitHandler(device.taskId);
+                    }
                     // check if the device is expendable
                     expendable = IgnoreExpendable(device);
                     // Update SetProperties OPs only if unexpected exit
@@ -225,6 +315,9 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                 for (auto& op : mWaitForStateOps) {
                     op.second.Update(device.taskId, device.lastState, device.state, expendable);
                 }
+                // an exited device does not report further state changes
+                AdvancePipeline(device.taskId, device.state);
+                AdvanceRollouts(device.taskId, device.state);
             }
 
             std::stringstream ss;
@@ -236,14 +329,30 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                << "; host: "              << task.m_host
                << "; working directory: " << quoted(task.m_wrkDir);
             if (unexpected) {
-                OLOG(error, mPartitionID, mSession.mLastRunNr.load()) << ss.str();
+                OLOG(error, PartitionID(), mSession.mLastRunNr.load()) << ss.str();
             } else {
-                OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << ss.str();
+                OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << ss.str();
             }
         });
         mSession.mDDSSession.sendRequest<SOnTaskDoneRequest>(mDDSOnTaskDoneRequest);
     }
 
+    // precondition: mMtx is locked
+    /// @brief Take back a crashed expendable task that was started again on its agent
+    void TakeBackRestarted(DeviceStatus& device)
+    {
+        mRestartProbes.erase(device.taskId);
+        device.ignored = false;
+        device.exitCode = -1;
+        device.signal = -1;
+        ++device.restarts;
+        mRestartedTasks.insert(device.taskId);
+        OLOG(info, PartitionID(), mSession.mLastRunNr.load()) << "Expendable task " << device.taskId << " reported back in " << device.state << " state after a restart (restarts: " << device.restarts << ")";
+        if (mTaskRestartHandler) {
+            mTaskRestartHandler(device.taskId);
+        }
+    }
+
     // precondition: mMtx is locked
     void CheckExpendable(FailedDevices failed)
     {
@@ -257,20 +366,25 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     bool IgnoreExpendable(odc::core::DeviceStatus& device)
     {
         if (device.ignored) {
-            OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "Failed Device " << device.taskId << " is already ignored.";
+            OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Failed Device " << device.taskId << " is already ignored.";
             // TODO: check if and when this can happen
             return true;
         }
 
         if (device.expendable) {
-            OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "Failed Device " << device.taskId << " is expendable. ignoring.";
+            OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Failed Device " << device.taskId << " is expendable. ignoring.";
             IgnoreDevice(device);
+            if (mTaskRestartHandler) {
+                mRestartProbes.erase(device.taskId);
+                mCrashedTasks.insert(device.taskId);
+                mTaskRestartHandler(device.taskId);
+            }
             return true;
         }
 
         // if task is not expendable, but is in a collection, check nMin condition
         if (device.collectionId != 0) {
-            auto runtimeCollection = mDDSTopo.getRuntimeCollectionById(device.collectionId);
+            auto runtimeCollection = mDDSTopo->getRuntimeCollectionById(device.collectionId);
             auto col = runtimeCollection.m_collection;
             auto it = mSession.mCollections.find(col->getName());
             if (it != mSession.mCollections.end()) {
@@ -283,10 +397,18 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                 // check nMin condition
                 if (CheckNmin(colInfo.nCurrent, colInfo.nMin, runtimeCollection.m_collectionPath, col->getPath(), device.collectionId)) {
                     IgnoreCollectionDevices(device.collectionId);
+                    if (mIgnoredCollections.insert(device.collectionId).second && mCollectionIgnoredHandler) {
+                        mCollectionIgnoredHandler(device.collectionId);
+                    }
 
-                    // TODO: shutdown agent only if it has no tasks left
                     uint64_t agentId = colInfo.mRuntimeCollectionAgents.at(device.collectionId);
-                    ShutdownDDSAgent(agentId);
+                    if (mLostAgents.count(agentId) > 0) {
+                        OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Agent " << agentId << " is already lost, not sending shutdown signal";
+                    } else if (AgentHasActiveTasks(agentId)) {
+                        OLOG(info, PartitionID(), mSession.mLastRunNr.load()) << "Agent " << agentId << " still runs active tasks, not sending shutdown signal";
+                    } else {
+                        ShutdownDDSAgent(agentId);
+                    }
 
                     return true;
                 }
@@ -301,13 +423,13 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     {
         if (nMin == -1) {
             // no nMin defined, failure cannot be ignored
-            OLOG(error, mPartitionID, mSession.mLastRunNr.load())
+            OLOG(error, PartitionID(), mSession.mLastRunNr.load())
                 << "Collection '" << runtimeColPath << "' (id: " << colId << ")"
                 << " has no nMin defined. Cannot be ignored.";
             return false;
         } else if (nCurrent < nMin) {
             // if nMin is not satisfied, the failure cannot be ignored
-            OLOG(error, mPartitionID, mSession.mLastRunNr.load())
+            OLOG(error, PartitionID(), mSession.mLastRunNr.load())
                 << "Collection '" << runtimeColPath << "' (id: " << colId << ")"
                 << " has failed and current number of '" << colPath << "' collections (" << nCurrent
                 << ") is less than nMin (" << nMin << "). Cannot be ignored.";
@@ -315,7 +437,7 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         } else {
             // if nMin is satisfied, ignore the entire collection & shutdown the responsible agent
             auto& colDetails = mSession.getCollectionDetails(colId);
-            OLOG(info, mPartitionID, mSession.mLastRunNr.load())
+            OLOG(info, PartitionID(), mSession.mLastRunNr.load())
                 << "Ignoring failed collection '" << runtimeColPath << "' (id: " << colId << ")"
                 << " as the remaining number of '" << colPath << "' collections (" << nCurrent
                 << ") is greater than or equal to nMin (" << nMin << ")."
@@ -327,7 +449,7 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     // precondition: mMtx is locked.
     void IgnoreDevice(DeviceStatus& device)
     {
-        // OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "Ignoring device " << device.taskId << " from collection " << device.collectionId;
+        // OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Ignoring device " << device.taskId << " from collection " << device.collectionId;
         if (device.subscribedToStateChanges) {
             device.subscribedToStateChanges = false;
             --mNumStateChangePublishers;
@@ -341,6 +463,42 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         IgnoreTaskForAllOps(device.taskId);
     }
 
+    // precondition: mMtx is locked.
+    bool AgentHasActiveTasks(DDSAgentId agentID) const
+    {
+        for (const auto taskID : mSession.getAgentTasks(agentID)) {
+            auto it = mStateIndex.find(taskID);
+            if (it != mStateIndex.end() && !mStateData.at(it->second).ignored) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // precondition: mMtx is locked.
+    /// @brief Set device to Error after an unexpected exit and propagate the failure to all pending operations
+    /// @return true if the failure can be ignored (expendable device or nMin still satisfied)
+    bool FailDevice(DeviceStatus& device)
+    {
+        if (device.subscribedToStateChanges) {
+            device.subscribedToStateChanges = false;
+            --mNumStateChangePublishers;
+        }
+        device.lastState = device.state;
+        device.state = DeviceState::Error;
+        bool expendable = IgnoreExpendable(device);
+        for (auto& op : mSetPropertiesOps) {
+            op.second.Update(device.taskId, cc::Result::Failure, expendable);
+        }
+        for (auto& op : mChangeStateOps) {
+            op.second.Update(device.taskId, device.state, expendable);
+        }
+        for (auto& op : mWaitForStateOps) {
+            op.second.Update(device.taskId, device.lastState, device.state, expendable);
+        }
+        return expendable;
+    }
+
     // precondition: mMtx is locked.
     void IgnoreCollectionDevices(odc::core::DDSCollectionId id)
     {
@@ -351,8 +509,11 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         }
     }
 
+    // precondition: mMtx is locked.
     void IgnoreTaskForAllOps(odc::core::DDSTaskId id)
     {
+        // ignored devices get no further transitions
+        mPipelines.erase(id);
         for (auto& op : mChangeStateOps) {
             op.second.Ignore(id);
         }
@@ -365,6 +526,8 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         for (auto& op : mSetPropertiesOps) {
             op.second.Ignore(id);
         }
+        // frees the rollout slot, ignored devices are not released again
+        AdvanceRollouts(id, DeviceState::Exiting);
     }
 
     void WaitForPublisherCount(unsigned int number)
@@ -396,6 +559,29 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         }
     }
 
+    void ExpireSnapshot(const boost::system::error_code& ec)
+    {
+        if (ec) {
+            return;
+        }
+        std::lock_guard<std::mutex> lk(*mMtx);
+        size_t numExpired = 0;
+        for (const auto& taskId : mSnapshotTasks) {
+            auto it = mStateIndex.find(taskId);
+            if (it == mStateIndex.end()) {
+                continue;
+            }
+            DeviceStatus& ds = mStateData.at(it->second);
+            ds.lastState = DeviceState::Undefined;
+            ds.state = DeviceState::Undefined;
+            ++numExpired;
+        }
+        mSnapshotTasks.clear();
+        if (numExpired > 0) {
+            OLOG(warning, PartitionID(), mSession.mLastRunNr.load()) << numExpired << " devices did not report back since the snapshot was applied, their state is Undefined";
+        }
+    }
+
     void UnsubscribeFromStateChanges()
     {
         // stop sending heartbeats
@@ -435,6 +621,9 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                     case cc::Type::properties_set:
                         HandleCmd(static_cast<cc::PropertiesSet&>(*cmd));
                         break;
+                    case cc::Type::scheduled_transition:
+                        HandleCmd(static_cast<cc::ScheduledTransition&>(*cmd));
+                        break;
                     default:
                         OLOG(warning) << "Unexpected/unknown command received: " << cmd->GetType();
                         OLOG(warning) << "Origin: " << ddsSenderChannelId;
@@ -452,6 +641,8 @@ class BasicTopology : public AsioBase<Executor, Allocator>
             try {
                 std::unique_lock<std::mutex> lk(*mMtx);
                 DeviceStatus& task = mStateData.at(mStateIndex.at(taskId));
+                // a probed task is only taken back by the state it reports along with the subscription, see HandleCmd(cc::StateChange)
+                mSnapshotTasks.erase(taskId);
                 if (!task.subscribedToStateChanges) {
                     task.subscribedToStateChanges = true;
                     ++mNumStateChangePublishers;
@@ -500,16 +691,26 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         try {
             std::lock_guard<std::mutex> lk(*mMtx);
             DeviceStatus& device = mStateData.at(mStateIndex.at(taskId));
+            mSnapshotTasks.erase(taskId);
             DeviceState lastState = device.state;
             device.lastState = cmd.GetLastState();
             device.state = cmd.GetCurrentState();
-            // OLOG(debug, mPartitionID, mSession.mLastRunNr.load()) << "Updated state entry: taskId=" << taskId << ", state=" << device.state;
+            if (device.ignored && mRestartProbes.count(taskId) > 0) {
+                // Any process of the task answers a probe, also the crashed one if it is still alive. Devices only leave Error
+                // towards Exiting, a process in another state is a new one.
+                if (device.state == DeviceState::Error || device.state == DeviceState::Exiting) {
+                    OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Probed expendable task " << taskId << " is still in " << device.state << " state, it was not restarted yet";
+                } else {
+                    TakeBackRestarted(device);
+                }
+            }
+            // OLOG(debug, PartitionID(), mSession.mLastRunNr.load()) << "Updated state entry: taskId=" << taskId << ", state=" << device.state;
 
             bool expendable = false;
             // check if we have an unexpected exit
             if (device.state == DeviceState::Error || (device.state == DeviceState::Exiting && lastState != DeviceState::Idle)) {
                 auto& deviceDetails = mSession.getTaskDetails(device.taskId);
-                OLOG(error, mPartitionID, mSession.mLastRunNr.load()) << "Device " << device.taskId << " unexpectedly reached " << device.state << " state. On host: " << deviceDetails.mHost << ", working directory: " << deviceDetails.mWrkDir;
+                OLOG(error, PartitionID(), mSession.mLastRunNr.load()) << "Device " << device.taskId << " unexpectedly reached " << device.state << " state. On host: " << deviceDetails.mHost << ", working directory: " << deviceDetails.mWrkDir;
                 // check if the device is expendable
                 expendable = IgnoreExpendable(device);
                 // Update SetProperties OPs only if unexpected exit
@@ -524,6 +725,8 @@ class BasicTopology : public AsioBase<Executor, Allocator>
             for (auto& op : mWaitForStateOps) {
                 op.second.Update(taskId, cmd.GetLastState(), cmd.GetCurrentState(), expendable);
             }
+            AdvancePipeline(taskId, device.state);
+            AdvanceRollouts(taskId, device.state);
         } catch (const std::exception& e) {
             OLOG(error) << "Exception in HandleCmd(cmd::StateChange const&): " << e.what();
             OLOG(error) << "Possibly no task with id '" << taskId << "'?";
@@ -546,9 +749,28 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                     }
                 }
             }
+            // a device already in the target state does not report a state change, free its rollout slot now
+            AdvanceRollouts(taskId, mStateData.at(mStateIndex.at(taskId)).state);
         }
     }
 
+    void HandleCmd(cc::ScheduledTransition const& cmd)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        auto it = mSkews.find(cmd.GetRequestId());
+        if (it == mSkews.end()) {
+            OLOG(debug) << "Scheduled transition (request id: " << cmd.GetRequestId() << ") not found (probably completed or timed out), "
+                        << "discarding reply of device " << cmd.GetDeviceId() << ", task id: " << cmd.GetTaskId();
+            return;
+        }
+        if (cmd.GetResult() != cc::Result::Ok) {
+            OLOG(error) << "Scheduled " << cmd.GetTransition() << " transition failed for " << cmd.GetDeviceId();
+            ++it->second.mNumFailed;
+            return;
+        }
+        it->second.Add(std::chrono::nanoseconds(cmd.GetDelay()));
+    }
+
     void HandleCmd(cc::Properties const& cmd)
     {
         try {
@@ -582,9 +804,42 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     /// @throws std::system_error
     template<typename CompletionToken>
     auto AsyncChangeState(const TopoTransition transition, const std::string& path, Duration timeout, CompletionToken&& token)
+    {
+        return AsyncChangeState(transition, path, timeout, RolloutPolicy(), std::forward<CompletionToken>(token));
+    }
+
+    /// @brief Initiate state transition on FairMQ devices in this topology, limiting the devices in transition at the same time
+    /// Without limits the transition is broadcast to all selected devices. With limits it is sent to single devices,
+    /// further devices are released in waves as the ones in transition reach the target state, taking turns among the hosts.
+    /// @param transition FairMQ device state machine transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param policy Limits on the devices in transition at the same time
+    /// @param token Asio completion token
+    /// @tparam CompletionToken Asio completion token type
+    /// @throws std::system_error
+    template<typename CompletionToken>
+    auto AsyncChangeState(const TopoTransition transition, const std::string& path, Duration timeout, const RolloutPolicy& policy, CompletionToken&& token)
+    {
+        return AsyncChangeStateOrdered(transition, {}, path, timeout, policy, std::forward<CompletionToken>(token));
+    }
+
+    /// @brief Initiate state transition on FairMQ devices in this topology, one layer of devices after the other
+    /// The transition is sent to the devices of a layer once all devices of the previous layers reached the target state.
+    /// Selected devices missing in the layers form an additional last layer. Without layers this is AsyncChangeState.
+    /// @param transition FairMQ device state machine transition
+    /// @param layers Devices in the order of the transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param policy Limits on the devices in transition at the same time, within a layer
+    /// @param token Asio completion token
+    /// @tparam CompletionToken Asio completion token type
+    /// @throws std::system_error
+    template<typename CompletionToken>
+    auto AsyncChangeStateOrdered(const TopoTransition transition, const std::vector<std::vector<DDSTaskId>>& layers, const std::string& path, Duration timeout, const RolloutPolicy& policy, CompletionToken&& token)
     {
         return boost::asio::async_initiate<CompletionToken, ChangeStateCompletionSignature>(
-            [&](auto handler) {
+            [&, policy, layers](auto handler) {
                 const uint64_t id = uuidHash();
 
                 std::lock_guard<std::mutex> lk(*mMtx);
@@ -596,10 +851,18 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                         ++it;
                     }
                 }
+                for (auto it = begin(mRollouts); it != end(mRollouts);) {
+                    if (mChangeStateOps.count(it->first) == 0) {
+                        it = mRollouts.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
 
+                const auto tasks = GetTasks(path);
                 auto [it, inserted] = mChangeStateOps.try_emplace(id,
                                                                   transition,
-                                                                  GetTasks(path),
+                                                                  tasks,
                                                                   mStateIndex,
                                                                   mStateData,
                                                                   timeout,
@@ -610,8 +873,34 @@ class BasicTopology : public AsioBase<Executor, Allocator>
                                                                   std::move(handler)
                 );
 
-                cc::Cmds cmds(cc::make<cc::ChangeState>(transition));
-                mDDSCustomCmd.send(cmds.Serialize(), path);
+                if (!layers.empty()) {
+                    Rollout& rollout = mRollouts.try_emplace(id, Rollout{ transition, policy, {}, {}, {}, {} }).first->second;
+                    std::unordered_set<DDSTaskId> remaining(tasks.begin(), tasks.end());
+                    for (const auto& layer : layers) {
+                        std::vector<DDSTaskId> layerTasks;
+                        for (const auto& taskId : layer) {
+                            if (remaining.erase(taskId) > 0) {
+                                layerTasks.push_back(taskId);
+                            }
+                        }
+                        if (!layerTasks.empty()) {
+                            rollout.mLayers.push_back(std::move(layerTasks));
+                        }
+                    }
+                    if (!remaining.empty()) {
+                        rollout.mLayers.emplace_back(remaining.begin(), remaining.end());
+                    }
+                    ReleaseRollout(rollout);
+                } else if (policy.IsLimited()) {
+                    Rollout& rollout = mRollouts.try_emplace(id, Rollout{ transition, policy, {}, {}, {}, {} }).first->second;
+                    for (const auto& taskId : tasks) {
+                        rollout.mPending[GetHost(taskId)].push_back(taskId);
+                    }
+                    ReleaseRollout(rollout);
+                } else {
+                    cc::Cmds cmds(cc::make<cc::ChangeState>(transition));
+                    mDDSCustomCmd.send(cmds.Serialize(), path);
+                }
 
                 // TODO: make sure following operation properly queues the completion and not doing it directly out of initiation call.
                 it->second.TryCompletion();
@@ -625,11 +914,272 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     /// @param timeout Timeout in milliseconds, 0 means no timeout
     /// @throws std::system_error
     std::pair<std::error_code, TopoState> ChangeState(const TopoTransition transition, const std::string& path = "", Duration timeout = Duration(0))
+    {
+        return ChangeState(transition, path, timeout, RolloutPolicy());
+    }
+
+    /// @brief Perform state transition on FairMQ devices in this topology, limiting the devices in transition at the same time
+    /// @param transition FairMQ device state machine transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param policy Limits on the devices in transition at the same time
+    /// @throws std::system_error
+    std::pair<std::error_code, TopoState> ChangeState(const TopoTransition transition, const std::string& path, Duration timeout, const RolloutPolicy& policy)
+    {
+        return ChangeStateOrdered(transition, {}, path, timeout, policy);
+    }
+
+    /// @brief Perform state transition on FairMQ devices in this topology, one layer of devices after the other, see AsyncChangeStateOrdered
+    /// @param transition FairMQ device state machine transition
+    /// @param layers Devices in the order of the transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param policy Limits on the devices in transition at the same time, within a layer
+    /// @throws std::system_error
+    std::pair<std::error_code, TopoState> ChangeStateOrdered(const TopoTransition transition, const std::vector<std::vector<DDSTaskId>>& layers, const std::string& path, Duration timeout, const RolloutPolicy& policy = RolloutPolicy())
+    {
+        SharedSemaphore blocker;
+        std::error_code ec;
+        TopoState state;
+        AsyncChangeStateOrdered(transition, layers, path, timeout, policy, [&, blocker](std::error_code _ec, TopoState _state) mutable {
+            ec = _ec;
+            state = _state;
+            blocker.Signal();
+        });
+        blocker.Wait();
+        return { ec, state };
+    }
+
+    /// @brief Initiate state transition on FairMQ devices in this topology, started by all devices at the same time
+    /// Devices arm a local timer for the given time, which requires synchronized clocks on all hosts.
+    /// Each device reports the delay of its actual start, collected under the given request ID until TakeSkew() is called.
+    /// @param requestId ID to collect the reported delays under
+    /// @param transition FairMQ device state machine transition
+    /// @param time Start time of the transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param token Asio completion token
+    /// @tparam CompletionToken Asio completion token type
+    /// @throws std::system_error
+    template<typename CompletionToken>
+    auto AsyncChangeStateAt(uint64_t requestId, const TopoTransition transition, std::chrono::system_clock::time_point time, const std::string& path, Duration timeout, CompletionToken&& token)
+    {
+        return boost::asio::async_initiate<CompletionToken, ChangeStateCompletionSignature>(
+            [&, requestId, transition, time](auto handler) {
+                std::lock_guard<std::mutex> lk(*mMtx);
+
+                for (auto it = begin(mChangeStateOps); it != end(mChangeStateOps);) {
+                    if (it->second.IsCompleted()) {
+                        it = mChangeStateOps.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                mSkews[requestId] = TransitionSkew();
+                auto [it, inserted] = mChangeStateOps.try_emplace(requestId,
+                                                                  transition,
+                                                                  GetTasks(path),
+                                                                  mStateIndex,
+                                                                  mStateData,
+                                                                  timeout,
+                                                                  *mMtx,
+                                                                  std::bind(&BasicTopology::CheckExpendable, this, std::placeholders::_1),
+                                                                  AsioBase<Executor, Allocator>::GetExecutor(),
+                                                                  AsioBase<Executor, Allocator>::GetAllocator(),
+                                                                  std::move(handler)
+                );
+
+                const int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+                cc::Cmds cmds(cc::make<cc::ChangeStateAt>(requestId, transition, timestamp));
+                mDDSCustomCmd.send(cmds.Serialize(), path);
+
+                it->second.TryCompletion();
+            },
+            token);
+    }
+
+    /// @brief Perform state transition on FairMQ devices in this topology, started by all devices at the same time, see AsyncChangeStateAt
+    /// @param transition FairMQ device state machine transition
+    /// @param time Start time of the transition
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param skew Filled with the delays reported by the devices until completion
+    /// @throws std::system_error
+    std::pair<std::error_code, TopoState> ChangeStateAt(const TopoTransition transition, std::chrono::system_clock::time_point time, const std::string& path, Duration timeout, TransitionSkew& skew)
+    {
+        const uint64_t requestId = uuidHash();
+        SharedSemaphore blocker;
+        std::error_code ec;
+        TopoState state;
+        AsyncChangeStateAt(requestId, transition, time, path, timeout, [&, blocker](std::error_code _ec, TopoState _state) mutable {
+            ec = _ec;
+            state = _state;
+            blocker.Signal();
+        });
+        blocker.Wait();
+        skew = TakeSkew(requestId);
+        return { ec, state };
+    }
+
+    /// @brief Stop collecting the delays reported for a scheduled transition
+    /// @param requestId ID given to AsyncChangeStateAt
+    /// @return delays reported so far
+    TransitionSkew TakeSkew(uint64_t requestId)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        TransitionSkew skew;
+        auto it = mSkews.find(requestId);
+        if (it != mSkews.end()) {
+            skew = it->second;
+            mSkews.erase(it);
+        }
+        return skew;
+    }
+
+    /// @brief Initiate a sequence of state transitions, driven by each FairMQ device on its own
+    /// The devices start each transition once the previous one is done and publish every state they pass.
+    /// The operation completes once the selected devices reached the target state of the last transition.
+    /// @param transitions FairMQ device state machine transitions, in order
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param token Asio completion token
+    /// @tparam CompletionToken Asio completion token type
+    /// @throws std::system_error
+    template<typename CompletionToken>
+    auto AsyncChangeStateSequence(const std::vector<TopoTransition>& transitions, const std::string& path, Duration timeout, CompletionToken&& token)
+    {
+        return boost::asio::async_initiate<CompletionToken, ChangeStateCompletionSignature>(
+            [&](auto handler) {
+                if (transitions.empty()) {
+                    throw std::invalid_argument("ChangeStateSequence requires at least one transition");
+                }
+                const uint64_t id = uuidHash();
+
+                std::lock_guard<std::mutex> lk(*mMtx);
+
+                for (auto it = begin(mChangeStateOps); it != end(mChangeStateOps);) {
+                    if (it->second.IsCompleted()) {
+                        it = mChangeStateOps.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                // intermediate states of the sequence never equal the target state of its last transition
+                auto [it, inserted] = mChangeStateOps.try_emplace(id,
+                                                                  transitions.back(),
+                                                                  GetTasks(path),
+                                                                  mStateIndex,
+                                                                  mStateData,
+                                                                  timeout,
+                                                                  *mMtx,
+                                                                  std::bind(&BasicTopology::CheckExpendable, this, std::placeholders::_1),
+                                                                  AsioBase<Executor, Allocator>::GetExecutor(),
+                                                                  AsioBase<Executor, Allocator>::GetAllocator(),
+                                                                  std::move(handler)
+                );
+
+                cc::Cmds cmds(cc::make<cc::ChangeStateSequence>(id, transitions));
+                mDDSCustomCmd.send(cmds.Serialize(), path);
+
+                it->second.TryCompletion();
+            },
+            token);
+    }
+
+    /// @brief Perform a sequence of state transitions on FairMQ devices in this topology, see AsyncChangeStateSequence
+    /// @param transitions FairMQ device state machine transitions, in order
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @throws std::system_error
+    std::pair<std::error_code, TopoState> ChangeStateSequence(const std::vector<TopoTransition>& transitions, const std::string& path = "", Duration timeout = Duration(0))
+    {
+        SharedSemaphore blocker;
+        std::error_code ec;
+        TopoState state;
+        AsyncChangeStateSequence(transitions, path, timeout, [&, blocker](std::error_code _ec, TopoState _state) mutable {
+            ec = _ec;
+            state = _state;
+            blocker.Signal();
+        });
+        blocker.Wait();
+        return { ec, state };
+    }
+
+    /// @brief Initiate a sequence of state transitions, advancing each FairMQ device on its own
+    /// The first transition is sent to all selected devices, every further one to a single device as soon as it completed the previous one.
+    /// The operation completes once the selected devices reached the target state of the last transition, which is the only barrier.
+    /// @param transitions FairMQ device state machine transitions, in order
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @param token Asio completion token
+    /// @tparam CompletionToken Asio completion token type
+    /// @throws std::system_error
+    template<typename CompletionToken>
+    auto AsyncChangeStatePipelined(const std::vector<TopoTransition>& transitions, const std::string& path, Duration timeout, CompletionToken&& token)
+    {
+        return boost::asio::async_initiate<CompletionToken, ChangeStateCompletionSignature>(
+            [&](auto handler) {
+                if (transitions.empty()) {
+                    throw std::invalid_argument("ChangeStatePipelined requires at least one transition");
+                }
+                const uint64_t id = uuidHash();
+
+                std::lock_guard<std::mutex> lk(*mMtx);
+
+                for (auto it = begin(mChangeStateOps); it != end(mChangeStateOps);) {
+                    if (it->second.IsCompleted()) {
+                        it = mChangeStateOps.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                for (auto it = begin(mPipelines); it != end(mPipelines);) {
+                    if (mChangeStateOps.count(it->second.mOpID) == 0) {
+                        it = mPipelines.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                const auto tasks = GetTasks(path);
+                for (const auto& taskId : tasks) {
+                    mPipelines[taskId] = Pipeline{ id, transitions, 0 };
+                }
+
+                auto [it, inserted] = mChangeStateOps.try_emplace(id,
+                                                                  transitions.back(),
+                                                                  tasks,
+                                                                  mStateIndex,
+                                                                  mStateData,
+                                                                  timeout,
+                                                                  *mMtx,
+                                                                  std::bind(&BasicTopology::CheckExpendable, this, std::placeholders::_1),
+                                                                  AsioBase<Executor, Allocator>::GetExecutor(),
+                                                                  AsioBase<Executor, Allocator>::GetAllocator(),
+                                                                  std::move(handler)
+                );
+
+                cc::Cmds cmds(cc::make<cc::ChangeState>(transitions.front()));
+                mDDSCustomCmd.send(cmds.Serialize(), path);
+
+                it->second.TryCompletion();
+            },
+            token);
+    }
+
+    /// @brief Perform a sequence of state transitions on FairMQ devices in this topology, see AsyncChangeStatePipelined
+    /// @param transitions FairMQ device state machine transitions, in order
+    /// @param path Select a subset of FairMQ devices in this topology, empty selects all
+    /// @param timeout Timeout in milliseconds, 0 means no timeout
+    /// @throws std::system_error
+    std::pair<std::error_code, TopoState> ChangeStatePipelined(const std::vector<TopoTransition>& transitions, const std::string& path = "", Duration timeout = Duration(0))
     {
         SharedSemaphore blocker;
         std::error_code ec;
         TopoState state;
-        AsyncChangeState(transition, path, timeout, [&, blocker](std::error_code _ec, TopoState _state) mutable {
+        AsyncChangeStatePipelined(transitions, path, timeout, [&, blocker](std::error_code _ec, TopoState _state) mutable {
             ec = _ec;
             state = _state;
             blocker.Signal();
@@ -646,6 +1196,42 @@ class BasicTopology : public AsioBase<Executor, Allocator>
         return mStateData;
     }
 
+    /// @brief Take over the states of a persisted snapshot for devices that have not reported their state yet
+    /// A state reported by a device always takes precedence, the snapshot only bridges the time until the subscriptions are renewed.
+    /// Devices that do not report back within the grace period go back to Undefined, the snapshot state may no longer hold for them.
+    /// @param states states of a previous run of the controller
+    /// @param grace time the devices have to confirm the snapshot state
+    /// @return number of devices the state was taken over for
+    size_t ApplySnapshot(const TopoState& states, std::chrono::milliseconds grace)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        size_t numApplied = 0;
+        for (const auto& s : states) {
+            auto it = mStateIndex.find(s.taskId);
+            if (it == mStateIndex.end()) {
+                continue;
+            }
+            DeviceStatus& ds = mStateData.at(it->second);
+            // restarts are only counted by the controller, devices do not report them
+            ds.restarts = std::max(ds.restarts, s.restarts);
+            if (ds.subscribedToStateChanges || ds.state != DeviceState::Undefined) {
+                continue;
+            }
+            ds.lastState = s.lastState;
+            ds.state = s.state;
+            ds.ignored = s.ignored;
+            ds.exitCode = s.exitCode;
+            ds.signal = s.signal;
+            mSnapshotTasks.insert(s.taskId);
+            ++numApplied;
+        }
+        if (numApplied > 0) {
+            mSnapshotTimer.expires_after(grace);
+            mSnapshotTimer.async_wait(std::bind(&BasicTopology::ExpireSnapshot, this, std::placeholders::_1));
+        }
+        return numApplied;
+    }
+
     DeviceState AggregateState() const { return AggregateState(GetCurrentState()); }
 
     bool StateEqualsTo(DeviceState state) const { return StateEqualsTo(GetCurrentState(), state); }
@@ -841,18 +1427,177 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     std::chrono::milliseconds GetHeartbeatInterval() const { return mHeartbeatInterval; }
     void SetHeartbeatInterval(std::chrono::milliseconds duration) { mHeartbeatInterval = duration; }
 
+    /// @brief Mark all tasks of a lost DDS agent as failed in one operation
+    /// @param agentID DDS agent ID
+    /// @return number of tasks that were marked as failed
+    size_t HandleAgentLost(DDSAgentId agentID)
+    {
+        size_t numFailed = 0;
+        size_t numIgnored = 0;
+        {
+            std::lock_guard<std::mutex> lk(*mMtx);
+            if (!mLostAgents.insert(agentID).second) {
+                return 0;
+            }
+            if (mSession.getAgentTasks(agentID).empty()) {
+                // released or never used by this topology
+                return 0;
+            }
+            for (const auto taskID : mSession.getAgentTasks(agentID)) {
+                auto it = mStateIndex.find(taskID);
+                if (it == mStateIndex.end()) {
+                    continue;
+                }
+                DeviceStatus& device = mStateData.at(it->second);
+                if (device.ignored || device.state == DeviceState::Error) {
+                    continue;
+                }
+                ++numFailed;
+                if (FailDevice(device)) {
+                    ++numIgnored;
+                }
+            }
+        }
+        OLOG(error, PartitionID(), mSession.mLastRunNr.load()) << "Agent " << agentID << " lost: " << numFailed << " task(s) marked as failed, " << numIgnored << " of them ignored";
+        return numFailed;
+    }
+
+    /// @brief Set the handler called when a task exits unexpectedly. It is called with the topology locked and must not block.
+    /// @brief Change the partition ID of the log messages, e.g. when a standby partition takes over a partition
+    void SetPartitionID(const std::string& partitionID) { std::atomic_store(&mPartitionID, std::make_shared<const std::string>(partitionID)); }
+
+    void SetTaskExitHandler(std::function<void(DDSTaskId)> handler)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        mTaskExitHandler = std::move(handler);
+    }
+
+    /// @brief Set the handler called when a failed collection is ignored under nMin. It is called with the topology locked and must not block.
+    void SetCollectionIgnoredHandler(std::function<void(DDSCollectionId)> handler)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        mCollectionIgnoredHandler = std::move(handler);
+    }
+
+    /// @brief Runtime collections that failed and were ignored under nMin, and are not replaced yet
+    std::vector<DDSCollectionId> GetIgnoredCollections() const
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        return std::vector<DDSCollectionId>(mIgnoredCollections.begin(), mIgnoredCollections.end());
+    }
+
+    /// @brief Register new runtime collections replacing ignored ones, before they are activated
+    /// The new collections count towards the current number of their collection, their failures are handled like those of the original ones.
+    /// If the activation fails, RevertReplaceCollections() undoes the registration.
+    /// @param replaced ignored runtime collections that are replaced
+    /// @param added new runtime collections and the names of their collections
+    void ReplaceCollections(const std::vector<DDSCollectionId>& replaced, const std::vector<std::pair<DDSCollectionId, std::string>>& added)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        for (const auto id : replaced) {
+            mIgnoredCollections.erase(id);
+        }
+        for (const auto& [id, name] : added) {
+            CollectionInfo& colInfo = mSession.mCollections.at(name);
+            colInfo.mRuntimeCollectionAgents.emplace(id, 0);
+            mSession.mRuntimeCollectionIndex[id] = &colInfo;
+            ++colInfo.nCurrent;
+        }
+    }
+
+    /// @brief Undo ReplaceCollections() after the activation of the new runtime collections failed
+    /// The replaced collections are ignored again, without calling the collection ignored handler. The new ones are forgotten.
+    void RevertReplaceCollections(const std::vector<DDSCollectionId>& replaced, const std::vector<std::pair<DDSCollectionId, std::string>>& added)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        mIgnoredCollections.insert(replaced.begin(), replaced.end());
+        for (const auto& [id, name] : added) {
+            auto it = mSession.mCollections.find(name);
+            if (it == mSession.mCollections.end()) {
+                continue;
+            }
+            CollectionInfo& colInfo = it->second;
+            colInfo.mRuntimeCollectionAgents.erase(id);
+            mSession.mRuntimeCollectionIndex.erase(id);
+            // a new collection that failed during the activation no longer counts already
+            if (colInfo.mFailedRuntimeCollections.erase(id) == 0) {
+                --colInfo.nCurrent;
+            }
+        }
+    }
+
+    /// @brief Set the handler called when a failed expendable task is ignored, and when it reported back after a restart.
+    /// It is called with the topology locked and must not block. Crashed tasks are only recorded while a handler is set.
+    void SetTaskRestartHandler(std::function<void(DDSTaskId)> handler)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        mTaskRestartHandler = std::move(handler);
+    }
+
+    /// @brief Expendable tasks that failed and were ignored since the last call
+    std::vector<DDSTaskId> TakeCrashedTasks()
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        std::vector<DDSTaskId> tasks(mCrashedTasks.begin(), mCrashedTasks.end());
+        mCrashedTasks.clear();
+        return tasks;
+    }
+
+    /// @brief Ask crashed expendable tasks to subscribe to state changes again
+    /// A task that was started again on its agent answers with its state and is taken back: it is no longer ignored and counts one more restart.
+    /// A crashed process that is still alive answers in Error or Exiting state and stays ignored.
+    /// Tasks that are not running yet do not answer, the probe can be repeated.
+    void ProbeTasks(const std::vector<DDSTaskId>& ids)
+    {
+        if (ids.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(*mMtx);
+            for (const auto id : ids) {
+                auto it = mStateIndex.find(id);
+                if (it != mStateIndex.end() && mStateData.at(it->second).ignored) {
+                    mRestartProbes.insert(id);
+                }
+            }
+        }
+        const std::string cmds = cc::Cmds(cc::make<cc::SubscribeToStateChange>(mHeartbeatInterval.count())).Serialize();
+        for (const auto id : ids) {
+            mDDSCustomCmd.send(cmds, std::to_string(id));
+        }
+    }
+
+    /// @brief Stop probing tasks that did not report back in time, they stay ignored
+    void CancelProbes(const std::vector<DDSTaskId>& ids)
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        for (const auto id : ids) {
+            mRestartProbes.erase(id);
+        }
+    }
+
+    /// @brief Tasks taken back after a restart since the last call, to be brought to the state of the topology
+    std::vector<DDSTaskId> TakeRestartedTasks()
+    {
+        std::lock_guard<std::mutex> lk(*mMtx);
+        std::vector<DDSTaskId> tasks(mRestartedTasks.begin(), mRestartedTasks.end());
+        mRestartedTasks.clear();
+        return tasks;
+    }
+
     void ShutdownDDSAgent(uint64_t agentID)
     {
         try {
             using namespace dds::tools_api;
-            OLOG(info, mPartitionID, mSession.mLastRunNr.load()) << "Sending shutdown signal to agent " << agentID;
+            OLOG(info, PartitionID(), mSession.mLastRunNr.load()) << "Sending shutdown signal to agent " << agentID;
             SAgentCommandRequest::request_t agentCmd;
             agentCmd.m_commandType = SAgentCommandRequestData::EAgentCommandType::shutDownByID;
             agentCmd.m_arg1 = agentID;
             SAgentCommandRequest::ptr_t requestPtr{ SAgentCommandRequest::makeRequest(agentCmd) };
             mSession.mDDSSession.sendRequest<SAgentCommandRequest>(requestPtr);
+            mSession.mAgentTracker.remove(agentID);
         } catch (std::exception& e) {
-            OLOG(error, mPartitionID, mSession.mLastRunNr.load()) << "Failed sending shutdown signal to agent with id " << agentID << ": " << e.what();
+            OLOG(error, PartitionID(), mSession.mLastRunNr.load()) << "Failed sending shutdown signal to agent with id " << agentID << ": " << e.what();
         }
     }
 
@@ -860,7 +1605,7 @@ class BasicTopology : public AsioBase<Executor, Allocator>
     Session& mSession;
     dds::intercom_api::CIntercomService mDDSService;
     dds::intercom_api::CCustomCmd mDDSCustomCmd;
-    dds::topology_api::CTopology& mDDSTopo;
+    dds::topology_api::CTopology* mDDSTopo;
     dds::tools_api::SOnTaskDoneRequest::ptr_t mDDSOnTaskDoneRequest;
     TopoState mStateData;
     TopoStateIndex mStateIndex;
@@ -869,15 +1614,152 @@ class BasicTopology : public AsioBase<Executor, Allocator>
 
     std::unique_ptr<std::condition_variable> mStateChangeSubscriptionsCV;
     unsigned int mNumStateChangePublishers;
-    boost::asio::steady_timer mHeartbeatsTimer;
+    boost::asio::basic_waitable_timer<Clock> mHeartbeatsTimer;
     std::chrono::milliseconds mHeartbeatInterval;
+    boost::asio::basic_waitable_timer<Clock> mSnapshotTimer;
+    std::set<DDSTaskId> mSnapshotTasks; ///< devices showing the state of a snapshot they did not confirm yet
 
-    std::unordered_map<uint64_t, ChangeStateOp<Executor, Allocator>> mChangeStateOps;
-    std::unordered_map<uint64_t, WaitForStateOp<Executor, Allocator>> mWaitForStateOps;
-    std::unordered_map<uint64_t, SetPropertiesOp<Executor, Allocator>> mSetPropertiesOps;
-    std::unordered_map<uint64_t, GetPropertiesOp<Executor, Allocator>> mGetPropertiesOps;
+    std::unordered_map<uint64_t, ChangeStateOp<Executor, Allocator, Clock>> mChangeStateOps;
+    std::unordered_map<uint64_t, WaitForStateOp<Executor, Allocator, Clock>> mWaitForStateOps;
+    std::unordered_map<uint64_t, SetPropertiesOp<Executor, Allocator, Clock>> mSetPropertiesOps;
+    std::unordered_map<uint64_t, GetPropertiesOp<Executor, Allocator, Clock>> mGetPropertiesOps;
+
+    /// Progress of a device through the transitions of a pipelined state change
+    struct Pipeline
+    {
+        uint64_t mOpID;                           ///< ChangeState operation waiting for the last transition
+        std::vector<TopoTransition> mTransitions; ///< all transitions of the state change
+        size_t mCurrent;                          ///< index of the transition in progress
+    };
+    std::unordered_map<DDSTaskId, Pipeline> mPipelines; ///< pipelined state changes in progress, by task ID
+
+    /// Devices of a state change with a limited rollout
+    struct Rollout
+    {
+        TopoTransition mTransition;
+        RolloutPolicy mPolicy;
+        std::map<std::string, std::deque<DDSTaskId>> mPending;  ///< devices not sent the transition yet, by host
+        std::unordered_map<DDSTaskId, std::string> mInFlight;   ///< devices in transition and their hosts
+        std::unordered_map<std::string, size_t> mInFlightPerHost; ///< number of devices in transition, by host
+        std::deque<std::vector<DDSTaskId>> mLayers;             ///< devices of an ordered state change, sent the transition after the pending ones are done
+    };
+    std::unordered_map<uint64_t, Rollout> mRollouts; ///< state changes with a limited rollout in progress, by ChangeState operation ID
+    std::unordered_map<uint64_t, TransitionSkew> mSkews; ///< delays reported for scheduled transitions, by request ID
+
+    std::string GetHost(DDSTaskId taskId)
+    {
+        try {
+            return mSession.getTaskDetails(taskId).mHost;
+        } catch (const std::exception&) {
+            return "";
+        }
+    }
+
+    // precondition: mMtx is locked.
+    /// @brief Send the transition of a limited rollout to as many devices as the limits allow, one device per host at a time
+    /// Once all pending devices are done, the next layer of an ordered state change becomes pending.
+    void ReleaseRollout(Rollout& rollout)
+    {
+        while (true) {
+            ReleasePending(rollout);
+            if (!rollout.mPending.empty() || !rollout.mInFlight.empty() || rollout.mLayers.empty()) {
+                return;
+            }
+            for (const auto& taskId : rollout.mLayers.front()) {
+                rollout.mPending[GetHost(taskId)].push_back(taskId);
+            }
+            rollout.mLayers.pop_front();
+        }
+    }
+
+    // precondition: mMtx is locked.
+    void ReleasePending(Rollout& rollout)
+    {
+        const DeviceState targetState = gExpectedState.at(rollout.mTransition);
+        const size_t maxDevices = rollout.mPolicy.mMaxDevices;
+        const size_t maxPerHost = rollout.mPolicy.mMaxPerHost;
+        bool released = true;
+        while (released && (maxDevices == 0 || rollout.mInFlight.size() < maxDevices)) {
+            released = false;
+            for (auto it = rollout.mPending.begin(); it != rollout.mPending.end() && (maxDevices == 0 || rollout.mInFlight.size() < maxDevices);) {
+                size_t& inFlight = rollout.mInFlightPerHost[it->first];
+                if (maxPerHost > 0 && inFlight >= maxPerHost) {
+                    ++it;
+                    continue;
+                }
+                const DDSTaskId taskId = it->second.front();
+                it->second.pop_front();
+                const DeviceStatus& ds = mStateData.at(mStateIndex.at(taskId));
+                // skip devices that are done or failed in the meantime
+                if (!ds.ignored && ds.state != targetState && ds.state != DeviceState::Error && ds.state != DeviceState::Exiting) {
+                    ++inFlight;
+                    rollout.mInFlight.emplace(taskId, it->first);
+                    cc::Cmds cmds(cc::make<cc::ChangeState>(rollout.mTransition));
+                    mDDSCustomCmd.send(cmds.Serialize(), std::to_string(taskId));
+                }
+                released = true;
+                it = it->second.empty() ? rollout.mPending.erase(it) : std::next(it);
+            }
+        }
+    }
+
+    // precondition: mMtx is locked.
+    /// @brief Free the rollout slot of a device that finished its transition and release further devices
+    void AdvanceRollouts(DDSTaskId taskId, DeviceState state)
+    {
+        for (auto it = mRollouts.begin(); it != mRollouts.end();) {
+            auto op = mChangeStateOps.find(it->first);
+            if (op == mChangeStateOps.end() || op->second.IsCompleted()) {
+                it = mRollouts.erase(it);
+                continue;
+            }
+            Rollout& rollout = it->second;
+            auto task = rollout.mInFlight.find(taskId);
+            if (task != rollout.mInFlight.end() && (state == gExpectedState.at(rollout.mTransition) || state == DeviceState::Error || state == DeviceState::Exiting)) {
+                --rollout.mInFlightPerHost[task->second];
+                rollout.mInFlight.erase(task);
+                ReleaseRollout(rollout);
+            }
+            ++it;
+        }
+    }
+
+    // precondition: mMtx is locked.
+    /// @brief Send the next transition of a pipelined state change to a device that completed the previous one
+    void AdvancePipeline(DDSTaskId taskId, DeviceState state)
+    {
+        auto it = mPipelines.find(taskId);
+        if (it == mPipelines.end()) {
+            return;
+        }
+        Pipeline& pipeline = it->second;
+        auto op = mChangeStateOps.find(pipeline.mOpID);
+        if (op == mChangeStateOps.end() || op->second.IsCompleted() || state == DeviceState::Error || state == DeviceState::Exiting) {
+            mPipelines.erase(it);
+            return;
+        }
+        if (state != gExpectedState.at(pipeline.mTransitions.at(pipeline.mCurrent))) {
+            return;
+        }
+        if (++pipeline.mCurrent == pipeline.mTransitions.size()) {
+            mPipelines.erase(it);
+            return;
+        }
+        cc::Cmds cmds(cc::make<cc::ChangeState>(pipeline.mTransitions.at(pipeline.mCurrent)));
+        mDDSCustomCmd.send(cmds.Serialize(), std::to_string(taskId));
+    }
 
-    std::string mPartitionID;
+    std::string PartitionID() const { return *std::atomic_load(&mPartitionID); }
+
+    std::shared_ptr<const std::string> mPartitionID; ///< Replaced by SetPartitionID() while DDS callbacks may log with it
+    std::unordered_set<DDSAgentId> mLostAgents; ///< agents reported as lost, no shutdown signal is sent to them
+    std::set<DDSCollectionId> mIgnoredCollections; ///< failed runtime collections ignored under nMin, until they are replaced
+    std::function<void(DDSCollectionId)> mCollectionIgnoredHandler;
+    std::function<void(DDSTaskId)> mTaskExitHandler;
+    std::set<DDSTaskId> mCrashedTasks;   ///< failed expendable tasks, until taken by TakeCrashedTasks()
+    std::set<DDSTaskId> mRestartProbes;  ///< crashed tasks asked to subscribe again, taken back once they answer
+    std::set<DDSTaskId> mRestartedTasks; ///< tasks taken back after a restart, until taken by TakeRestartedTasks()
+    std::function<void(DDSTaskId)> mTaskRestartHandler;
 
     // precodition: mMtx is locked.
     TopoState GetCurrentStateUnsafe() const { return mStateData; }
@@ -0,0 +1,393 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_TOPOLOGYCACHE
+#define ODC_CORE_TOPOLOGYCACHE
+
+#include <odc/Logger.h>
+#include <odc/MiscUtils.h>
+#include <odc/Session.h>
+#include <odc/TopologyDefs.h>
+
+#include <dds/Topology.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace odc::core
+{
+
+/// Parsed topology and the requirements derived from it, shared between sessions activating the same topology content
+struct TopologyCacheEntry
+{
+    std::string mHash;     ///< Content hash
+    std::string mFilePath; ///< Materialized topology file
+    uintmax_t mSize = 0;   ///< Size of the topology file in bytes
+    std::shared_ptr<dds::topology_api::CTopology> mDDSTopo; ///< Parsed DDS topology
+    std::map<std::string, CollectionNInfo> mNinfo;
+    std::map<std::string, std::vector<ZoneGroup>> mZoneInfo;
+    std::vector<AgentGroupInfo> mAgentGroupInfo;
+    std::vector<TaskInfo> mStandaloneTasks;
+    std::map<std::string, CollectionInfo> mCollections;
+    std::unordered_set<DDSTaskId> mExpendableTasks;
+};
+
+class TopologyCache;
+
+/// Keeps an entry of the topology cache from being evicted while it is alive.
+/// Sessions hold one for the topology file they run from, see Session::mTopoCachePin.
+class TopologyCachePin
+{
+  public:
+    TopologyCachePin(TopologyCache& cache, std::string h)
+        : mCache(&cache)
+        , mHash(std::move(h))
+    {}
+    TopologyCachePin(const TopologyCachePin&) = delete;
+    TopologyCachePin& operator=(const TopologyCachePin&) = delete;
+    TopologyCachePin(TopologyCachePin&& other)
+        : mCache(other.mCache)
+        , mHash(std::move(other.mHash))
+    {
+        other.mCache = nullptr;
+    }
+    TopologyCachePin& operator=(TopologyCachePin&&) = delete;
+    ~TopologyCachePin();
+
+    const std::string& hash() const { return mHash; }
+
+  private:
+    TopologyCache* mCache;
+    std::string mHash;
+};
+
+/**
+ * @class TopologyCache
+ * @brief Content-addressed cache of topology files, parsed topologies and their requirements
+ *
+ * Topology files are materialized as <dir>/<hash>.xml and survive restarts.
+ * Parsed topologies and extracted requirements are kept in memory only.
+ * Both levels are evicted in LRU order once the total size of the topology files exceeds the size cap.
+ * Pinned entries are never evicted: sessions keep a pin for as long as they run from the topology file.
+ * Sessions get their own copy of a cached parsed topology.
+ * The cache has to outlive the pins.
+ *
+ * @par Thread Safety
+ * Safe.
+ */
+class TopologyCache
+{
+  public:
+    using Pin = TopologyCachePin;
+
+    /// @brief Configure the cache. Existing topology files in the directory are picked up.
+    /// @param dir cache directory
+    /// @param maxSize size cap in bytes, 0 disables the cache
+    void configure(const std::string& dir, uintmax_t maxSize)
+    {
+        namespace bfs = boost::filesystem;
+        std::lock_guard<std::mutex> lock(mMtx);
+        mDir = dir;
+        mMaxSize = maxSize;
+        mDisk.clear();
+        mDiskSize = 0;
+        mLRU.clear();
+        // pins and parsed topologies of running sessions stay, they are still referenced
+        for (auto it = mMemory.begin(); it != mMemory.end();) {
+            if (mPins.count(it->first) > 0 || it->second.use_count() > 1) {
+                mLRU.push_back(it->first);
+                ++it;
+            } else {
+                it = mMemory.erase(it);
+            }
+        }
+        if (mMaxSize == 0) {
+            return;
+        }
+        bfs::create_directories(mDir);
+
+        // pick up files from previous runs, oldest first
+        std::multimap<std::time_t, bfs::path> files;
+        for (const auto& e : bfs::directory_iterator(mDir)) {
+            if (bfs::is_regular_file(e.path()) && e.path().extension() == ".xml") {
+                files.emplace(bfs::last_write_time(e.path()), e.path());
+            }
+        }
+        for (const auto& [time, path] : files) {
+            const std::string hash = path.stem().string();
+            mDisk.emplace(hash, bfs::file_size(path));
+            mDiskSize += mDisk.at(hash);
+            touch(hash);
+        }
+        OLOG(info) << "Topology cache in " << std::quoted(mDir) << ": " << mDisk.size() << " topologies, " << mDiskSize << " bytes, size cap " << mMaxSize << " bytes";
+        evict();
+    }
+
+    bool enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mMaxSize > 0;
+    }
+
+    /// @brief Content hash used as the cache key (SHA-256, hex encoded)
+    static std::string hash(const std::string& content) { return contentHash(content); }
+
+    /// @brief Store topology content as a file, unless a file with identical content is cached already
+    /// @return pin of the entry, holding the content hash
+    Pin put(const std::string& content)
+    {
+        namespace bfs = boost::filesystem;
+        const std::string h = hash(content);
+        std::lock_guard<std::mutex> lock(mMtx);
+        const bfs::path filepath = filePathUnsafe(h);
+
+        if (mDisk.count(h) > 0 && bfs::exists(filepath)) {
+            if (readFile(filepath.string()) == content) {
+                touch(h);
+                ++mPins[h];
+                return Pin(*this, h);
+            }
+            throw std::runtime_error(toString("Topology cache: hash collision for ", h, ", content differs from ", std::quoted(filepath.string())));
+        }
+
+        // write to a temporary file first, so that a cached file is always complete
+        const bfs::path tmpPath = bfs::path(mDir) / toString(".", h, "-", bfs::unique_path().string());
+        {
+            std::ofstream file(tmpPath.string());
+            if (!file.is_open()) {
+                throw std::runtime_error(toString("Failed to create topology file ", std::quoted(tmpPath.string())));
+            }
+            file << content;
+        }
+        bfs::rename(tmpPath, filepath);
+
+        mDisk[h] = content.size();
+        mDiskSize += content.size();
+        touch(h);
+        ++mPins[h];
+        evict();
+        return Pin(*this, h);
+    }
+
+    /// @brief Pin a cached topology given by its hash
+    /// @throws std::runtime_error if the hash is unknown
+    Pin pin(const std::string& h)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mDisk.count(h) == 0 || !boost::filesystem::exists(filePathUnsafe(h))) {
+            throw std::runtime_error(toString("Topology with hash ", std::quoted(h), " is not known to the topology cache. Send the topology file, content or script instead."));
+        }
+        touch(h);
+        ++mPins[h];
+        return Pin(*this, h);
+    }
+
+    /// @brief Pin the cached topology a session runs from, e.g. after attaching to it on restore
+    /// @param path topology file of the session
+    /// @return pin of the entry, none if the file is not in the cache
+    std::optional<Pin> pinFile(const std::string& path)
+    {
+        namespace bfs = boost::filesystem;
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mMaxSize == 0 || path.empty()) {
+            return std::nullopt;
+        }
+        const bfs::path p(path);
+        const std::string h = p.stem().string();
+        boost::system::error_code ec;
+        if (p.extension() != ".xml" || mDisk.count(h) == 0 || !bfs::equivalent(p, filePathUnsafe(h), ec)) {
+            return std::nullopt;
+        }
+        touch(h);
+        ++mPins[h];
+        return std::optional<Pin>(std::in_place, *this, h);
+    }
+
+    /// @brief Number of pins of the entry, for diagnostics and tests
+    size_t numPins(const std::string& h) const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto it = mPins.find(h);
+        return it == mPins.end() ? 0 : it->second;
+    }
+
+    /// @brief Get path to the cached topology file for a given hash
+    /// @throws std::runtime_error if the hash is unknown
+    std::string filePath(const std::string& h)
+    {
+        namespace bfs = boost::filesystem;
+        std::lock_guard<std::mutex> lock(mMtx);
+        const bfs::path filepath = filePathUnsafe(h);
+        if (mDisk.count(h) == 0 || !bfs::exists(filepath)) {
+            throw std::runtime_error(toString("Topology with hash ", std::quoted(h), " is not known to the topology cache. Send the topology file, content or script instead."));
+        }
+        touch(h);
+        return filepath.string();
+    }
+
+    /// @brief Restore the parsed topology & requirements into the session
+    /// @return false if not cached
+    bool restore(const std::string& h, Session& session)
+    {
+        std::shared_ptr<const TopologyCacheEntry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            auto it = mMemory.find(h);
+            if (it == mMemory.end()) {
+                return false;
+            }
+            entry = it->second;
+            touch(h);
+        }
+
+        session.mParsedDDSTopo = std::make_shared<dds::topology_api::CTopology>(*(entry->mDDSTopo));
+        session.mParsedTopoFilePath = session.mTopoFilePath;
+        session.mNinfo = entry->mNinfo;
+        session.mZoneInfo = entry->mZoneInfo;
+        session.mAgentGroupInfo = entry->mAgentGroupInfo;
+        session.mStandaloneTasks = entry->mStandaloneTasks;
+        session.mCollections = entry->mCollections;
+        session.mExpendableTasks = entry->mExpendableTasks;
+        session.mRuntimeCollectionIndex.clear();
+        for (auto& [name, colInfo] : session.mCollections) {
+            for (const auto& [colId, agentId] : colInfo.mRuntimeCollectionAgents) {
+                session.mRuntimeCollectionIndex.emplace(colId, &colInfo);
+            }
+        }
+        session.mTopoCacheEntry = entry;
+        return true;
+    }
+
+    /// @brief Store the parsed topology & freshly extracted requirements of the session
+    void store(const std::string& h, Session& session)
+    {
+        auto entry = std::make_shared<TopologyCacheEntry>();
+        entry->mHash = h;
+        entry->mFilePath = session.mTopoFilePath;
+        entry->mDDSTopo = std::make_shared<dds::topology_api::CTopology>(*(session.mParsedDDSTopo));
+        entry->mNinfo = session.mNinfo;
+        entry->mZoneInfo = session.mZoneInfo;
+        entry->mAgentGroupInfo = session.mAgentGroupInfo;
+        entry->mStandaloneTasks = session.mStandaloneTasks;
+        entry->mCollections = session.mCollections;
+        entry->mExpendableTasks = session.mExpendableTasks;
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto it = mDisk.find(h);
+        entry->mSize = (it == mDisk.end()) ? 0 : it->second;
+        mMemory[h] = entry;
+        session.mTopoCacheEntry = entry;
+        touch(h);
+        evict();
+    }
+
+  private:
+    friend class TopologyCachePin;
+
+    mutable std::mutex mMtx;
+    std::string mDir;
+    uintmax_t mMaxSize = 0;
+    uintmax_t mDiskSize = 0;
+    std::unordered_map<std::string, uintmax_t> mDisk; ///< hash -> file size
+    std::unordered_map<std::string, std::shared_ptr<const TopologyCacheEntry>> mMemory; ///< hash -> parsed topology & requirements
+    std::list<std::string> mLRU; ///< most recently used first
+    std::unordered_map<std::string, size_t> mPins; ///< hash -> number of pins
+
+    void unpin(const std::string& h)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto it = mPins.find(h);
+        if (it != mPins.end() && --(it->second) == 0) {
+            mPins.erase(it);
+        }
+    }
+
+    // precondition: mMtx is locked
+    boost::filesystem::path filePathUnsafe(const std::string& h) const { return boost::filesystem::path(mDir) / (h + ".xml"); }
+
+    // precondition: mMtx is locked
+    void touch(const std::string& h)
+    {
+        mLRU.remove(h);
+        mLRU.push_front(h);
+    }
+
+    // precondition: mMtx is locked
+    uintmax_t memorySize() const
+    {
+        uintmax_t size = 0;
+        for (const auto& [h, entry] : mMemory) {
+            size += entry->mSize;
+        }
+        return size;
+    }
+
+    // precondition: mMtx is locked
+    void evict()
+    {
+        namespace bfs = boost::filesystem;
+        // parsed topologies take a multiple of the file size in memory, they are evicted by the same cap as the files
+        auto it = mLRU.end();
+        while ((mDiskSize > mMaxSize || memorySize() > mMaxSize) && it != mLRU.begin()) {
+            --it;
+            const std::string h = *it;
+            if (mPins.count(h) > 0) {
+                continue; // a session runs from it or is being set up with it
+            }
+            auto memIt = mMemory.find(h);
+            if (memIt != mMemory.end() && memIt->second.use_count() > 1) {
+                continue; // in use by a session
+            }
+            if (memIt != mMemory.end()) {
+                mMemory.erase(memIt);
+            }
+            if (mDiskSize > mMaxSize) {
+                auto diskIt = mDisk.find(h);
+                if (diskIt != mDisk.end()) {
+                    boost::system::error_code ec;
+                    bfs::remove(filePathUnsafe(h), ec);
+                    mDiskSize -= diskIt->second;
+                    mDisk.erase(diskIt);
+                }
+                it = mLRU.erase(it);
+            }
+        }
+    }
+
+    static std::string readFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+};
+
+inline TopologyCachePin::~TopologyCachePin()
+{
+    if (mCache != nullptr) {
+        mCache->unpin(mHash);
+    }
+}
+
+} // namespace odc::core
+
+#endif /* ODC_CORE_TOPOLOGYCACHE */
@@ -100,6 +100,49 @@ inline AggregatedState GetAggregatedState(const std::string& state)
     }
 }
 
+/// Limits on the number of devices going through a transition at the same time, 0 means no limit
+struct RolloutPolicy
+{
+    size_t mMaxDevices = 0; ///< devices of the whole request
+    size_t mMaxPerHost = 0; ///< devices of the request on the same host
+
+    bool IsLimited() const { return mMaxDevices > 0 || mMaxPerHost > 0; }
+
+    friend std::ostream& operator<<(std::ostream& os, const RolloutPolicy& p)
+    {
+        return os << "max devices: " << p.mMaxDevices << ", max per host: " << p.mMaxPerHost;
+    }
+};
+
+/// Start delays of a scheduled transition, measured by the devices from the scheduled to the actual start
+struct TransitionSkew
+{
+    size_t mNumDevices = 0;                    ///< devices that reported their start
+    size_t mNumFailed = 0;                     ///< devices that failed to start the transition
+    std::chrono::nanoseconds mMinDelay{ 0 };
+    std::chrono::nanoseconds mMaxDelay{ 0 };
+
+    void Add(std::chrono::nanoseconds delay)
+    {
+        mMinDelay = (mNumDevices == 0) ? delay : std::min(mMinDelay, delay);
+        mMaxDelay = (mNumDevices == 0) ? delay : std::max(mMaxDelay, delay);
+        ++mNumDevices;
+    }
+
+    /// time between the first and the last device starting the transition
+    std::chrono::nanoseconds Spread() const { return mMaxDelay - mMinDelay; }
+
+    friend std::ostream& operator<<(std::ostream& os, const TransitionSkew& s)
+    {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        return os << "devices: " << s.mNumDevices
+                  << ", failed: " << s.mNumFailed
+                  << ", delay min/max: " << duration_cast<microseconds>(s.mMinDelay).count() << "/" << duration_cast<microseconds>(s.mMaxDelay).count() << " us"
+                  << ", skew: " << duration_cast<microseconds>(s.Spread()).count() << " us";
+    }
+};
+
 struct DeviceStatus
 {
     DeviceStatus() = default;
@@ -120,7 +163,8 @@ struct DeviceStatus
                   << "; expendable: " << ds.expendable
                   << "; subscribedToStateChanges: " << ds.subscribedToStateChanges
                   << "; exitCode: " << ds.exitCode
-                  << "; signal: " << ds.signal;
+                  << "; signal: " << ds.signal
+                  << "; restarts: " << ds.restarts;
     }
 
     bool ignored = false;
@@ -132,6 +176,7 @@ struct DeviceStatus
     DDSCollectionId collectionId;
     int exitCode = -1;
     int signal = -1;
+    uint32_t restarts = 0; ///< number of times the task was taken back after a crash
 };
 
 struct DetailedTaskStatus
@@ -13,7 +13,7 @@
 #include <odc/Error.h>
 #include <odc/TopologyDefs.h>
 
-#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
 
 #include <dds/Tools.h>
 #include <dds/Topology.h>
@@ -30,7 +30,7 @@ namespace odc::core
 
 using ChangeStateCompletionSignature = void(std::error_code, TopoState);
 
-template<typename Executor, typename Allocator>
+template<typename Executor, typename Allocator, typename Clock = std::chrono::steady_clock>
 struct ChangeStateOp
 {
     template<typename Handler>
@@ -142,7 +142,7 @@ struct ChangeStateOp
     AsioAsyncOp<Executor, Allocator, ChangeStateCompletionSignature> mOp;
     TimeoutHandler mTimeoutHandler;
     TopoState& mStateData;
-    boost::asio::steady_timer mTimer;
+    boost::asio::basic_waitable_timer<Clock> mTimer;
     std::unordered_set<DDSTaskId> mTasks;
     DeviceState mTargetState;
     std::mutex& mMtx;
@@ -13,7 +13,7 @@
 #include <odc/Error.h>
 #include <odc/TopologyDefs.h>
 
-#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
 
 #include <dds/Tools.h>
 #include <dds/Topology.h>
@@ -30,7 +30,7 @@ namespace odc::core
 
 using GetPropertiesCompletionSignature = void(std::error_code, GetPropertiesResult);
 
-template<typename Executor, typename Allocator>
+template<typename Executor, typename Allocator, typename Clock = std::chrono::steady_clock>
 struct GetPropertiesOp
 {
     template<typename Handler>
@@ -123,7 +123,7 @@ struct GetPropertiesOp
   private:
     AsioAsyncOp<Executor, Allocator, GetPropertiesCompletionSignature> mOp;
     TimeoutHandler mTimeoutHandler;
-    boost::asio::steady_timer mTimer;
+    boost::asio::basic_waitable_timer<Clock> mTimer;
     std::unordered_set<DDSTaskId> mTasks;
     GetPropertiesResult mResult;
     std::mutex& mMtx;
@@ -13,7 +13,7 @@
 #include <odc/Error.h>
 #include <odc/TopologyDefs.h>
 
-#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
 
 #include <dds/Tools.h>
 #include <dds/Topology.h>
@@ -30,7 +30,7 @@ namespace odc::core
 
 using WaitForStateCompletionSignature = void(std::error_code, FailedDevices);
 
-template<typename Executor, typename Allocator>
+template<typename Executor, typename Allocator, typename Clock = std::chrono::steady_clock>
 struct WaitForStateOp
 {
     template<typename Handler>
@@ -139,7 +139,7 @@ struct WaitForStateOp
   private:
     AsioAsyncOp<Executor, Allocator, WaitForStateCompletionSignature> mOp;
     TimeoutHandler mTimeoutHandler;
-    boost::asio::steady_timer mTimer;
+    boost::asio::basic_waitable_timer<Clock> mTimer;
     std::unordered_set<DDSTaskId> mTasks;
     DeviceState mTargetLastState;
     DeviceState mTargetCurrentState;
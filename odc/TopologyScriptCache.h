@@ -0,0 +1,186 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_TOPOLOGYSCRIPTCACHE
+#define ODC_CORE_TOPOLOGYSCRIPTCACHE
+
+#include <odc/Logger.h>
+#include <odc/MiscUtils.h>
+#include <odc/Params.h>
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace odc::core
+{
+
+/**
+ * @class TopologyScriptCache
+ * @brief Memoizes the output of topology generation scripts
+ *
+ * The key covers the script text plus a declared set of inputs:
+ * files (path, size, mtime and content hash, directories are walked recursively) and environment variables (name and value).
+ * A script is re-executed as soon as any of these change. Inputs the script reads without them being declared are not tracked.
+ *
+ * @par Thread Safety
+ * Safe.
+ */
+class TopologyScriptCache
+{
+  public:
+    /// @brief Configure the cache. Drops all entries.
+    /// @param enabled enable memoization
+    /// @param inputFiles files or directories the scripts depend on
+    /// @param inputEnv names of environment variables the scripts depend on
+    /// @param maxEntries maximum number of memoized outputs, least recently used ones are dropped first
+    void configure(bool enabled, const std::vector<std::string>& inputFiles, const std::vector<std::string>& inputEnv, size_t maxEntries = 64)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mEnabled = enabled;
+        mInputFiles = inputFiles;
+        mInputEnv = inputEnv;
+        mMaxEntries = maxEntries;
+        mEntries.clear();
+        mLRU.clear();
+        if (mEnabled) {
+            OLOG(info) << "Topology script cache enabled. Input files: " << strVecToStr(mInputFiles) << "; input environment variables: " << strVecToStr(mInputEnv);
+        }
+    }
+
+    bool enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mEnabled;
+    }
+
+    /// @brief Compute the cache key for a script from the script text and the current state of the declared inputs
+    std::string key(const std::string& script) const
+    {
+        namespace bfs = boost::filesystem;
+        std::vector<std::string> inputFiles;
+        std::vector<std::string> inputEnv;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            inputFiles = mInputFiles;
+            inputEnv = mInputEnv;
+        }
+
+        std::stringstream ss;
+        ss << "script:" << script.size() << ":" << script << "\n";
+        for (const auto& name : inputEnv) {
+            const char* value = std::getenv(name.c_str());
+            ss << "env:" << name << "=" << (value == nullptr ? "<unset>" : toString("'", value, "'")) << "\n";
+        }
+        for (const auto& input : inputFiles) {
+            std::set<bfs::path> files;
+            boost::system::error_code ec;
+            if (bfs::is_directory(input, ec)) {
+                for (bfs::recursive_directory_iterator it(input, ec), end; !ec && it != end; it.increment(ec)) {
+                    if (bfs::is_regular_file(it->path(), ec)) {
+                        files.insert(it->path());
+                    }
+                }
+            } else {
+                files.insert(input);
+            }
+            for (const auto& file : files) {
+                ss << "file:" << file.string() << ":" << fileFingerprint(file) << "\n";
+            }
+        }
+        return contentHash(ss.str());
+    }
+
+    /// @brief Look up the output file of a previous run
+    /// @return false if not cached or the output file is gone
+    bool get(const std::string& k, std::string& outputFile)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto it = mEntries.find(k);
+        if (it == mEntries.end() || !boost::filesystem::exists(it->second.mOutputFile)) {
+            ++mStats.mMisses;
+            return false;
+        }
+        ++mStats.mHits;
+        mStats.mSavedTime += it->second.mDuration;
+        mLRU.remove(k);
+        mLRU.push_front(k);
+        outputFile = it->second.mOutputFile;
+        return true;
+    }
+
+    /// @brief Remember the output file of a script run
+    /// @param k key, computed before the script was executed
+    /// @param outputFile file holding the script output
+    /// @param duration execution time of the script
+    void put(const std::string& k, const std::string& outputFile, std::chrono::milliseconds duration)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (!mEnabled) {
+            return;
+        }
+        mEntries[k] = Entry{ outputFile, duration };
+        mLRU.remove(k);
+        mLRU.push_front(k);
+        while (mLRU.size() > mMaxEntries) {
+            mEntries.erase(mLRU.back());
+            mLRU.pop_back();
+        }
+    }
+
+    TopologyScriptCacheStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mStats;
+    }
+
+  private:
+    struct Entry
+    {
+        std::string mOutputFile;
+        std::chrono::milliseconds mDuration{ 0 };
+    };
+
+    mutable std::mutex mMtx;
+    bool mEnabled = false;
+    std::vector<std::string> mInputFiles;
+    std::vector<std::string> mInputEnv;
+    size_t mMaxEntries = 64;
+    std::unordered_map<std::string, Entry> mEntries; ///< key -> output of the script run
+    std::list<std::string> mLRU;                     ///< most recently used first
+    TopologyScriptCacheStats mStats;
+
+    static std::string fileFingerprint(const boost::filesystem::path& file)
+    {
+        namespace bfs = boost::filesystem;
+        boost::system::error_code ec;
+        const uintmax_t size = bfs::file_size(file, ec);
+        if (ec) {
+            return "<missing>";
+        }
+        const std::time_t mtime = bfs::last_write_time(file, ec);
+        std::ifstream in(file.string(), std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return toString(size, ":", mtime, ":", contentHash(content));
+    }
+};
+
+} // namespace odc::core
+
+#endif /* ODC_CORE_TOPOLOGYSCRIPTCACHE */
@@ -0,0 +1,123 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_TRANSITIONSTATS
+#define ODC_CORE_TRANSITIONSTATS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility> // std::pair
+#include <vector>
+
+namespace odc::core {
+
+/**
+ * @brief Completion times of past state transitions, by topology and transition, to derive deadlines for the next ones.
+ *
+ * The deadline of a transition is a quantile of its recorded completion times times a safety factor,
+ * scaled up for more devices than on average in the recorded transitions and bounded below by a minimum.
+ */
+class TransitionStats
+{
+  public:
+    struct Policy
+    {
+        double mFactor = 0;                        ///< safety factor on the quantile, 0 disables deadlines
+        double mQuantile = 0.99;                   ///< quantile of the completion times the deadline is based on
+        size_t mMinSamples = 5;                    ///< completed transitions needed before a deadline is given
+        size_t mMaxSamples = 100;                  ///< most recent completed transitions kept
+        std::chrono::milliseconds mMinDeadline{ 10000 };
+    };
+
+    TransitionStats() = default;
+    TransitionStats(const TransitionStats&) = delete;
+    TransitionStats& operator=(const TransitionStats&) = delete;
+
+    void setPolicy(const Policy& policy)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mPolicy = policy;
+    }
+
+    bool enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mPolicy.mFactor > 0;
+    }
+
+    /// @brief Record the completion time of a transition
+    /// @param topology identifies the topology, e.g. its content hash
+    /// @param transition transition name
+    /// @param duration time from the request to the completion on all devices
+    /// @param numDevices devices that went through the transition
+    void add(const std::string& topology, const std::string& transition, std::chrono::milliseconds duration, size_t numDevices)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto& samples = mSamples[{ topology, transition }];
+        samples.push_back({ duration, numDevices });
+        while (samples.size() > std::max<size_t>(mPolicy.mMaxSamples, 1)) {
+            samples.pop_front();
+        }
+    }
+
+    /// @brief Deadline for a transition, derived from the recorded ones
+    /// @param topology identifies the topology, e.g. its content hash
+    /// @param transition transition name
+    /// @param numDevices devices going through the transition
+    /// @return deadline, none if disabled or not enough transitions are recorded
+    std::optional<std::chrono::milliseconds> deadline(const std::string& topology, const std::string& transition, size_t numDevices) const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mPolicy.mFactor <= 0) {
+            return std::nullopt;
+        }
+        auto it = mSamples.find({ topology, transition });
+        if (it == mSamples.end() || it->second.empty() || it->second.size() < mPolicy.mMinSamples) {
+            return std::nullopt;
+        }
+
+        const auto& samples = it->second;
+        std::vector<std::chrono::milliseconds::rep> durations;
+        durations.reserve(samples.size());
+        double meanDevices = 0;
+        for (const auto& s : samples) {
+            durations.push_back(s.mDuration.count());
+            meanDevices += static_cast<double>(s.mNumDevices) / samples.size();
+        }
+        // nearest-rank quantile
+        const size_t rank = static_cast<size_t>(std::ceil(std::clamp(mPolicy.mQuantile, 0.0, 1.0) * durations.size()));
+        const size_t n = std::min(rank > 0 ? rank - 1 : 0, durations.size() - 1);
+        std::nth_element(durations.begin(), durations.begin() + n, durations.end());
+
+        const double scale = (meanDevices > 0) ? std::max(1.0, numDevices / meanDevices) : 1.0;
+        const auto result = std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(std::ceil(durations.at(n) * mPolicy.mFactor * scale)));
+        return std::max(result, mPolicy.mMinDeadline);
+    }
+
+  private:
+    struct Sample
+    {
+        std::chrono::milliseconds mDuration;
+        size_t mNumDevices;
+    };
+
+    mutable std::mutex mMtx;
+    Policy mPolicy;
+    std::map<std::pair<std::string, std::string>, std::deque<Sample>> mSamples; ///< recorded transitions, by topology and transition
+};
+
+} // namespace odc::core
+
+#endif // ODC_CORE_TRANSITIONSTATS
@@ -0,0 +1,105 @@
+/********************************************************************************
+ * Copyright (C) 2019-2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH  *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef ODC_CORE_VIRTUALCLOCK
+#define ODC_CORE_VIRTUALCLOCK
+
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/wait_traits.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace odc::core
+{
+
+/**
+ * @class VirtualClock
+ * @brief Manually advanced clock, meeting the C++ Clock requirements
+ *
+ * Timers based on this clock (see VirtualTimer) expire only when the clock is advanced,
+ * which allows running timeout scenarios deterministically and without waiting in wall-clock time.
+ * Pass it as the Clock template argument of BasicTopology or of the topology operations.
+ *
+ * @par Thread Safety
+ * Safe. The clock is process-wide.
+ */
+struct VirtualClock
+{
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<VirtualClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept { return time_point(duration(sNow.load())); }
+
+    /// @brief Move the clock forward. Time never goes backwards.
+    static void advance(duration d)
+    {
+        if (d > duration::zero()) {
+            sNow += d.count();
+        }
+    }
+
+    /// @brief Move the clock forward and run all handlers that became ready
+    /// @param ctx I/O context the virtual timers are associated with
+    /// @param d amount of virtual time to advance
+    /// @return number of executed handlers
+    static std::size_t advanceAndPoll(boost::asio::io_context& ctx, duration d)
+    {
+        advance(d);
+        if (ctx.stopped()) {
+            ctx.restart();
+        }
+        // the reactor re-checks pending timers once per poll interval, keep polling until handlers stop scheduling new work
+        std::size_t numHandlers = 0;
+        std::size_t numPolled = 0;
+        do {
+            std::this_thread::sleep_for(kPollInterval);
+            numPolled = ctx.poll();
+            numHandlers += numPolled;
+        } while (numPolled > 0);
+        return numHandlers;
+    }
+
+    /// Real time interval in which the reactor re-checks pending virtual timers
+    static constexpr std::chrono::milliseconds kPollInterval{ 1 };
+
+  private:
+    static inline std::atomic<rep> sNow{ 0 };
+};
+
+/// Waitable timer driven by the VirtualClock
+using VirtualTimer = boost::asio::basic_waitable_timer<VirtualClock>;
+
+} // namespace odc::core
+
+namespace boost::asio
+{
+
+/// Pending virtual timers are re-checked by the reactor in short real intervals, since virtual time can be advanced from any thread
+template<>
+struct wait_traits<odc::core::VirtualClock>
+{
+    static odc::core::VirtualClock::duration to_wait_duration(const odc::core::VirtualClock::duration& d)
+    {
+        return d > odc::core::VirtualClock::duration::zero() ? odc::core::VirtualClock::kPollInterval : odc::core::VirtualClock::duration::zero();
+    }
+
+    static odc::core::VirtualClock::duration to_wait_duration(const odc::core::VirtualClock::time_point& t)
+    {
+        return to_wait_duration(t - odc::core::VirtualClock::now());
+    }
+};
+
+} // namespace boost::asio
+
+#endif /* ODC_CORE_VIRTUALCLOCK */
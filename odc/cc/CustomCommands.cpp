@@ -25,7 +25,7 @@ namespace odc::cc
 
     array<string, 2> resultNames = { { "Ok", "Failure" } };
 
-    array<string, 15> typeNames = { { "CheckState",
+    array<string, 18> typeNames = { { "CheckState",
                                       "ChangeState",
                                       "DumpConfig",
                                       "SubscribeToStateChange",
@@ -40,7 +40,11 @@ namespace odc::cc
                                       "StateChangeUnsubscription",
                                       "StateChange",
                                       "Properties",
-                                      "PropertiesSet" } };
+                                      "PropertiesSet",
+
+                                      "ChangeStateSequence",
+                                      "ChangeStateAt",
+                                      "ScheduledTransition" } };
 
     array<fair::mq::State, 16> fbStateToMQState = { { fair::mq::State::Undefined,
                                                       fair::mq::State::Ok,
@@ -102,7 +106,7 @@ namespace odc::cc
                                                              FBTransition_End,
                                                              FBTransition_ErrorFound } };
 
-    array<FBCmd, 15> typeToFBCmd = { { FBCmd::FBCmd_check_state,
+    array<FBCmd, 18> typeToFBCmd = { { FBCmd::FBCmd_check_state,
                                        FBCmd::FBCmd_change_state,
                                        FBCmd::FBCmd_dump_config,
                                        FBCmd::FBCmd_subscribe_to_state_change,
@@ -116,9 +120,12 @@ namespace odc::cc
                                        FBCmd::FBCmd_state_change_unsubscription,
                                        FBCmd::FBCmd_state_change,
                                        FBCmd::FBCmd_properties,
-                                       FBCmd::FBCmd_properties_set } };
+                                       FBCmd::FBCmd_properties_set,
+                                       FBCmd::FBCmd_change_state_sequence,
+                                       FBCmd::FBCmd_change_state_at,
+                                       FBCmd::FBCmd_scheduled_transition } };
 
-    array<Type, 15> fbCmdToType = { { Type::check_state,
+    array<Type, 18> fbCmdToType = { { Type::check_state,
                                       Type::change_state,
                                       Type::dump_config,
                                       Type::subscribe_to_state_change,
@@ -132,7 +139,10 @@ namespace odc::cc
                                       Type::state_change_unsubscription,
                                       Type::state_change,
                                       Type::properties,
-                                      Type::properties_set } };
+                                      Type::properties_set,
+                                      Type::change_state_sequence,
+                                      Type::change_state_at,
+                                      Type::scheduled_transition } };
 
     fair::mq::State GetMQState(const FBState state)
     {
@@ -197,6 +207,38 @@ namespace odc::cc
                     cmdBuilder->add_transition(GetFBTransition(static_cast<ChangeState&>(*cmd).GetTransition()));
                 }
                 break;
+                case Type::change_state_sequence:
+                {
+                    auto _cmd = static_cast<ChangeStateSequence&>(*cmd);
+                    std::vector<int8_t> transitionsVector;
+                    for (auto const& t : _cmd.GetTransitions())
+                    {
+                        transitionsVector.push_back(GetFBTransition(t));
+                    }
+                    auto transitions = fbb.CreateVector(transitionsVector);
+                    std::vector<flatbuffers::Offset<FBProperty>> propsVector;
+                    for (auto const& e : _cmd.GetProps())
+                    {
+                        auto const key(fbb.CreateString(e.first));
+                        auto const val(fbb.CreateString(e.second));
+                        propsVector.push_back(CreateFBProperty(fbb, key, val));
+                    }
+                    auto props = fbb.CreateVector(propsVector);
+                    cmdBuilder = make_unique<FBCommandBuilder>(fbb);
+                    cmdBuilder->add_request_id(_cmd.GetRequestId());
+                    cmdBuilder->add_transitions(transitions);
+                    cmdBuilder->add_properties(props);
+                }
+                break;
+                case Type::change_state_at:
+                {
+                    auto _cmd = static_cast<ChangeStateAt&>(*cmd);
+                    cmdBuilder = make_unique<FBCommandBuilder>(fbb);
+                    cmdBuilder->add_request_id(_cmd.GetRequestId());
+                    cmdBuilder->add_transition(GetFBTransition(_cmd.GetTransition()));
+                    cmdBuilder->add_timestamp(_cmd.GetTimestamp());
+                }
+                break;
                 case Type::dump_config:
                 {
                     cmdBuilder = make_unique<FBCommandBuilder>(fbb);
@@ -333,6 +375,19 @@ namespace odc::cc
                     cmdBuilder->add_result(GetFBResult(_cmd.GetResult()));
                 }
                 break;
+                case Type::scheduled_transition:
+                {
+                    auto _cmd = static_cast<ScheduledTransition&>(*cmd);
+                    auto deviceId = fbb.CreateString(_cmd.GetDeviceId());
+                    cmdBuilder = make_unique<FBCommandBuilder>(fbb);
+                    cmdBuilder->add_device_id(deviceId);
+                    cmdBuilder->add_task_id(_cmd.GetTaskId());
+                    cmdBuilder->add_request_id(_cmd.GetRequestId());
+                    cmdBuilder->add_result(GetFBResult(_cmd.GetResult()));
+                    cmdBuilder->add_transition(GetFBTransition(_cmd.GetTransition()));
+                    cmdBuilder->add_delay(_cmd.GetDelay());
+                }
+                break;
                 default:
                     throw CommandFormatError("unrecognized command type given to odc::cc::Cmds::Serialize()");
                     break;
@@ -372,6 +427,26 @@ namespace odc::cc
                 case FBCmd_change_state:
                     fCmds.emplace_back(make<ChangeState>(GetMQTransition(cmdPtr.transition())));
                     break;
+                case FBCmd_change_state_sequence:
+                {
+                    std::vector<fair::mq::Transition> transitions;
+                    auto ts = cmdPtr.transitions();
+                    for (unsigned int j = 0; j < ts->size(); ++j)
+                    {
+                        transitions.push_back(GetMQTransition(static_cast<FBTransition>(ts->Get(j))));
+                    }
+                    std::vector<std::pair<std::string, std::string>> properties;
+                    auto props = cmdPtr.properties();
+                    for (unsigned int j = 0; j < props->size(); ++j)
+                    {
+                        properties.emplace_back(props->Get(j)->key()->str(), props->Get(j)->value()->str());
+                    }
+                    fCmds.emplace_back(make<ChangeStateSequence>(cmdPtr.request_id(), transitions, properties));
+                }
+                break;
+                case FBCmd_change_state_at:
+                    fCmds.emplace_back(make<ChangeStateAt>(cmdPtr.request_id(), GetMQTransition(cmdPtr.transition()), cmdPtr.timestamp()));
+                    break;
                 case FBCmd_dump_config:
                     fCmds.emplace_back(make<DumpConfig>());
                     break;
@@ -441,6 +516,14 @@ namespace odc::cc
                     fCmds.emplace_back(make<PropertiesSet>(
                         cmdPtr.device_id()->str(), cmdPtr.task_id(), cmdPtr.request_id(), GetResult(cmdPtr.result())));
                     break;
+                case FBCmd_scheduled_transition:
+                    fCmds.emplace_back(make<ScheduledTransition>(cmdPtr.device_id()->str(),
+                                                                 cmdPtr.task_id(),
+                                                                 cmdPtr.request_id(),
+                                                                 GetResult(cmdPtr.result()),
+                                                                 GetMQTransition(cmdPtr.transition()),
+                                                                 cmdPtr.delay()));
+                    break;
                 default:
                     throw CommandFormatError("unrecognized command type given to odc::cc::Cmds::Deserialize()");
                     break;
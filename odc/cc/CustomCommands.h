@@ -51,7 +51,11 @@ namespace odc::cc
         state_change_unsubscription, // args: { device_id, task_id, Result }
         state_change,                // args: { device_id, task_id, last_state, current_state }
         properties,                  // args: { device_id, task_id, request_id, Result, properties }
-        properties_set               // args: { device_id, task_id, request_id, Result }
+        properties_set,              // args: { device_id, task_id, request_id, Result }
+
+        change_state_sequence,       // args: { request_id, transitions, properties }
+        change_state_at,             // args: { request_id, transition, timestamp }
+        scheduled_transition         // args: { device_id, task_id, request_id, Result, transition, delay }
     };
 
     struct Cmd
@@ -100,6 +104,94 @@ namespace odc::cc
         fair::mq::Transition fTransition;
     };
 
+    /// Transitions performed by the device one after another, each started once the previous one is done.
+    /// Properties, if any, are set before the CompleteInit transition, or before the first transition if CompleteInit is not part of the sequence.
+    struct ChangeStateSequence : Cmd
+    {
+        explicit ChangeStateSequence(std::size_t request_id,
+                                     std::vector<fair::mq::Transition> transitions,
+                                     std::vector<std::pair<std::string, std::string>> properties = {})
+            : Cmd(Type::change_state_sequence)
+            , fRequestId(request_id)
+            , fTransitions(std::move(transitions))
+            , fProperties(std::move(properties))
+        {
+        }
+
+        auto GetRequestId() const -> std::size_t
+        {
+            return fRequestId;
+        }
+        auto SetRequestId(std::size_t requestId) -> void
+        {
+            fRequestId = requestId;
+        }
+        auto GetTransitions() const -> std::vector<fair::mq::Transition>
+        {
+            return fTransitions;
+        }
+        auto SetTransitions(std::vector<fair::mq::Transition> transitions) -> void
+        {
+            fTransitions = std::move(transitions);
+        }
+        auto GetProps() const -> std::vector<std::pair<std::string, std::string>>
+        {
+            return fProperties;
+        }
+        auto SetProps(std::vector<std::pair<std::string, std::string>> properties) -> void
+        {
+            fProperties = std::move(properties);
+        }
+
+      private:
+        std::size_t fRequestId;
+        std::vector<fair::mq::Transition> fTransitions;
+        std::vector<std::pair<std::string, std::string>> fProperties;
+    };
+
+    /// Transition started by the device at the given time, in nanoseconds since the epoch of the system clock.
+    /// The device replies with ScheduledTransition once it started the transition.
+    struct ChangeStateAt : Cmd
+    {
+        explicit ChangeStateAt(std::size_t request_id, fair::mq::Transition transition, int64_t timestamp)
+            : Cmd(Type::change_state_at)
+            , fRequestId(request_id)
+            , fTransition(transition)
+            , fTimestamp(timestamp)
+        {
+        }
+
+        auto GetRequestId() const -> std::size_t
+        {
+            return fRequestId;
+        }
+        auto SetRequestId(std::size_t requestId) -> void
+        {
+            fRequestId = requestId;
+        }
+        fair::mq::Transition GetTransition() const
+        {
+            return fTransition;
+        }
+        void SetTransition(fair::mq::Transition transition)
+        {
+            fTransition = transition;
+        }
+        int64_t GetTimestamp() const
+        {
+            return fTimestamp;
+        }
+        void SetTimestamp(int64_t timestamp)
+        {
+            fTimestamp = timestamp;
+        }
+
+      private:
+        std::size_t fRequestId;
+        fair::mq::Transition fTransition;
+        int64_t fTimestamp;
+    };
+
     struct DumpConfig : Cmd
     {
         explicit DumpConfig()
@@ -568,6 +660,83 @@ namespace odc::cc
         Result fResult;
     };
 
+    /// Reply to ChangeStateAt. The delay is the time in nanoseconds from the requested to the actual start of the transition.
+    struct ScheduledTransition : Cmd
+    {
+        explicit ScheduledTransition(std::string deviceId,
+                                     const uint64_t taskId,
+                                     std::size_t requestId,
+                                     const Result result,
+                                     const fair::mq::Transition transition,
+                                     int64_t delay)
+            : Cmd(Type::scheduled_transition)
+            , fDeviceId(std::move(deviceId))
+            , fTaskId(taskId)
+            , fRequestId(requestId)
+            , fResult(result)
+            , fTransition(transition)
+            , fDelay(delay)
+        {
+        }
+
+        std::string GetDeviceId() const
+        {
+            return fDeviceId;
+        }
+        void SetDeviceId(const std::string& deviceId)
+        {
+            fDeviceId = deviceId;
+        }
+        uint64_t GetTaskId() const
+        {
+            return fTaskId;
+        }
+        void SetTaskId(const uint64_t taskId)
+        {
+            fTaskId = taskId;
+        }
+        auto GetRequestId() const -> std::size_t
+        {
+            return fRequestId;
+        }
+        auto SetRequestId(std::size_t requestId) -> void
+        {
+            fRequestId = requestId;
+        }
+        Result GetResult() const
+        {
+            return fResult;
+        }
+        void SetResult(const Result result)
+        {
+            fResult = result;
+        }
+        fair::mq::Transition GetTransition() const
+        {
+            return fTransition;
+        }
+        void SetTransition(const fair::mq::Transition transition)
+        {
+            fTransition = transition;
+        }
+        int64_t GetDelay() const
+        {
+            return fDelay;
+        }
+        void SetDelay(int64_t delay)
+        {
+            fDelay = delay;
+        }
+
+      private:
+        std::string fDeviceId;
+        uint64_t fTaskId;
+        std::size_t fRequestId;
+        Result fResult;
+        fair::mq::Transition fTransition;
+        int64_t fDelay;
+    };
+
     template <typename C, typename... Args>
     std::unique_ptr<Cmd> make(Args&&... args)
     {
@@ -56,6 +56,7 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         request.set_topology(activateParams.mTopoFile);
         request.set_content(activateParams.mTopoContent);
         request.set_script(activateParams.mTopoScript);
+        request.set_topologyhash(activateParams.mTopoHash);
         odc::GeneralReply reply;
         grpc::ClientContext context;
         grpc::Status status = mStub->Activate(&context, request, &reply);
@@ -71,7 +72,10 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         request.set_topology(runParams.mTopoFile);
         request.set_content(runParams.mTopoContent);
         request.set_script(runParams.mTopoScript);
+        request.set_topologyhash(runParams.mTopoHash);
         request.set_extracttoporesources(runParams.mExtractTopoResources);
+        request.set_pipelined(runParams.mPipelined);
+        request.set_standby(runParams.mStandby);
         odc::GeneralReply reply;
         grpc::ClientContext context;
         grpc::Status status = mStub->Run(&context, request, &reply);
@@ -87,6 +91,7 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         updateCommonParams(common, &request);
         request.set_path(deviceParams.mPath);
         request.set_detailed(deviceParams.mDetailed);
+        request.set_host(deviceParams.mHost);
         odc::StateReply reply;
         grpc::ClientContext context;
         grpc::Status status = mStub->GetState(&context, request, &reply);
@@ -144,6 +149,16 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         return GetGeneralReplyString(status, reply);
     }
 
+    std::string requestTakeover(const odc::core::CommonParams& common)
+    {
+        odc::TakeoverRequest request;
+        updateCommonParams(common, &request);
+        odc::StateReply reply;
+        grpc::ClientContext context;
+        grpc::Status status = mStub->Takeover(&context, request, &reply);
+        return GetStateReplyString(status, reply);
+    }
+
     std::string requestStatus(const odc::core::StatusParams& statusParams)
     {
         odc::StatusRequest request;
@@ -160,6 +175,7 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         odc::UpdateRequest request;
         updateCommonParams(common, &request);
         request.set_topology(updateParams.mTopoFile);
+        request.set_topologyhash(updateParams.mTopoHash);
         odc::GeneralReply reply;
         grpc::ClientContext context;
         grpc::Status status = mStub->Update(&context, request, &reply);
@@ -174,6 +190,9 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
         updateCommonParams(common, stateChange);
         stateChange->set_path(deviceParams.mPath);
         stateChange->set_detailed(deviceParams.mDetailed);
+        stateChange->set_host(deviceParams.mHost);
+        stateChange->set_rolloutmaxdevices(deviceParams.mRollout.mMaxDevices);
+        stateChange->set_rolloutmaxperhost(deviceParams.mRollout.mMaxPerHost);
 
         Request request;
         request.set_allocated_request(stateChange);
@@ -196,6 +215,9 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
                << "; topology state: " << rep.state()
                << "; execution time: " << rep.exectime() << "ms"
                << "; RMS job IDs: "    << rep.rmsjobids();
+            if (!rep.topologyhash().empty()) {
+                ss << "; topology hash: " << rep.topologyhash();
+            }
             if (!rep.hosts().empty()) {
                 ss << "\n  Hosts:\n    ";
                 for (int i = 0; i < rep.hosts().size(); ++i) {
@@ -232,7 +254,8 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
                     << "; path: "       << d.path()
                     << "; ignored: "    << d.ignored()
                     << "; expendable: " << d.expendable()
-                    << "; RMS job ID: " << d.rmsjobid() << "\n";
+                    << "; RMS job ID: " << d.rmsjobid()
+                    << "; restarts: "   << d.restarts() << "\n";
                 }
             }
             if (!rep.collections().empty()) {
@@ -263,7 +286,32 @@ class GrpcClient : public odc::core::CliControllerHelper<GrpcClient>
                        << "; DDS session: " << odc::SessionStatus_Name(p.status())
                        << "; DDS session ID: " << p.sessionid()
                        << "; Run Nr.: " << p.runnr()
-                       << "; topology state: " << p.state() << "\n";
+                       << "; topology state: " << p.state()
+                       << "; agents: " << p.numagents()
+                       << "; slots: " << p.numslots();
+                    if (!p.standbyfor().empty()) {
+                        ss << "; standby for: " << p.standbyfor() << " (" << p.standbystate() << ")";
+                    }
+                    ss << "\n";
+                }
+                ss << "  topology script cache: hits: " << rep.toposcriptcache().hits()
+                   << "; misses: " << rep.toposcriptcache().misses()
+                   << "; saved time: " << rep.toposcriptcache().savedtime() << "ms\n";
+                ss << "  DDS session pool: size: " << rep.sessionpool().size()
+                   << "; ready: " << rep.sessionpool().ready()
+                   << "; hits: " << rep.sessionpool().hits()
+                   << "; misses: " << rep.sessionpool().misses()
+                   << "; created: " << rep.sessionpool().created()
+                   << "; failed: " << rep.sessionpool().failed()
+                   << "; creation time: " << rep.sessionpool().createtime() << "ms\n";
+                for (const auto& p : rep.agentpools()) {
+                    ss << "  agent pool: zone: " << p.zone()
+                       << "; agent group: " << p.agentgroup()
+                       << "; agents: " << p.numagents()
+                       << "; slots: " << p.numslots()
+                       << "; state: " << p.state()
+                       << "; DDS session ID: " << p.sessionid()
+                       << "; adopted: " << p.numadopted() << "\n";
                 }
                 ss << "  execution time: " << rep.exectime() << "ms\n";
             } else {
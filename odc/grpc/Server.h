@@ -9,6 +9,7 @@
 #ifndef ODC_GRPCSERVER
 #define ODC_GRPCSERVER
 
+#include <odc/Admission.h>
 #include <odc/DDSSubmit.h>
 #include <odc/Controller.h>
 #include <odc/Logger.h>
@@ -25,16 +26,35 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include <cassert>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 #include <string>
+#include <thread>
 
 namespace odc {
 
 class GrpcServer final : public odc::ODC::Service
 {
   public:
-    GrpcServer() {}
+    GrpcServer()
+    {
+        // a recovery waits for the requests in progress on its partition, like a request on the whole partition
+        mController.setRecoveryAdmission([this](const std::string& partitionID, const std::function<void()>& recover) {
+            const auto admission{ getAdmission(partitionID).admitPartition() };
+            recover();
+        });
+    }
+
+    ~GrpcServer()
+    {
+        if (mRestoreThread.joinable()) {
+            mRestoreThread.join();
+        }
+    }
 
     void run(const std::string& host)
     {
@@ -48,11 +68,67 @@ class GrpcServer final : public odc::ODC::Service
     void setTimeout(const std::chrono::seconds& timeout) { mController.setTimeout(timeout); }
     void setAgentWaitTimeout(const std::string& agentWaitTimeoutStr) { mController.setAgentWaitTimeout(agentWaitTimeoutStr); }
     void setHistoryDir(const std::string& dir) { mController.setHistoryDir(dir); }
+    void setPersistence(const std::string& fsync, std::chrono::seconds compactionInterval) { mController.setPersistence(fsync, compactionInterval); }
     void setZoneCfgs(const std::vector<std::string>& zonesStr) { mController.setZoneCfgs(zonesStr); }
     void setRMS(const std::string& rms) { mController.setRMS(rms); }
+    void setSubmitParallelism(size_t parallelism) { mController.setSubmitParallelism(parallelism); }
+    void setSubmitSurplus(uint32_t percent) { mController.setSubmitSurplus(percent); }
+    void setAgentPools(const std::vector<std::string>& poolsStr) { mController.setAgentPools(poolsStr); }
+    void setSessionPool(size_t size) { mController.setSessionPool(size); }
+    void setMacroTransitions(bool enable) { mController.setMacroTransitions(enable); }
+    void setPipelinedTransitions(bool enable) { mController.setPipelinedTransitions(enable); }
+    void setRolloutPolicies(const std::vector<std::string>& policiesStr) { mController.setRolloutPolicies(policiesStr); }
+    void setScheduledStart(std::chrono::milliseconds margin) { mController.setScheduledStart(margin); }
+    void setOrderedStartStop(bool enable) { mController.setOrderedStartStop(enable); }
+    void setAdaptiveTimeouts(double factor, std::chrono::milliseconds minimum) { mController.setAdaptiveTimeouts(factor, minimum); }
+    void setTopologyCache(const std::string& dir, size_t maxSizeMB) { mController.setTopologyCache(dir, maxSizeMB); }
+    void setTopologyScriptCache(const std::vector<std::string>& inputFiles, const std::vector<std::string>& inputEnv) { mController.setTopologyScriptCache(inputFiles, inputEnv); }
 
     void registerResourcePlugins(const core::PluginManager::PluginMap& pluginMap) { mController.registerResourcePlugins(pluginMap); }
-    void restore(const std::string& restoreId, const std::string& restoreDir) { mController.restore(restoreId, restoreDir); }
+    void setRestoreParallelism(size_t parallelism) { mController.setRestoreParallelism(parallelism); }
+    void setSnapshotInterval(std::chrono::seconds interval) { mController.setSnapshotInterval(interval); }
+    void setCollectionRecovery(bool enable) { mController.setCollectionRecovery(enable); }
+    void setTaskRestart(uint32_t maxRestarts, std::chrono::seconds window, std::chrono::seconds timeout)
+    {
+        core::RestartLimiter::Config config;
+        config.mMaxRestarts = maxRestarts;
+        config.mWindow = window;
+        config.mTimeout = timeout;
+        mController.setTaskRestart(config);
+    }
+
+    /// @brief Restore partitions in the background. Returns once all partitions to restore are known,
+    /// requests to them wait until their own restore completed, requests to other partitions are served right away.
+    void restore(const std::string& restoreId, const std::string& restoreDir)
+    {
+        std::promise<void> restoring;
+        std::future<void> restoringFuture = restoring.get_future();
+        mRestoreThread = std::thread([this, restoreId, restoreDir, restoring = std::move(restoring)]() mutable {
+            // admissions of the partitions being restored, released as each one completes
+            std::map<std::string, core::Admission::Ticket> tickets;
+            std::mutex ticketsMutex;
+            try {
+                mController.restore(restoreId, restoreDir,
+                    [&](const std::vector<std::string>& partitionIDs) {
+                        {
+                            std::lock_guard<std::mutex> lock(ticketsMutex);
+                            for (const auto& partitionID : partitionIDs) {
+                                tickets.emplace(partitionID, getAdmission(partitionID).admitPartition());
+                            }
+                        }
+                        restoring.set_value();
+                    },
+                    [&](const std::string& partitionID) {
+                        std::lock_guard<std::mutex> lock(ticketsMutex);
+                        tickets.erase(partitionID);
+                    });
+            } catch (const std::exception& e) {
+                OLOG(error) << "Restore failed: " << e.what();
+            }
+        });
+        // a failed restore leaves the promise unfulfilled, which also ends the wait
+        restoringFuture.wait();
+    }
 
   private:
     ::grpc::Status Initialize(::grpc::ServerContext* ctx, const odc::InitializeRequest* req, odc::GeneralReply* rep) override
@@ -64,7 +140,7 @@ class GrpcServer final : public odc::ODC::Service
         logCommonRequest("Initialize", client, common, req);
         OLOG(info, common) << "Initialize request session ID: " << req->sessionid();
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
         const core::InitializeParams initializeParams{ req->sessionid() };
         const core::RequestResult res{ mController.execInitialize(common, initializeParams) };
@@ -83,7 +159,7 @@ class GrpcServer final : public odc::ODC::Service
         logCommonRequest("Submit", client, common, req);
         OLOG(info, common) << "Submit request plugin: " << req->plugin() << "; resources: " << req->resources();
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
         const core::SubmitParams submitParams{ req->plugin(), req->resources() };
         const core::RequestResult res{ mController.execSubmit(common, submitParams) };
@@ -102,6 +178,7 @@ class GrpcServer final : public odc::ODC::Service
         logCommonRequest("Activate", client, common, req);
         OLOG(info, common) << "Activate request topology file: " << req->topology();
         OLOG(info, common) << "Activate request topology content: "  << req->content();
+        OLOG(info, common) << "Activate request topology hash: " << req->topologyhash();
         if (req->script().empty()) {
             OLOG(info, common) << "Activate request topology script: " << req->script();
         } else {
@@ -114,9 +191,9 @@ class GrpcServer final : public odc::ODC::Service
             OLOG(info, common) << "Run request END OF TOPOLOGY SCRIPT";
         }
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
-        const core::ActivateParams activateParams{ req->topology(), req->content(), req->script() };
+        const core::ActivateParams activateParams{ req->topology(), req->content(), req->script(), req->topologyhash() };
         const core::RequestResult res{ mController.execActivate(common, activateParams) };
 
         setupGeneralReply(rep, res);
@@ -133,9 +210,12 @@ class GrpcServer final : public odc::ODC::Service
         logCommonRequest("Run", client, common, req);
         OLOG(info, common) << "Run request plugin: " << req->plugin()
                            << "; resources: " << req->resources()
-                           << "; extractTopoResources: " << req->extracttoporesources();
+                           << "; extractTopoResources: " << req->extracttoporesources()
+                           << "; pipelined: " << req->pipelined()
+                           << "; standby: " << req->standby();
         OLOG(info, common) << "Run request topology file: " << req->topology();
         OLOG(info, common) << "Run request topology content: "  << req->content();
+        OLOG(info, common) << "Run request topology hash: " << req->topologyhash();
         if (req->script().empty()) {
             OLOG(info, common) << "Run request topology script: " << req->script();
         } else {
@@ -148,9 +228,9 @@ class GrpcServer final : public odc::ODC::Service
             OLOG(info, common) << "Run request END OF TOPOLOGY SCRIPT";
         }
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
-        const core::RunParams runParams{ req->plugin(), req->resources(), req->topology(), req->content(), req->script(), req->extracttoporesources() };
+        const core::RunParams runParams{ req->plugin(), req->resources(), req->topology(), req->content(), req->script(), req->extracttoporesources(), req->topologyhash(), req->pipelined(), req->standby() };
         const core::RequestResult res{ mController.execRun(common, runParams) };
 
         setupGeneralReply(rep, res);
@@ -168,10 +248,11 @@ class GrpcServer final : public odc::ODC::Service
         OLOG(info, common) << "Update request topology: " << req->topology();
         OLOG(info, common) << "Update request content: "  << req->content();
         OLOG(info, common) << "Update request script: "   << req->script();
+        OLOG(info, common) << "Update request hash: "     << req->topologyhash();
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
-        const core::UpdateParams updateParams{ req->topology(), req->content(), req->script() };
+        const core::UpdateParams updateParams{ req->topology(), req->content(), req->script(), req->topologyhash() };
         const core::RequestResult res{ mController.execUpdate(common, updateParams) };
 
         setupGeneralReply(rep, res);
@@ -188,7 +269,7 @@ class GrpcServer final : public odc::ODC::Service
         logCommonRequest("GetState", client, common, req, true);
         OLOG(debug, common) << "GetState request detailed: " << req->detailed() << "; path: " << std::quoted(req->path());
 
-        const core::DeviceParams deviceParams{ req->path(), req->detailed() };
+        const core::DeviceParams deviceParams{ req->path(), req->detailed(), req->host() };
         const core::RequestResult res{ mController.execGetState(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -214,7 +295,7 @@ class GrpcServer final : public odc::ODC::Service
             props.push_back(core::SetPropertiesParams::Prop(prop.key(), prop.value()));
         }
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->path()); }) };
 
         const core::SetPropertiesParams setPropertiesParams{ props, req->path() };
         const core::RequestResult res{ mController.execSetProperties(common, setPropertiesParams) };
@@ -232,9 +313,9 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Configure", client, common, &(req->request()));
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->request().path()); }) };
 
-        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed() };
+        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed(), req->request().host(), rolloutPolicy(req->request()) };
         const core::RequestResult res{ mController.execConfigure(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -250,9 +331,9 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Start", client, common, &(req->request()));
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->request().path()); }) };
 
-        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed() };
+        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed(), req->request().host(), rolloutPolicy(req->request()) };
         const core::RequestResult res{ mController.execStart(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -268,9 +349,9 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Stop", client, common, &(req->request()));
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->request().path()); }) };
 
-        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed() };
+        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed(), req->request().host(), rolloutPolicy(req->request()) };
         const core::RequestResult res{ mController.execStop(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -286,9 +367,9 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Reset", client, common, &(req->request()));
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->request().path()); }) };
 
-        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed() };
+        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed(), req->request().host(), rolloutPolicy(req->request()) };
         const core::RequestResult res{ mController.execReset(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -304,9 +385,9 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Terminate", client, common, &(req->request()));
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitTasks([&]() { return mController.getTasks(common.mPartitionID, req->request().path()); }) };
 
-        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed() };
+        const core::DeviceParams deviceParams{ req->request().path(), req->request().detailed(), req->request().host(), rolloutPolicy(req->request()) };
         const core::RequestResult res{ mController.execTerminate(common, deviceParams) };
 
         setupStateReply(rep, res);
@@ -322,7 +403,7 @@ class GrpcServer final : public odc::ODC::Service
 
         logCommonRequest("Shutdown", client, common, req);
 
-        std::lock_guard<std::mutex> lock(getMutex(common.mPartitionID));
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
 
         const core::RequestResult res{ mController.execShutdown(common) };
 
@@ -331,6 +412,23 @@ class GrpcServer final : public odc::ODC::Service
         return ::grpc::Status::OK;
     }
 
+    ::grpc::Status Takeover(::grpc::ServerContext* ctx, const odc::TakeoverRequest* req, odc::StateReply* rep) override
+    {
+        assert(ctx);
+        const std::string client{ clientMetadataAsString(*ctx) };
+        const core::CommonParams common(req->partitionid(), req->runnr(), req->timeout());
+
+        logCommonRequest("Takeover", client, common, req);
+
+        const auto admission{ getAdmission(common.mPartitionID).admitPartition() };
+
+        const core::RequestResult res{ mController.execTakeover(common) };
+
+        setupStateReply(rep, res);
+        logStateReply("Takeover", common, *rep);
+        return ::grpc::Status::OK;
+    }
+
     ::grpc::Status Status(::grpc::ServerContext* ctx, const odc::StatusRequest* req, odc::StatusReply* rep) override
     {
         assert(ctx);
@@ -368,6 +466,7 @@ class GrpcServer final : public odc::ODC::Service
         rep->set_exectime(res.mExecTime);
         rep->set_state(GetAggregatedStateName(res.mTopologyState.aggregated));
         rep->set_rmsjobids(res.mRMSJobIDs);
+        rep->set_topologyhash(res.mTopoHash);
         for (const auto& host : res.mHosts) {
             rep->add_hosts(host);
         }
@@ -390,6 +489,7 @@ class GrpcServer final : public odc::ODC::Service
                 device->set_host(task.mHost);
                 device->set_expendable(task.mStatus.expendable);
                 device->set_rmsjobid(task.mRMSJobID);
+                device->set_restarts(task.mStatus.restarts);
             }
 
             for (const auto& collection : res.mTopologyState.detailed.value().collections) {
@@ -418,14 +518,47 @@ class GrpcServer final : public odc::ODC::Service
             partition->set_sessionid(p.mDDSSessionID);
             partition->set_status((p.mDDSSessionStatus == core::DDSSessionStatus::running ? SessionStatus::RUNNING : SessionStatus::STOPPED));
             partition->set_state(GetAggregatedStateName(p.mAggregatedState));
+            partition->set_numagents(p.mNumAgents);
+            partition->set_numslots(p.mNumSlots);
+            partition->set_standbyfor(p.mStandbyFor);
+            partition->set_standbystate(p.mStandbyState);
         }
+        auto scriptCache{ rep->mutable_toposcriptcache() };
+        scriptCache->set_hits(res.mTopoScriptCacheStats.mHits);
+        scriptCache->set_misses(res.mTopoScriptCacheStats.mMisses);
+        scriptCache->set_savedtime(res.mTopoScriptCacheStats.mSavedTime.count());
+        auto sessionPool{ rep->mutable_sessionpool() };
+        sessionPool->set_size(res.mSessionPool.mSize);
+        sessionPool->set_ready(res.mSessionPool.mNumReady);
+        sessionPool->set_hits(res.mSessionPool.mHits);
+        sessionPool->set_misses(res.mSessionPool.mMisses);
+        sessionPool->set_created(res.mSessionPool.mNumCreated);
+        sessionPool->set_failed(res.mSessionPool.mNumFailed);
+        sessionPool->set_createtime(res.mSessionPool.mCreateTime.count());
+        for (const auto& p : res.mAgentPools) {
+            auto pool{ rep->add_agentpools() };
+            pool->set_zone(p.mZone);
+            pool->set_agentgroup(p.mAgentGroup);
+            pool->set_numagents(p.mNumAgents);
+            pool->set_numslots(p.mNumSlots);
+            pool->set_sessionid(p.mDDSSessionID);
+            pool->set_state(p.mState);
+            pool->set_numadopted(p.mNumAdopted);
+        }
+    }
+
+    static core::RolloutPolicy rolloutPolicy(const odc::StateRequest& req)
+    {
+        core::RolloutPolicy policy;
+        policy.mMaxDevices = req.rolloutmaxdevices();
+        policy.mMaxPerHost = req.rolloutmaxperhost();
+        return policy;
     }
 
-    std::mutex& getMutex(const std::string& partitionID)
+    core::Admission& getAdmission(const std::string& partitionID)
     {
-        std::lock_guard<std::mutex> lock(mMutexMapMutex);
-        auto it{ mMutexMap.find(partitionID) };
-        return (it == mMutexMap.end()) ? mMutexMap[partitionID] : it->second;
+        std::lock_guard<std::mutex> lock(mAdmissionMapMutex);
+        return mAdmissionMap[partitionID];
     }
 
     template<typename Request>
@@ -487,7 +620,8 @@ class GrpcServer final : public odc::ODC::Service
                                    << "; ignored: " << d.ignored()
                                    << "; host: "    << d.host()
                                    << "; expendable: " << d.expendable()
-                                   << "; RMS job ID: " << d.rmsjobid();
+                                   << "; RMS job ID: " << d.rmsjobid()
+                                   << "; restarts: " << d.restarts();
             }
         }
     }
@@ -501,7 +635,29 @@ class GrpcServer final : public odc::ODC::Service
                            << "; DDS session: " << odc::SessionStatus_Name(p.status())
                            << "; DDS session ID: " << p.sessionid()
                            << "; Run Nr.: " << p.runnr()
-                           << "; topology state: " << p.state();
+                           << "; topology state: " << p.state()
+                           << "; agents: " << p.numagents()
+                           << "; slots: " << p.numslots()
+                           << (p.standbyfor().empty() ? "" : "; standby for: " + p.standbyfor() + " (" + p.standbystate() + ")");
+            }
+            OLOG(info) << "Topology script cache: hits: " << rep.toposcriptcache().hits()
+                       << "; misses: " << rep.toposcriptcache().misses()
+                       << "; saved time: " << rep.toposcriptcache().savedtime() << "ms";
+            OLOG(info) << "DDS session pool: size: " << rep.sessionpool().size()
+                       << "; ready: " << rep.sessionpool().ready()
+                       << "; hits: " << rep.sessionpool().hits()
+                       << "; misses: " << rep.sessionpool().misses()
+                       << "; created: " << rep.sessionpool().created()
+                       << "; failed: " << rep.sessionpool().failed()
+                       << "; creation time: " << rep.sessionpool().createtime() << "ms";
+            for (const auto& p : rep.agentpools()) {
+                OLOG(info) << "Agent pool: zone: " << p.zone()
+                           << "; agent group: " << p.agentgroup()
+                           << "; agents: " << p.numagents()
+                           << "; slots: " << p.numslots()
+                           << "; state: " << p.state()
+                           << "; DDS session ID: " << p.sessionid()
+                           << "; adopted: " << p.numadopted();
             }
         } else {
             OLOG(error) << "Status: " << rep.DebugString();
@@ -517,11 +673,12 @@ class GrpcServer final : public odc::ODC::Service
             }));
     }
 
-    core::Controller mController; ///< Core ODC service
-
-    // Mutex for each partition - all requests for a certain partition are processed sequentially.
-    std::map<std::string, std::mutex> mMutexMap; ///< Mutex for each partition
-    std::mutex mMutexMapMutex;                   ///< Mutex of global mutex map
+    // Admission for each partition - requests on the whole partition are processed sequentially,
+    // requests on disjoint sets of tasks of a partition concurrently.
+    std::map<std::string, core::Admission> mAdmissionMap; ///< Admission for each partition
+    std::mutex mAdmissionMapMutex;                        ///< Mutex of global admission map
+    core::Controller mController;                         ///< Core ODC service. Declared after the admissions: its background recoveries use them until it is destroyed.
+    std::thread mRestoreThread;                           ///< Restores partitions at startup
 };
 
 } // namespace odc::grpc
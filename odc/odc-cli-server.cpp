@@ -43,6 +43,15 @@ int main(int argc, char** argv)
         string restoreId;
         string restoreDir;
         string historyDir;
+        string topoCacheDir;
+        size_t topoCacheSize;
+        size_t submitParallelism;
+        uint32_t submitSurplus;
+        vector<string> agentPools;
+        vector<string> rolloutPolicies;
+        size_t sessionPoolSize;
+        vector<string> topoScriptInputs;
+        vector<string> topoScriptEnv;
 
         bpo::options_description options("odc-cli-server options");
         options.add_options()
@@ -52,10 +61,34 @@ int main(int argc, char** argv)
             ("rp", bpo::value<std::vector<std::string>>()->multitoken(), "Register resource plugins ( name1:cmd1 name2:cmd2 )")
             ("zones", bpo::value<vector<string>>(&zonesStr)->multitoken()->composing(), "Zones in <name>:<cfgFilePath>:<envFilePath> format")
             ("agent-wait-timeout", bpo::value<string>(&agentWaitTimeoutStr)->default_value(""), "Override timeout for waiting for active agents in seconds or percentage. If empty, default request timeout is taken. Format: with % or 's' suffix, e.g.: '10s' or '10%'. When percentage is given, it is calculated from the request timeout.")
+            ("submit-parallelism", bpo::value<size_t>(&submitParallelism)->default_value(1), "Maximum number of agent group submissions in flight, the next group is submitted as soon as one is acknowledged. 1 submits the groups one after another")
+            ("submit-surplus", bpo::value<uint32_t>(&submitSurplus)->default_value(0), "Request this many percent more agents for agent groups protected by nMin, proceed once the required ones are active and release the rest. 0 disables")
+            ("recover-collections", bpo::bool_switch()->default_value(false), "Replace collections that failed and were ignored under nMin during the run: submit replacement agents, grow the group of the failed collections by a topology update and bring the new collections to the state of the partition. Replacement agents use --rms and --zones. Past Idle, collections binding channels that other devices connect to are not replaced: connected devices do not connect again")
+            ("restart-expendable", bpo::value<uint32_t>()->default_value(0), "Take failed expendable tasks back into their partition once they are started again on their agent, e.g. by a restart loop around their executable, and bring them to the state of the partition. DDS does not start tasks again and, with such a loop, does not see the task exit: failures are detected by the Error state, a task is taken back once it reports a state other than Error or Exiting. Maximum number of restarts of a task within --restart-window, 0 disables")
+            ("restart-window", bpo::value<size_t>()->default_value(600), "Window in seconds in which the restarts of an expendable task are counted, further failures leave it ignored")
+            ("restart-timeout", bpo::value<size_t>()->default_value(60), "Time in seconds a failed expendable task has to report back after its restart backoff, it stays ignored afterwards")
+            ("agent-pool", bpo::value<vector<string>>(&agentPools)->multitoken()->composing(), "Keep pre-warmed DDS agents, adopted by the next partition that requests matching resources. Format: <zone>:<agentGroup>:<numAgents>:<numSlots>[:<numCores>], zone configuration and RMS are taken from --zones and --rms")
+            ("macro-transitions", bpo::bool_switch()->default_value(false), "Let devices go through the Configure and Reset transitions on their own, one custom command per step instead of one per transition. Requires the ODC plugin of the same version in all devices")
+            ("pipelined-transitions", bpo::bool_switch()->default_value(false), "Send each device its next Configure and Reset transition as soon as it completed the previous one, instead of waiting for all devices after every transition. Ignored with --macro-transitions")
+            ("rollout", bpo::value<vector<string>>(&rolloutPolicies)->multitoken()->composing(), "Limit the devices going through a transition at the same time, released in waves as devices finish. Format: <transition>:<maxDevices>[:<maxPerHost>], e.g. InitTask:200:4, 0 means no limit. Applies to transitions sent one at a time, requests can override it")
+            ("scheduled-start", bpo::value<size_t>()->default_value(0), "Start all devices of a Start request at the same time, this many milliseconds after the request is sent to them. Requires synchronized clocks on all hosts. Start requests with rollout limits are rejected. 0 disables scheduling")
+            ("ordered-start-stop", bpo::bool_switch()->default_value(false), "Start and Stop devices layer by layer along the flow of data, derived from the push/pull and pub/sub channels of the devices: Start from the sinks, Stop from the sources. Ignored for Start with --scheduled-start")
+            ("adaptive-timeout-factor", bpo::value<double>()->default_value(0), "Derive the deadline of each state transition from previous ones of the same topology: 99th percentile of their completion times times this factor, scaled by the number of devices. Needs 5 completed transitions, the request timeout remains the upper bound. 0 disables")
+            ("adaptive-timeout-min", bpo::value<size_t>()->default_value(10), "Lower bound of the adaptive state transition deadlines in seconds")
+            ("session-pool", bpo::value<size_t>(&sessionPoolSize)->default_value(0), "Number of spare DDS sessions kept ready for Initialize/Run of new partitions, 0 disables")
             ("rms", bpo::value<string>(&rms)->default_value("localhost"), "Resource management system to be used by DDS  (localhost/ssh/slurm)")
             ("restore", bpo::value<std::string>(&restoreId)->default_value(""), "If set ODC will restore the sessions from file with specified ID")
             ("restore-dir", bpo::value<std::string>(&restoreDir)->default_value(smart_path(toString("$HOME/.ODC/restore/"))), "Directory where restore files are kept")
-            ("history-dir", bpo::value<std::string>(&historyDir)->default_value(smart_path(toString("$HOME/.ODC/history/"))), "Directory where history file (timestamp, partitionId, sessionId) is kept");
+            ("restore-parallelism", bpo::value<size_t>()->default_value(8), "Maximum number of partitions restored concurrently")
+            ("snapshot-interval", bpo::value<size_t>()->default_value(10), "Interval in seconds of the partition snapshots written next to the restore file, 0 disables them. Only used with --restore")
+            ("history-dir", bpo::value<std::string>(&historyDir)->default_value(smart_path(toString("$HOME/.ODC/history/"))), "Directory where history file (timestamp, partitionId, sessionId) is kept")
+            ("fsync", bpo::value<std::string>()->default_value("periodic"), "When appends to the restore journal and the history file are flushed to disk: always, periodic (every second) or never")
+            ("restore-compaction-interval", bpo::value<size_t>()->default_value(60), "Interval in seconds at which the restore journal is folded into the restore file")
+            ("topo-cache-dir", bpo::value<std::string>(&topoCacheDir)->default_value(smart_path(toString("$HOME/.ODC/topo-cache/"))), "Directory where the topology cache keeps topology files")
+            ("topo-cache-size", bpo::value<size_t>(&topoCacheSize)->default_value(512), "Size cap of the topology cache in MiB, 0 disables the cache")
+            ("topo-script-cache", bpo::bool_switch()->default_value(false), "Reuse the output of a topology script if the script and its declared inputs (--topo-script-inputs, --topo-script-env) are unchanged")
+            ("topo-script-inputs", bpo::value<vector<string>>(&topoScriptInputs)->multitoken()->composing(), "Files or directories the topology scripts depend on")
+            ("topo-script-env", bpo::value<vector<string>>(&topoScriptEnv)->multitoken()->composing(), "Names of environment variables the topology scripts depend on");
         CliHelper::addLogOptions(options, logConfig);
         CliHelper::addBatchOptions(options, batchOptions, batch);
 
@@ -89,9 +122,28 @@ int main(int argc, char** argv)
         controller.setTimeout(chrono::seconds(timeout));
         controller.setAgentWaitTimeout(agentWaitTimeoutStr);
         controller.setHistoryDir(historyDir);
+        controller.setPersistence(vm["fsync"].as<std::string>(), chrono::seconds(vm["restore-compaction-interval"].as<size_t>()));
         controller.setZoneCfgs(zonesStr);
         controller.setRMS(rms);
+        controller.setSubmitParallelism(submitParallelism);
+        controller.setSubmitSurplus(submitSurplus);
+        controller.setCollectionRecovery(vm["recover-collections"].as<bool>());
+        controller.setTaskRestart(vm["restart-expendable"].as<uint32_t>(), chrono::seconds(vm["restart-window"].as<size_t>()), chrono::seconds(vm["restart-timeout"].as<size_t>()));
+        controller.setAgentPools(agentPools);
+        controller.setSessionPool(sessionPoolSize);
+        controller.setMacroTransitions(vm["macro-transitions"].as<bool>());
+        controller.setPipelinedTransitions(vm["pipelined-transitions"].as<bool>());
+        controller.setRolloutPolicies(rolloutPolicies);
+        controller.setScheduledStart(chrono::milliseconds(vm["scheduled-start"].as<size_t>()));
+        controller.setOrderedStartStop(vm["ordered-start-stop"].as<bool>());
+        controller.setAdaptiveTimeouts(vm["adaptive-timeout-factor"].as<double>(), chrono::seconds(vm["adaptive-timeout-min"].as<size_t>()));
+        controller.setTopologyCache(topoCacheDir, topoCacheSize);
+        if (vm["topo-script-cache"].as<bool>()) {
+            controller.setTopologyScriptCache(topoScriptInputs, topoScriptEnv);
+        }
         controller.registerResourcePlugins(plugins);
+        controller.setRestoreParallelism(vm["restore-parallelism"].as<size_t>());
+        controller.setSnapshotInterval(chrono::seconds(vm["snapshot-interval"].as<size_t>()));
         if (!restoreId.empty()) {
             controller.restore(restoreId, restoreDir);
         }
@@ -13,6 +13,7 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/asio/post.hpp>
 
+#include <algorithm>
 #include <cstdlib>
 #include <initializer_list>
 #include <sstream>
@@ -35,6 +36,26 @@ auto ToString(T&&... t) -> std::string
     return ss.str();
 }
 
+/// @brief stable state reached once the given transition is done
+/// @param transition transition
+/// @return target state, Undefined for transitions without a stable target state
+DeviceState TargetState(Transition transition)
+{
+    switch (transition) {
+        case Transition::InitDevice:   return DeviceState::InitializingDevice;
+        case Transition::CompleteInit: return DeviceState::Initialized;
+        case Transition::Bind:         return DeviceState::Bound;
+        case Transition::Connect:      return DeviceState::DeviceReady;
+        case Transition::InitTask:     return DeviceState::Ready;
+        case Transition::Run:          return DeviceState::Running;
+        case Transition::Stop:         return DeviceState::Ready;
+        case Transition::ResetTask:    return DeviceState::DeviceReady;
+        case Transition::ResetDevice:  return DeviceState::Idle;
+        case Transition::End:          return DeviceState::Exiting;
+        default:                       return DeviceState::Undefined;
+    }
+}
+
 ODC::ODC(const string& name, const Plugin::Version version, const string& maintainer, const string& homepage, PluginServices* pluginServices)
     : Plugin(name, version, maintainer, homepage, pluginServices)
     , fDDSTaskId(dds::env_prop<dds::task_id>())
@@ -43,6 +64,9 @@ ODC::ODC(const string& name, const Plugin::Version version, const string& mainta
     , fDeviceTerminationRequested(false)
     , fUpdatesAllowed(false)
     , fWorkGuard(fWorkerQueue.get_executor())
+    , fSequenceRunning(false)
+    , fSequenceWorkGuard(fSequenceQueue.get_executor())
+    , fScheduleCancelled(false)
 {
     try {
         TakeDeviceControl();
@@ -99,6 +123,7 @@ ODC::ODC(const string& name, const Plugin::Version version, const string& mainta
                 } break;
                 case DeviceState::Exiting: {
                     fWorkGuard.reset();
+                    fSequenceWorkGuard.reset();
                     fDeviceTerminationRequested = true;
                     UnsubscribeFromDeviceStateChange();
                     ReleaseDeviceControl();
@@ -113,6 +138,10 @@ ODC::ODC(const string& name, const Plugin::Version version, const string& mainta
             fLastState = fCurrentState;
             fCurrentState = newState;
 
+            if (fSequenceRunning) {
+                fSequenceStates.Push(newState);
+            }
+
             lock_guard<mutex> lock{ fStateChangeSubscriberMutex };
             for (auto it = fStateChangeSubscribers.cbegin(); it != fStateChangeSubscribers.end();) {
                 // if a subscriber did not send a heartbeat in more than 3 times the promised interval,
@@ -133,6 +162,7 @@ ODC::ODC(const string& name, const Plugin::Version version, const string& mainta
         });
 
         StartWorkerThread();
+        StartSequenceThread();
 
         fDDS.Start();
     } catch (PluginServices::DeviceControlError& e) {
@@ -153,6 +183,11 @@ void ODC::StartWorkerThread()
     fWorkerThread = thread([this]() { fWorkerQueue.run(); });
 }
 
+void ODC::StartSequenceThread()
+{
+    fSequenceThread = thread([this]() { fSequenceQueue.run(); });
+}
+
 void ODC::FillChannelContainers()
 {
     try {
@@ -348,6 +383,26 @@ void ODC::HandleCmd(const string& id, odc::cc::Cmd& cmd, const string& cond, uin
                 fDDS.Send(outCmds.Serialize(), to_string(senderId));
             }
         } break;
+        case Type::change_state_sequence: {
+            auto _cmd = static_cast<ChangeStateSequence&>(cmd);
+            auto transitions(_cmd.GetTransitions());
+            if (transitions.empty()) {
+                break;
+            }
+            if (fSequenceRunning.exchange(true)) {
+                LOG(warn) << "Transition sequence requested by " << senderId << " while another one is in progress, ignoring it";
+                Cmds outCmds(make<TransitionStatus>(id, fDDSTaskId, Result::Failure, transitions.front(), GetCurrentDeviceState()));
+                fDDS.Send(outCmds.Serialize(), to_string(senderId));
+                break;
+            }
+            fSequenceStates.Clear();
+            boost::asio::post(fSequenceQueue, [this, id, transitions, props = _cmd.GetProps(), senderId]() {
+                RunSequence(id, transitions, props, senderId);
+            });
+        } break;
+        case Type::change_state_at: {
+            ScheduleTransition(id, static_cast<ChangeStateAt&>(cmd), senderId);
+        } break;
         case Type::dump_config: {
             stringstream ss;
             for (const auto& pKey : GetPropertyKeys()) {
@@ -426,8 +481,97 @@ void ODC::HandleCmd(const string& id, odc::cc::Cmd& cmd, const string& cond, uin
     }
 }
 
+void ODC::RunSequence(const string& id, const vector<Transition>& transitions, const vector<pair<string, string>>& props, uint64_t senderId)
+{
+    using namespace odc::cc;
+    // properties are meant to be set while the device is initializing, if the sequence gets there
+    const bool setPropsOnCompleteInit = find(transitions.cbegin(), transitions.cend(), Transition::CompleteInit) != transitions.cend();
+    bool propsSet = props.empty();
+
+    for (const auto transition : transitions) {
+        if (!propsSet && (!setPropsOnCompleteInit || transition == Transition::CompleteInit)) {
+            try {
+                fair::mq::Properties properties;
+                for (auto const& prop : props) {
+                    properties.insert({ prop.first, fair::mq::Property(prop.second) });
+                }
+                SetProperties(properties);
+                propsSet = true;
+            } catch (exception const& e) {
+                LOG(warn) << "Setting properties of the transition sequence failed: " << e.what();
+                Cmds outCmds(make<TransitionStatus>(id, fDDSTaskId, Result::Failure, transition, GetCurrentDeviceState()));
+                fDDS.Send(outCmds.Serialize(), to_string(senderId));
+                break;
+            }
+        }
+
+        if (!ChangeDeviceState(transition)) {
+            Cmds outCmds(make<TransitionStatus>(id, fDDSTaskId, Result::Failure, transition, GetCurrentDeviceState()));
+            fDDS.Send(outCmds.Serialize(), to_string(senderId));
+            break;
+        }
+
+        // intermediate states are published to the controller by the state change subscription
+        const DeviceState target = TargetState(transition);
+        DeviceState state = DeviceState::Undefined;
+        while (state != target && state != DeviceState::Error && state != DeviceState::Exiting) {
+            state = fSequenceStates.WaitForNext();
+        }
+        if (state != target) {
+            LOG(warn) << "Transition sequence aborted in " << state << " state during " << transition << " transition";
+            break;
+        }
+    }
+
+    fSequenceRunning = false;
+}
+
+void ODC::ScheduleTransition(const string& id, cc::ChangeStateAt cmd, uint64_t senderId)
+{
+    // a new schedule replaces a pending one
+    CancelScheduledTransition();
+
+    const chrono::system_clock::time_point startTime{ chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(cmd.GetTimestamp())) };
+    LOG(debug) << "Scheduling " << cmd.GetTransition() << " transition in " << chrono::duration_cast<chrono::milliseconds>(startTime - chrono::system_clock::now()).count() << " ms";
+
+    fScheduleThread = thread([this, id, cmd, startTime, senderId]() {
+        using namespace odc::cc;
+        {
+            unique_lock<mutex> lk(fScheduleMutex);
+            if (fScheduleCondition.wait_until(lk, startTime, [&] { return fScheduleCancelled; })) {
+                LOG(debug) << "Scheduled " << cmd.GetTransition() << " transition cancelled";
+                return;
+            }
+        }
+        // how late the transition starts: positive if the start time had already passed when the command arrived, or the timer fired late
+        const int64_t delay = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now() - startTime).count();
+        const Result result = ChangeDeviceState(cmd.GetTransition()) ? Result::Ok : Result::Failure;
+        Cmds outCmds(make<ScheduledTransition>(id, fDDSTaskId, cmd.GetRequestId(), result, cmd.GetTransition(), delay));
+        if (result == Result::Failure) {
+            outCmds.Add<TransitionStatus>(id, fDDSTaskId, Result::Failure, cmd.GetTransition(), GetCurrentDeviceState());
+        }
+        fDDS.Send(outCmds.Serialize(), to_string(senderId));
+    });
+}
+
+void ODC::CancelScheduledTransition()
+{
+    {
+        lock_guard<mutex> lk(fScheduleMutex);
+        fScheduleCancelled = true;
+    }
+    fScheduleCondition.notify_one();
+    if (fScheduleThread.joinable()) {
+        fScheduleThread.join();
+    }
+    lock_guard<mutex> lk(fScheduleMutex);
+    fScheduleCancelled = false;
+}
+
 ODC::~ODC()
 {
+    CancelScheduledTransition();
+
     UnsubscribeFromDeviceStateChange();
     ReleaseDeviceControl();
 
@@ -435,6 +579,15 @@ ODC::~ODC()
     if (fWorkerThread.joinable()) {
         fWorkerThread.join();
     }
+
+    fSequenceWorkGuard.reset();
+    if (fSequenceRunning) {
+        // wake up a sequence that waits for a state that will not come anymore
+        fSequenceStates.Push(DeviceState::Exiting);
+    }
+    if (fSequenceThread.joinable()) {
+        fSequenceThread.join();
+    }
 }
 
 } // namespace odc::plugins
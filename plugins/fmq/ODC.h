@@ -134,6 +134,7 @@ class ODC : public fair::mq::Plugin
 
   private:
     void StartWorkerThread();
+    void StartSequenceThread();
 
     void FillChannelContainers();
     void EmptyChannelContainers();
@@ -142,6 +143,9 @@ class ODC : public fair::mq::Plugin
     void PublishBoundChannels();
     void SubscribeForCustomCommands();
     void HandleCmd(const std::string& id, cc::Cmd& cmd, const std::string& cond, uint64_t senderId);
+    void RunSequence(const std::string& id, const std::vector<fair::mq::Transition>& transitions, const std::vector<std::pair<std::string, std::string>>& props, uint64_t senderId);
+    void ScheduleTransition(const std::string& id, cc::ChangeStateAt cmd, uint64_t senderId);
+    void CancelScheduledTransition();
 
     DDSSubscription fDDS;
     size_t fDDSTaskId;
@@ -166,6 +170,19 @@ class ODC : public fair::mq::Plugin
     std::thread fWorkerThread;
     boost::asio::io_context fWorkerQueue;
     boost::asio::executor_work_guard<boost::asio::executor> fWorkGuard;
+
+    // transition sequences run on their own thread, since the worker thread may block until the device is bound
+    std::atomic<bool> fSequenceRunning;
+    fair::mq::StateQueue fSequenceStates; // states reached while a sequence is running
+    std::thread fSequenceThread;
+    boost::asio::io_context fSequenceQueue;
+    boost::asio::executor_work_guard<boost::asio::executor> fSequenceWorkGuard;
+
+    // a scheduled transition waits for its start time on its own thread, until started or cancelled
+    std::thread fScheduleThread;
+    std::mutex fScheduleMutex;
+    std::condition_variable fScheduleCondition;
+    bool fScheduleCancelled;
 };
 
 inline fair::mq::Plugin::ProgOptions ODCPluginProgramOptions()
@@ -24,6 +24,7 @@ BOOST_AUTO_TEST_SUITE(format)
 BOOST_AUTO_TEST_CASE(construction)
 {
     auto const props(std::vector<std::pair<std::string, std::string>>({ { "k1", "v1" }, { "k2", "v2" } }));
+    auto const transitions(std::vector<Transition>({ Transition::InitDevice, Transition::CompleteInit, Transition::Bind }));
 
     Cmds checkStateCmds(make<CheckState>());
     Cmds changeStateCmds(make<ChangeState>(fair::mq::Transition::Stop));
@@ -40,6 +41,9 @@ BOOST_AUTO_TEST_CASE(construction)
     Cmds stateChangeCmds(make<StateChange>("somedeviceid", 123456, State::Running, State::Ready));
     Cmds propertiesCmds(make<Properties>("somedeviceid", 123456, 66, Result::Ok, props));
     Cmds propertiesSetCmds(make<PropertiesSet>("somedeviceid", 123456, 42, Result::Ok));
+    Cmds changeStateSequenceCmds(make<ChangeStateSequence>(77, transitions, props));
+    Cmds changeStateAtCmds(make<ChangeStateAt>(78, Transition::Run, 1700000000000000000));
+    Cmds scheduledTransitionCmds(make<ScheduledTransition>("somedeviceid", 123456, 78, Result::Ok, Transition::Run, 2500));
 
     BOOST_TEST(checkStateCmds.At(0).GetType() == Type::check_state);
 
@@ -103,11 +107,30 @@ BOOST_AUTO_TEST_CASE(construction)
     BOOST_TEST(static_cast<PropertiesSet&>(propertiesSetCmds.At(0)).GetTaskId() == 123456);
     BOOST_TEST(static_cast<PropertiesSet&>(propertiesSetCmds.At(0)).GetRequestId() == 42);
     BOOST_TEST(static_cast<PropertiesSet&>(propertiesSetCmds.At(0)).GetResult() == Result::Ok);
+
+    BOOST_TEST(changeStateSequenceCmds.At(0).GetType() == Type::change_state_sequence);
+    BOOST_TEST(static_cast<ChangeStateSequence&>(changeStateSequenceCmds.At(0)).GetRequestId() == 77);
+    BOOST_TEST(static_cast<ChangeStateSequence&>(changeStateSequenceCmds.At(0)).GetTransitions() == transitions);
+    BOOST_TEST(static_cast<ChangeStateSequence&>(changeStateSequenceCmds.At(0)).GetProps() == props);
+
+    BOOST_TEST(changeStateAtCmds.At(0).GetType() == Type::change_state_at);
+    BOOST_TEST(static_cast<ChangeStateAt&>(changeStateAtCmds.At(0)).GetRequestId() == 78);
+    BOOST_TEST(static_cast<ChangeStateAt&>(changeStateAtCmds.At(0)).GetTransition() == Transition::Run);
+    BOOST_TEST(static_cast<ChangeStateAt&>(changeStateAtCmds.At(0)).GetTimestamp() == 1700000000000000000);
+
+    BOOST_TEST(scheduledTransitionCmds.At(0).GetType() == Type::scheduled_transition);
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetDeviceId() == "somedeviceid");
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetTaskId() == 123456);
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetRequestId() == 78);
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetResult() == Result::Ok);
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetTransition() == Transition::Run);
+    BOOST_TEST(static_cast<ScheduledTransition&>(scheduledTransitionCmds.At(0)).GetDelay() == 2500);
 }
 
 void fillCommands(Cmds& cmds)
 {
     auto const props(std::vector<std::pair<std::string, std::string>>({ { "k1", "v1" }, { "k2", "v2" } }));
+    auto const transitions(std::vector<Transition>({ Transition::InitDevice, Transition::CompleteInit, Transition::Bind }));
 
     cmds.Add<CheckState>();
     cmds.Add<ChangeState>(Transition::Stop);
@@ -124,14 +147,18 @@ void fillCommands(Cmds& cmds)
     cmds.Add<StateChange>("somedeviceid", 123456, State::Running, State::Ready);
     cmds.Add<Properties>("somedeviceid", 123456, 66, Result::Ok, props);
     cmds.Add<PropertiesSet>("somedeviceid", 123456, 42, Result::Ok);
+    cmds.Add<ChangeStateSequence>(77, transitions, props);
+    cmds.Add<ChangeStateAt>(78, Transition::Run, 1700000000000000000);
+    cmds.Add<ScheduledTransition>("somedeviceid", 123456, 78, Result::Ok, Transition::Run, 2500);
 }
 
 void checkCommands(Cmds& cmds)
 {
-    BOOST_TEST(cmds.Size() == 15);
+    BOOST_TEST(cmds.Size() == 18);
 
     int count = 0;
     auto const props(std::vector<std::pair<std::string, std::string>>({ { "k1", "v1" }, { "k2", "v2" } }));
+    auto const transitions(std::vector<Transition>({ Transition::InitDevice, Transition::CompleteInit, Transition::Bind }));
 
     for (const auto& cmd : cmds) {
         switch (cmd->GetType()) {
@@ -213,13 +240,34 @@ void checkCommands(Cmds& cmds)
                 BOOST_TEST(static_cast<PropertiesSet&>(*cmd).GetRequestId() == 42);
                 BOOST_TEST(static_cast<PropertiesSet&>(*cmd).GetResult() == Result::Ok);
                 break;
+            case Type::change_state_sequence:
+                ++count;
+                BOOST_TEST(static_cast<ChangeStateSequence&>(*cmd).GetRequestId() == 77);
+                BOOST_TEST(static_cast<ChangeStateSequence&>(*cmd).GetTransitions() == transitions);
+                BOOST_TEST(static_cast<ChangeStateSequence&>(*cmd).GetProps() == props);
+                break;
+            case Type::change_state_at:
+                ++count;
+                BOOST_TEST(static_cast<ChangeStateAt&>(*cmd).GetRequestId() == 78);
+                BOOST_TEST(static_cast<ChangeStateAt&>(*cmd).GetTransition() == Transition::Run);
+                BOOST_TEST(static_cast<ChangeStateAt&>(*cmd).GetTimestamp() == 1700000000000000000);
+                break;
+            case Type::scheduled_transition:
+                ++count;
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetDeviceId() == "somedeviceid");
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetTaskId() == 123456);
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetRequestId() == 78);
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetResult() == Result::Ok);
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetTransition() == Transition::Run);
+                BOOST_TEST(static_cast<ScheduledTransition&>(*cmd).GetDelay() == 2500);
+                break;
             default:
                 BOOST_TEST(false);
                 break;
         }
     }
 
-    BOOST_TEST(count == 15);
+    BOOST_TEST(count == 18);
 }
 
 BOOST_AUTO_TEST_CASE(serialization)
@@ -36,7 +36,8 @@ struct AsyncOpFixture
 
 struct TopologyFixture
 {
-    TopologyFixture(std::string topoXMLPath)
+    /// @param activate if false, only the DDS session is created: no agents are submitted and no task runs
+    TopologyFixture(std::string topoXMLPath, bool activate = true)
         : mDDSTopo(std::move(topoXMLPath))
     {
         using namespace dds::tools_api;
@@ -57,6 +58,10 @@ struct TopologyFixture
             std::cerr << "Can't initialize log: " << e.what() << std::endl;
         }
 
+        if (!activate) {
+            return;
+        }
+
         SSubmitRequestData submitInfo;
         submitInfo.m_rms = "localhost";
         submitInfo.m_instances = 1;
@@ -8,14 +8,23 @@
 #include <boost/test/included/unit_test.hpp>
 
 #include "odc-fixtures.h"
+#include <odc/AgentPool.h>
 #include <odc/AsioAsyncOp.h>
 #include <odc/AsioBase.h>
 #include <odc/Topology.h>
+#include <odc/VirtualClock.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <boost/asio.hpp>
 #include <thread>
 
+#include <signal.h>
+
 using namespace boost::unit_test;
 using namespace odc::core;
 
@@ -99,6 +108,76 @@ BOOST_AUTO_TEST_CASE(timeout2)
     BOOST_CHECK_THROW(op.Complete(), RuntimeError);
 }
 
+BOOST_AUTO_TEST_CASE(timeout_virtual_clock)
+{
+    using namespace std::chrono_literals;
+    AsyncOpFixture f;
+    VirtualTimer timer(f.mIoContext.get_executor(), 1h);
+    AsioAsyncOp<DefaultExecutor, DefaultAllocator, void(std::error_code)> op(f.mIoContext.get_executor(), [](std::error_code ec) {
+        BOOST_CHECK_EQUAL(ec, MakeErrorCode(ErrorCode::OperationTimeout));
+    });
+    timer.async_wait([&op](boost::system::error_code ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            op.Timeout();
+        }
+    });
+
+    VirtualClock::advanceAndPoll(f.mIoContext, 59min);
+    BOOST_REQUIRE(!op.IsCompleted());
+    VirtualClock::advanceAndPoll(f.mIoContext, 1min);
+    BOOST_REQUIRE(op.IsCompleted());
+    BOOST_CHECK_THROW(op.Complete(), RuntimeError); // No completion after the timeout!
+}
+
+BOOST_AUTO_TEST_CASE(timeout_virtual_clock_many_ops)
+{
+    using namespace std::chrono_literals;
+    constexpr int num(10000);
+    AsyncOpFixture f;
+
+    int numTimedOut(0);
+    int numSucceeded(0);
+    std::vector<std::unique_ptr<VirtualTimer>> timers;
+    std::vector<std::unique_ptr<AsioAsyncOp<DefaultExecutor, DefaultAllocator, void(std::error_code)>>> ops;
+    timers.reserve(num);
+    ops.reserve(num);
+
+    for (int i = 0; i < num; ++i) {
+        // op i times out after (i + 1) virtual seconds
+        timers.push_back(std::make_unique<VirtualTimer>(f.mIoContext.get_executor(), std::chrono::seconds(i + 1)));
+        ops.push_back(std::make_unique<AsioAsyncOp<DefaultExecutor, DefaultAllocator, void(std::error_code)>>(
+            f.mIoContext.get_executor(), [&, i](std::error_code ec) {
+                timers[i]->cancel();
+                if (ec == MakeErrorCode(ErrorCode::OperationTimeout)) {
+                    ++numTimedOut;
+                } else if (!ec) {
+                    ++numSucceeded;
+                }
+            }));
+        timers[i]->async_wait([&, i](boost::system::error_code ec) {
+            if (ec != boost::asio::error::operation_aborted && !ops[i]->IsCompleted()) {
+                ops[i]->Timeout();
+            }
+        });
+    }
+
+    // every second op completes before its timeout
+    for (int i = 0; i < num; i += 2) {
+        ops[i]->Complete();
+    }
+    f.mIoContext.poll();
+    BOOST_CHECK_EQUAL(numSucceeded, num / 2);
+    BOOST_CHECK_EQUAL(numTimedOut, 0);
+
+    // half of the remaining ops time out
+    VirtualClock::advanceAndPoll(f.mIoContext, std::chrono::seconds(num / 2));
+    BOOST_CHECK_EQUAL(numTimedOut, num / 4);
+
+    VirtualClock::advanceAndPoll(f.mIoContext, std::chrono::seconds(num / 2));
+    BOOST_CHECK_EQUAL(numTimedOut, num / 2);
+    BOOST_CHECK_EQUAL(numSucceeded, num / 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END() // async_op
 
 template<typename Functor>
@@ -118,6 +197,119 @@ void full_device_lifecycle(Functor&& functor)
     }
 }
 
+/// @brief Topology next to the one given by --topo-file, where half of the processors take 1 s in ResetTask and the other half 1 s in ResetDevice
+std::string straggler_topo_file()
+{
+    return (std::filesystem::path(framework::master_test_suite().argv[2]).parent_path() / "odc-tests-straggler-topo.xml").string();
+}
+
+/// @brief Topology next to the one given by --topo-file, where the RestartedProcessor fails in InitDevice and its launcher starts it again 3 s later
+std::string restart_topo_file()
+{
+    return (std::filesystem::path(framework::master_test_suite().argv[2]).parent_path() / "odc-tests-restart-topo.xml").string();
+}
+
+/// @brief Runtime ID of the only task declared with the given name
+DDSTaskId task_id_by_name(dds::topology_api::CTopology& ddsTopo, const std::string& name)
+{
+    auto taskIt = ddsTopo.getRuntimeTaskIterator(nullptr);
+    auto it = std::find_if(taskIt.first, taskIt.second, [&](const auto& task) { return task.second.m_task->getName() == name; });
+    BOOST_REQUIRE(it != taskIt.second);
+    return it->first;
+}
+
+/// @brief Runtime IDs of all tasks declared with the given name
+std::vector<DDSTaskId> task_ids_by_name(dds::topology_api::CTopology& ddsTopo, const std::string& name)
+{
+    std::vector<DDSTaskId> ids;
+    auto taskIt = ddsTopo.getRuntimeTaskIterator(nullptr);
+    for (auto it = taskIt.first; it != taskIt.second; ++it) {
+        if (it->second.m_task->getName() == name) {
+            ids.push_back(it->first);
+        }
+    }
+    return ids;
+}
+
+/// @brief Kill the process of the task with SIGKILL, found by the DDS task and session IDs in its environment
+/// @return true if the process was found
+bool kill_task(Session& session, DDSTaskId taskId)
+{
+    std::stringstream ss;
+    ss << session.mDDSSession.getSessionID();
+    const std::string taskVar = "DDS_TASK_ID=" + std::to_string(taskId);
+    const std::string sessionVar = "DDS_SESSION_ID=" + ss.str();
+    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
+        const std::string pid = entry.path().filename().string();
+        if (pid.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        std::ifstream environ(entry.path() / "environ");
+        bool task = false;
+        bool session = false;
+        for (std::string var; std::getline(environ, var, '\0');) {
+            task = task || var == taskVar;
+            session = session || var == sessionVar;
+        }
+        if (task && session) {
+            return ::kill(std::stoi(pid), SIGKILL) == 0;
+        }
+    }
+    return false;
+}
+
+/// @brief Status of the task in the current state of the topology
+DeviceStatus device_status(const Topology& topo, DDSTaskId taskId)
+{
+    const auto state = topo.GetCurrentState();
+    auto it = std::find_if(state.cbegin(), state.cend(), [&](const DeviceStatus& ds) { return ds.taskId == taskId; });
+    BOOST_REQUIRE(it != state.cend());
+    return *it;
+}
+
+/// @brief Probe the task until it is taken back after its restart
+/// @return true if it was taken back before the deadline
+bool probe_until_restarted(Topology& topo, DDSTaskId taskId, std::chrono::seconds deadline)
+{
+    const auto end = std::chrono::steady_clock::now() + deadline;
+    while (std::chrono::steady_clock::now() < end) {
+        topo.ProbeTasks({ taskId });
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const auto restarted = topo.TakeRestartedTasks();
+        if (std::find(restarted.cbegin(), restarted.cend(), taskId) != restarted.cend()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Configure the topology, then roll out ResetTask under the given policy
+/// @return highest number of devices seen in ResettingTask at the same time and duration of the rollout
+std::pair<size_t, std::chrono::milliseconds> rollout_reset_task(Topology& topo, const RolloutPolicy& policy)
+{
+    for (auto transition : { TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind, TopoTransition::Connect, TopoTransition::InitTask }) {
+        BOOST_REQUIRE_EQUAL(topo.ChangeState(transition).first, std::error_code());
+    }
+
+    std::atomic<bool> done(false);
+    const auto start = std::chrono::steady_clock::now();
+    topo.AsyncChangeState(TopoTransition::ResetTask, "", Duration(0), policy, [&](std::error_code ec, TopoState) {
+        BOOST_CHECK_EQUAL(ec, std::error_code());
+        done = true;
+    });
+    // the stragglers stay in ResettingTask for 1 s, long enough to be seen by polling
+    size_t maxResetting = 0;
+    while (!done) {
+        const auto state = topo.GetCurrentState();
+        const size_t resetting = std::count_if(state.cbegin(), state.cend(), [](const DeviceStatus& ds) { return ds.state == DeviceState::ResettingTask; });
+        maxResetting = std::max(maxResetting, resetting);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_TEST_MESSAGE("ResetTask rollout with " << policy << ": " << duration.count() << " ms, at most " << maxResetting << " devices resetting at once");
+    return { maxResetting, duration };
+}
+
 BOOST_AUTO_TEST_SUITE(topology)
 
 BOOST_AUTO_TEST_CASE(construction)
@@ -286,6 +478,111 @@ BOOST_AUTO_TEST_CASE(async_change_state_concurrent)
     BOOST_CHECK_EQUAL(StateEqualsTo(currentState, DeviceState::InitializingDevice), true);
 }
 
+BOOST_AUTO_TEST_CASE(async_change_state_rollout_unlimited)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(straggler_topo_file());
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    const auto [maxResetting, duration] = rollout_reset_task(topo, RolloutPolicy());
+    // both stragglers reset at the same time
+    BOOST_CHECK_GE(maxResetting, 2);
+    BOOST_CHECK_GE(duration.count(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(async_change_state_rollout_max_devices)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(straggler_topo_file());
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    RolloutPolicy policy;
+    policy.mMaxDevices = 1;
+    const auto [maxResetting, duration] = rollout_reset_task(topo, policy);
+    // the stragglers reset one after the other
+    BOOST_CHECK_EQUAL(maxResetting, 1);
+    BOOST_CHECK_GE(duration.count(), 2000);
+    for (const auto& ds : topo.GetCurrentState()) {
+        BOOST_CHECK_EQUAL(ds.state, DeviceState::DeviceReady);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(async_change_state_rollout_max_per_host)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(straggler_topo_file());
+
+    // all devices run on the local host, the per-host limit bounds the whole rollout
+    Topology topo(f.mDDSTopo, f.mSession);
+    RolloutPolicy policy;
+    policy.mMaxDevices = 4;
+    policy.mMaxPerHost = 1;
+    const auto [maxResetting, duration] = rollout_reset_task(topo, policy);
+    BOOST_CHECK_EQUAL(maxResetting, 1);
+    BOOST_CHECK_GE(duration.count(), 2000);
+    for (const auto& ds : topo.GetCurrentState()) {
+        BOOST_CHECK_EQUAL(ds.state, DeviceState::DeviceReady);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(async_change_state_rollout_device_exited)
+{
+    using namespace std::chrono_literals;
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(straggler_topo_file());
+
+    // the exit of a straggler can be ignored, the rollout has to go on without it
+    const auto stragglers = task_ids_by_name(f.mDDSTopo, "SlowResetTaskProcessor");
+    BOOST_REQUIRE_EQUAL(stragglers.size(), 2);
+    f.mSession.mExpendableTasks.insert(stragglers.cbegin(), stragglers.cend());
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    for (auto transition : { TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind, TopoTransition::Connect, TopoTransition::InitTask }) {
+        BOOST_REQUIRE_EQUAL(topo.ChangeState(transition).first, std::error_code());
+    }
+
+    std::atomic<bool> done(false);
+    std::error_code result;
+    RolloutPolicy policy;
+    policy.mMaxDevices = 1;
+    topo.AsyncChangeState(TopoTransition::ResetTask, "", Duration(30000), policy, [&](std::error_code ec, TopoState) {
+        result = ec;
+        done = true;
+    });
+
+    // kill the straggler while it is the one device of the rollout in ResettingTask
+    DDSTaskId killed = 0;
+    const auto end = std::chrono::steady_clock::now() + 20s;
+    while (killed == 0 && !done && std::chrono::steady_clock::now() < end) {
+        for (const auto id : stragglers) {
+            if (device_status(topo, id).state == DeviceState::ResettingTask) {
+                BOOST_REQUIRE(kill_task(f.mSession, id));
+                killed = id;
+                break;
+            }
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    BOOST_REQUIRE_NE(killed, 0);
+
+    while (!done && std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(10ms);
+    }
+    BOOST_REQUIRE(done);
+    BOOST_CHECK_EQUAL(result, std::error_code());
+    for (const auto& ds : topo.GetCurrentState()) {
+        if (ds.taskId == killed) {
+            BOOST_CHECK(ds.ignored);
+        } else {
+            BOOST_CHECK_EQUAL(ds.state, DeviceState::DeviceReady);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(async_change_state_timeout)
 {
     BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
@@ -301,6 +598,28 @@ BOOST_AUTO_TEST_CASE(async_change_state_timeout)
     f.mIoContext.run();
 }
 
+BOOST_AUTO_TEST_CASE(async_change_state_timeout_virtual_clock)
+{
+    using namespace std::chrono_literals;
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    // the topology is not activated, so no device can reply before the timeout
+    TopologyFixture f(framework::master_test_suite().argv[2], false);
+
+    bool completed(false);
+    BasicTopology<DefaultExecutor, DefaultAllocator, VirtualClock> topo(f.mIoContext.get_executor(), f.mDDSTopo, f.mSession);
+    topo.AsyncChangeState(TopoTransition::InitDevice, "", 1h, [&completed](std::error_code ec, TopoState) {
+        BOOST_TEST_MESSAGE(ec);
+        BOOST_CHECK_EQUAL(ec, MakeErrorCode(ErrorCode::OperationTimeout));
+        completed = true;
+    });
+
+    VirtualClock::advanceAndPoll(f.mIoContext, 59min);
+    BOOST_REQUIRE(!completed);
+    VirtualClock::advanceAndPoll(f.mIoContext, 1min);
+    BOOST_REQUIRE(completed);
+}
+
 BOOST_AUTO_TEST_CASE(async_change_state_collection_view)
 {
     BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
@@ -383,6 +702,85 @@ BOOST_AUTO_TEST_CASE(change_state_full_device_lifecycle2)
     }
 }
 
+BOOST_AUTO_TEST_CASE(change_state_at)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(framework::master_test_suite().argv[2]);
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    for (auto transition : { TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind, TopoTransition::Connect, TopoTransition::InitTask }) {
+        BOOST_REQUIRE_EQUAL(topo.ChangeState(transition).first, std::error_code());
+    }
+
+    const auto start = std::chrono::system_clock::now() + std::chrono::seconds(1);
+    TransitionSkew skew;
+    const auto [ec, state] = topo.ChangeStateAt(TopoTransition::Run, start, "", Duration(0), skew);
+    BOOST_TEST_MESSAGE("Scheduled start: " << skew);
+    BOOST_REQUIRE_EQUAL(ec, std::error_code());
+    // no device starts before the start time, each reports how late it started
+    BOOST_CHECK(std::chrono::system_clock::now() >= start);
+    BOOST_CHECK_EQUAL(skew.mNumDevices, static_cast<size_t>(f.mSlots));
+    BOOST_CHECK_EQUAL(skew.mNumFailed, 0);
+    BOOST_CHECK_GE(skew.mMinDelay.count(), 0);
+    for (const auto& ds : state) {
+        BOOST_CHECK_EQUAL(ds.state, DeviceState::Running);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(change_state_at_passed)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(framework::master_test_suite().argv[2]);
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    for (auto transition : { TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind, TopoTransition::Connect, TopoTransition::InitTask }) {
+        BOOST_REQUIRE_EQUAL(topo.ChangeState(transition).first, std::error_code());
+    }
+
+    // a start time in the past starts the devices right away, reported as late by at least the time passed
+    TransitionSkew skew;
+    const auto [ec, state] = topo.ChangeStateAt(TopoTransition::Run, std::chrono::system_clock::now() - std::chrono::seconds(1), "", Duration(0), skew);
+    BOOST_TEST_MESSAGE("Scheduled start in the past: " << skew);
+    BOOST_REQUIRE_EQUAL(ec, std::error_code());
+    BOOST_CHECK_EQUAL(skew.mNumDevices, static_cast<size_t>(f.mSlots));
+    BOOST_CHECK_GE(skew.mMinDelay.count(), std::chrono::nanoseconds(std::chrono::seconds(1)).count());
+}
+
+BOOST_AUTO_TEST_CASE(change_state_pipelined_stragglers)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(straggler_topo_file());
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    const std::vector<TopoTransition> bind{ TopoTransition::InitDevice, TopoTransition::CompleteInit, TopoTransition::Bind };
+    const std::vector<TopoTransition> connect{ TopoTransition::Connect, TopoTransition::InitTask };
+    const std::vector<TopoTransition> reset{ TopoTransition::ResetTask, TopoTransition::ResetDevice };
+    const auto configure = [&]() {
+        BOOST_REQUIRE_EQUAL(topo.ChangeStatePipelined(bind).first, std::error_code());
+        BOOST_REQUIRE_EQUAL(topo.ChangeStatePipelined(connect).first, std::error_code());
+    };
+
+    configure();
+    auto start = std::chrono::steady_clock::now();
+    for (auto transition : reset) {
+        BOOST_REQUIRE_EQUAL(topo.ChangeState(transition).first, std::error_code());
+    }
+    const auto lockstep = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    configure();
+    start = std::chrono::steady_clock::now();
+    BOOST_REQUIRE_EQUAL(topo.ChangeStatePipelined(reset).first, std::error_code());
+    const auto pipelined = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    BOOST_TEST_MESSAGE("Reset with stragglers: lockstep " << lockstep.count() << " ms, pipelined " << pipelined.count() << " ms");
+    // lockstep waits for both kinds of stragglers one after the other, pipelined only for the slower one
+    BOOST_CHECK_GE(lockstep.count(), 2000);
+    BOOST_CHECK_LT(pipelined.count(), lockstep.count() - 500);
+}
+
 BOOST_AUTO_TEST_CASE(set_properties)
 {
     BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
@@ -726,6 +1124,157 @@ BOOST_AUTO_TEST_CASE(underlying_session_terminated)
     BOOST_TEST_CHECKPOINT("Topology destructed.");
 }
 
+BOOST_AUTO_TEST_CASE(replace_collections_reverted)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(framework::master_test_suite().argv[2]);
+
+    auto colIt = f.mDDSTopo.getRuntimeCollectionIterator();
+    BOOST_REQUIRE(colIt.first != colIt.second);
+    const DDSCollectionId failed = colIt.first->first;
+    CollectionInfo& colInfo = f.mSession.mCollections["Pipeline"];
+    colInfo.name = "Pipeline";
+    colInfo.nCurrent = 1;
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    BOOST_CHECK(topo.GetIgnoredCollections().empty());
+
+    // a replacement registered before its activation counts towards its collection
+    const DDSCollectionId added = failed + 1000;
+    topo.ReplaceCollections({ failed }, { { added, "Pipeline" } });
+    BOOST_CHECK_EQUAL(colInfo.nCurrent, 2);
+    BOOST_CHECK_EQUAL(colInfo.mRuntimeCollectionAgents.count(added), 1);
+    BOOST_CHECK_EQUAL(f.mSession.mRuntimeCollectionIndex.count(added), 1);
+
+    // a failed activation leaves the collection as it was, the replaced collection is ignored again
+    topo.RevertReplaceCollections({ failed }, { { added, "Pipeline" } });
+    BOOST_CHECK_EQUAL(colInfo.nCurrent, 1);
+    BOOST_CHECK_EQUAL(colInfo.mRuntimeCollectionAgents.count(added), 0);
+    BOOST_CHECK_EQUAL(f.mSession.mRuntimeCollectionIndex.count(added), 0);
+    BOOST_CHECK(topo.GetIgnoredCollections() == std::vector<DDSCollectionId>{ failed });
+}
+
+BOOST_AUTO_TEST_CASE(restart_expendable)
+{
+    using namespace std::chrono_literals;
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(restart_topo_file());
+
+    const DDSTaskId restartedId = task_id_by_name(f.mDDSTopo, "RestartedProcessor");
+    f.mSession.mExpendableTasks.insert(restartedId);
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    std::atomic<size_t> numCalls(0);
+    topo.SetTaskRestartHandler([&](DDSTaskId) { ++numCalls; });
+
+    // the failure of the expendable task does not fail the transition
+    BOOST_CHECK_EQUAL(topo.ChangeState(TopoTransition::InitDevice).first, std::error_code());
+    BOOST_CHECK(topo.TakeCrashedTasks() == std::vector<DDSTaskId>{ restartedId });
+    BOOST_CHECK(device_status(topo, restartedId).ignored);
+
+    // the launcher starts the processor again, the new process reports in Idle and is taken back
+    BOOST_REQUIRE(probe_until_restarted(topo, restartedId, 30s));
+    const DeviceStatus status = device_status(topo, restartedId);
+    BOOST_CHECK(!status.ignored);
+    BOOST_CHECK_EQUAL(status.restarts, 1);
+    BOOST_CHECK_EQUAL(status.state, DeviceState::Idle);
+    BOOST_CHECK_EQUAL(numCalls, 2); // crash and restart
+
+    // brought to the state of the topology, it takes part in the following transitions
+    BOOST_CHECK_EQUAL(topo.ChangeState(TopoTransition::InitDevice, ".*RestartedProcessor.*").first, std::error_code());
+    BOOST_CHECK_EQUAL(topo.ChangeState(TopoTransition::CompleteInit).first, std::error_code());
+    BOOST_CHECK(topo.StateEqualsTo(DeviceState::Initialized));
+}
+
+BOOST_AUTO_TEST_CASE(restart_expendable_early_probe)
+{
+    using namespace std::chrono_literals;
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(restart_topo_file());
+
+    const DDSTaskId restartedId = task_id_by_name(f.mDDSTopo, "RestartedProcessor");
+    f.mSession.mExpendableTasks.insert(restartedId);
+
+    Topology topo(f.mDDSTopo, f.mSession);
+    topo.SetTaskRestartHandler([](DDSTaskId) {});
+    BOOST_CHECK_EQUAL(topo.ChangeState(TopoTransition::InitDevice).first, std::error_code());
+    BOOST_CHECK(topo.TakeCrashedTasks() == std::vector<DDSTaskId>{ restartedId });
+
+    // within the 3 s delay of the launcher no process of the task answers, or only the failed one in Error or Exiting
+    topo.ProbeTasks({ restartedId });
+    std::this_thread::sleep_for(1s);
+    BOOST_CHECK(topo.TakeRestartedTasks().empty());
+    BOOST_CHECK(device_status(topo, restartedId).ignored);
+    BOOST_CHECK_EQUAL(device_status(topo, restartedId).restarts, 0);
+
+    // a later probe reaches the new process
+    BOOST_REQUIRE(probe_until_restarted(topo, restartedId, 30s));
+    BOOST_CHECK(!device_status(topo, restartedId).ignored);
+    BOOST_CHECK_EQUAL(device_status(topo, restartedId).restarts, 1);
+}
+
+BOOST_AUTO_TEST_CASE(update_in_place_reverted)
+{
+    BOOST_REQUIRE(framework::master_test_suite().argc >= 3);
+    BOOST_REQUIRE_EQUAL(framework::master_test_suite().argv[1], "--topo-file");
+    TopologyFixture f(framework::master_test_suite().argv[2]);
+
+    // requirements of the running topology, as extracted for it
+    Session& session = f.mSession;
+    session.mDDSTopo = std::make_shared<dds::topology_api::CTopology>(f.mDDSTopo);
+    session.mTopoFilePath = f.mDDSTopo.getFilepath();
+    session.mTopoHash = "running";
+    CollectionInfo& colInfo = session.mCollections["Pipeline"];
+    colInfo.name = "Pipeline";
+    colInfo.nCurrent = 1;
+    auto colIt = f.mDDSTopo.getRuntimeCollectionIterator();
+    BOOST_REQUIRE(colIt.first != colIt.second);
+    const DDSCollectionId colId = colIt.first->first;
+    colInfo.mRuntimeCollectionAgents.emplace(colId, 0);
+    session.mRuntimeCollectionIndex.emplace(colId, &colInfo);
+    session.mNinfo.try_emplace("Pipeline", CollectionNInfo{ 1, 1, 0, "online" });
+    session.mAgentGroupInfo.emplace_back(AgentGroupInfo{ "online", "online", "unknown", 1, 0, 6, 0 });
+
+    Topology topo(f.mDDSTopo, session);
+    BOOST_REQUIRE_EQUAL(topo.ChangeState(TopoTransition::InitDevice).first, std::error_code());
+
+    // the update prepares the requirements of the new topology, then fails before switching over
+    auto previous = session.snapshotTopology();
+    session.mTopoFilePath = straggler_topo_file();
+    session.mTopoHash = "updated";
+    session.parseTopology();
+    session.mCollections.clear();
+    session.mCollections["Stragglers"].name = "Stragglers";
+    session.mNinfo.clear();
+    session.mAgentGroupInfo.clear();
+    session.mExpendableTasks.insert(1);
+    session.mDDSTopo = session.takeParsedTopology();
+    session.restoreTopology(std::move(previous));
+
+    BOOST_CHECK_EQUAL(session.mDDSTopo->getFilepath(), f.mDDSTopo.getFilepath());
+    BOOST_CHECK_EQUAL(session.mTopoFilePath, f.mDDSTopo.getFilepath());
+    BOOST_CHECK_EQUAL(session.mTopoHash, "running");
+    BOOST_CHECK(session.mParsedDDSTopo == nullptr);
+    BOOST_REQUIRE_EQUAL(session.mCollections.size(), 1);
+    BOOST_REQUIRE_EQUAL(session.mCollections.count("Pipeline"), 1);
+    BOOST_CHECK_EQUAL(session.mNinfo.count("Pipeline"), 1);
+    BOOST_REQUIRE_EQUAL(session.mAgentGroupInfo.size(), 1);
+    BOOST_CHECK_EQUAL(session.mAgentGroupInfo.at(0).name, "online");
+    BOOST_CHECK(session.mExpendableTasks.empty());
+    // the collection index points into the restored collections
+    BOOST_REQUIRE_EQUAL(session.mRuntimeCollectionIndex.count(colId), 1);
+    BOOST_CHECK(session.mRuntimeCollectionIndex.at(colId) == &(session.mCollections.at("Pipeline")));
+
+    // the FairMQ topology continues with the restored DDS topology: an in-place update to it keeps all devices and their state
+    BOOST_CHECK_EQUAL(topo.UpdateTopology(*(session.mDDSTopo), ""), 0);
+    BOOST_CHECK_EQUAL(topo.GetNumTasks(""), f.mSlots);
+    BOOST_CHECK_EQUAL(topo.ChangeState(TopoTransition::CompleteInit).first, std::error_code());
+    BOOST_CHECK_EQUAL(AggregateState(topo.GetCurrentState()), AggregatedState::Initialized);
+}
+
 BOOST_AUTO_TEST_SUITE_END() // topology
 
 BOOST_AUTO_TEST_SUITE(multiple_topologies)
@@ -830,4 +1379,101 @@ BOOST_AUTO_TEST_CASE(change_state_full_lifecycle_concurrent)
 
 BOOST_AUTO_TEST_SUITE_END() // multiple_topologies
 
+BOOST_AUTO_TEST_SUITE(agent_pool)
+
+/// @brief Pool spec of a single localhost agent
+DDSSubmitParams localhost_pool_params()
+{
+    DDSSubmitParams params;
+    params.mRMS = "localhost";
+    params.mZone = "online";
+    params.mAgentGroup = "online";
+    params.mNumAgents = 1;
+    params.mNumSlots = 2;
+    return params;
+}
+
+/// @brief Wait until the only pool entry is ready with a session other than the given one
+/// @return DDS session ID of the ready entry, empty if it did not become ready before the deadline
+std::string wait_until_ready(const AgentPool& pool, const std::string& previousSessionID, std::chrono::seconds deadline)
+{
+    const auto end = std::chrono::steady_clock::now() + deadline;
+    while (std::chrono::steady_clock::now() < end) {
+        const auto status = pool.status();
+        BOOST_REQUIRE_EQUAL(status.size(), 1);
+        if (status.at(0).mState == "READY" && status.at(0).mDDSSessionID != previousSessionID) {
+            return status.at(0).mDDSSessionID;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return "";
+}
+
+BOOST_AUTO_TEST_CASE(take_and_refill)
+{
+    using namespace std::chrono_literals;
+    AgentPool pool;
+    pool.configure({ localhost_pool_params() }, 60s);
+
+    const std::string sessionID = wait_until_ready(pool, "", 60s);
+    BOOST_REQUIRE(!sessionID.empty());
+
+    // a request for more agents than pooled adopts the entry, a different agent group does not
+    DDSSubmitParams other = localhost_pool_params();
+    other.mAgentGroup = "calib";
+    DDSSubmitParams requested = localhost_pool_params();
+    requested.mNumAgents = 2;
+    BOOST_CHECK(!pool.take({ other }));
+    const auto lease = pool.take({ other, requested });
+    BOOST_REQUIRE(lease);
+    BOOST_CHECK_EQUAL(lease->mSessionID, sessionID);
+    BOOST_CHECK_EQUAL(lease->mParamsIndex, 1);
+    BOOST_CHECK_EQUAL(pool.status().at(0).mNumAdopted, 1);
+
+    // dropping the handle of the pool does not stop the adopted session
+    dds::tools_api::CSession adopted;
+    adopted.attach(lease->mSessionID);
+    BOOST_CHECK(adopted.IsRunning());
+    dds::tools_api::SAgentCountRequest::response_t res;
+    adopted.syncSendRequest<dds::tools_api::SAgentCountRequest>(dds::tools_api::SAgentCountRequest::request_t(), res);
+    BOOST_CHECK_EQUAL(res.m_activeSlotsCount, 2);
+
+    // the taken entry is refilled with a new session
+    BOOST_CHECK(!wait_until_ready(pool, sessionID, 60s).empty());
+
+    adopted.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(expired_session)
+{
+    using namespace std::chrono_literals;
+    AgentPool pool;
+    // no periodic checks during the test, only take() finds the expired entry
+    pool.configure({ localhost_pool_params() }, 60s, 600s);
+
+    const std::string sessionID = wait_until_ready(pool, "", 60s);
+    BOOST_REQUIRE(!sessionID.empty());
+
+    dds::tools_api::CSession pooled;
+    pooled.attach(sessionID);
+    pooled.shutdown();
+
+    // the stopped session is not handed out, but refilled
+    BOOST_CHECK(!pool.take({ localhost_pool_params() }));
+    const std::string refilledID = wait_until_ready(pool, sessionID, 60s);
+    BOOST_REQUIRE(!refilledID.empty());
+
+    const auto lease = pool.take({ localhost_pool_params() });
+    BOOST_REQUIRE(lease);
+    BOOST_CHECK_EQUAL(lease->mSessionID, refilledID);
+    BOOST_CHECK_EQUAL(pool.status().at(0).mNumAdopted, 1);
+
+    dds::tools_api::CSession adopted;
+    adopted.attach(lease->mSessionID);
+    BOOST_CHECK(adopted.IsRunning());
+    adopted.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END() // agent_pool
+
 int main(int argc, char* argv[]) { return boost::unit_test::unit_test_main(init_unit_test, argc, argv); }
@@ -147,6 +147,47 @@ BOOST_AUTO_TEST_CASE(odc_rp_same_zones)
     testParameterSet(ddsParams.at(4), "localhost", "online", "online", 1, 2, 2, 0, "", "");
 }
 
+BOOST_AUTO_TEST_CASE(odc_rp_same_zones_surplus)
+{
+    string plugin = "odc-rp-same";
+    string resources = "<submit><rms>localhost</rms><agents>1</agents><zone>calib</zone><slots>2</slots></submit>"
+                       "<submit><rms>localhost</rms><agents>1</agents><zone>online</zone><slots>2</slots></submit>"
+                       "<submit><rms>localhost</rms><agents>1</agents><zone>online</zone><slots>2</slots></submit>"
+                       "<submit><rms>localhost</rms><agents>1</agents><zone>online</zone><slots>2</slots></submit>"
+                       "<submit><rms>localhost</rms><agents>1</agents><zone>online</zone><slots>2</slots></submit>";
+    string partitionId = "test_partition_" + uuid();
+    CommonParams common(partitionId, 0, 10);
+
+    Session session;
+    session.mPartitionID = partitionId;
+    session.mTopoFilePath = kODCDataDir + "/ex-topo-groupname.xml";
+    Controller::extractRequirements(common, session);
+
+    DDSSubmit ddsSubmit;
+    vector<DDSSubmitParams> ddsParams;
+    ddsParams = ddsSubmit.makeParams(plugin, resources, common, session.mZoneInfo, session.mNinfo, seconds(10));
+    const vector<DDSSubmitParams> required = ddsParams;
+
+    Controller::addSurplusParams(common, ddsParams, 0);
+    BOOST_TEST(ddsParams.size() == 5);
+
+    // 50% of the 4 agents of the nMin protected online group, one submission per agent on localhost. The calib group has no nMin.
+    Controller::addSurplusParams(common, ddsParams, 50);
+    printParams(ddsParams);
+    BOOST_TEST(ddsParams.size() == 7);
+    for (size_t i = 0; i < required.size(); ++i) {
+        compareParameterSets(ddsParams.at(i), required.at(i));
+    }
+    testParameterSet(ddsParams.at(5), "localhost", "online", "online", 1, 0, 2, 0, "", "");
+    testParameterSet(ddsParams.at(6), "localhost", "online", "online", 1, 0, 2, 0, "", "");
+
+    // rounded up
+    vector<DDSSubmitParams> ddsParams2 = required;
+    Controller::addSurplusParams(common, ddsParams2, 10);
+    BOOST_TEST(ddsParams2.size() == 6);
+    testParameterSet(ddsParams2.at(5), "localhost", "online", "online", 1, 0, 2, 0, "", "");
+}
+
 BOOST_AUTO_TEST_CASE(odc_rp_epn_slurm_zones)
 {
     string rms = "slurm";
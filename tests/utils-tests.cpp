@@ -11,7 +11,31 @@
 #define BOOST_TEST_ALTERNATIVE_INIT_API
 #include <boost/test/included/unit_test.hpp>
 
+#include <odc/Admission.h>
+#include <odc/AgentTracker.h>
+#include <odc/DataFlow.h>
+#include <odc/InFlightWindow.h>
 #include <odc/MiscUtils.h>
+#include <odc/PartitionWorker.h>
+#include <odc/Persistence.h>
+#include <odc/RestartLimiter.h>
+#include <odc/Restore.h>
+#include <odc/Snapshot.h>
+#include <odc/TopologyCache.h>
+#include <odc/TopologyScriptCache.h>
+#include <odc/TransitionStats.h>
+
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace odc::core;
 using namespace boost::unit_test;
@@ -81,6 +105,663 @@ BOOST_AUTO_TEST_CASE(test_edge_cases)
     BOOST_CHECK_EQUAL(parseTimeString("3600", std::chrono::seconds(60)).count(), 3600);
 }
 
+BOOST_AUTO_TEST_CASE(test_content_hash)
+{
+    // FIPS 180-2 test vectors
+    BOOST_CHECK_EQUAL(contentHash(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    BOOST_CHECK_EQUAL(contentHash("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    BOOST_CHECK_EQUAL(contentHash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    BOOST_CHECK_EQUAL(contentHash(std::string(1000000, 'a')), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+BOOST_AUTO_TEST_CASE(test_topology_script_cache)
+{
+    namespace bfs = boost::filesystem;
+    const bfs::path dir{ bfs::temp_directory_path() / bfs::unique_path() };
+    bfs::create_directories(dir);
+    const bfs::path input{ dir / "input.cfg" };
+    const bfs::path output{ dir / "topology.xml" };
+    std::ofstream(input.string()) << "a";
+    std::ofstream(output.string()) << "<topology/>";
+    unsetenv("ODC_TEST_SCRIPT_ENV");
+
+    TopologyScriptCache cache;
+    cache.configure(true, { dir.string() }, { "ODC_TEST_SCRIPT_ENV" });
+
+    const std::string key{ cache.key("echo topology") };
+    std::string file;
+    BOOST_CHECK(!cache.get(key, file));
+    cache.put(key, output.string(), std::chrono::milliseconds(100));
+    BOOST_CHECK(cache.get(cache.key("echo topology"), file));
+    BOOST_CHECK_EQUAL(file, output.string());
+    BOOST_CHECK_NE(cache.key("echo other topology"), key);
+
+    setenv("ODC_TEST_SCRIPT_ENV", "1", 1);
+    BOOST_CHECK_NE(cache.key("echo topology"), key);
+    unsetenv("ODC_TEST_SCRIPT_ENV");
+    BOOST_CHECK_EQUAL(cache.key("echo topology"), key);
+
+    std::ofstream(input.string()) << "b";
+    BOOST_CHECK_NE(cache.key("echo topology"), key);
+
+    const TopologyScriptCacheStats stats{ cache.stats() };
+    BOOST_CHECK_EQUAL(stats.mHits, 1);
+    BOOST_CHECK_EQUAL(stats.mMisses, 1);
+    BOOST_CHECK_EQUAL(stats.mSavedTime.count(), 100);
+
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_topology_cache_put_pin)
+{
+    namespace bfs = boost::filesystem;
+    const bfs::path dir{ bfs::temp_directory_path() / bfs::unique_path() };
+
+    TopologyCache cache;
+    cache.configure(dir.string(), 1024);
+    const std::string h = TopologyCache::hash("<topology a/>");
+    {
+        TopologyCache::Pin pin = cache.put("<topology a/>");
+        BOOST_CHECK_EQUAL(pin.hash(), h);
+        BOOST_CHECK_EQUAL(cache.numPins(h), 1);
+        // identical content is stored once
+        TopologyCache::Pin pin2 = cache.put("<topology a/>");
+        BOOST_CHECK_EQUAL(cache.numPins(h), 2);
+        BOOST_CHECK(bfs::equivalent(cache.filePath(h), dir / (h + ".xml")));
+    }
+    BOOST_CHECK_EQUAL(cache.numPins(h), 0);
+
+    // known by its hash and by its file, e.g. for a session restored from the cached file
+    {
+        TopologyCache::Pin pin = cache.pin(h);
+        BOOST_CHECK_EQUAL(cache.numPins(h), 1);
+    }
+    std::optional<TopologyCache::Pin> filePin = cache.pinFile((dir / (h + ".xml")).string());
+    BOOST_REQUIRE(filePin.has_value());
+    BOOST_CHECK_EQUAL(filePin->hash(), h);
+    BOOST_CHECK(!cache.pinFile((dir / "unknown.xml").string()).has_value());
+    BOOST_CHECK_THROW(cache.pin(TopologyCache::hash("<topology b/>")), std::runtime_error);
+    filePin.reset();
+    BOOST_CHECK_EQUAL(cache.numPins(h), 0);
+
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_topology_cache_evict)
+{
+    namespace bfs = boost::filesystem;
+    const bfs::path dir{ bfs::temp_directory_path() / bfs::unique_path() };
+    const std::string a(10, 'a');
+    const std::string b(10, 'b');
+    const std::string c(10, 'c');
+    const std::string d(10, 'd');
+    const auto cached = [&](const std::string& content) { return bfs::exists(dir / (TopologyCache::hash(content) + ".xml")); };
+
+    TopologyCache cache;
+    cache.configure(dir.string(), 20);
+    // a session runs from a, b is released after its use
+    auto pinA = std::make_shared<TopologyCachePin>(cache.put(a));
+    cache.put(b);
+    BOOST_CHECK(cached(a) && cached(b));
+
+    // over the cap: the least recently used entry goes, unless it is pinned
+    std::optional<TopologyCache::Pin> pinC(cache.put(c));
+    BOOST_CHECK(cached(a));
+    BOOST_CHECK(!cached(b));
+    BOOST_CHECK(cached(c));
+
+    // pins survive a reconfiguration of the cache
+    cache.configure(dir.string(), 20);
+    BOOST_CHECK_EQUAL(cache.numPins(TopologyCache::hash(a)), 1);
+    pinC.reset();
+    cache.put(d);
+    BOOST_CHECK(cached(a));
+    BOOST_CHECK(!cached(c));
+    BOOST_CHECK(cached(d));
+
+    // once the session is gone its file can be evicted
+    pinA.reset();
+    cache.put(b);
+    BOOST_CHECK(!cached(a));
+    BOOST_CHECK(cached(b) && cached(d));
+
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_topology_cache_collision)
+{
+    namespace bfs = boost::filesystem;
+    const bfs::path dir{ bfs::temp_directory_path() / bfs::unique_path() };
+    bfs::create_directories(dir);
+    // a file under the hash of other content, as for a hash collision
+    std::ofstream((dir / (TopologyCache::hash("<topology a/>") + ".xml")).string()) << "<topology b/>";
+
+    TopologyCache cache;
+    cache.configure(dir.string(), 1024);
+    BOOST_CHECK_THROW(cache.put("<topology a/>"), std::runtime_error);
+    BOOST_CHECK_EQUAL(cache.numPins(TopologyCache::hash("<topology a/>")), 0);
+
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_restore_spare_sessions)
+{
+    RestoreData data;
+    data.mPartitions.push_back(RestorePartition("p1", "s1"));
+    data.mPartitions.push_back(RestorePartition("p1-standby", "s4", "p1"));
+    data.mSpareSessions = { "s2", "s3" };
+
+    const RestoreData restored(data.toPT());
+    BOOST_REQUIRE_EQUAL(restored.mPartitions.size(), 2);
+    BOOST_CHECK_EQUAL(restored.mPartitions.at(0).mPartitionID, "p1");
+    BOOST_CHECK_EQUAL(restored.mPartitions.at(0).mDDSSessionId, "s1");
+    BOOST_CHECK(restored.mPartitions.at(0).mStandbyFor.empty());
+    BOOST_CHECK_EQUAL(restored.mPartitions.at(1).mStandbyFor, "p1");
+    BOOST_REQUIRE_EQUAL(restored.mSpareSessions.size(), 2);
+    BOOST_CHECK_EQUAL(restored.mSpareSessions.at(0), "s2");
+    BOOST_CHECK_EQUAL(restored.mSpareSessions.at(1), "s3");
+
+    // restore files written before spare sessions were recorded
+    boost::property_tree::ptree pt;
+    pt.add_child("sessions", data.toPT().get_child("sessions"));
+    BOOST_CHECK(RestoreData(pt).mSpareSessions.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_restore_journal)
+{
+    RestoreData from;
+    from.mPartitions.push_back(RestorePartition("p1", "s1"));
+    from.mPartitions.push_back(RestorePartition("p2", "s2"));
+    RestoreData to;
+    to.mPartitions.push_back(RestorePartition("p1", "s3"));
+    to.mPartitions.push_back(RestorePartition("p4", "s4"));
+    to.mPartitions.push_back(RestorePartition("p1-standby", "s6", "p1"));
+    to.mSpareSessions = { "s5" };
+
+    const auto records = RestoreJournal::Diff(from, to);
+    BOOST_CHECK_EQUAL(records.size(), 5);
+    BOOST_CHECK(RestoreJournal::Diff(to, to).empty());
+
+    // records are applied in order, a torn last one is skipped
+    std::string journal;
+    for (const auto& r : records) {
+        journal += r + "\n";
+    }
+    RestoreData replayed(from);
+    std::istringstream is(journal + "-\tp1");
+    BOOST_CHECK_EQUAL(RestoreJournal::Replay(is, replayed), 5);
+    BOOST_REQUIRE_EQUAL(replayed.mPartitions.size(), 3);
+    BOOST_CHECK_EQUAL(replayed.mPartitions.at(0).mPartitionID, "p1");
+    BOOST_CHECK_EQUAL(replayed.mPartitions.at(0).mDDSSessionId, "s3");
+    BOOST_CHECK(replayed.mPartitions.at(0).mStandbyFor.empty());
+    BOOST_CHECK_EQUAL(replayed.mPartitions.at(1).mPartitionID, "p4");
+    BOOST_CHECK_EQUAL(replayed.mPartitions.at(2).mPartitionID, "p1-standby");
+    BOOST_CHECK_EQUAL(replayed.mPartitions.at(2).mStandbyFor, "p1");
+    BOOST_REQUIRE_EQUAL(replayed.mSpareSessions.size(), 1);
+    BOOST_CHECK_EQUAL(replayed.mSpareSessions.at(0), "s5");
+
+    // replaying on data that already contains the records changes nothing
+    std::istringstream again(journal);
+    RestoreJournal::Replay(again, replayed);
+    BOOST_CHECK_EQUAL(replayed.mPartitions.size(), 3);
+    BOOST_CHECK(RestoreJournal::Diff(replayed, to).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_persistence)
+{
+    const auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    {
+        Persistence persistence;
+        Persistence::Config config;
+        config.mFsync = Persistence::FsyncPolicy::Always;
+        config.mCompactionInterval = std::chrono::hours(1);
+        persistence.configure(config);
+
+        RestoreData data;
+        data.mPartitions.push_back(RestorePartition("p1", "s1"));
+        persistence.restore("id", dir.string(), data);
+        data.mPartitions.push_back(RestorePartition("p2", "s2"));
+        persistence.restore("id", dir.string(), data);
+        persistence.history(dir.string(), "line1\n");
+        persistence.history(dir.string(), "line2\n");
+        persistence.flush();
+
+        // not compacted yet: the changes are in the journal
+        BOOST_CHECK(boost::filesystem::file_size(dir / "odc_id.journal") > 0);
+        BOOST_CHECK_EQUAL(RestoreFile("id", dir.string()).read().mPartitions.size(), 2);
+    }
+    // compacted when stopping
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(dir / "odc_id.journal"), 0);
+    BOOST_CHECK(boost::filesystem::exists(dir / "odc_id.json"));
+    BOOST_CHECK_EQUAL(RestoreFile("id", dir.string()).read().mPartitions.size(), 2);
+
+    std::ifstream history((dir / "odc_session_history.log").string());
+    const std::string content((std::istreambuf_iterator<char>(history)), std::istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL(content, "line1\nline2\n");
+    boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_agent_tracker)
+{
+    using namespace std::chrono_literals;
+    AgentTracker tracker;
+    std::atomic<int> numUp{ 0 };
+    std::atomic<int> numQueries{ 0 };
+    // every query finds one more agent with 2 slots, alternating between two groups
+    AgentTracker::Query query = [&]() -> std::optional<AgentTracker::Agents> {
+        ++numQueries;
+        std::this_thread::sleep_for(10ms);
+        AgentTracker::Agents agents;
+        const int n = ++numUp;
+        for (int i = 1; i <= n; ++i) {
+            AgentTracker::Agent agent;
+            agent.mID = i;
+            agent.mGroup = (i % 2 == 0) ? "even" : "odd";
+            agent.mNumSlots = 2;
+            agents.push_back(agent);
+        }
+        return agents;
+    };
+
+    // concurrent waits share the queries
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    auto groups = std::async(std::launch::async, [&]() {
+        return tracker.waitUntil(query, [](const auto& groupSlots, size_t) { return groupSlots.count("even") > 0 && groupSlots.at("even") >= 4; }, deadline, 1ms);
+    });
+    const bool total = tracker.waitUntil(query, [](const auto&, size_t numSlots) { return numSlots >= 8; }, deadline, 1ms);
+    BOOST_CHECK(total);
+    BOOST_CHECK(groups.get());
+    // how the two waits interleave depends on the scheduling, only the minimum number of queries is certain
+    const int numQueriesWaited = numQueries.load();
+    BOOST_CHECK_GE(numQueriesWaited, 4);
+    BOOST_CHECK_GE(tracker.numSlots(), 8);
+    BOOST_CHECK_GE(tracker.groupSlots().at("odd"), 4);
+
+    // an already reached condition needs no query, unless a fresh result is asked for
+    BOOST_CHECK(tracker.waitUntil(query, [](const auto&, size_t numSlots) { return numSlots >= 8; }, deadline, 1ms, false));
+    BOOST_CHECK_EQUAL(numQueries.load(), numQueriesWaited);
+    BOOST_CHECK(tracker.waitUntil(query, [](const auto&, size_t numSlots) { return numSlots >= 8; }, deadline, 1ms));
+    BOOST_CHECK_GT(numQueries.load(), numQueriesWaited);
+
+    // shut down agents are removed right away
+    const size_t numAgents = tracker.agents().size();
+    const size_t numSlots = tracker.numSlots();
+    tracker.remove(1);
+    BOOST_CHECK_EQUAL(tracker.numSlots(), numSlots - 2);
+    BOOST_CHECK_EQUAL(tracker.agents().size(), numAgents - 1);
+
+    // incomplete answers leave the table as it is, and time out
+    AgentTracker::Query failing = []() -> std::optional<AgentTracker::Agents> { return std::nullopt; };
+    BOOST_CHECK(!tracker.waitUntil(failing, [](const auto&, size_t numSlots) { return numSlots >= 100; }, std::chrono::steady_clock::now() + 50ms, 1ms));
+    BOOST_CHECK_EQUAL(tracker.agents().size(), numAgents - 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_agent_tracker_down)
+{
+    AgentTracker tracker;
+    std::vector<uint64_t> down;
+    tracker.setDownHandler([&](const AgentTracker::Agent& agent) {
+        // the handler runs without the table locked
+        BOOST_CHECK_EQUAL(tracker.agents().size(), 2);
+        down.push_back(agent.mID);
+    });
+
+    AgentTracker::Agents agents;
+    for (uint64_t id = 1; id <= 3; ++id) {
+        AgentTracker::Agent agent;
+        agent.mID = id;
+        agent.mGroup = "online";
+        agent.mNumSlots = 1;
+        agents.push_back(agent);
+    }
+    tracker.update(agents);
+    BOOST_CHECK(down.empty());
+
+    // agents that disappear are reported, shut down ones are not
+    tracker.remove(1);
+    agents.erase(agents.begin(), agents.begin() + 2);
+    agents.push_back(AgentTracker::Agent{});
+    agents.back().mID = 4;
+    tracker.update(agents);
+    BOOST_CHECK_EQUAL(down.size(), 1);
+    BOOST_CHECK_EQUAL(down.at(0), 2);
+
+    // a cleared handler is not called anymore
+    tracker.setDownHandler(nullptr);
+    tracker.update({});
+    BOOST_CHECK_EQUAL(down.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_admission)
+{
+    using namespace std::chrono_literals;
+    Admission admission;
+
+    std::atomic<bool> overlappingAdmitted{ false };
+    std::atomic<bool> partitionAdmitted{ false };
+    std::future<void> overlapping;
+    std::future<void> partition;
+    {
+        // disjoint task sets are admitted concurrently
+        const auto a{ admission.admitTasks([]() { return Admission::Tasks{ 1, 2 }; }) };
+        const auto b{ admission.admitTasks([]() { return Admission::Tasks{ 3 }; }) };
+        BOOST_CHECK_EQUAL(admission.numActive(), 2);
+
+        // overlapping task sets and the whole partition wait
+        overlapping = std::async(std::launch::async, [&]() {
+            const auto c{ admission.admitTasks([]() { return Admission::Tasks{ 2, 4 }; }) };
+            overlappingAdmitted = true;
+        });
+        partition = std::async(std::launch::async, [&]() {
+            const auto d{ admission.admitPartition() };
+            partitionAdmitted = true;
+        });
+        std::this_thread::sleep_for(100ms);
+        BOOST_CHECK(!overlappingAdmitted);
+        BOOST_CHECK(!partitionAdmitted);
+    }
+    overlapping.get();
+    partition.get();
+    BOOST_CHECK(overlappingAdmitted);
+    BOOST_CHECK(partitionAdmitted);
+    BOOST_CHECK_EQUAL(admission.numActive(), 0);
+
+    std::atomic<bool> otherAdmitted{ false };
+    std::future<void> other;
+    {
+        // an empty task set is admitted like the whole partition
+        const auto a{ admission.admitTasks([]() { return Admission::Tasks{}; }) };
+        other = std::async(std::launch::async, [&]() {
+            const auto b{ admission.admitTasks([]() { return Admission::Tasks{ 5 }; }) };
+            otherAdmitted = true;
+        });
+        std::this_thread::sleep_for(100ms);
+        BOOST_CHECK(!otherAdmitted);
+    }
+    other.get();
+    BOOST_CHECK(otherAdmitted);
+    BOOST_CHECK_EQUAL(admission.numActive(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_data_flow_layers)
+{
+    // sampler (1, 2) -push/pull-> processor (3, 4) -push/pull-> sink (5), monitor (6) subscribes to the processors,
+    // control (7) only has a req channel and a pull channel nobody pushes to
+    const std::unordered_map<uint64_t, DataFlow::Props> props{
+        { 1, { { "chans.data1.0.type", "push" } } },
+        { 2, { { "chans.data1.0.type", "push" } } },
+        { 3, { { "chans.data1.0.type", "pull" }, { "chans.data2.0.type", "push" }, { "chans.mon.0.type", "pub" } } },
+        { 4, { { "chans.data1.0.type", "pull" }, { "chans.data2.0.type", "push" }, { "chans.mon.0.type", "pub" } } },
+        { 5, { { "chans.data2.0.type", "pull" }, { "chans.data2.1.type", "pull" } } },
+        { 6, { { "chans.mon.0.type", "sub" } } },
+        { 7, { { "chans.ctrl.0.type", "req" }, { "chans.unused.0.type", "pull" } } }
+    };
+    const DataFlow flow(DataFlow::FromChannelTypes(props));
+    BOOST_REQUIRE_EQUAL(flow.mLayers.size(), 3);
+    BOOST_CHECK(flow.mLayers.at(0) == (std::vector<uint64_t>{ 1, 2, 7 }));
+    BOOST_CHECK(flow.mLayers.at(1) == (std::vector<uint64_t>{ 3, 4 }));
+    BOOST_CHECK(flow.mLayers.at(2) == (std::vector<uint64_t>{ 5, 6 }));
+    BOOST_CHECK_EQUAL(flow.mNumCyclic, 0);
+
+    // a feedback channel from the sink to the processors forms a cycle, placed last with everything behind it
+    auto cyclicProps(props);
+    cyclicProps.at(5).push_back({ "chans.feedback.0.type", "push" });
+    cyclicProps.at(3).push_back({ "chans.feedback.0.type", "pull" });
+    const DataFlow cyclic(DataFlow::FromChannelTypes(cyclicProps));
+    BOOST_REQUIRE_EQUAL(cyclic.mLayers.size(), 3);
+    BOOST_CHECK(cyclic.mLayers.at(0) == (std::vector<uint64_t>{ 1, 2, 7 }));
+    BOOST_CHECK(cyclic.mLayers.at(1) == (std::vector<uint64_t>{ 4 }));
+    BOOST_CHECK(cyclic.mLayers.at(2) == (std::vector<uint64_t>{ 3, 5, 6 }));
+    BOOST_CHECK_EQUAL(cyclic.mNumCyclic, 3);
+
+    // a processor pushing back into the channel it pulls from only waits for the other producers of it,
+    // while the other consumers of the channel wait for it
+    auto selfProps(props);
+    selfProps.at(4).push_back({ "chans.data1.1.type", "push" });
+    selfProps.at(6).push_back({ "chans.data1.0.type", "pull" });
+    const DataFlow self(DataFlow::FromChannelTypes(selfProps));
+    BOOST_REQUIRE_EQUAL(self.mLayers.size(), 4);
+    BOOST_CHECK(self.mLayers.at(0) == (std::vector<uint64_t>{ 1, 2, 7 }));
+    BOOST_CHECK(self.mLayers.at(1) == (std::vector<uint64_t>{ 4 }));
+    BOOST_CHECK(self.mLayers.at(2) == (std::vector<uint64_t>{ 3 }));
+    BOOST_CHECK(self.mLayers.at(3) == (std::vector<uint64_t>{ 5, 6 }));
+    BOOST_CHECK_EQUAL(self.mNumCyclic, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_transition_stats)
+{
+    using namespace std::chrono_literals;
+    TransitionStats stats;
+    for (int i = 1; i <= 10; ++i) {
+        stats.add("topo", "InitTask", std::chrono::milliseconds(i * 1000), 100);
+    }
+
+    // disabled by default
+    BOOST_CHECK(!stats.deadline("topo", "InitTask", 100).has_value());
+
+    TransitionStats::Policy policy;
+    policy.mFactor = 2;
+    policy.mMinDeadline = 1s;
+    stats.setPolicy(policy);
+    // p99 of 1..10 s is 10 s
+    BOOST_CHECK(stats.deadline("topo", "InitTask", 100) == std::make_optional(20000ms));
+    // scaled up for more devices, not down for fewer
+    BOOST_CHECK(stats.deadline("topo", "InitTask", 200) == std::make_optional(40000ms));
+    BOOST_CHECK(stats.deadline("topo", "InitTask", 10) == std::make_optional(20000ms));
+    // no history for other topologies and transitions
+    BOOST_CHECK(!stats.deadline("other", "InitTask", 100).has_value());
+    BOOST_CHECK(!stats.deadline("topo", "Run", 100).has_value());
+
+    // bounded below, and only given after enough transitions
+    for (int i = 0; i < 4; ++i) {
+        stats.add("topo", "Run", 10ms, 100);
+    }
+    BOOST_CHECK(!stats.deadline("topo", "Run", 100).has_value());
+    stats.add("topo", "Run", 10ms, 100);
+    BOOST_CHECK(stats.deadline("topo", "Run", 100) == std::make_optional(1000ms));
+}
+
+BOOST_AUTO_TEST_CASE(test_partition_snapshot)
+{
+    PartitionSnapshot snapshot;
+    snapshot.mPartitionID = "p1";
+    snapshot.mDDSSessionID = "s1";
+    snapshot.mTopoFilePath = "/tmp/topo.xml";
+    snapshot.mRunNr = 42;
+    DeviceStatus ds(true, 7, 3);
+    ds.lastState = DeviceState::Ready;
+    ds.state = DeviceState::Running;
+    ds.exitCode = 1;
+    ds.signal = 9;
+    ds.restarts = 2;
+    snapshot.mStates.push_back(ds);
+    snapshot.mDetails.mTasks.push_back(TaskDetails{ 11, 12, 7, 3, "main/col/task", "host1", "/wrk", "job1" });
+    snapshot.mDetails.mCollections.push_back(CollectionDetails{ 11, 3, "main/col", "host1", "/wrk", "job1" });
+    snapshot.mDetails.mAgents.emplace_back(11, AgentInfo{ 4, 1 });
+
+    const std::string encoded = snapshot.Encode();
+    const PartitionSnapshot decoded = PartitionSnapshot::Decode(encoded);
+    BOOST_CHECK_EQUAL(decoded.mPartitionID, "p1");
+    BOOST_CHECK_EQUAL(decoded.mDDSSessionID, "s1");
+    BOOST_CHECK_EQUAL(decoded.mTopoFilePath, "/tmp/topo.xml");
+    BOOST_CHECK_EQUAL(decoded.mRunNr, 42);
+    BOOST_REQUIRE_EQUAL(decoded.mStates.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.mStates.at(0).taskId, 7);
+    BOOST_CHECK_EQUAL(decoded.mStates.at(0).collectionId, 3);
+    BOOST_CHECK(decoded.mStates.at(0).expendable);
+    BOOST_CHECK(!decoded.mStates.at(0).ignored);
+    BOOST_CHECK(decoded.mStates.at(0).lastState == DeviceState::Ready);
+    BOOST_CHECK(decoded.mStates.at(0).state == DeviceState::Running);
+    BOOST_CHECK_EQUAL(decoded.mStates.at(0).exitCode, 1);
+    BOOST_CHECK_EQUAL(decoded.mStates.at(0).signal, 9);
+    BOOST_CHECK_EQUAL(decoded.mStates.at(0).restarts, 2);
+    BOOST_REQUIRE_EQUAL(decoded.mDetails.mTasks.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.mDetails.mTasks.at(0).mPath, "main/col/task");
+    BOOST_CHECK_EQUAL(decoded.mDetails.mTasks.at(0).mRMSJobID, "job1");
+    BOOST_REQUIRE_EQUAL(decoded.mDetails.mCollections.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.mDetails.mCollections.at(0).mCollectionID, 3);
+    BOOST_REQUIRE_EQUAL(decoded.mDetails.mAgents.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.mDetails.mAgents.at(0).first, 11);
+    BOOST_CHECK_EQUAL(decoded.mDetails.mAgents.at(0).second.numSlots, 4);
+
+    // truncated and foreign data is rejected
+    BOOST_CHECK_THROW(PartitionSnapshot::Decode(encoded.substr(0, encoded.size() - 1)), std::runtime_error);
+    BOOST_CHECK_THROW(PartitionSnapshot::Decode("not a snapshot"), std::runtime_error);
+
+    // written atomically and read back from the restore directory
+    const auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    SnapshotFile file("restore", "p1", dir.string());
+    BOOST_CHECK(!file.read().has_value());
+    BOOST_REQUIRE(file.write(encoded));
+    const auto read = file.read();
+    BOOST_REQUIRE(read.has_value());
+    BOOST_CHECK_EQUAL(read->mRunNr, 42);
+    file.remove();
+    BOOST_CHECK(!file.read().has_value());
+    boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_in_flight_window)
+{
+    using namespace std::chrono_literals;
+    // requests are acknowledged asynchronously, in the order they were sent
+    const auto submit = [](size_t maxInFlight, size_t num) {
+        InFlightWindow window(maxInFlight);
+        std::vector<std::thread> acks;
+        const bool done = window.run(num, std::chrono::steady_clock::now() + 10s, [&](size_t) {
+            acks.emplace_back([&]() {
+                std::this_thread::sleep_for(20ms);
+                window.done();
+            });
+        });
+        for (auto& t : acks) {
+            t.join();
+        }
+        BOOST_CHECK(done);
+        BOOST_CHECK_EQUAL(acks.size(), num);
+        return window.maxSeen();
+    };
+
+    BOOST_CHECK_EQUAL(submit(1, 5), 1); // one after another
+    BOOST_CHECK_EQUAL(submit(0, 5), 1);
+    BOOST_CHECK_EQUAL(submit(3, 10), 3);
+    BOOST_CHECK_EQUAL(submit(8, 4), 4);
+
+    // requests that are not acknowledged before the deadline stop the sending
+    InFlightWindow window(2);
+    std::vector<size_t> sent;
+    BOOST_CHECK(!window.run(4, std::chrono::steady_clock::now() + 50ms, [&](size_t i) { sent.push_back(i); }));
+    BOOST_CHECK(sent == std::vector<size_t>({ 0, 1 }));
+}
+
+BOOST_AUTO_TEST_CASE(test_partition_worker)
+{
+    std::mutex mtx;
+    std::vector<std::string> runs;
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    PartitionWorker worker([&](const std::string& partitionID) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            runs.push_back(partitionID);
+            if (runs.size() == 1) {
+                started.set_value();
+            }
+        }
+        released.wait();
+    });
+
+    // the first run blocks the worker, partitions waiting behind it are scheduled once
+    worker.schedule("a");
+    started.get_future().wait();
+    worker.schedule("b");
+    worker.schedule("b");
+    worker.schedule("a"); // scheduled again while running
+    worker.schedule("b");
+    release.set_value();
+    worker.flush();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        BOOST_CHECK_EQUAL(runs.size(), 3);
+        BOOST_CHECK_EQUAL(runs.at(0), "a");
+        BOOST_CHECK_EQUAL(runs.at(1), "b");
+        BOOST_CHECK_EQUAL(runs.at(2), "a");
+    }
+    BOOST_CHECK_EQUAL(worker.numRuns(), 3);
+
+    // failing work does not stop the worker, nothing is run after stop
+    PartitionWorker failing([&](const std::string&) { throw std::runtime_error("failed"); });
+    failing.schedule("a");
+    failing.flush();
+    failing.schedule("b");
+    failing.flush();
+    BOOST_CHECK_EQUAL(failing.numRuns(), 2);
+    failing.stop();
+    failing.schedule("c");
+    failing.flush();
+    BOOST_CHECK_EQUAL(failing.numRuns(), 2);
+
+    // delayed partitions run once they are due, rescheduling earlier moves them forward
+    std::vector<std::string> delayedRuns;
+    PartitionWorker delayed([&](const std::string& partitionID) {
+        std::lock_guard<std::mutex> lock(mtx);
+        delayedRuns.push_back(partitionID);
+    });
+    const auto start = std::chrono::steady_clock::now();
+    delayed.schedule("late", std::chrono::milliseconds(200));
+    delayed.schedule("soon", std::chrono::milliseconds(50));
+    delayed.schedule("moved", std::chrono::seconds(60));
+    delayed.schedule("moved", std::chrono::milliseconds(100));
+    delayed.schedule("soon", std::chrono::seconds(60)); // already due earlier
+    delayed.flush();
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        BOOST_REQUIRE_EQUAL(delayedRuns.size(), 3);
+        BOOST_CHECK_EQUAL(delayedRuns.at(0), "soon");
+        BOOST_CHECK_EQUAL(delayedRuns.at(1), "moved");
+        BOOST_CHECK_EQUAL(delayedRuns.at(2), "late");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_restart_limiter)
+{
+    using namespace std::chrono;
+    RestartLimiter::Config config;
+    config.mMaxRestarts = 3;
+    config.mWindow = seconds(60);
+    config.mBackoff = milliseconds(100);
+    RestartLimiter limiter(config);
+    const auto t0 = steady_clock::now();
+
+    // backoff doubles with the restarts in the window
+    auto due = limiter.admit(1, t0);
+    BOOST_REQUIRE(due.has_value());
+    BOOST_CHECK(*due == t0 + milliseconds(100));
+    due = limiter.admit(1, t0 + seconds(1));
+    BOOST_REQUIRE(due.has_value());
+    BOOST_CHECK(*due == t0 + seconds(1) + milliseconds(200));
+    due = limiter.admit(1, t0 + seconds(2));
+    BOOST_REQUIRE(due.has_value());
+    BOOST_CHECK(*due == t0 + seconds(2) + milliseconds(400));
+    BOOST_CHECK_EQUAL(limiter.numRestarts(1, t0 + seconds(2)), 3);
+
+    // a crash loop is given up, other tasks are not affected
+    BOOST_CHECK(!limiter.admit(1, t0 + seconds(3)).has_value());
+    BOOST_CHECK(limiter.admit(2, t0 + seconds(3)).has_value());
+
+    // restarts leave the window over time
+    BOOST_CHECK_EQUAL(limiter.numRestarts(1, t0 + seconds(60)), 2);
+    due = limiter.admit(1, t0 + seconds(60));
+    BOOST_REQUIRE(due.has_value());
+    BOOST_CHECK(*due == t0 + seconds(60) + milliseconds(400));
+
+    // no restarts when disabled
+    RestartLimiter disabled;
+    BOOST_CHECK(!disabled.admit(1, t0).has_value());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 int main(int argc, char* argv[])